@@ -0,0 +1,212 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+Allocator throughput: tcalloc, dlmalloc, and the C library malloc.
+
+Each thread keeps a working set of live objects and replaces a random
+object in each step: the old object is freed and a new one allocated.
+Object sizes follow a web server style mix: 60% are 16 to 128 bytes,
+30% up to 1 KB, 9% up to 8 KB and 1% up to 64 KB. The program reports
+nanoseconds per malloc/free pair for 1 thread and for the number of
+threads given on the command line. tcalloc and dlmalloc manage a
+64 MB region.
+
+Usage: alloc [threads] [steps per thread]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <tcalloc.h>
+#include <dlmalloc.h>
+
+#define LIVE_OBJECTS 4096
+#define POOL_SIZE (64*1024*1024)
+
+typedef struct
+{
+   const char* name;
+   void* (*malloc)(size_t size);
+   void (*free)(void* ptr);
+   void (*threadExit)(void);
+} Allocator;
+
+typedef struct
+{
+   const Allocator* alloc;
+   long steps;
+   unsigned int seed;
+   int failed;
+} Worker;
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static unsigned int
+rnd(unsigned int* seed)
+{
+   *seed = *seed * 1103515245 + 12345;
+   return *seed >> 8;
+}
+
+
+static size_t
+randomSize(unsigned int* seed)
+{
+   unsigned int r = rnd(seed) % 100;
+   if(r < 60)
+      return 16 + rnd(seed) % 113;
+   if(r < 90)
+      return 129 + rnd(seed) % 896;
+   if(r < 99)
+      return 1025 + rnd(seed) % 7168;
+   return 16385 + rnd(seed) % 49152;
+}
+
+
+static void*
+runWorker(void* arg)
+{
+   Worker* w = (Worker*)arg;
+   void** live = (void**)calloc(LIVE_OBJECTS, sizeof(void*));
+   long i;
+   if(!live)
+   {
+      w->failed = 1;
+      return 0;
+   }
+   for(i=0 ; i < w->steps ; i++)
+   {
+      unsigned int ix = rnd(&w->seed) % LIVE_OBJECTS;
+      size_t size = randomSize(&w->seed);
+      if(live[ix])
+         w->alloc->free(live[ix]);
+      if( ! (live[ix] = w->alloc->malloc(size)) )
+      {
+         w->failed = 1;
+         break;
+      }
+      *(char*)live[ix] = (char)i;
+   }
+   for(i=0 ; i < LIVE_OBJECTS ; i++)
+   {
+      if(live[i])
+         w->alloc->free(live[i]);
+   }
+   free(live);
+   if(w->alloc->threadExit)
+      w->alloc->threadExit();
+   return 0;
+}
+
+
+static double
+run(const Allocator* alloc, int threads, long steps)
+{
+   pthread_t tid[64];
+   Worker w[64];
+   double start;
+   int i;
+   for(i=0 ; i < threads ; i++)
+   {
+      w[i].alloc = alloc;
+      w[i].steps = steps;
+      w[i].seed = 1234 + i;
+      w[i].failed = 0;
+   }
+   start = now();
+   for(i=0 ; i < threads ; i++)
+      pthread_create(&tid[i], 0, runWorker, &w[i]);
+   for(i=0 ; i < threads ; i++)
+      pthread_join(tid[i], 0);
+   start = now() - start;
+   for(i=0 ; i < threads ; i++)
+   {
+      if(w[i].failed)
+      {
+         fprintf(stderr, "%s: out of memory\n", alloc->name);
+         exit(1);
+      }
+   }
+   return start / (steps * threads) * 1e9;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   static const Allocator allocators[] = {
+      {"tcalloc", tcalloc, tcfree, tcalloc_flushThreadCache},
+      {"dlmalloc", dlmalloc, dlfree, 0},
+      {"malloc", malloc, free, 0}
+   };
+   int threads = argc > 1 ? atoi(argv[1]) : 4;
+   long steps = argc > 2 ? atol(argv[2]) : 2000000;
+   size_t freePages;
+   char* tcPool;
+   char* dlPool;
+   unsigned int i;
+   if(threads < 1 || threads > 64 || steps <= 0)
+   {
+      fprintf(stderr, "Usage: %s [threads (1-64)] [steps per thread]\n",
+              argv[0]);
+      return 1;
+   }
+   if( ! (tcPool = (char*)malloc(POOL_SIZE)) ||
+       ! (dlPool = (char*)malloc(POOL_SIZE)) )
+   {
+      fprintf(stderr, "Out of memory\n");
+      return 1;
+   }
+   init_tcalloc(tcPool, tcPool + POOL_SIZE);
+   init_dlmalloc(dlPool, dlPool + POOL_SIZE);
+   freePages = tcalloc_freePages();
+   printf("%-10s %14s %14s\n", "", "1 thread", "threads");
+   for(i=0 ; i < sizeof(allocators)/sizeof(allocators[0]) ; i++)
+   {
+      double one = run(allocators+i, 1, steps);
+      double many = run(allocators+i, threads, steps);
+      printf("%-10s %8.1f ns/op %8.1f ns/op (%d)\n",
+             allocators[i].name, one, many, threads);
+   }
+   if(tcalloc_freePages() != freePages)
+   {
+      fprintf(stderr, "tcalloc: %lu bytes not returned\n",
+              (unsigned long)(freePages - tcalloc_freePages()));
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,248 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+/*
+Client side cost of a TLS handshake with and without the certificate
+chain verification cache (SharkSsl_setCertCacheSize).
+
+A client and a server SharkSslCon run in the same process and exchange
+the handshake records through memory, thus no network time is
+included. Only the CPU time spent in the client's
+SharkSslCon_decrypt calls is counted. Session resumption is not used,
+so the client receives and validates the server's certificate chain in
+every handshake. Two clients, one with the cache enabled, take turns
+so that both see the same system load.
+
+Usage: certcache ca.pem chain.pem key.pem [handshakes]
+  ca.pem     the root CA trusted by the client
+  chain.pem  the server certificate followed by its intermediates
+  key.pem    the server's private key
+See README.md for how to create a test PKI with openssl.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SharkSSL.h>
+
+typedef struct
+{
+   U8 data[32*1024];
+   int len;
+} Pipe;
+
+typedef struct
+{
+   SharkSslCon* scon;
+   Pipe* in;
+   Pipe* out;
+   double time;
+   BaBool done;
+} Peer;
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static char*
+readFile(const char* name, U32* size)
+{
+   FILE* fp = fopen(name, "rb");
+   char* buf;
+   long len;
+   if(!fp)
+   {
+      perror(name);
+      exit(1);
+   }
+   fseek(fp, 0, SEEK_END);
+   len = ftell(fp);
+   rewind(fp);
+   buf = (char*)malloc(len+1);
+   if(!buf || fread(buf, 1, len, fp) != (size_t)len)
+   {
+      fprintf(stderr, "Cannot read %s\n", name);
+      exit(1);
+   }
+   buf[len]=0;
+   fclose(fp);
+   if(size)
+      *size=(U32)len;
+   return buf;
+}
+
+
+/* Feed the data waiting in the peer's input pipe to SharkSslCon and
+   append the handshake data it produces to the output pipe. Returns
+   -1 on error.
+*/
+static int
+Peer_run(Peer* o)
+{
+   double start = now();
+   U16 len = 0;
+   for(;;)
+   {
+      switch(SharkSslCon_decrypt(o->scon, len))
+      {
+         case SharkSslCon_Handshake:
+         {
+            U16 n = SharkSslCon_getHandshakeDataLen(o->scon);
+            if(n)
+            {
+               memcpy(o->out->data+o->out->len,
+                      SharkSslCon_getHandshakeData(o->scon), n);
+               o->out->len += n;
+               SharkSslCon_setHandshakeDataSent(o->scon, n);
+            }
+            if(SharkSslCon_isHandshakeComplete(o->scon))
+               o->done=TRUE;
+            len=0;
+            break;
+         }
+
+         case SharkSslCon_NeedMoreData:
+            if( ! o->in->len )
+            {
+               o->time += now() - start;
+               return 0;
+            }
+            /* The receive buffer is allocated by SharkSslCon_decrypt */
+            len = SharkSslCon_getBufLen(o->scon);
+            if(len > o->in->len)
+               len = (U16)o->in->len;
+            memcpy(SharkSslCon_getBuf(o->scon), o->in->data, len);
+            o->in->len -= len;
+            memmove(o->in->data, o->in->data+len, o->in->len);
+            break;
+
+         default:
+            fprintf(stderr, "Handshake failed\n");
+            return -1;
+      }
+   }
+}
+
+
+static double
+handshake(SharkSsl* client, SharkSsl* server)
+{
+   static Pipe c2s, s2c;
+   Peer c, s;
+   c2s.len = s2c.len = 0;
+   memset(&c, 0, sizeof(c));
+   memset(&s, 0, sizeof(s));
+   c.scon = SharkSsl_createCon(client);
+   s.scon = SharkSsl_createCon(server);
+   if(!c.scon || !s.scon)
+   {
+      fprintf(stderr, "Cannot create SharkSslCon\n");
+      exit(1);
+   }
+   c.in=&s2c; c.out=&c2s;
+   s.in=&c2s; s.out=&s2c;
+   while( ! c.done || ! s.done )
+   {
+      if(Peer_run(&c) || Peer_run(&s))
+         exit(1);
+      if(!c2s.len && !s2c.len && !(c.done && s.done))
+      {
+         fprintf(stderr, "Handshake stalled\n");
+         exit(1);
+      }
+   }
+   if( ! SharkSslCon_trustedCA(c.scon) )
+   {
+      fprintf(stderr, "The server certificate is not trusted\n");
+      exit(1);
+   }
+   SharkSsl_terminateCon(client, c.scon);
+   SharkSsl_terminateCon(server, s.scon);
+   return c.time;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   SharkSsl client, cacheClient, server;
+   SharkSslCertStore store;
+   SharkSslCAList caList;
+   SharkSslCert cert;
+   char* caPem;
+   U32 caLen;
+   int handshakes = argc > 4 ? atoi(argv[4]) : 200;
+   double off=0, on=0;
+   int i;
+   if(argc < 4 || handshakes <= 0)
+   {
+      fprintf(stderr, "Usage: %s ca.pem chain.pem key.pem [handshakes]\n",
+              argv[0]);
+      return 1;
+   }
+   caPem = readFile(argv[1], &caLen);
+   if(sharkssl_PEM(readFile(argv[2], 0), readFile(argv[3], 0), 0, &cert))
+   {
+      fprintf(stderr, "Cannot parse the server certificate or key\n");
+      return 1;
+   }
+   SharkSslCertStore_constructor(&store);
+   if(SharkSslCertStore_add(&store, caPem, caLen) != 1 ||
+      !SharkSslCertStore_assemble(&store, &caList))
+   {
+      fprintf(stderr, "Cannot parse the CA certificate\n");
+      return 1;
+   }
+   SharkSsl_constructor(&server, SharkSsl_Server, 0, 4096, 4096);
+   SharkSsl_addCertificate(&server, cert);
+   SharkSsl_constructor(&client, SharkSsl_Client, 0, 4096, 4096);
+   SharkSsl_setCAList(&client, caList);
+   SharkSsl_constructor(&cacheClient, SharkSsl_Client, 0, 4096, 4096);
+   SharkSsl_setCAList(&cacheClient, caList);
+   SharkSsl_setCertCacheSize(&cacheClient, 16);
+
+   handshake(&cacheClient, &server); /* Fill the cache */
+   for(i=0 ; i < handshakes ; i++)
+   {
+      off += handshake(&client, &server);
+      on += handshake(&cacheClient, &server);
+   }
+   printf("client CPU time per handshake, %d handshakes\n", handshakes);
+   printf("  cache disabled: %8.1f us\n", off / handshakes * 1e6);
+   printf("  cache enabled:  %8.1f us\n", on / handshakes * 1e6);
+
+   SharkSsl_destructor(&client);
+   SharkSsl_destructor(&cacheClient);
+   SharkSsl_destructor(&server);
+   SharkSslCertStore_destructor(&store);
+   return 0;
+}
@@ -0,0 +1,224 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+Double and integer formatting speed.
+
+The program formats random doubles of varied magnitude with
+BufPrint_dtoa (used by JEncoder_setDouble), with BufPrint_printf "%f",
+"%e", "%g" and "%.15g", and with snprintf "%.17g", and reports the time
+per value. BufPrint_dtoa output is checked to convert back to the same
+double with strtod, and the BufPrint_printf output is compared with
+the snprintf output for the same format. The program then encodes a JSON array of doubles and
+integers with JEncoder and reports the time per document.
+
+Usage: dtoa [values]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <JEncoder.h>
+
+static char outBuf[64*1024];
+static U32 seed = 12345;
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static U32
+rnd(void)
+{
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+
+/* The output is discarded when the buffer is full */
+static int
+discard(BufPrint* o, int sizeRequired)
+{
+   (void)sizeRequired;
+   BufPrint_erase(o);
+   return 0;
+}
+
+
+static double
+randomDouble(void)
+{
+   double v = (double)rnd() / (1 << 24) + (double)rnd() / (1 << 24) / (1 << 24);
+   switch(rnd() % 4)
+   {
+      case 0: return v; /* 0 to 1 */
+      case 1: return v * 1000; /* Sensor style values */
+      case 2: return (double)(rnd() % 100000) / 100; /* Two decimals */
+      default: return ldexp(v, (int)(rnd() % 200) - 100);
+   }
+}
+
+
+/* Time BufPrint_printf with 'fmt' and count the values printed
+   differently by snprintf.
+*/
+static void
+printfValues(double* vals, int n, const char* fmt)
+{
+   BufPrint out;
+   char tmp[64], ref[64];
+   double start;
+   int i, diff = 0;
+   BufPrint_constructor2(&out, outBuf, sizeof(outBuf), 0, discard);
+   start = now();
+   for(i=0 ; i < n ; i++)
+      BufPrint_printf(&out, fmt, vals[i]);
+   start = now() - start;
+   BufPrint_constructor2(&out, tmp, sizeof(tmp)-1, 0, 0);
+   for(i=0 ; i < n ; i++)
+   {
+      BufPrint_erase(&out);
+      BufPrint_printf(&out, fmt, vals[i]);
+      tmp[BufPrint_getBufSize(&out)] = 0;
+      snprintf(ref, sizeof(ref), fmt, vals[i]);
+      if(strcmp(tmp, ref))
+      {
+         if(!diff++)
+            fprintf(stderr, "%s: %.17g printed as %s, snprintf %s\n",
+                    fmt, vals[i], tmp, ref);
+      }
+   }
+   printf("BufPrint_printf %-6s %6.1f ns/value, %d differ from snprintf\n",
+          fmt, start / n * 1e9, diff);
+}
+
+
+static void
+formatValues(double* vals, int n)
+{
+   BufPrint out;
+   char tmp[64];
+   double start, dtoa, g;
+   long digits = 0;
+   int i, bad = 0;
+   BufPrint_constructor2(&out, outBuf, sizeof(outBuf), 0, discard);
+
+   start = now();
+   for(i=0 ; i < n ; i++)
+      BufPrint_dtoa(&out, vals[i]);
+   dtoa = now() - start;
+
+   start = now();
+   for(i=0 ; i < n ; i++)
+      snprintf(tmp, sizeof(tmp), "%.17g", vals[i]);
+   g = now() - start;
+
+   /* Round-trip check */
+   BufPrint_constructor2(&out, tmp, sizeof(tmp)-1, 0, 0);
+   for(i=0 ; i < n ; i++)
+   {
+      BufPrint_erase(&out);
+      BufPrint_dtoa(&out, vals[i]);
+      tmp[BufPrint_getBufSize(&out)] = 0;
+      digits += BufPrint_getBufSize(&out);
+      if(strtod(tmp, 0) != vals[i])
+      {
+         if(!bad++)
+            fprintf(stderr, "%.17g printed as %s\n", vals[i], tmp);
+      }
+   }
+   printf("BufPrint_dtoa:          %6.1f ns/value, %.1f chars, "
+          "%d round-trip errors\n",
+          dtoa / n * 1e9, (double)digits / n, bad);
+   printf("snprintf %%.17g:         %6.1f ns/value\n", g / n * 1e9);
+   printfValues(vals, n, "%f");
+   printfValues(vals, n, "%e");
+   printfValues(vals, n, "%g");
+   printfValues(vals, n, "%.15g");
+}
+
+
+static void
+encode(double* vals, int n)
+{
+   BufPrint out;
+   JErr err;
+   JEncoder enc;
+   double start, best = 1e9;
+   int run, i;
+   BufPrint_constructor2(&out, outBuf, sizeof(outBuf), 0, discard);
+   for(run=0 ; run < 10 ; run++)
+   {
+      JErr_constructor(&err);
+      JEncoder_constructor(&enc, &err, &out);
+      start = now();
+      JEncoder_beginArray(&enc);
+      for(i=0 ; i < n ; i++)
+      {
+         JEncoder_setDouble(&enc, vals[i]);
+         JEncoder_setInt(&enc, i * 7919);
+      }
+      JEncoder_endArray(&enc);
+      JEncoder_commit(&enc);
+      start = now() - start;
+      if(start < best)
+         best = start;
+      if(JErr_isError(&err))
+      {
+         fprintf(stderr, "JEncoder error\n");
+         exit(1);
+      }
+   }
+   printf("JEncoder, %d doubles and %d ints: %.2f ms\n", n, n, best * 1e3);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   int n = argc > 1 ? atoi(argv[1]) : 1000000;
+   double* vals;
+   int i;
+   if(n <= 0 || !(vals = (double*)malloc(n * sizeof(double))))
+   {
+      fprintf(stderr, "Usage: %s [values]\n", argv[0]);
+      return 1;
+   }
+   for(i=0 ; i < n ; i++)
+      vals[i] = rnd() & 1 ? randomDouble() : -randomDouble();
+   formatValues(vals, n);
+   encode(vals, n < 100000 ? n : 100000);
+   free(vals);
+   return 0;
+}
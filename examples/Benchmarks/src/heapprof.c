@@ -0,0 +1,189 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+Cost and accuracy of the sampling heap profiler.
+
+The program includes HeapProfiler.h, so baMalloc and baFree go through
+the profiler as in a build with BA_HEAP_PROFILE. It replaces random
+objects of 16 to 1024 bytes in a working set and reports the time per
+malloc/free pair for the C library called directly, for the profiler
+when stopped, and for two sampling rates. It then allocates a known
+amount of live memory under two tags and prints the profiler's
+estimate per tag.
+
+Usage: heapprof [steps]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <HeapProfiler.h>
+
+#define LIVE_OBJECTS 1024
+
+static void* live[LIVE_OBJECTS];
+static char outBuf[4096];
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static unsigned int
+rnd(void)
+{
+   static unsigned int seed = 12345;
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+
+static void
+flush(void)
+{
+   int i;
+   for(i=0 ; i < LIVE_OBJECTS ; i++)
+   {
+      baFree(live[i]);
+      live[i]=0;
+   }
+}
+
+
+static void
+churnMalloc(long steps)
+{
+   long i;
+   for(i=0 ; i < steps ; i++)
+   {
+      unsigned int ix = rnd() % LIVE_OBJECTS;
+      free(live[ix]);
+      live[ix] = malloc(16 + rnd() % 1009);
+   }
+   for(i=0 ; i < LIVE_OBJECTS ; i++)
+   {
+      free(live[i]);
+      live[i]=0;
+   }
+}
+
+
+static void
+churnProfiled(long steps)
+{
+   long i;
+   for(i=0 ; i < steps ; i++)
+   {
+      unsigned int ix = rnd() % LIVE_OBJECTS;
+      baFree(live[ix]);
+      live[ix] = baMalloc(16 + rnd() % 1009);
+   }
+   flush();
+}
+
+
+static void
+measure(const char* name, void (*churn)(long), long steps)
+{
+   double start, best = 1e9;
+   int run;
+   for(run=0 ; run < 5 ; run++)
+   {
+      start = now();
+      churn(steps);
+      start = now() - start;
+      if(start < best)
+         best = start;
+   }
+   printf("%-24s %6.1f ns/op\n", name, best / steps * 1e9);
+}
+
+
+/* Allocate 'total' bytes in blocks of 'size' with the given tag */
+static void**
+allocTagged(const char* tag, size_t size, size_t total)
+{
+   size_t i, n = total / size;
+   void** blocks = (void**)malloc((n+1) * sizeof(void*));
+   const char* prev = baHeapProf_setTag(tag);
+   for(i=0 ; i < n ; i++)
+      blocks[i] = baMalloc(size);
+   blocks[n] = 0;
+   baHeapProf_setTag(prev);
+   return blocks;
+}
+
+
+static void
+freeBlocks(void** blocks)
+{
+   void** b;
+   for(b=blocks ; *b ; b++)
+      baFree(*b);
+   free(blocks);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   long steps = argc > 1 ? atol(argv[1]) : 5000000;
+   BufPrint out;
+   void** a;
+   void** b;
+   if(steps <= 0)
+   {
+      fprintf(stderr, "Usage: %s [steps]\n", argv[0]);
+      return 1;
+   }
+   measure("malloc, no profiler", churnMalloc, steps);
+   measure("profiler stopped", churnProfiled, steps);
+   baHeapProf_start(512*1024);
+   measure("sampling every 512 KB", churnProfiled, steps);
+   baHeapProf_stop();
+   baHeapProf_start(64*1024);
+   measure("sampling every 64 KB", churnProfiled, steps);
+
+   printf("\nLive: 20 MB in tag 'large' (4 KB blocks), "
+          "10 MB in tag 'small' (64 byte blocks)\n");
+   a = allocTagged("large", 4096, 20*1024*1024);
+   b = allocTagged("small", 64, 10*1024*1024);
+   BufPrint_constructor2(&out, outBuf, sizeof(outBuf)-1, 0, 0);
+   baHeapProf_printTags(&out);
+   outBuf[BufPrint_getBufSize(&out)] = 0;
+   printf("%s", outBuf);
+   freeBlocks(a);
+   freeBlocks(b);
+   baHeapProf_stop();
+   return 0;
+}
@@ -0,0 +1,258 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+HTTP request throughput of the web server on the loopback interface.
+
+The server runs in the main thread. Client threads each open one
+persistent connection and send GET requests for a page that returns
+a short text, waiting for each response before sending the next
+request. The program reports requests per second and the process CPU
+time per request, which includes the client threads.
+
+The optional 'idle' argument opens that many more connections that
+send nothing, which makes the dispatcher watch more sockets.
+
+Variants built by the Makefile:
+  httpserver         the default build with the select() dispatcher
+  httpserver-stats   the library compiled with USE_HTTP_STATS=1; also
+                     prints the HttpStats latency percentiles
+  httpserver-poll    the poll() dispatcher (src/arch/NET/poll)
+  httpserver-epoll   the epoll dispatcher (src/arch/NET/epoll)
+
+Usage: httpserver [clients] [requests per client] [port] [idle]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <barracuda.h>
+#include <HttpServCon.h>
+#include <HttpStats.h>
+
+static int clients = 4;
+static long requests = 20000;
+static int port = 9357;
+static int idle = 0;
+
+
+static double
+now(clockid_t id)
+{
+   struct timespec t;
+   clock_gettime(id, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/* The select() dispatcher stops with a fatal error when a socket
+   handle exceeds FD_SETSIZE. */
+static void
+fatalError(BaFatalErrorCodes ecode1, unsigned int ecode2,
+           const char* file, int line)
+{
+   printf("Fatal error %d %u at %s:%d\n", ecode1, ecode2, file, line);
+   exit(1);
+}
+
+
+static void
+hello(HttpPage* page, HttpRequest* request, HttpResponse* response)
+{
+   (void)page;
+   (void)request;
+   HttpResponse_setContentLength(response, 11);
+   HttpResponse_write(response, "Hello World", 11, TRUE);
+}
+
+
+/* Read one response; returns -1 on error. */
+static int
+readResponse(int s, char* buf, int size)
+{
+   int len = 0;
+   char* body = 0;
+   long contentLen = -1;
+   for(;;)
+   {
+      int n = (int)recv(s, buf + len, size - len - 1, 0);
+      if(n <= 0)
+         return -1;
+      len += n;
+      buf[len] = 0;
+      if(!body && (body = strstr(buf, "\r\n\r\n")) != 0)
+      {
+         char* cl = strstr(buf, "Content-Length:");
+         body += 4;
+         if(!cl || cl > body)
+            return -1;
+         contentLen = atol(cl + 15);
+      }
+      if(body && len - (body - buf) >= contentLen)
+         return 0;
+      if(len >= size - 1)
+         return -1;
+   }
+}
+
+
+static int
+connectServer(void)
+{
+   struct sockaddr_in addr;
+   int one = 1;
+   int s = socket(AF_INET, SOCK_STREAM, 0);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((unsigned short)port);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if(s < 0 || connect(s, (struct sockaddr*)&addr, sizeof(addr)))
+   {
+      perror("connect");
+      exit(1);
+   }
+   setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+   return s;
+}
+
+
+static void*
+client(void* arg)
+{
+   static const char req[] = "GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n";
+   char buf[4096];
+   long i;
+   int s = connectServer();
+   (void)arg;
+   for(i=0 ; i < requests ; i++)
+   {
+      if(send(s, req, sizeof(req)-1, 0) != sizeof(req)-1 ||
+         readResponse(s, buf, sizeof(buf)))
+      {
+         fprintf(stderr, "Request %ld failed\n", i);
+         exit(1);
+      }
+   }
+   close(s);
+   return 0;
+}
+
+
+/* Runs the clients and terminates the program when they are done. */
+static void*
+monitor(void* arg)
+{
+   pthread_t tid[64];
+   double wall, cpu;
+   long total = requests * clients;
+   int i;
+   (void)arg;
+   for(i=0 ; i < idle ; i++)
+   {
+      connectServer();
+      /* Stay below the server's listen backlog of 32 */
+      if(i % 16 == 15)
+         usleep(5000);
+   }
+   if(idle)
+      sleep(1); /* Let the server accept the idle connections */
+   wall = now(CLOCK_MONOTONIC);
+   cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+   for(i=0 ; i < clients ; i++)
+      pthread_create(&tid[i], 0, client, 0);
+   for(i=0 ; i < clients ; i++)
+      pthread_join(tid[i], 0);
+   wall = now(CLOCK_MONOTONIC) - wall;
+   cpu = now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+   printf("%d clients, %d idle, %ld requests: %.0f requests/s, "
+          "%.2f us CPU/request\n",
+          clients, idle, total, total / wall, cpu / total * 1e6);
+#if USE_HTTP_STATS
+   {
+      HttpStatsData d;
+      HttpStats_collect(&d);
+      printf("HttpStats: %lu 2xx responses, service p50 %u us, p99 %u us,"
+             " parse p50 %u us\n",
+             (unsigned long)d.counters[HttpStats_Status2xx],
+             HttpStatsHist_percentile(d.hist+HttpStats_Service, 500),
+             HttpStatsHist_percentile(d.hist+HttpStats_Service, 990),
+             HttpStatsHist_percentile(d.hist+HttpStats_Parse, 500));
+   }
+#endif
+   exit(0);
+   return 0;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   static ThreadMutex mutex;
+   static SoDisp disp;
+   static HttpServer server;
+   static HttpServerConfig cfg;
+   static HttpServCon scon;
+   static HttpDir root;
+   static HttpPage page;
+   pthread_t tid;
+   if(argc > 1) clients = atoi(argv[1]);
+   if(argc > 2) requests = atol(argv[2]);
+   if(argc > 3) port = atoi(argv[3]);
+   if(argc > 4) idle = atoi(argv[4]);
+   if(clients < 1 || clients > 64 || requests <= 0 || idle < 0 ||
+      idle > 60000)
+   {
+      fprintf(stderr, "Usage: %s [clients (1-64)] [requests per client] "
+              "[port] [idle (0-60000)]\n", argv[0]);
+      return 1;
+   }
+   HttpServer_setErrHnd(fatalError);
+   ThreadMutex_constructor(&mutex);
+   SoDisp_constructor(&disp, &mutex);
+   HttpServerConfig_constructor(&cfg);
+   HttpServerConfig_setNoOfHttpConnections(&cfg, (U16)(clients + idle + 2));
+   HttpServer_constructor(&server, &disp, &cfg);
+   HttpServCon_constructor(&scon, &server, &disp, (U16)port, FALSE, 0, 0);
+   if( ! HttpServCon_isValid(&scon) )
+   {
+      fprintf(stderr, "Cannot open server port %d\n", port);
+      return 1;
+   }
+   HttpDir_constructor(&root, 0, 0);
+   HttpPage_constructor(&page, hello, "hello");
+   HttpDir_insertPage(&root, &page);
+   HttpServer_insertRootDir(&server, &root);
+   pthread_create(&tid, 0, monitor, 0);
+   SoDisp_run(&disp, -1);
+   return 0;
+}
@@ -0,0 +1,279 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+JParser throughput in MB/s.
+
+The program generates three documents: string-heavy objects similar to
+a social media feed, an array of numbers, and one wide object. Files
+given on the command line are parsed in addition. Each document is
+parsed as one buffer and in 16 KB chunks; the best of 'runs' passes is
+printed. The parser callback only counts the values, so the numbers
+show the cost of the lexer and parser alone.
+
+Usage: jsonparse [-r runs] [file.json ...]
+*/
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <JParser.h>
+
+#define CHUNK_SIZE (16*1024)
+
+typedef struct
+{
+   char* data;
+   size_t len;
+   size_t size;
+} Doc;
+
+static unsigned long values;
+static U32 seed = 12345;
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static U32
+rnd(void)
+{
+   seed = seed * 1103515245 + 12345;
+   return seed >> 8;
+}
+
+
+static void
+Doc_printf(Doc* o, const char* fmt, ...)
+{
+   va_list args;
+   int n;
+   if(o->size - o->len < 512)
+   {
+      o->size = o->size ? o->size * 2 : 64*1024;
+      o->data = (char*)realloc(o->data, o->size);
+      if(!o->data)
+      {
+         fprintf(stderr, "Out of memory\n");
+         exit(1);
+      }
+   }
+   va_start(args, fmt);
+   n = vsnprintf(o->data + o->len, o->size - o->len, fmt, args);
+   va_end(args);
+   o->len += n;
+}
+
+
+static const char*
+word(void)
+{
+   static const char* words[] = {
+      "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog",
+      "\\\"quoted\\\"", "path\\/to", "\\u00e9t\\u00e9", "tab\\there"
+   };
+   return words[rnd() % (sizeof(words)/sizeof(words[0]))];
+}
+
+
+static void
+makeFeed(Doc* o, size_t size)
+{
+   int i, j;
+   Doc_printf(o, "{\n \"statuses\": [\n");
+   for(i=0 ; o->len < size ; i++)
+   {
+      Doc_printf(o, "  %s{\n   \"id\": %u,\n   \"text\": \"", i ? "," : "", rnd());
+      for(j=0 ; j < 12 ; j++)
+         Doc_printf(o, "%s%s", j ? " " : "", word());
+      Doc_printf(o, "\",\n   \"created_at\": \"Sun Aug 31 00:29:15 +0000 2014\",\n"
+                 "   \"truncated\": %s,\n   \"retweet_count\": %u,\n"
+                 "   \"user\": {\n    \"id\": %u,\n    \"name\": \"%s %s\",\n"
+                 "    \"screen_name\": \"user%d\",\n"
+                 "    \"description\": \"%s %s %s %s %s %s\"\n   }\n  }\n",
+                 rnd() & 1 ? "true" : "false", rnd() % 1000, rnd(),
+                 word(), word(), i, word(), word(), word(), word(), word(),
+                 word());
+   }
+   Doc_printf(o, " ]\n}\n");
+}
+
+
+static void
+makeNumbers(Doc* o, size_t size)
+{
+   int i;
+   Doc_printf(o, "[");
+   for(i=0 ; o->len < size ; i++)
+   {
+      Doc_printf(o, "%s%d, %.17g", i ? ", " : "",
+                 (int)(rnd() % 2000000) - 1000000,
+                 (double)rnd() / (1 << 5));
+   }
+   Doc_printf(o, "]");
+}
+
+
+static void
+makeWide(Doc* o, size_t size)
+{
+   int i;
+   Doc_printf(o, "{\"wide\": {");
+   for(i=0 ; o->len < size ; i++)
+      Doc_printf(o, "%s\"k%d\": %d", i ? ", " : "", i, i);
+   Doc_printf(o, "}}");
+}
+
+
+static void
+readFile(Doc* o, const char* name)
+{
+   FILE* fp = fopen(name, "rb");
+   long len;
+   if(!fp)
+   {
+      perror(name);
+      exit(1);
+   }
+   fseek(fp, 0, SEEK_END);
+   len = ftell(fp);
+   rewind(fp);
+   o->data = (char*)malloc(len);
+   if(!o->data || fread(o->data, 1, len, fp) != (size_t)len)
+   {
+      fprintf(stderr, "Cannot read %s\n", name);
+      exit(1);
+   }
+   fclose(fp);
+   o->len = o->size = len;
+}
+
+
+static int
+countValues(JParserIntf* o, JParserVal* v, int recLevel)
+{
+   (void)o; (void)v; (void)recLevel;
+   values++;
+   return 0;
+}
+
+
+/* Parse the document once and return the elapsed time. */
+static double
+parse(Doc* doc, size_t chunk)
+{
+   static char name[1024];
+   static struct {
+      JParser parser;
+      JParserStackNode stack[64];
+   } p;
+   JParserIntf intf;
+   size_t pos;
+   double start;
+   int status = 0;
+   JParserIntf_constructor(&intf, countValues);
+   JParser_constructor(&p.parser, &intf, name, sizeof(name),
+                       AllocatorIntf_getDefault(), 64);
+   values = 0;
+   start = now();
+   for(pos=0 ; pos < doc->len && status == 0 ; pos += chunk)
+   {
+      status = JParser_parse(&p.parser, (U8*)doc->data + pos,
+                             (U32)(doc->len-pos < chunk ? doc->len-pos : chunk));
+   }
+   start = now() - start;
+   JParser_destructor(&p.parser);
+   if(status <= 0)
+   {
+      fprintf(stderr, "Parse error %d\n", JParser_getStatus(&p.parser));
+      exit(1);
+   }
+   return start;
+}
+
+
+static void
+run(const char* name, Doc* doc, int runs)
+{
+   double whole = 1e9, chunked = 1e9, t;
+   int i;
+   for(i=0 ; i < runs ; i++)
+   {
+      if((t = parse(doc, doc->len)) < whole)
+         whole = t;
+      if((t = parse(doc, CHUNK_SIZE)) < chunked)
+         chunked = t;
+   }
+   printf("%-16s %6.2f MB %8lu values %7.1f MB/s %7.1f MB/s\n",
+          name, doc->len / 1e6, values,
+          doc->len / whole / 1e6, doc->len / chunked / 1e6);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   Doc doc;
+   int runs = 20;
+   int i = 1;
+   if(argc > 2 && !strcmp(argv[1], "-r"))
+   {
+      runs = atoi(argv[2]);
+      i = 3;
+   }
+   if(runs <= 0)
+   {
+      fprintf(stderr, "Usage: %s [-r runs] [file.json ...]\n", argv[0]);
+      return 1;
+   }
+   printf("%-16s %9s %15s %12s %12s\n",
+          "document", "size", "", "whole", "16K chunks");
+   memset(&doc, 0, sizeof(doc));
+   makeFeed(&doc, 3*1024*1024);
+   run("feed", &doc, runs);
+   doc.len = 0;
+   makeNumbers(&doc, 4*1024*1024);
+   run("numbers", &doc, runs);
+   doc.len = 0;
+   makeWide(&doc, 8*1024*1024);
+   run("wide object", &doc, runs);
+   free(doc.data);
+   for( ; i < argc ; i++)
+   {
+      readFile(&doc, argv[i]);
+      run(argv[i], &doc, runs);
+      free(doc.data);
+   }
+   return 0;
+}
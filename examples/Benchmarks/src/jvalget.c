@@ -0,0 +1,204 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+JParserValFact tree building and JVal_get member lookup.
+
+The program generates three documents, each an array of objects with
+integer members named "m0", "m1", ...: one wide object with 5000
+members, 500 objects with 20 members, and 1000 objects with 10
+members. Each document is parsed into a JVal tree with the heap
+allocator and with an ArenaAllocator (arena mode). The program then
+extracts the last 8 members of every object with one JVal_get call
+per object, 'runs' times.
+
+The output shows the parse and tree build throughput, the time to
+release the tree, and the time per member lookup for the first pass
+and for the following passes. Objects with at least
+JVAL_INDEX_THRESHOLD members build their member index in the first
+pass.
+
+Usage: jvalget [runs]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <JParser.h>
+#include <JVal.h>
+#include <ArenaAllocator.h>
+
+typedef struct
+{
+   char* data;
+   size_t len;
+} Doc;
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static void
+makeDoc(Doc* o, int objects, int members)
+{
+   size_t size = (size_t)objects * members * 24 + 16;
+   char* p;
+   int i, j;
+   o->data = p = (char*)malloc(size);
+   if(!p)
+   {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+   }
+   *p++ = '[';
+   for(i=0 ; i < objects ; i++)
+   {
+      *p++ = i ? ',' : ' ';
+      *p++ = '{';
+      for(j=0 ; j < members ; j++)
+         p += sprintf(p, "%s\"m%d\":%d", j ? "," : "", j, i+j);
+      *p++ = '}';
+   }
+   *p++ = ']';
+   o->len = (size_t)(p - o->data);
+}
+
+
+static JVal*
+parse(JParserValFact* vf, Doc* doc)
+{
+   static char name[256];
+   static struct {
+      JParser parser;
+      JParserStackNode stack[16];
+   } p;
+   int status;
+   JParser_constructor(&p.parser, (JParserIntf*)vf, name, sizeof(name),
+                       AllocatorIntf_getDefault(), 16);
+   status = JParser_parse(&p.parser, (U8*)doc->data, (U32)doc->len);
+   JParser_destructor(&p.parser);
+   if(status <= 0)
+   {
+      fprintf(stderr, "Parse error %d\n", JParser_getStatus(&p.parser));
+      exit(1);
+   }
+   return JParserValFact_getFirstVal(vf);
+}
+
+
+/* Extract the last 8 members of every object and return the time. */
+static double
+lookup(JVal* array, int members)
+{
+   char n[8][16];
+   S32 v[8];
+   JErr err;
+   JVal* o;
+   double start;
+   int i;
+   for(i=0 ; i < 8 ; i++)
+      sprintf(n[i], "m%d", members-8+i);
+   JErr_constructor(&err);
+   start = now();
+   for(o = JVal_getArray(array, &err) ; o ; o = JVal_getNextElem(o))
+   {
+      JVal_get(o, &err, "{dddddddd}", n[0], v, n[1], v+1, n[2], v+2,
+               n[3], v+3, n[4], v+4, n[5], v+5, n[6], v+6, n[7], v+7);
+   }
+   start = now() - start;
+   if(JErr_isError(&err))
+   {
+      fprintf(stderr, "JVal_get failed\n");
+      exit(1);
+   }
+   return start;
+}
+
+
+static void
+run(const char* mode, Doc* doc, AllocatorIntf* vAlloc,
+    AllocatorIntf* dAlloc, int objects, int members, int runs)
+{
+   JParserValFact vf;
+   JVal* array;
+   double build, term, first, rest = 1e9, t;
+   double lookups = (double)objects * 8;
+   int i;
+   JParserValFact_constructor(&vf, vAlloc, dAlloc);
+   t = now();
+   array = parse(&vf, doc);
+   build = now() - t;
+   first = lookup(array, members);
+   for(i=1 ; i < runs ; i++)
+   {
+      if((t = lookup(array, members)) < rest)
+         rest = t;
+   }
+   t = now();
+   JParserValFact_termFirstVal(&vf);
+   term = now() - t;
+   JParserValFact_destructor(&vf);
+   printf("%4d x %4d  %-5s %7.1f MB/s %8.2f ms %9.1f ns %9.1f ns\n",
+          objects, members, mode, doc->len / build / 1e6, term * 1e3,
+          first / lookups * 1e9, rest / lookups * 1e9);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   static const int shape[3][2] = { {1, 5000}, {500, 20}, {1000, 10} };
+   ArenaAllocator arena;
+   AllocatorIntf* heap = AllocatorIntf_getDefault();
+   int runs = argc > 1 ? atoi(argv[1]) : 200;
+   int i;
+   if(runs < 2)
+   {
+      fprintf(stderr, "Usage: %s [runs (>1)]\n", argv[0]);
+      return 1;
+   }
+   printf("%-17s %12s %11s %12s %12s\n",
+          "objects x members", "build", "release", "first pass", "later");
+   ArenaAllocator_constructor(&arena, heap, 64*1024);
+   for(i=0 ; i < 3 ; i++)
+   {
+      Doc doc;
+      makeDoc(&doc, shape[i][0], shape[i][1]);
+      run("heap", &doc, heap, heap, shape[i][0], shape[i][1], runs);
+      run("arena", &doc, (AllocatorIntf*)&arena, (AllocatorIntf*)&arena,
+          shape[i][0], shape[i][1], runs);
+      free(doc.data);
+   }
+   ArenaAllocator_destructor(&arena);
+   return 0;
+}
@@ -0,0 +1,470 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+Failed requests and the longest response time while an HTTP server is
+restarted, with and without the listen socket handoff used by the
+Mako Server's hot restart (mako -r).
+
+The program starts a server process, runs client threads that send
+requests on new connections, and replaces the server process once a
+second:
+
+  cold   the old server is terminated, then the new server is started
+         and opens its listen socket
+  hot    the new server is started while the old server runs. It gets
+         the listen socket from the old server over a Unix domain
+         socket (SCM_RIGHTS) and registers it with
+         HttpServCon_inheritSocket. When the new server is ready, the
+         old server calls HttpServCon_stopAccepting, completes its
+         active requests, and exits.
+
+Each server waits 'startup' milliseconds before opening its ports, as
+an application loading its configuration would. The program reports
+the requests sent, the failed requests, the longest response time, and
+the longest time without a successful response for each mode.
+
+Usage: restart [restarts] [startup ms] [clients] [port]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <barracuda.h>
+#include <HttpServCon.h>
+
+#define HR_MAXFDS 16
+
+static int restarts = 5;
+static int startup = 200;
+static int clients = 4;
+static int port = 9359;
+static char hrPath[64];
+static char* self;
+
+static volatile int running;
+static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
+static long sent, failed;
+static double maxTime;
+static double maxGap; /* Longest time between two successful responses */
+static double lastOk;
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/****************************** Server *********************************/
+
+static ThreadMutex mutex;
+static SoDisp disp;
+static HttpServer server;
+static int hrListenSock = -1;
+
+
+static void
+hello(HttpPage* page, HttpRequest* request, HttpResponse* response)
+{
+   (void)page;
+   (void)request;
+   HttpResponse_setContentLength(response, 11);
+   HttpResponse_write(response, "Hello World", 11, TRUE);
+}
+
+
+static int
+hrSend(int sock, char type, int* fds, int nfds)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   union {
+      struct cmsghdr align;
+      char buf[CMSG_SPACE(HR_MAXFDS*sizeof(int))];
+   } cbuf;
+   memset(&msg, 0, sizeof(msg));
+   iov.iov_base=&type;
+   iov.iov_len=1;
+   msg.msg_iov=&iov;
+   msg.msg_iovlen=1;
+   if(nfds)
+   {
+      struct cmsghdr* cmsg;
+      memset(&cbuf, 0, sizeof(cbuf));
+      msg.msg_control=cbuf.buf;
+      msg.msg_controllen=CMSG_SPACE(nfds*sizeof(int));
+      cmsg=CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level=SOL_SOCKET;
+      cmsg->cmsg_type=SCM_RIGHTS;
+      cmsg->cmsg_len=CMSG_LEN(nfds*sizeof(int));
+      memcpy(CMSG_DATA(cmsg), fds, nfds*sizeof(int));
+   }
+   return sendmsg(sock, &msg, 0) == 1 ? 0 : -1;
+}
+
+
+/* Receive one message and return the message type or -1. Received
+   sockets are handed to HttpServCon.
+*/
+static int
+hrRecv(int sock)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   struct cmsghdr* cmsg;
+   union {
+      struct cmsghdr align;
+      char buf[CMSG_SPACE(HR_MAXFDS*sizeof(int))];
+   } cbuf;
+   char type;
+   memset(&msg, 0, sizeof(msg));
+   iov.iov_base=&type;
+   iov.iov_len=1;
+   msg.msg_iov=&iov;
+   msg.msg_iovlen=1;
+   msg.msg_control=cbuf.buf;
+   msg.msg_controllen=sizeof(cbuf.buf);
+   if(recvmsg(sock, &msg, 0) != 1)
+      return -1;
+   for(cmsg=CMSG_FIRSTHDR(&msg) ; cmsg ; cmsg=CMSG_NXTHDR(&msg, cmsg))
+   {
+      if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      {
+         int fd;
+         memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+         if(HttpServCon_inheritSocket(fd))
+            close(fd);
+      }
+   }
+   return (U8)type;
+}
+
+
+/* Old server: hand the listen socket to the next server, then stop
+   accepting, wait for the active requests, and stop the dispatcher.
+*/
+static void*
+hrRun(void* arg)
+{
+   int lsock = *(int*)arg;
+   int sock, busy;
+   while( (sock=accept(hrListenSock, 0, 0)) < 0 && errno == EINTR ) ;
+   if(sock < 0 || hrSend(sock, 'F', &lsock, 1) || hrSend(sock, 'E', 0, 0) ||
+      hrRecv(sock) != 'R')
+   {
+      fprintf(stderr, "Hot restart: new server failed\n");
+      exit(1);
+   }
+   ThreadMutex_set(&mutex);
+   HttpServCon_stopAccepting();
+   ThreadMutex_release(&mutex);
+   hrSend(sock, 'S', 0, 0);
+   close(sock);
+   close(hrListenSock);
+   for(;;)
+   {
+      ThreadMutex_set(&mutex);
+      HttpServer_termIdleCons(&server);
+      busy=HttpServer_getNoOfActiveRequests(&server);
+      if( ! busy )
+         SoDisp_setExit(&disp);
+      ThreadMutex_release(&mutex);
+      if( ! busy )
+         break;
+      usleep(10000);
+   }
+   return 0;
+}
+
+
+/* Connect to the running server, if any, and receive its listen
+   socket. Returns the connection or -1.
+*/
+static int
+hrConnect(struct sockaddr_un* addr)
+{
+   int type;
+   int sock=socket(AF_UNIX, SOCK_STREAM, 0);
+   if(connect(sock, (struct sockaddr*)addr, sizeof(*addr)))
+   {
+      close(sock);
+      return -1;
+   }
+   while( (type=hrRecv(sock)) == 'F' ) ;
+   if(type != 'E')
+   {
+      fprintf(stderr, "Hot restart: cannot get the listen socket\n");
+      exit(1);
+   }
+   return sock;
+}
+
+
+static int
+runServer(BaBool hot)
+{
+   static HttpServerConfig cfg;
+   static HttpServCon scon;
+   static HttpDir root;
+   static HttpPage page;
+   struct sockaddr_un addr;
+   pthread_t tid;
+   int lsock;
+   int hrSock = -1;
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family=AF_UNIX;
+   strcpy(addr.sun_path, hrPath);
+   if(hot)
+      hrSock=hrConnect(&addr);
+   usleep(startup * 1000); /* Load the application */
+   ThreadMutex_constructor(&mutex);
+   SoDisp_constructor(&disp, &mutex);
+   HttpServerConfig_constructor(&cfg);
+   HttpServerConfig_setNoOfHttpConnections(&cfg, (U16)(clients * 2 + 4));
+   HttpServer_constructor(&server, &disp, &cfg);
+   HttpServCon_constructor(&scon, &server, &disp, (U16)port, FALSE, 0, 0);
+   HttpServCon_closeInherited();
+   if( ! HttpServCon_isValid(&scon) )
+   {
+      fprintf(stderr, "Cannot open server port %d\n", port);
+      return 1;
+   }
+   lsock = SoDispCon_getId((SoDispCon*)&scon);
+   HttpDir_constructor(&root, 0, 0);
+   HttpPage_constructor(&page, hello, "hello");
+   HttpDir_insertPage(&root, &page);
+   HttpServer_insertRootDir(&server, &root);
+   if(hot)
+   {
+      if(hrSock >= 0 && (hrSend(hrSock, 'R', 0, 0) || hrRecv(hrSock) != 'S'))
+      {
+         fprintf(stderr, "Hot restart: no response from old server\n");
+         return 1;
+      }
+      if(hrSock >= 0)
+         close(hrSock);
+      unlink(hrPath);
+      hrListenSock=socket(AF_UNIX, SOCK_STREAM, 0);
+      if(bind(hrListenSock, (struct sockaddr*)&addr, sizeof(addr)) ||
+         listen(hrListenSock, 1))
+      {
+         perror(hrPath);
+         return 1;
+      }
+      pthread_create(&tid, 0, hrRun, &lsock);
+   }
+   SoDisp_run(&disp, -1);
+   return 0;
+}
+
+
+/****************************** Client *********************************/
+
+/* Send one request on a new connection; returns -1 on error */
+static int
+request(void)
+{
+   static const char req[] =
+      "GET /hello HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+   char buf[1024];
+   struct sockaddr_in addr;
+   int len = 0;
+   int status = -1;
+   int s = socket(AF_INET, SOCK_STREAM, 0);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((unsigned short)port);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if(s >= 0 && ! connect(s, (struct sockaddr*)&addr, sizeof(addr)) &&
+      send(s, req, sizeof(req)-1, 0) == sizeof(req)-1)
+   {
+      for(;;)
+      {
+         int n = (int)recv(s, buf + len, sizeof(buf) - len - 1, 0);
+         if(n <= 0)
+            break;
+         len += n;
+         buf[len] = 0;
+         if(strstr(buf, "Hello World"))
+         {
+            status = 0;
+            break;
+         }
+      }
+   }
+   if(s >= 0)
+      close(s);
+   return status;
+}
+
+
+static void*
+client(void* arg)
+{
+   (void)arg;
+   while(running)
+   {
+      double start = now();
+      int status = request();
+      double end = now();
+      pthread_mutex_lock(&statsMutex);
+      sent++;
+      if(status)
+         failed++;
+      else
+      {
+         if(lastOk && end - lastOk > maxGap)
+            maxGap = end - lastOk;
+         lastOk = end;
+      }
+      if(end - start > maxTime)
+         maxTime = end - start;
+      pthread_mutex_unlock(&statsMutex);
+      if(status)
+         usleep(1000); /* Do not spin while the port is closed */
+   }
+   return 0;
+}
+
+
+static pid_t
+startServer(BaBool hot)
+{
+   char arg[8];
+   pid_t pid = fork();
+   if(pid == 0)
+   {
+      sprintf(arg, "%d", hot ? 1 : 0);
+      execl(self, self, "-server", arg, (char*)0);
+      _exit(1);
+   }
+   return pid;
+}
+
+
+/* Wait until the server answers requests */
+static void
+waitReady(void)
+{
+   while(request())
+      usleep(10000);
+}
+
+
+static void
+run(const char* name, BaBool hot)
+{
+   pthread_t tid[64];
+   pid_t pid = startServer(hot);
+   int i;
+   waitReady();
+   sent = failed = 0;
+   maxTime = maxGap = lastOk = 0;
+   running = TRUE;
+   for(i=0 ; i < clients ; i++)
+      pthread_create(&tid[i], 0, client, 0);
+   for(i=0 ; i < restarts ; i++)
+   {
+      sleep(1);
+      if(hot)
+      {
+         pid_t next = startServer(TRUE);
+         waitpid(pid, 0, 0); /* The old server exits when replaced */
+         pid = next;
+      }
+      else
+      {
+         kill(pid, SIGTERM);
+         waitpid(pid, 0, 0);
+         pid = startServer(FALSE);
+      }
+   }
+   sleep(1);
+   running = FALSE;
+   for(i=0 ; i < clients ; i++)
+      pthread_join(tid[i], 0);
+   kill(pid, SIGTERM);
+   waitpid(pid, 0, 0);
+   printf("%-5s %d restarts: %7ld requests  %5ld failed  "
+          "longest response %4.0f ms  longest gap %4.0f ms\n",
+          name, restarts, sent, failed, maxTime * 1e3, maxGap * 1e3);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   self = argv[0];
+   sprintf(hrPath, "/tmp/restart-%d.sock", (int)getpid());
+   if(argc == 3 && ! strcmp(argv[1], "-server"))
+   {
+      /* The server inherits its settings through the environment */
+      const char* env = getenv("RESTART_BENCH");
+      if(!env || sscanf(env, "%d %d %d %63s",
+                        &startup, &clients, &port, hrPath) != 4)
+      {
+         return 1;
+      }
+      return runServer(atoi(argv[2]) ? TRUE : FALSE);
+   }
+   if(argc > 1) restarts = atoi(argv[1]);
+   if(argc > 2) startup = atoi(argv[2]);
+   if(argc > 3) clients = atoi(argv[3]);
+   if(argc > 4) port = atoi(argv[4]);
+   if(restarts < 1 || startup < 0 || clients < 1 || clients > 64)
+   {
+      fprintf(stderr, "Usage: %s [restarts] [startup ms] [clients (1-64)] "
+              "[port]\n", argv[0]);
+      return 1;
+   }
+   {
+      char env[128];
+      sprintf(env, "%d %d %d %s", startup, clients, port, hrPath);
+      setenv("RESTART_BENCH", env, 1);
+   }
+   signal(SIGPIPE, SIG_IGN);
+   printf("%d clients, server startup %d ms\n", clients, startup);
+   run("cold", FALSE);
+   run("hot", TRUE);
+   unlink(hrPath);
+   return 0;
+}
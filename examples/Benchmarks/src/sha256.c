@@ -0,0 +1,137 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+SHA-256 throughput.
+
+bulk:   sharkssl_sha256 on a 1 MB buffer, reported in MB/s.
+small:  many short messages (MQTT payloads, HMAC inputs), hashed one
+        at a time with sharkssl_sha256 and in one call with
+        sharkssl_sha256_multi, reported in million messages/s.
+
+The 'sha256' program uses the CPU's SHA instructions when present. The
+'sha256-c' program is built with SHARKSSL_SHA256_USE_HW=0 and measures
+the portable C code.
+
+Usage: sha256 [seconds per test]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <SharkSslCrypto.h>
+
+#define BULK_SIZE (1024*1024)
+#define MSG_COUNT 1024
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static void
+bulk(U8* buf, double seconds)
+{
+   U8 digest[SHARKSSL_SHA256_HASH_LEN];
+   double start = now(), elapsed;
+   long n=0;
+   do {
+      sharkssl_sha256(buf, BULK_SIZE, digest);
+      n++;
+   } while((elapsed = now() - start) < seconds);
+   printf("bulk 1 MB:            %8.1f MB/s\n",
+          n * (BULK_SIZE / 1e6) / elapsed);
+}
+
+
+static void
+small(U8* buf, U32 size, double seconds)
+{
+   static const U8* data[MSG_COUNT];
+   static U32 len[MSG_COUNT];
+   static U8 d1[MSG_COUNT][SHARKSSL_SHA256_HASH_LEN];
+   static U8 d2[MSG_COUNT][SHARKSSL_SHA256_HASH_LEN];
+   static U8* digest[MSG_COUNT];
+   double start, elapsed, single;
+   long n;
+   int i;
+   for(i=0 ; i < MSG_COUNT ; i++)
+   {
+      data[i] = buf + i * size;
+      len[i] = size;
+      digest[i] = d2[i];
+   }
+
+   start = now(); n=0;
+   do {
+      for(i=0 ; i < MSG_COUNT ; i++)
+         sharkssl_sha256(data[i], size, d1[i]);
+      n++;
+   } while((elapsed = now() - start) < seconds);
+   single = n * MSG_COUNT / elapsed;
+
+   start = now(); n=0;
+   do {
+      sharkssl_sha256_multi(MSG_COUNT, data, len, digest);
+      n++;
+   } while((elapsed = now() - start) < seconds);
+
+   if(memcmp(d1, d2, sizeof(d1)))
+   {
+      fprintf(stderr, "sharkssl_sha256_multi digest mismatch\n");
+      exit(1);
+   }
+   printf("%4u byte messages:    %8.2f M msg/s single, %5.2f M msg/s multi\n",
+          (unsigned)size, single / 1e6, n * MSG_COUNT / elapsed / 1e6);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   static const U32 sizes[] = {32, 100, 256, 1000};
+   double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+   U8* buf = (U8*)malloc(BULK_SIZE);
+   unsigned int i;
+   if(!buf || seconds <= 0)
+   {
+      fprintf(stderr, "Usage: %s [seconds per test]\n", argv[0]);
+      return 1;
+   }
+   for(i=0 ; i < BULK_SIZE ; i++)
+      buf[i] = (U8)(i * 131 + 7);
+   bulk(buf, seconds);
+   for(i=0 ; i < sizeof(sizes)/sizeof(sizes[0]) ; i++)
+      small(buf, sizes[i], seconds);
+   free(buf);
+   return 0;
+}
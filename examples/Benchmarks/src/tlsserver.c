@@ -0,0 +1,479 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+HTTPS throughput of the web server on the loopback interface.
+
+The server runs in the main thread and uses HttpSharkSslServCon with a
+4K SharkSSL output buffer. Client threads each open one persistent
+TLS connection with a SharkSSL client and send GET requests, waiting
+for each response before sending the next request. The server's page
+writes the response body with HttpResponse_write in 100 byte calls,
+as many LSP and C pages do, through the default response buffer.
+
+Two responses are measured: a short 300 byte page and a 1 MB page.
+The program reports requests per second, the process CPU time per
+request (including the client threads), the number of TLS records per
+response, and the average record size. The clients count the records
+in the received byte stream before it is decrypted.
+
+Variants built by the Makefile:
+  tlsserver       the default build
+  tlsserver-ktls  the library compiled with USE_KTLS=1. The program
+                  prints whether the server's connections were
+                  offloaded to the kernel TLS module; without the
+                  module, the connections keep SharkSSL encryption.
+
+Usage: tlsserver [clients] [short requests per client]
+                 [1 MB requests per client] [port]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <barracuda.h>
+#include <HttpSharkSslServCon.h>
+#include "../../HostInit/localhost_RSA_2048.h"
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+#define SHORT_SIZE 300
+#define LARGE_SIZE (1024*1024)
+
+typedef struct
+{
+   SharkSslCon* scon;
+   int sock;
+   /* Record parser for the received TLS byte stream */
+   U8 hdr[5];
+   int hdrLen;
+   long recLeft;
+   long records;
+   long recBytes;
+   /* HTTP response parser */
+   char head[1024];
+   int headLen;
+   long bodyLeft;
+   BaBool inBody;
+} Client;
+
+static int clients = 4;
+static long shortRequests = 2000;
+static long largeRequests = 20;
+static int port = 9443;
+static SharkSsl sharkSslClient;
+static pthread_mutex_t clientMutex = PTHREAD_MUTEX_INITIALIZER;
+static U16 cipherSuite;
+static U8 protocol;
+static int offloaded;
+static int servedCons;
+
+
+static double
+now(clockid_t id)
+{
+   struct timespec t;
+   clock_gettime(id, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/* Writes 'size' bytes in 100 byte calls. Also records if the
+   connection's socket uses the kernel TLS module.
+*/
+static void
+writeBody(HttpResponse* response, long size)
+{
+   static const char data[100] =
+      "0123456789012345678901234567890123456789"
+      "0123456789012345678901234567890123456789"
+      "012345678901234567\r\n";
+   SoDispCon* con = (SoDispCon*)HttpResponse_getConnection(response);
+   char ulp[16];
+   socklen_t len = sizeof(ulp);
+   memset(ulp, 0, sizeof(ulp));
+   if(!getsockopt(SoDispCon_getId(con), IPPROTO_TCP, TCP_ULP, ulp, &len) &&
+      !strcmp(ulp, "tls"))
+   {
+      offloaded++;
+   }
+   servedCons++;
+   HttpResponse_setContentLength(response, size);
+   for( ; size > 0 ; size -= 100)
+      HttpResponse_write(response, data, size < 100 ? (int)size : 100, TRUE);
+}
+
+
+static void
+shortPage(HttpPage* page, HttpRequest* request, HttpResponse* response)
+{
+   (void)page;
+   (void)request;
+   writeBody(response, SHORT_SIZE);
+}
+
+
+static void
+largePage(HttpPage* page, HttpRequest* request, HttpResponse* response)
+{
+   (void)page;
+   (void)request;
+   writeBody(response, LARGE_SIZE);
+}
+
+
+static void
+fail(const char* msg)
+{
+   fprintf(stderr, "%s\n", msg);
+   exit(1);
+}
+
+
+static void
+sendAll(Client* o, const U8* data, int len)
+{
+   while(len > 0)
+   {
+      int n = (int)send(o->sock, data, len, 0);
+      if(n <= 0)
+         fail("send failed");
+      data += n;
+      len -= n;
+   }
+}
+
+
+/* Counts the TLS records in received data. */
+static void
+countRecords(Client* o, const U8* data, long len)
+{
+   while(len > 0)
+   {
+      if(o->recLeft)
+      {
+         long n = len < o->recLeft ? len : o->recLeft;
+         o->recLeft -= n;
+         data += n;
+         len -= n;
+      }
+      else
+      {
+         o->hdr[o->hdrLen++] = *data++;
+         len--;
+         if(o->hdrLen == 5)
+         {
+            o->recLeft = (o->hdr[3] << 8) | o->hdr[4];
+            o->hdrLen = 0;
+            /* Application data */
+            if(o->hdr[0] == 23)
+            {
+               o->records++;
+               o->recBytes += o->recLeft;
+            }
+         }
+      }
+   }
+}
+
+
+/* Parses decrypted response data; returns TRUE when a response is
+   complete.
+*/
+static BaBool
+consume(Client* o, const U8* data, long len)
+{
+   while(len > 0 && !o->inBody)
+   {
+      char* end;
+      if(o->headLen == sizeof(o->head)-1)
+         fail("Response header too large");
+      o->head[o->headLen++] = *data++;
+      len--;
+      o->head[o->headLen] = 0;
+      if((end = strstr(o->head, "\r\n\r\n")) != 0)
+      {
+         char* cl = strstr(o->head, "Content-Length:");
+         if(!cl || cl > end)
+            fail("No Content-Length");
+         o->bodyLeft = atol(cl + 15);
+         o->inBody = TRUE;
+      }
+   }
+   if(o->inBody)
+   {
+      if(len > o->bodyLeft)
+         fail("Unexpected data after the response");
+      o->bodyLeft -= len;
+      if(!o->bodyLeft)
+      {
+         o->inBody = FALSE;
+         o->headLen = 0;
+         return TRUE;
+      }
+   }
+   return FALSE;
+}
+
+
+/* Runs SharkSslCon_decrypt until the handshake is complete or, when
+   'handshake' is FALSE, until one response is received.
+*/
+static void
+receive(Client* o, BaBool handshake)
+{
+   U16 len = 0;
+   BaBool done = FALSE;
+   for(;;)
+   {
+      switch(SharkSslCon_decrypt(o->scon, len))
+      {
+         case SharkSslCon_Handshake:
+         {
+            U16 n = SharkSslCon_getHandshakeDataLen(o->scon);
+            if(n)
+            {
+               sendAll(o, SharkSslCon_getHandshakeData(o->scon), n);
+               SharkSslCon_setHandshakeDataSent(o->scon, n);
+            }
+            if(handshake && SharkSslCon_isHandshakeComplete(o->scon) == 1)
+               return;
+            len = 0;
+            break;
+         }
+
+         case SharkSslCon_Decrypted:
+         {
+            U8* buf;
+            U16 n = SharkSslCon_getDecData(o->scon, &buf);
+            if(handshake)
+               fail("Unexpected data");
+            if(consume(o, buf, n))
+               done = TRUE;
+            len = 0;
+            break;
+         }
+
+         case SharkSslCon_NeedMoreData:
+         {
+            int n;
+            if(done)
+               return;
+            n = (int)recv(o->sock, SharkSslCon_getBuf(o->scon),
+                          SharkSslCon_getBufLen(o->scon), 0);
+            if(n <= 0)
+               fail("recv failed");
+            countRecords(o, SharkSslCon_getBuf(o->scon), n);
+            len = (U16)n;
+            break;
+         }
+
+         default:
+            fail("TLS error");
+      }
+   }
+}
+
+
+static void
+Client_connect(Client* o)
+{
+   struct sockaddr_in addr;
+   int one = 1;
+   memset(o, 0, sizeof(Client));
+   o->sock = socket(AF_INET, SOCK_STREAM, 0);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((unsigned short)port);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if(o->sock < 0 || connect(o->sock, (struct sockaddr*)&addr, sizeof(addr)))
+   {
+      perror("connect");
+      exit(1);
+   }
+   setsockopt(o->sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+   pthread_mutex_lock(&clientMutex);
+   o->scon = SharkSsl_createCon(&sharkSslClient);
+   pthread_mutex_unlock(&clientMutex);
+   if(!o->scon)
+      fail("Cannot create SharkSslCon");
+   receive(o, TRUE);
+}
+
+
+static void
+Client_request(Client* o, const char* path)
+{
+   char req[128];
+   int len = sprintf(req, "GET /%s HTTP/1.1\r\nHost: localhost\r\n\r\n", path);
+   if(SharkSslCon_encrypt(o->scon, (U8*)req, (U16)len) !=
+      SharkSslCon_Encrypted)
+   {
+      fail("Cannot encrypt the request");
+   }
+   sendAll(o, SharkSslCon_getEncData(o->scon),
+           SharkSslCon_getEncDataLen(o->scon));
+   receive(o, FALSE);
+}
+
+
+typedef struct
+{
+   pthread_t tid;
+   const char* path;
+   long requests;
+   long records;
+   long recBytes;
+} ClientThread;
+
+
+static void*
+client(void* arg)
+{
+   ClientThread* t = (ClientThread*)arg;
+   Client c;
+   long i;
+   Client_connect(&c);
+   for(i=0 ; i < t->requests ; i++)
+      Client_request(&c, t->path);
+   cipherSuite = SharkSslCon_getCiphersuite(c.scon);
+   protocol = SharkSslCon_getProtocol(c.scon);
+   t->records = c.records;
+   t->recBytes = c.recBytes;
+   close(c.sock);
+   pthread_mutex_lock(&clientMutex);
+   SharkSsl_terminateCon(&sharkSslClient, c.scon);
+   pthread_mutex_unlock(&clientMutex);
+   return 0;
+}
+
+
+static void
+run(const char* path, long requests, long size)
+{
+   ClientThread t[64];
+   double wall, cpu;
+   long total = requests * clients;
+   long records = 0, recBytes = 0;
+   int i;
+   wall = now(CLOCK_MONOTONIC);
+   cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+   for(i=0 ; i < clients ; i++)
+   {
+      t[i].path = path;
+      t[i].requests = requests;
+      pthread_create(&t[i].tid, 0, client, t+i);
+   }
+   for(i=0 ; i < clients ; i++)
+   {
+      pthread_join(t[i].tid, 0);
+      records += t[i].records;
+      recBytes += t[i].recBytes;
+   }
+   wall = now(CLOCK_MONOTONIC) - wall;
+   cpu = now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+   printf("%-7s %7.0f requests/s %8.1f MB/s %9.1f us CPU/request "
+          "%7.1f records/response %5.0f bytes/record\n",
+          path, total / wall, total * (double)size / wall / 1e6,
+          cpu / total * 1e6, (double)records / total,
+          records ? (double)recBytes / records : 0.0);
+}
+
+
+/* Runs the clients and terminates the program when they are done. */
+static void*
+monitor(void* arg)
+{
+   (void)arg;
+   printf("%d clients, %ld short and %ld 1 MB requests per client\n",
+          clients, shortRequests, largeRequests);
+   run("short", shortRequests, SHORT_SIZE);
+   run("large", largeRequests, LARGE_SIZE);
+   printf("TLS 1.%d, cipher suite 0x%04X\n", (protocol & 15) - 1, cipherSuite);
+#if USE_KTLS
+   printf("kTLS offload: %d of %d responses\n", offloaded, servedCons);
+#endif
+   exit(0);
+   return 0;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   static ThreadMutex mutex;
+   static SoDisp disp;
+   static HttpServer server;
+   static HttpServerConfig cfg;
+   static SharkSsl sharkSsl;
+   static HttpSharkSslServCon scon;
+   static HttpDir root;
+   static HttpPage shortP, largeP;
+   pthread_t tid;
+   if(argc > 1) clients = atoi(argv[1]);
+   if(argc > 2) shortRequests = atol(argv[2]);
+   if(argc > 3) largeRequests = atol(argv[3]);
+   if(argc > 4) port = atoi(argv[4]);
+   if(clients < 1 || clients > 64 || shortRequests <= 0 || largeRequests <= 0)
+   {
+      fprintf(stderr, "Usage: %s [clients (1-64)] [short requests per client]"
+              " [1 MB requests per client] [port]\n", argv[0]);
+      return 1;
+   }
+   ThreadMutex_constructor(&mutex);
+   SoDisp_constructor(&disp, &mutex);
+   HttpServerConfig_constructor(&cfg);
+   HttpServerConfig_setNoOfHttpConnections(&cfg, (U16)(clients + 2));
+   HttpServer_constructor(&server, &disp, &cfg);
+   SharkSsl_constructor(&sharkSsl, SharkSsl_Server, 16, 4096, 4096);
+   SharkSsl_addCertificate(&sharkSsl, sharkSslRSACert2048_localhost);
+   SharkSsl_constructor(&sharkSslClient, SharkSsl_Client, 0, 4096, 4096);
+   HttpSharkSslServCon_constructor(
+      &scon, &sharkSsl, &server, &disp, (U16)port, FALSE, 0, 0);
+   if( ! HttpServCon_isValid((HttpServCon*)&scon) )
+   {
+      fprintf(stderr, "Cannot open server port %d\n", port);
+      return 1;
+   }
+   HttpDir_constructor(&root, 0, 0);
+   HttpPage_constructor(&shortP, shortPage, "short");
+   HttpPage_constructor(&largeP, largePage, "large");
+   HttpDir_insertPage(&root, &shortP);
+   HttpDir_insertPage(&root, &largeP);
+   HttpServer_insertRootDir(&server, &root);
+   pthread_create(&tid, 0, monitor, 0);
+   SoDisp_run(&disp, -1);
+   return 0;
+}
@@ -0,0 +1,313 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+HTTP throughput and connection distribution with several server
+processes listening on one port with SO_REUSEPORT
+(HttpServCon_setReusePort), as in the Mako Server's worker mode
+(mako -w N).
+
+The program forks the worker processes and then runs client threads
+that send each request on a new connection. The response tells which
+worker served the request. The test runs with one worker and with N
+workers, the latter with the kernel's default distribution and with
+the client address steering program used by mako -W ip. Each client
+thread uses its own source address (127.0.0.2, 127.0.0.3, ...) so
+that the steering can be seen.
+
+The program reports requests per second, the share of the requests
+served by each worker, and the number of clients that always reached
+the same worker. The throughput can only scale with the number of
+workers on a computer with that many CPU cores.
+
+Usage: workers [workers] [clients] [requests per client] [port]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <barracuda.h>
+#include <HttpServCon.h>
+
+#define MAX_WORKERS 32
+#define MAX_CLIENTS 64
+
+static int workers = 4;
+static int clients = 16;
+static long requests = 2000;
+static int port = 9360;
+
+/* served[client][worker] */
+static long served[MAX_CLIENTS][MAX_WORKERS];
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+/****************************** Worker *********************************/
+
+static char workerId[4];
+
+
+static void
+hello(HttpPage* page, HttpRequest* request, HttpResponse* response)
+{
+   (void)page;
+   (void)request;
+   HttpResponse_setContentLength(response, 3);
+   HttpResponse_write(response, workerId, 3, TRUE);
+}
+
+
+/* Attach the client address steering program used by the Mako
+   Server to the listen socket.
+*/
+static int
+steer(int fd, int n)
+{
+   struct sock_filter code[] = {
+      /* IPv4 source address */
+      BPF_STMT(BPF_LD|BPF_W|BPF_ABS, SKF_NET_OFF+12),
+      BPF_STMT(BPF_ALU|BPF_MUL|BPF_K, 0x9E3779B1),
+      BPF_STMT(BPF_ALU|BPF_RSH|BPF_K, 16),
+      BPF_STMT(BPF_ALU|BPF_MOD|BPF_K, 0), /* Number of workers */
+      BPF_STMT(BPF_RET|BPF_A, 0)
+   };
+   struct sock_fprog prog;
+   code[3].k=(U32)n;
+   prog.len=sizeof(code)/sizeof(code[0]);
+   prog.filter=code;
+   return setsockopt(
+      fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog));
+}
+
+
+/* Runs a server and writes one byte to 'ready' when it is listening */
+static void
+runWorker(int id, int n, BaBool steering, int ready)
+{
+   static ThreadMutex mutex;
+   static SoDisp disp;
+   static HttpServer server;
+   static HttpServerConfig cfg;
+   static HttpServCon scon;
+   static HttpDir root;
+   static HttpPage page;
+   sprintf(workerId, "%03d", id);
+   ThreadMutex_constructor(&mutex);
+   SoDisp_constructor(&disp, &mutex);
+   HttpServerConfig_constructor(&cfg);
+   HttpServerConfig_setNoOfHttpConnections(&cfg, (U16)(clients + 4));
+   HttpServer_constructor(&server, &disp, &cfg);
+   if(HttpServCon_setReusePort(TRUE))
+   {
+      fprintf(stderr, "SO_REUSEPORT is not supported\n");
+      _exit(1);
+   }
+   HttpServCon_constructor(&scon, &server, &disp, (U16)port, FALSE, 0, 0);
+   if( ! HttpServCon_isValid(&scon) )
+   {
+      fprintf(stderr, "Worker %d: cannot open server port %d\n", id, port);
+      _exit(1);
+   }
+   /* The steering program is shared by the sockets in the group and
+      selects a socket by its position in the group */
+   if(steering && id == n - 1 &&
+      steer(SoDispCon_getId((SoDispCon*)&scon), n))
+   {
+      perror("SO_ATTACH_REUSEPORT_CBPF");
+      _exit(1);
+   }
+   HttpDir_constructor(&root, 0, 0);
+   HttpPage_constructor(&page, hello, "hello");
+   HttpDir_insertPage(&root, &page);
+   HttpServer_insertRootDir(&server, &root);
+   if(write(ready, "R", 1) != 1)
+      _exit(1);
+   close(ready);
+   SoDisp_run(&disp, -1);
+   _exit(0);
+}
+
+
+/****************************** Client *********************************/
+
+static void*
+client(void* arg)
+{
+   static const char req[] =
+      "GET /hello HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+   int ix = (int)(ptrdiff_t)arg;
+   struct sockaddr_in src, addr;
+   long i;
+   memset(&src, 0, sizeof(src));
+   src.sin_family = AF_INET;
+   src.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + ix);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((unsigned short)port);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   for(i=0 ; i < requests ; i++)
+   {
+      char buf[1024];
+      char* body;
+      int len = 0;
+      int id;
+      int s = socket(AF_INET, SOCK_STREAM, 0);
+      if(s < 0 || bind(s, (struct sockaddr*)&src, sizeof(src)) ||
+         connect(s, (struct sockaddr*)&addr, sizeof(addr)) ||
+         send(s, req, sizeof(req)-1, 0) != sizeof(req)-1)
+      {
+         perror("client");
+         exit(1);
+      }
+      for(;;)
+      {
+         int n = (int)recv(s, buf + len, sizeof(buf) - len - 1, 0);
+         if(n <= 0)
+            break;
+         len += n;
+      }
+      buf[len] = 0;
+      close(s);
+      body = strstr(buf, "\r\n\r\n");
+      if(!body || sscanf(body + 4, "%3d", &id) != 1 || id < 0 ||
+         id >= workers)
+      {
+         fprintf(stderr, "Invalid response\n");
+         exit(1);
+      }
+      served[ix][id]++;
+   }
+   return 0;
+}
+
+
+static void
+run(const char* name, int n, BaBool steering)
+{
+   pthread_t tid[MAX_CLIENTS];
+   pid_t pids[MAX_WORKERS];
+   long total[MAX_WORKERS];
+   int fds[2];
+   double wall;
+   int i, j, sticky = 0;
+   char c;
+   memset(served, 0, sizeof(served));
+   if(pipe(fds))
+   {
+      perror("pipe");
+      exit(1);
+   }
+   /* Fork the workers one at a time to control the socket order */
+   for(i=0 ; i < n ; i++)
+   {
+      if( (pids[i]=fork()) == 0 )
+      {
+         close(fds[0]);
+         runWorker(i, n, steering, fds[1]);
+      }
+      if(read(fds[0], &c, 1) != 1)
+      {
+         fprintf(stderr, "Worker %d failed\n", i);
+         exit(1);
+      }
+   }
+   close(fds[0]);
+   close(fds[1]);
+   wall = now();
+   for(i=0 ; i < clients ; i++)
+      pthread_create(&tid[i], 0, client, (void*)(ptrdiff_t)i);
+   for(i=0 ; i < clients ; i++)
+      pthread_join(tid[i], 0);
+   wall = now() - wall;
+   for(i=0 ; i < n ; i++)
+   {
+      kill(pids[i], SIGTERM);
+      waitpid(pids[i], 0, 0);
+   }
+   for(j=0 ; j < n ; j++)
+      total[j] = 0;
+   for(i=0 ; i < clients ; i++)
+   {
+      int used = 0;
+      for(j=0 ; j < n ; j++)
+      {
+         total[j] += served[i][j];
+         if(served[i][j])
+            used++;
+      }
+      if(used == 1)
+         sticky++;
+   }
+   printf("%-8s %2d workers: %7.0f requests/s  sticky clients %2d/%d"
+          "  share", name, n, requests * clients / wall, sticky, clients);
+   for(j=0 ; j < n ; j++)
+      printf(" %3.0f%%", 100.0 * total[j] / (requests * clients));
+   printf("\n");
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   if(argc > 1) workers = atoi(argv[1]);
+   if(argc > 2) clients = atoi(argv[2]);
+   if(argc > 3) requests = atol(argv[3]);
+   if(argc > 4) port = atoi(argv[4]);
+   if(workers < 1 || workers > MAX_WORKERS || clients < 1 ||
+      clients > MAX_CLIENTS || requests <= 0)
+   {
+      fprintf(stderr, "Usage: %s [workers (1-%d)] [clients (1-%d)] "
+              "[requests per client] [port]\n",
+              argv[0], MAX_WORKERS, MAX_CLIENTS);
+      return 1;
+   }
+   signal(SIGPIPE, SIG_IGN);
+   printf("%d clients, %ld requests per client, %ld CPU cores\n",
+          clients, requests, sysconf(_SC_NPROCESSORS_ONLN));
+   run("single", 1, FALSE);
+   run("default", workers, FALSE);
+   run("ip", workers, TRUE);
+   return 0;
+}
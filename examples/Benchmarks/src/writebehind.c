@@ -0,0 +1,310 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+Upload throughput with and without WriteBehindIo when the storage is
+slow.
+
+The program simulates an upload: 16 KB chunks arrive from the network
+at a fixed rate and are written to a file. The file is opened in a
+simulated storage IoIntf whose writes take a fixed latency plus the
+time given by the storage bandwidth, as with an SD card or a network
+file system. The simulated storage checksums the data, and the
+checksum is compared with the data sent.
+
+The upload is made with the storage I/O used directly, in which case
+each network read waits for the previous write, and through a
+WriteBehindIo with different buffer sizes and counts.
+
+The program then makes the simulated storage fail with IOINTF_NOSPACE
+and checks that the WriteBehindIo returns the error to the writer, as
+HttpUpload requires for reporting it to the HttpUploadCbIntf: a
+failure in the middle of the file must be returned by a following
+write and by close, and a failure in the last buffer by close. No data
+may be written to the storage after the failure.
+
+Usage: writebehind [MB] [network MB/s] [storage MB/s] [latency ms]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <WriteBehindIo.h>
+
+#define CHUNK (16*1024)
+
+static double netRate = 10; /* MB/s */
+static double storageRate = 10;
+static double latency = 2; /* ms */
+
+typedef struct
+{
+   ResIntf super;
+   U32 sum;
+   long writes;
+   long written;
+   long failAt; /* Fail the write reaching this offset; -1: never */
+   long lateWrites; /* Writes after the failure */
+   BaBool failed;
+   BaBool closed;
+} SlowRes;
+
+static SlowRes slowRes;
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static void
+delay(double seconds)
+{
+   struct timespec t;
+   t.tv_sec = (time_t)seconds;
+   t.tv_nsec = (long)((seconds - t.tv_sec) * 1e9);
+   nanosleep(&t, 0);
+}
+
+
+static U32
+checksum(U32 sum, const U8* data, size_t len)
+{
+   size_t i;
+   for(i=0 ; i < len ; i++)
+      sum = sum * 31 + data[i];
+   return sum;
+}
+
+
+static int
+SlowRes_write(ResIntfPtr super, const void* buf, size_t size)
+{
+   SlowRes* o = (SlowRes*)super;
+   delay(latency / 1e3 + size / (storageRate * 1e6));
+   if(o->failed)
+      o->lateWrites++;
+   if(o->failAt >= 0 && o->written + (long)size > o->failAt)
+   {
+      o->failed = TRUE;
+      return IOINTF_NOSPACE;
+   }
+   o->sum = checksum(o->sum, (const U8*)buf, size);
+   o->written += (long)size;
+   o->writes++;
+   return 0;
+}
+
+
+static int
+SlowRes_flush(ResIntfPtr super)
+{
+   (void)super;
+   return 0;
+}
+
+
+static int
+SlowRes_close(ResIntfPtr super)
+{
+   ((SlowRes*)super)->closed = TRUE;
+   return 0;
+}
+
+
+/* The simulated storage has one file */
+static ResIntfPtr
+SlowIo_openRes(IoIntfPtr o, const char* name, U32 mode, int* status,
+               const char** ecode)
+{
+   (void)o;
+   (void)name;
+   (void)mode;
+   (void)ecode;
+   ResIntf_constructor((ResIntf*)&slowRes, 0, SlowRes_write, 0,
+                       SlowRes_flush, SlowRes_close);
+   slowRes.sum = 0;
+   slowRes.writes = 0;
+   slowRes.written = 0;
+   slowRes.failAt = -1;
+   slowRes.lateWrites = 0;
+   slowRes.failed = FALSE;
+   slowRes.closed = FALSE;
+   *status = 0;
+   return (ResIntfPtr)&slowRes;
+}
+
+
+static void
+upload(const char* name, IoIntfPtr io, long size)
+{
+   static U8 chunk[CHUNK];
+   ResIntfPtr res;
+   U32 sum = 0;
+   long sent;
+   int status;
+   double t = now();
+   res = io->openResFp(io, "upload.bin", OpenRes_WRITE, &status, 0);
+   if(!res)
+   {
+      fprintf(stderr, "Cannot open the file: %d\n", status);
+      exit(1);
+   }
+   for(sent=0 ; sent < size ; sent += CHUNK)
+   {
+      size_t i;
+      for(i=0 ; i < CHUNK ; i++)
+         chunk[i] = (U8)(sent / CHUNK * 7 + i);
+      delay(CHUNK / (netRate * 1e6)); /* Receive from the network */
+      sum = checksum(sum, chunk, CHUNK);
+      if( (status=res->writeFp(res, chunk, CHUNK)) != 0 )
+         break;
+   }
+   if(!status)
+      status = res->closeFp(res);
+   t = now() - t;
+   if(status || sum != slowRes.sum)
+   {
+      fprintf(stderr, "%s: upload failed: %d\n", name, status);
+      exit(1);
+   }
+   printf("%-18s %6.0f ms  %6.2f MB/s  %5ld storage writes\n",
+          name, t * 1e3, size / t / 1e6, slowRes.writes);
+}
+
+
+static void
+writeBehind(IoIntfPtr io, long size, size_t bufSize, int buffers)
+{
+   WriteBehindIo wb;
+   char name[40];
+   sprintf(name, "write-behind %dx%uK", buffers, (unsigned)(bufSize/1024));
+   WriteBehindIo_constructor(&wb, io, bufSize, buffers,
+                             WriteBehindIo_SyncOnClose, 0);
+   upload(name, (IoIntfPtr)&wb, size);
+   WriteBehindIo_destructor(&wb);
+}
+
+
+/* Write 'chunks' chunks with the storage failing at offset 'failAt'.
+   Returns the number of the write that returned the error, or
+   'chunks' if none did, and sets 'closeStatus'.
+*/
+static long
+failingUpload(IoIntfPtr io, long chunks, long failAt, int* closeStatus)
+{
+   static U8 chunk[CHUNK];
+   ResIntfPtr res;
+   long i;
+   int status = 0;
+   res = io->openResFp(io, "upload.bin", OpenRes_WRITE, &status, 0);
+   if(!res)
+   {
+      fprintf(stderr, "Cannot open the file: %d\n", status);
+      exit(1);
+   }
+   slowRes.failAt = failAt;
+   for(i=0 ; i < chunks ; i++)
+   {
+      if( (status=res->writeFp(res, chunk, CHUNK)) != 0 )
+         break;
+   }
+   if(status && status != IOINTF_NOSPACE)
+   {
+      fprintf(stderr, "Write returned %d, expected %d\n",
+              status, IOINTF_NOSPACE);
+      exit(1);
+   }
+   *closeStatus = res->closeFp(res);
+   return i;
+}
+
+
+static void
+errorCheck(IoIntfPtr io)
+{
+   WriteBehindIo wb;
+   long failed;
+   int closeStatus;
+   WriteBehindIo_constructor(&wb, io, CHUNK, 2,
+                             WriteBehindIo_SyncOnClose, 0);
+   /* Fails in the middle: the error must stop the writer */
+   failed = failingUpload((IoIntfPtr)&wb, 64, 8L*CHUNK, &closeStatus);
+   if(failed == 64 || closeStatus != IOINTF_NOSPACE ||
+      slowRes.lateWrites || !slowRes.closed)
+   {
+      fprintf(stderr, "Error check failed: write %ld of 64 failed, "
+              "close returned %d, %ld late writes\n",
+              failed, closeStatus, slowRes.lateWrites);
+      exit(1);
+   }
+   printf("Storage error at chunk 9 of 64: returned by write %ld and "
+          "by close\n", failed + 1);
+   /* Fails in the last buffer: only close can return the error */
+   failingUpload((IoIntfPtr)&wb, 4, 3L*CHUNK, &closeStatus);
+   if(closeStatus != IOINTF_NOSPACE || !slowRes.closed)
+   {
+      fprintf(stderr, "Error check failed: close returned %d\n",
+              closeStatus);
+      exit(1);
+   }
+   printf("Storage error in the last buffer: returned by close\n");
+   WriteBehindIo_destructor(&wb);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   IoIntf slowIo;
+   long size = 16;
+   if(argc > 1) size = atol(argv[1]);
+   if(argc > 2) netRate = atof(argv[2]);
+   if(argc > 3) storageRate = atof(argv[3]);
+   if(argc > 4) latency = atof(argv[4]);
+   if(size <= 0 || netRate <= 0 || storageRate <= 0 || latency < 0)
+   {
+      fprintf(stderr, "Usage: %s [MB] [network MB/s] [storage MB/s] "
+              "[latency ms]\n", argv[0]);
+      return 1;
+   }
+   size *= 1024*1024;
+   memset(&slowIo, 0, sizeof(slowIo));
+   slowIo.openResFp = SlowIo_openRes;
+   printf("%ld MB, network %.1f MB/s, storage %.1f MB/s + %.1f ms/write\n",
+          size >> 20, netRate, storageRate, latency);
+   upload("direct", &slowIo, size);
+   writeBehind(&slowIo, size, 16*1024, 2);
+   writeBehind(&slowIo, size, 16*1024, 4);
+   writeBehind(&slowIo, size, 64*1024, 2);
+   errorCheck(&slowIo);
+   return 0;
+}
@@ -0,0 +1,521 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+Broadcast throughput of the WebSocket server on the loopback interface.
+
+The server runs in the main thread. The program opens N WebSocket
+connections, each read by its own client thread, and broadcasts
+messages to all connections from a separate thread that holds the
+dispatcher mutex while sending one message. The test is repeated for
+the following send modes:
+
+  write     WSS_write on each connection; the frame is built and sent
+            per connection and the call blocks until the data is sent
+  send      one WSSFrame per message, sent with WSS_send to each
+            blocking connection
+  queue     one WSSFrame per message, queued with WSS_setQueue(64,
+            256K, WSS_QueueDrop); the broadcaster waits when a queue
+            is full so that no message is lost
+  queue+1   as 'queue' with one more client that never reads; its
+            frames are dropped when its queue is full
+  write+1   as 'write' with the client that never reads; the program
+            reports the number of messages sent before the broadcast
+            blocked
+
+'write' is how a broadcast was sent before WSSFrame and WSS_setQueue
+were added.
+
+With -z, the clients offer permessage-deflate and the program runs the
+'queue' test without compression and with a WSSDeflate configuration
+in its two modes:
+
+  deflate   server context takeover: each connection compresses the
+            message with its own compressor
+  shared    server no context takeover: the message is compressed
+            once and the compressed frame is shared by the connections
+
+The messages are JSON text with varying numbers. The program reports
+delivered frames per second, the process CPU time per delivered
+frame, which includes the client threads, and with -z the average
+frame size received by the clients.
+
+Usage: wsfanout [-z] [connections] [messages] [message size] [port]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <barracuda.h>
+#include <HttpServCon.h>
+#include <WebSocketServer.h>
+
+#define MAX_CONS 500
+
+typedef enum {
+   Mode_Write, Mode_Send, Mode_Queue
+} Mode;
+
+static int cons = 50;
+static long messages = 10000;
+static int msgSize = 64;
+static int port = 9358;
+
+static ThreadMutex mutex;
+static SoDisp disp;
+static WSSCB wsscb;
+static WSS* wssList[MAX_CONS+1];
+static int wssCount; /* Number of connections accepted by the server */
+static int wssOpen; /* Number of open server connections */
+static Mode mode;
+static int stalledIx; /* wssList index of the client that never reads */
+static WSSDeflate* deflateCfg;
+static BaBool compare; /* -z: compare the deflate modes */
+static long rxBytes; /* Received by all clients */
+static volatile long progress;
+
+
+static double
+now(clockid_t id)
+{
+   struct timespec t;
+   clock_gettime(id, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static void
+wsFrame(WSSCB* o, WSS* wss, void* data, int len, int text)
+{
+   (void)o;
+   (void)wss;
+   (void)data;
+   (void)len;
+   (void)text;
+}
+
+
+static void
+wsClose(WSSCB* o, WSS* wss, int status)
+{
+   int i;
+   (void)o;
+   (void)status;
+   for(i=0 ; i < wssCount ; i++)
+   {
+      if(wssList[i] == wss)
+         wssList[i]=0;
+   }
+   wssOpen--;
+   WSS_destructor(wss);
+   baFree(wss);
+}
+
+
+/* Upgrades the request and adds the connection to wssList */
+static void
+wsService(HttpPage* page, HttpRequest* request, HttpResponse* response)
+{
+   WSS* wss = (WSS*)baMalloc(sizeof(WSS));
+   (void)page;
+   (void)response;
+   WSS_constructor(wss, &wsscb, &disp, 1024, 1024);
+   WSS_setDeflate(wss, deflateCfg);
+   if(mode == Mode_Queue)
+      WSS_setQueue(wss, 64, 256*1024, WSS_QueueDrop);
+   if(wssCount > MAX_CONS || WSS_upgrade(wss, request))
+   {
+      WSS_destructor(wss);
+      baFree(wss);
+      return;
+   }
+   if(wssCount == stalledIx)
+   {
+      /* Limit the data buffered by the kernel for the stalled client */
+      int size = 16*1024;
+      setsockopt(SoDispCon_getId((SoDispCon*)wss), SOL_SOCKET, SO_SNDBUF,
+                 &size, sizeof(size));
+   }
+   wssList[wssCount++]=wss;
+   wssOpen++;
+}
+
+
+/* Open a WebSocket connection. The socket receive buffer is set to
+   'rcvBuf' bytes if not zero.
+*/
+static int
+wsConnect(int rcvBuf)
+{
+   static const char req[] =
+      "GET /ws HTTP/1.1\r\n"
+      "Host: localhost\r\n"
+      "Upgrade: websocket\r\n"
+      "Connection: Upgrade\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+      "Sec-WebSocket-Version: 13\r\n";
+   static const char ext[] =
+      "Sec-WebSocket-Extensions: permessage-deflate\r\n\r\n";
+   char buf[1024];
+   struct sockaddr_in addr;
+   int len = 0;
+   int one = 1;
+   int s = socket(AF_INET, SOCK_STREAM, 0);
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons((unsigned short)port);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if(rcvBuf)
+      setsockopt(s, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+   if(s < 0 || connect(s, (struct sockaddr*)&addr, sizeof(addr)))
+   {
+      perror("connect");
+      exit(1);
+   }
+   setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+   if(send(s, req, sizeof(req)-1, 0) != sizeof(req)-1 ||
+      (deflateCfg ? send(s, ext, sizeof(ext)-1, 0) != sizeof(ext)-1 :
+       send(s, "\r\n", 2, 0) != 2))
+   {
+      perror("send");
+      exit(1);
+   }
+   /* The server sends nothing after the response until the broadcast
+      starts, thus the response is all data up to the empty line. */
+   for(;;)
+   {
+      int n = (int)recv(s, buf + len, sizeof(buf) - len - 1, 0);
+      if(n <= 0)
+         break;
+      len += n;
+      buf[len] = 0;
+      if(strstr(buf, "\r\n\r\n"))
+      {
+         if(strncmp(buf, "HTTP/1.1 101", 12) ||
+            (deflateCfg && !strstr(buf, "permessage-deflate")))
+            break;
+         return s;
+      }
+      if(len >= (int)sizeof(buf) - 1)
+         break;
+   }
+   fprintf(stderr, "WebSocket handshake failed\n");
+   exit(1);
+   return -1;
+}
+
+
+/* Read frames until all messages are received */
+static void*
+reader(void* arg)
+{
+   U8 buf[16*1024];
+   long frames = 0;
+   long total = 0;
+   int len = 0;
+   int s = (int)(ptrdiff_t)arg;
+   while(frames < messages)
+   {
+      int ix = 0;
+      int n = (int)recv(s, buf + len, sizeof(buf) - len, 0);
+      if(n <= 0)
+      {
+         fprintf(stderr, "Client lost after %ld frames\n", frames);
+         exit(1);
+      }
+      len += n;
+      total += n;
+      /* Skip the complete frames in the buffer */
+      while(len - ix >= 2)
+      {
+         int hlen = 2;
+         int plen = buf[ix+1] & 0x7F;
+         if((buf[ix] & ~0x40) != 0x81 || plen == 127)
+         {
+            fprintf(stderr, "Unexpected frame %02X %02X\n",
+                    buf[ix], buf[ix+1]);
+            exit(1);
+         }
+         if(plen == 126)
+         {
+            if(len - ix < 4)
+               break;
+            plen = (buf[ix+2] << 8) | buf[ix+3];
+            hlen = 4;
+         }
+         if(len - ix < hlen + plen)
+            break;
+         ix += hlen + plen;
+         frames++;
+      }
+      memmove(buf, buf + ix, len - ix);
+      len -= ix;
+   }
+   ThreadMutex_set(&mutex);
+   rxBytes += total;
+   ThreadMutex_release(&mutex);
+   return 0;
+}
+
+
+/* A JSON message of 'msgSize' bytes with varying numbers */
+static void
+makeMsg(char* msg, long seq)
+{
+   int len = sprintf(msg, "{\"seq\":%ld,\"quotes\":[", seq);
+   while(len < msgSize - 1)
+   {
+      char q[64];
+      int n = sprintf(q, "{\"id\":%d,\"bid\":%d.%02d,\"ask\":%d.%02d},",
+                      rand() % 500, rand() % 1000, rand() % 100,
+                      rand() % 1000, rand() % 100);
+      if(n > msgSize - 1 - len)
+         n = msgSize - 1 - len;
+      memcpy(msg + len, q, n);
+      len += n;
+   }
+   msg[msgSize - 1] = '}';
+}
+
+
+/* Send one message to the first 'n' connections. Returns the number
+   of frames dropped for the connection at index 'stalled'. */
+static int
+broadcast(const char* msg, int n, int stalled)
+{
+   WSSFrame* f = 0;
+   int drops = 0;
+   int i, status;
+   ThreadMutex_set(&mutex);
+   if(mode != Mode_Write && (f=WSSFrame_create(msg, msgSize, TRUE)) == 0)
+   {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+   }
+   for(i=0 ; i < n ; i++)
+   {
+      for(;;)
+      {
+         status = mode == Mode_Write ?
+            WSS_write(wssList[i], msg, msgSize, TRUE) :
+            WSS_send(wssList[i], f);
+         if(status != E_TOO_MUCH_DATA)
+            break;
+         if(i == stalled)
+         {
+            drops++;
+            status=0;
+            break;
+         }
+         /* The queue is full: let the dispatcher send */
+         ThreadMutex_release(&mutex);
+         sched_yield();
+         ThreadMutex_set(&mutex);
+      }
+      if(status < 0)
+      {
+         fprintf(stderr, "Send failed: %d\n", status);
+         exit(1);
+      }
+   }
+   if(f)
+      WSSFrame_release(f);
+   ThreadMutex_release(&mutex);
+   progress++;
+   return drops;
+}
+
+
+static void
+waitOpen(int n)
+{
+   for(;;)
+   {
+      int open;
+      ThreadMutex_set(&mutex);
+      open = wssOpen;
+      ThreadMutex_release(&mutex);
+      if(open == n)
+         return;
+      usleep(1000);
+   }
+}
+
+
+/* Exits the program if the broadcast makes no progress for 2 seconds */
+static void*
+watchdog(void* arg)
+{
+   long last = -1;
+   (void)arg;
+   for(;;)
+   {
+      sleep(2);
+      if(progress == last)
+         break;
+      last = progress;
+   }
+   printf("%-9s the broadcast blocked after %ld of %ld messages\n",
+          "write+1", last, messages);
+   exit(0);
+   return 0;
+}
+
+
+static void
+run(const char* name, Mode m, BaBool stalled)
+{
+   static int socks[MAX_CONS+1];
+   pthread_t tid[MAX_CONS];
+   char* msg = (char*)malloc(msgSize + 64);
+   double wall, cpu;
+   long delivered = messages * cons;
+   long drops = 0;
+   long i;
+   int n = cons + (stalled ? 1 : 0);
+   mode = m;
+   rxBytes = 0;
+   wssCount = 0;
+   stalledIx = stalled ? cons : -1;
+   for(i=0 ; i < cons ; i++)
+      socks[i] = wsConnect(0);
+   if(stalled)
+      socks[cons] = wsConnect(4096);
+   waitOpen(n);
+   progress = 0;
+   wall = now(CLOCK_MONOTONIC);
+   cpu = now(CLOCK_PROCESS_CPUTIME_ID);
+   if(stalled && m == Mode_Write)
+   {
+      pthread_t wd;
+      pthread_create(&wd, 0, watchdog, 0);
+   }
+   for(i=0 ; i < cons ; i++)
+      pthread_create(&tid[i], 0, reader, (void*)(ptrdiff_t)socks[i]);
+   for(i=0 ; i < messages ; i++)
+   {
+      makeMsg(msg, i);
+      drops += broadcast(msg, n, stalledIx);
+   }
+   for(i=0 ; i < cons ; i++)
+      pthread_join(tid[i], 0);
+   wall = now(CLOCK_MONOTONIC) - wall;
+   cpu = now(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+   printf("%-9s %9.0f frames/s  %6.3f us CPU/frame", name,
+          delivered / wall, cpu / delivered * 1e6);
+   if(stalled)
+      printf("  %ld of %ld dropped for the stalled client", drops, messages);
+   if(compare)
+      printf("  %6.0f bytes/frame", (double)rxBytes / delivered);
+   printf("\n");
+   for(i=0 ; i < n ; i++)
+      close(socks[i]);
+   waitOpen(0);
+   free(msg);
+}
+
+
+static void*
+monitor(void* arg)
+{
+   (void)arg;
+   printf("%d connections, %ld messages of %d bytes\n",
+          cons, messages, msgSize);
+   if(compare)
+   {
+      static WSSDeflate perCon, shared;
+      WSSDeflate_constructor(&perCon, 6, FALSE);
+      WSSDeflate_constructor(&shared, 6, TRUE);
+      run("queue", Mode_Queue, FALSE);
+      deflateCfg = &perCon;
+      run("deflate", Mode_Queue, FALSE);
+      deflateCfg = &shared;
+      run("shared", Mode_Queue, FALSE);
+      exit(0);
+   }
+   run("write", Mode_Write, FALSE);
+   run("send", Mode_Send, FALSE);
+   run("queue", Mode_Queue, FALSE);
+   run("queue+1", Mode_Queue, TRUE);
+   run("write+1", Mode_Write, TRUE);
+   exit(0);
+   return 0;
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   static HttpServer server;
+   static HttpServerConfig cfg;
+   static HttpServCon scon;
+   static HttpDir root;
+   static HttpPage page;
+   pthread_t tid;
+   if(argc > 1 && !strcmp(argv[1], "-z"))
+   {
+      compare = TRUE;
+      argc--;
+      argv++;
+   }
+   if(argc > 1) cons = atoi(argv[1]);
+   if(argc > 2) messages = atol(argv[2]);
+   if(argc > 3) msgSize = atoi(argv[3]);
+   if(argc > 4) port = atoi(argv[4]);
+   if(cons < 1 || cons > MAX_CONS || messages <= 0 ||
+      msgSize < 1 || msgSize > 0xFFFF)
+   {
+      fprintf(stderr, "Usage: %s [-z] [connections (1-%d)] [messages] "
+              "[message size] [port]\n", argv[0], MAX_CONS);
+      return 1;
+   }
+   ThreadMutex_constructor(&mutex);
+   SoDisp_constructor(&disp, &mutex);
+   HttpServerConfig_constructor(&cfg);
+   HttpServerConfig_setNoOfHttpConnections(&cfg, 16);
+   HttpServer_constructor(&server, &disp, &cfg);
+   HttpServCon_constructor(&scon, &server, &disp, (U16)port, FALSE, 0, 0);
+   if( ! HttpServCon_isValid(&scon) )
+   {
+      fprintf(stderr, "Cannot open server port %d\n", port);
+      return 1;
+   }
+   WSSCB_constructor(&wsscb, wsFrame, wsClose, 0);
+   HttpDir_constructor(&root, 0, 0);
+   HttpPage_constructor(&page, wsService, "ws");
+   HttpDir_insertPage(&root, &page);
+   HttpServer_insertRootDir(&server, &root);
+   pthread_create(&tid, 0, monitor, 0);
+   SoDisp_run(&disp, -1);
+   return 0;
+}
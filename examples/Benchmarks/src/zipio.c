@@ -0,0 +1,232 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic
+ *               https://realtimelogic.com
+ *
+ *   The copyright to the program herein is the property of
+ *   Real Time Logic. The program may be used or copied only
+ *   with the written permission from Real Time Logic or
+ *   in accordance with the terms and conditions stipulated in
+ *   the agreement under which the program has been supplied.
+ ****************************************************************************
+ *
+ */
+
+
+/*
+ZipIo performance with a file based ZipReader and with MMapZipReader.
+
+For each reader, the program reports the time to mount the ZIP file
+(ZipIo_constructor), the time per stat lookup of every file in the
+archive and of as many non existing names, and the time and
+throughput for opening and reading every file through the IoIntf. The file
+based reader is an IoIntfZipReader on top of a DiskIo. Run the program
+twice and look at the second run if the ZIP file is not in the file
+system cache.
+
+Usage: zipio file.zip [runs]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <BaDiskIo.h>
+#include <IoIntfZipReader.h>
+#include <MMapZipReader.h>
+#include <ZipIo.h>
+
+typedef struct
+{
+   char** names;
+   int len;
+   int size;
+} NameList;
+
+static char readBuf[16*1024];
+
+
+static double
+now(void)
+{
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+
+static void
+NameList_add(NameList* o, const char* name)
+{
+   if(o->len == o->size)
+   {
+      o->size = o->size ? o->size * 2 : 1024;
+      o->names = (char**)realloc(o->names, o->size * sizeof(char*));
+   }
+   if(!o->names || !(o->names[o->len++] = strdup(name)))
+   {
+      fprintf(stderr, "Out of memory\n");
+      exit(1);
+   }
+}
+
+
+/* Collect the path of every file in the ZIP file */
+static void
+listFiles(IoIntf* io, const char* dirName, NameList* list)
+{
+   char path[1024];
+   int status;
+   DirIntfPtr dir = io->openDirFp(io, dirName, &status, 0);
+   if(!dir)
+      return;
+   while( ! dir->readFp(dir) )
+   {
+      IoStat st;
+      snprintf(path, sizeof(path), "%s%s%s", dirName, *dirName ? "/" : "",
+               dir->getNameFp(dir));
+      if( ! dir->statFp(dir, &st) && st.isDir )
+         listFiles(io, path, list);
+      else
+         NameList_add(list, path);
+   }
+   io->closeDirFp(io, &dir);
+}
+
+
+static void
+run(const char* readerName, ZipReader* reader, NameList* files, int runs)
+{
+   static char missing[1100];
+   ZipIo zipIo;
+   IoIntf* io = (IoIntf*)&zipIo;
+   IoStat st;
+   double start, t, mount = 1e9, stat = 1e9, miss = 1e9, rd = 1e9;
+   double bytes = 0;
+   int i, r;
+   for(r=0 ; r < runs ; r++)
+   {
+      start = now();
+      ZipIo_constructor(&zipIo, reader, 1024, 0);
+      if((t = now() - start) < mount)
+         mount = t;
+      if(ZipIo_getECode(&zipIo) != ZipErr_NoError)
+      {
+         fprintf(stderr, "Cannot mount the ZIP file: %d\n",
+                 ZipIo_getECode(&zipIo));
+         exit(1);
+      }
+
+      start = now();
+      for(i=0 ; i < files->len ; i++)
+      {
+         if(io->statFp(io, files->names[i], &st))
+         {
+            fprintf(stderr, "Cannot stat %s\n", files->names[i]);
+            exit(1);
+         }
+      }
+      if((t = now() - start) < stat)
+         stat = t;
+
+      start = now();
+      for(i=0 ; i < files->len ; i++)
+      {
+         snprintf(missing, sizeof(missing), "%s.x", files->names[i]);
+         io->statFp(io, missing, &st);
+      }
+      if((t = now() - start) < miss)
+         miss = t;
+
+      bytes = 0;
+      start = now();
+      for(i=0 ; i < files->len ; i++)
+      {
+         int status;
+         size_t size;
+         ResIntfPtr fp = io->openResFp(io, files->names[i], OpenRes_READ,
+                                       &status, 0);
+         if(!fp)
+         {
+            fprintf(stderr, "Cannot open %s\n", files->names[i]);
+            exit(1);
+         }
+         while( ! fp->readFp(fp, readBuf, sizeof(readBuf), &size) && size )
+            bytes += size;
+         fp->closeFp(fp);
+      }
+      if((t = now() - start) < rd)
+         rd = t;
+      ZipIo_destructor(&zipIo);
+   }
+   printf("%-16s mount %8.2f ms  stat %6.3f us  miss %6.3f us  "
+          "read %6.2f us/file %7.1f MB/s\n", readerName, mount * 1e3,
+          stat / files->len * 1e6, miss / files->len * 1e6,
+          rd / files->len * 1e6, bytes / rd / 1e6);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+   DiskIo diskIo;
+   IoIntfZipReader fileReader;
+   MMapZipReader mapReader;
+   NameList files;
+   char* path;
+   char* base;
+   int runs = argc > 2 ? atoi(argv[2]) : 5;
+   if(argc < 2 || runs <= 0)
+   {
+      fprintf(stderr, "Usage: %s file.zip [runs]\n", argv[0]);
+      return 1;
+   }
+   if( ! (path = realpath(argv[1], 0)) )
+   {
+      perror(argv[1]);
+      return 1;
+   }
+   base = strrchr(path, '/');
+   *base++ = 0;
+   DiskIo_constructor(&diskIo);
+   DiskIo_setRootDir(&diskIo, *path ? path : "/");
+   IoIntfZipReader_constructor(&fileReader, (IoIntf*)&diskIo, base);
+   MMapZipReader_constructor(&mapReader, argv[1]);
+   if( ! CspReader_isValid((CspReader*)&fileReader) ||
+       ! CspReader_isValid((CspReader*)&mapReader) )
+   {
+      fprintf(stderr, "Cannot open %s\n", argv[1]);
+      return 1;
+   }
+
+   memset(&files, 0, sizeof(files));
+   {
+      ZipIo zipIo;
+      ZipIo_constructor(&zipIo, (ZipReader*)&mapReader, 1024, 0);
+      listFiles((IoIntf*)&zipIo, "", &files);
+      ZipIo_destructor(&zipIo);
+   }
+   printf("%s: %d files\n", argv[1], files.len);
+   if(!files.len)
+      return 1;
+
+   run("IoIntfZipReader", (ZipReader*)&fileReader, &files, runs);
+   run("MMapZipReader", (ZipReader*)&mapReader, &files, runs);
+
+   IoIntfZipReader_close(&fileReader);
+   MMapZipReader_close(&mapReader);
+   DiskIo_destructor(&diskIo);
+   free(path);
+   return 0;
+}
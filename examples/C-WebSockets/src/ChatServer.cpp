@@ -33,10 +33,14 @@ thoroughly documented in the Lua documentation, which provides the
 same concept:
 https://realtimelogic.com/ba/doc/?url=SockLib.html#AsynchronousSockets
 
-Since writing data is blocking and broadcasting data to all connected
-clients could potentially block the caller, a separate thread is
-constructed for the purpose of broadcasting data to all connected
-clients. See ChatPage::send2allThread for more information.
+Writing data can also be made non-blocking by giving each connection
+a bounded outbound queue (WSS::setQueue). This example uses queued
+connections, which makes it possible to broadcast data to all
+connected clients directly from the WebSocket callbacks: a slow
+client only fills its own queue and cannot stall the other
+clients. A client whose queue is full is disconnected. A broadcast
+message is framed once (WSSFrame) and the frame is shared by all
+connection queues. See ChatPage::send2all for more information.
 
 The Barracuda Server library is implemented in C code, but provides
 wrappers for C++. This example shows how to use the C++
@@ -135,30 +139,24 @@ public:
 
 /* The chat entry page for WebSocket upgrade requests.
    HttpPage: the instance is inserted into the server's virtual file system
-   Thread: Method send2allThread runs as a separate thread
  */
-class ChatPage : public HttpPage, public Thread
+class ChatPage : public HttpPage
 {
     /* list of connected users: type ChatConnection */
    DoubleList chatList;
-    /* Queued messages managed by send2allThread, type: ChatMessage */
+    /* Messages waiting to be broadcast, type: ChatMessage */
    SingleList msgQueue;
-   /* Semaphore used for starting and stopping send2allThread */
-   ThreadSemaphore sem;
-   SoDisp* dispatcher;
-   int userCounter; /* Number of connected chat clients */
+   bool sending; /* True while send2all sends to the connections */
    /* WebSocket entry page */
    static void service(HttpPage* page, HttpRequest* req, HttpResponse* resp);
-   static void send2allThread(Thread* thread);
 public:
-   ChatPage(const char *pageName, SoDisp* dispatcher);
+   ChatPage(const char *pageName);
    void send2all(void* data,int len,bool isText);
-   void decrementUserCounter() { userCounter--; }
 };
 
 
-/* A chat message created in ChatPage::send2all and processed in
- * ChatPage::send2allThread.
+/* A chat message created in ChatPage::send2all and sent when
+ * send2all is not already sending.
  */
 struct ChatMessage : public SingleLink
 {
@@ -184,6 +182,10 @@ ChatConnection::ChatConnection(SoDisp* disp, ChatPage* p) :
    WSS(this,disp,8*1024,8*1024),
    page(p)
 {
+   /* Queue up to 64 frames or 256 Kbytes; disconnect a client that
+    * cannot keep up.
+    */
+   setQueue(64, 256*1024, WSS_QueueDisconnect);
 }
 
 
@@ -214,7 +216,6 @@ void ChatConnection::close(WSSCB* o, WSS* wss, int status)
    basnprintf(buf,sizeof(buf),"User %p leaving: status %d", self, status);
    printf("%s\n",buf);
    self->page->send2all(buf, strlen(buf), true);
-   self->page->decrementUserCounter();
    delete self;
 }
 
@@ -253,7 +254,6 @@ void ChatPage::service(HttpPage* page, HttpRequest* req, HttpResponse* resp)
       else
       {
          char buf[30];
-         self->userCounter++;
          basnprintf(buf,sizeof(buf),"You are user %p.", self);
          /* Send a short message to the new chat client */
          ws->write(buf, strlen(buf), true);
@@ -267,8 +267,17 @@ void ChatPage::service(HttpPage* page, HttpRequest* req, HttpResponse* resp)
 }
 
 
-/* Creates a ChatMessage from args, inserts the message into the
- * message queue, and activates the send2allThread.
+/* Sends a message to all connected chat clients. The method is
+ * called from the WebSocket callbacks and runs in the context of the
+ * socket dispatcher thread. WSS::send does not block since the
+ * connections are queued.
+ *
+ * WSS::send calls ChatConnection::close before returning if the
+ * client's queue is full. The close callback deletes the connection
+ * and calls send2all recursively. The message is for this reason
+ * inserted into msgQueue, and the loop below sends all queued
+ * messages unless a send2all call further up the stack is already
+ * sending.
  */
 void ChatPage::send2all(void* data, int len, bool isText)
 {
@@ -277,63 +286,37 @@ void ChatPage::send2all(void* data, int len, bool isText)
    {
       ChatMessage* msg = new(buf) ChatMessage(data, len, isText);
       msgQueue.insertLast(msg);
-      sem.signal();
    }
-}
-
-
-/* This method, which runs as a separate thread, waits for
- * ChatMessages from ChatPage::send2all. When a chat message is
- * received, the message's content is sent to all connected chat
- * clients.
- */
-void ChatPage::send2allThread(Thread* thread)
-{
-   ChatPage* self = (ChatPage*)thread;
-   for(;;)
+   if(sending)
+      return;
+   sending=true;
+   while( ! msgQueue.isEmpty() )
    {
-      /* Wait for activation from method ChatPage::send2all */
-      self->sem.wait();
-      /* The function is running in it's own thread and is not running
-       * in the context of the socket dispatcher thread. We must for
-       * this reason lock the dispatcher thread when working. Each
-       * call to WSS::write below releases the mutex while sending
-       * socket data.
-       */
-      ThreadLock dispLock(self->dispatcher->getMutex());
-      while( ! self->msgQueue.isEmpty() )
+      ChatMessage* msg = (ChatMessage*)msgQueue.removeFirst();
+      /* Create the WebSocket frame once and share it */
+      WSSFrame* frame = WSSFrame::create(msg->data, msg->size, msg->isTxt);
+      baFree(msg); /* Release memory allocated above */
+      if( ! frame )
+         continue;
+      DoubleListEnumerator e(&chatList);
+      DoubleLink* link = e.getElement();
+      while(link)
       {
-         ChatMessage* msg = (ChatMessage*)self->msgQueue.removeFirst();
-         DoubleListEnumerator e(&self->chatList);
-         int users = self->userCounter;
-         for(DoubleLink* link = e.getElement() ; link ; link = e.nextElement())
-         {
-            ((ChatConnection*)link)->write(msg->data, msg->size, msg->isTxt);
-            if(users != self->userCounter)
-            {
-               /* Method write releases the dispatcher mutex.
-                  if users != self->userCounter:
-                    We had a disconnect while the mutex was released and
-                    we can no longer trust the data and current pointer,
-                    which may be deleted, in the iterator.
-                */
-               break;
-            }
-         }
-         baFree(msg); /* Release memory allocated in ChatPage::send2all */
+         ChatConnection* con = (ChatConnection*)link;
+         /* Advance first; 'con' is deleted if send closes it */
+         link = e.nextElement();
+         con->send(frame);
       }
-      /* dispLock goes out of scope and destructor releases the mutex */
+      frame->release(); /* The queues keep a reference until sent */
    }
+   sending=false;
 }
 
 
-ChatPage::ChatPage(const char *pageName, SoDisp* disp) :
-   HttpPage(service,pageName),
-   Thread(send2allThread, ThreadPrioNormal, 6000)
+ChatPage::ChatPage(const char *pageName) :
+   HttpPage(service,pageName)
 {
-   dispatcher=disp;
-   userCounter=0;
-   start(); // Thread::start. Activate ChatPage::send2allThread
+   sending=false;
 }
 
 
@@ -381,7 +364,7 @@ installVirtualDir(HttpServer* server)
    // https://realtimelogic.com/ba/doc/en/C/reference/html/structHttpResRdr.html
    static HttpResRdr readDir(&io, 0);
    server->insertDir(0,&readDir);
-   static ChatPage wsp("my-web-socket-service", server->getDispatcher());
+   static ChatPage wsp("my-web-socket-service");
    readDir.insertPage(&wsp);
 }
 
@@ -45,6 +45,9 @@ extern void barracuda(void);
 #ifdef USE_DLMALLOC
 extern void init_dlmalloc(char* heapstart, char* heapend);
 #endif
+#ifdef USE_TCALLOC
+extern void init_tcalloc(char* heapstart, char* heapend);
+#endif
 
 /* Changes the current directory to the object directory.
 
@@ -109,6 +112,9 @@ main(int argc, char* argv[])
 #ifdef USE_DLMALLOC
    static char poolBuf[3 * 1024 * 1024];
    init_dlmalloc(poolBuf, poolBuf + sizeof(poolBuf));
+#elif defined(USE_TCALLOC)
+   static char poolBuf[8 * 1024 * 1024];
+   init_tcalloc(poolBuf, poolBuf + sizeof(poolBuf));
 #endif
 
    change2ObjDir(argv[0]);
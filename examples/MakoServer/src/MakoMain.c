@@ -60,6 +60,7 @@
 #include <HttpTrace.h>
 #include <HttpCmdThreadPool.h>
 #include <HttpResRdr.h>
+#include <HttpServCon.h>
 #include <IoIntfZipReader.h>
 #include <lualib.h>
 
@@ -175,6 +176,10 @@ int luaopen_org_conman_cbor_c(lua_State *L);
 #include <opcua_module.h>
 #endif
 
+#if USE_WRITEBEHIND
+#include <WriteBehindIo.h>
+#endif
+
 #ifndef AUX_LUA_BINDINGS
 #ifdef myCustomBindings
 extern void myCustomBindings(lua_State *L);
@@ -208,6 +213,9 @@ static ThreadMutex mutex;
 static HttpServer server;
 static BaTimer timer;
 static DiskIo diskIo; /* The IO named "disk" */
+#if USE_WRITEBEHIND
+static WriteBehindIo wbIo; /* The IO named "wbdisk" */
+#endif
 
 
 #if USE_EMBEDDED_ZIP
@@ -805,6 +813,655 @@ setUser(int argc, char** argv)
 #endif /* #ifdef CUSTOM_PLAT */
 
 
+/****************************** HOT RESTART *******************************/
+/* Zero downtime restart: mako -r path
+   The server listens for a new server process on the Unix domain
+   socket 'path'. A new server started with the same -r argument
+   connects to the running server and receives the listen sockets
+   (SCM_RIGHTS). The HttpServCon objects created by '.openports' use
+   the inherited sockets instead of binding new sockets. When the new
+   server is about to start its dispatcher, the old server stops
+   accepting connections, closes its idle persistent connections,
+   waits for the active requests to complete, and exits. The pending
+   connections are left in the shared listen queue, thus no client is
+   refused. WebSocket connections are closed by the applications'
+   onunload handlers when the old server exits; the clients then
+   reconnect to the new server.
+
+   Messages (one byte each):
+     old -> new: 'F' with up to HR_MAXFDS sockets, repeated, then 'E'
+     new -> old: 'R' (ready), sent just before the dispatcher starts
+     old -> new: 'S' (stopped), the old server no longer accepts
+*/
+#if !defined(_WIN32) && !defined(CUSTOM_PLAT) && !defined(BA_VXWORKS)
+#ifndef NO_HOT_RESTART
+#define USE_HOT_RESTART
+#endif
+#ifndef NO_MAKO_WORKERS
+#define USE_WORKERS
+#endif
+#endif
+
+#if defined(USE_HOT_RESTART) || defined(USE_WORKERS)
+/* Returns TRUE if 'fd' is a TCP listen socket */
+static int
+isListenSocket(int fd)
+{
+   struct sockaddr_storage sa;
+   socklen_t len=sizeof(int);
+   int val=0;
+   if(getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &val, &len) || !val)
+      return FALSE;
+   len=sizeof(sa);
+   return ! getsockname(fd, (struct sockaddr*)&sa, &len) &&
+      (sa.ss_family == AF_INET || sa.ss_family == AF_INET6);
+}
+
+/* Highest file descriptor scanned by isListenSocket callers */
+static int
+maxSocket(void)
+{
+   long maxfd=sysconf(_SC_OPEN_MAX);
+   return maxfd < 0 || maxfd > 65536 ? 65536 : (int)maxfd;
+}
+#endif
+
+#ifdef USE_HOT_RESTART
+#include <sys/un.h>
+
+/* Max time in seconds the old server waits for active requests */
+#ifndef HOT_RESTART_DRAIN_TIME
+#define HOT_RESTART_DRAIN_TIME 30
+#endif
+#define HR_MAXFDS 16
+
+static const char* hrPath;
+static int hrSock=-1; /* New server: the connection to the old server */
+static int hrListenSock=-1;
+static Thread hrThread;
+
+
+static int
+hrSockaddr(struct sockaddr_un* addr)
+{
+   memset(addr, 0, sizeof(struct sockaddr_un));
+   addr->sun_family=AF_UNIX;
+   if(strlen(hrPath) >= sizeof(addr->sun_path))
+      return -1;
+   strcpy(addr->sun_path, hrPath);
+   return 0;
+}
+
+
+static int
+hrSend(int sock, char type, int* fds, int nfds)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   union {
+      struct cmsghdr align;
+      char buf[CMSG_SPACE(HR_MAXFDS*sizeof(int))];
+   } cbuf;
+   ssize_t n;
+   memset(&msg, 0, sizeof(msg));
+   iov.iov_base=&type;
+   iov.iov_len=1;
+   msg.msg_iov=&iov;
+   msg.msg_iovlen=1;
+   if(nfds)
+   {
+      struct cmsghdr* cmsg;
+      memset(&cbuf, 0, sizeof(cbuf));
+      msg.msg_control=cbuf.buf;
+      msg.msg_controllen=CMSG_SPACE(nfds*sizeof(int));
+      cmsg=CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level=SOL_SOCKET;
+      cmsg->cmsg_type=SCM_RIGHTS;
+      cmsg->cmsg_len=CMSG_LEN(nfds*sizeof(int));
+      memcpy(CMSG_DATA(cmsg), fds, nfds*sizeof(int));
+   }
+   do n=sendmsg(sock, &msg, 0); while(n < 0 && errno == EINTR);
+   return n == 1 ? 0 : -1;
+}
+
+
+/* Receive one message and return the message type or -1. Received
+   sockets are handed to HttpServCon.
+*/
+static int
+hrRecv(int sock)
+{
+   struct msghdr msg;
+   struct iovec iov;
+   struct cmsghdr* cmsg;
+   union {
+      struct cmsghdr align;
+      char buf[CMSG_SPACE(HR_MAXFDS*sizeof(int))];
+   } cbuf;
+   ssize_t n;
+   char type;
+   memset(&msg, 0, sizeof(msg));
+   iov.iov_base=&type;
+   iov.iov_len=1;
+   msg.msg_iov=&iov;
+   msg.msg_iovlen=1;
+   msg.msg_control=cbuf.buf;
+   msg.msg_controllen=sizeof(cbuf.buf);
+   do n=recvmsg(sock, &msg, 0); while(n < 0 && errno == EINTR);
+   if(n != 1)
+      return -1;
+   for(cmsg=CMSG_FIRSTHDR(&msg) ; cmsg ; cmsg=CMSG_NXTHDR(&msg, cmsg))
+   {
+      if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+      {
+         int i, fd;
+         int nfds=(int)((cmsg->cmsg_len-CMSG_LEN(0))/sizeof(int));
+         for(i=0 ; i < nfds ; i++)
+         {
+            memcpy(&fd, CMSG_DATA(cmsg)+i*sizeof(int), sizeof(int));
+            if(HttpServCon_inheritSocket(fd))
+               close(fd);
+         }
+      }
+   }
+   return (U8)type;
+}
+
+
+/* Old server: send all TCP listen sockets. Mutex must be locked. */
+static int
+hrSendListenSockets(int sock)
+{
+   int fds[HR_MAXFDS];
+   int fd, nfds=0;
+   int maxfd=maxSocket();
+   for(fd=3 ; fd < maxfd ; fd++)
+   {
+      if( ! isListenSocket(fd) )
+         continue;
+      fds[nfds++]=fd;
+      if(nfds == HR_MAXFDS)
+      {
+         if(hrSend(sock, 'F', fds, nfds))
+            return -1;
+         nfds=0;
+      }
+   }
+   if(nfds && hrSend(sock, 'F', fds, nfds))
+      return -1;
+   return hrSend(sock, 'E', 0, 0);
+}
+
+
+/* Old server: wait for the active requests and exit */
+static void
+hrDrain(void)
+{
+   int busy;
+   U32 deadline=baGetUnixTime()+HOT_RESTART_DRAIN_TIME;
+   makoprintf(FALSE,"Hot restart: draining connections\n");
+   for(;;)
+   {
+      ThreadMutex_set(&mutex);
+      HttpServer_termIdleCons(&server);
+      busy=HttpServer_getNoOfActiveRequests(&server);
+      ThreadMutex_release(&mutex);
+      if( ! busy || baGetUnixTime() >= deadline )
+         break;
+      Thread_sleep(100);
+   }
+   if(busy)
+      makoprintf(TRUE,"Hot restart: terminating %d active requests\n",busy);
+   ThreadMutex_set(&mutex);
+   setDispExit();
+   ThreadMutex_release(&mutex);
+}
+
+
+/* Old server: wait for a new server process */
+static void
+hrRun(Thread* th)
+{
+   (void)th;
+   for(;;)
+   {
+      int status;
+      int sock=accept(hrListenSock, 0, 0);
+      if(sock < 0)
+      {
+         if(errno == EINTR)
+            continue;
+         return; /* hrStop */
+      }
+      ThreadMutex_set(&mutex);
+      status=hrSendListenSockets(sock);
+      ThreadMutex_release(&mutex);
+      /* Wait for 'R' while the new server loads its configuration */
+      if( ! status && hrRecv(sock) == 'R' )
+      {
+         ThreadMutex_set(&mutex);
+         HttpServCon_stopAccepting();
+         ThreadMutex_release(&mutex);
+         hrSend(sock, 'S', 0, 0);
+         close(sock);
+         /* The new server now owns 'path' */
+         close(hrListenSock);
+         hrListenSock=-1;
+         hrDrain();
+         return;
+      }
+      close(sock);
+      makoprintf(TRUE,"Hot restart: new server process failed\n");
+   }
+}
+
+
+/* New server: receive the listen sockets from the running server, if
+   any. Called before '.openports'.
+*/
+static void
+hrConnect(int argc, char** argv)
+{
+   struct sockaddr_un addr;
+   struct timeval tv;
+   int type;
+   if( ! findFlag(argc, argv, 'r', &hrPath) )
+      return;
+   if( ! hrPath || hrSockaddr(&addr) )
+      errQuit("-r: invalid path\n");
+   hrSock=socket(AF_UNIX, SOCK_STREAM, 0);
+   if(hrSock < 0)
+      errQuit("-r: %s\n", strerror(errno));
+   if(connect(hrSock, (struct sockaddr*)&addr, sizeof(addr)))
+   {
+      close(hrSock); /* No running server */
+      hrSock=-1;
+      return;
+   }
+   fcntl(hrSock, F_SETFD, FD_CLOEXEC);
+   tv.tv_sec=10;
+   tv.tv_usec=0;
+   setsockopt(hrSock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+   while( (type=hrRecv(hrSock)) == 'F' ) ;
+   if(type != 'E')
+   {
+      makoprintf(TRUE,"Hot restart: cannot get the listen sockets\n");
+      HttpServCon_closeInherited();
+      close(hrSock);
+      hrSock=-1;
+   }
+   else
+      makoprintf(FALSE,"Hot restart: taking over from running server\n");
+}
+
+
+/* New server: stop the old server and listen on 'path'. Called just
+   before the dispatcher starts.
+*/
+static void
+hrStart(void)
+{
+   struct sockaddr_un addr;
+   if( ! hrPath )
+      return;
+   if(hrSock >= 0)
+   {
+      if(hrSend(hrSock, 'R', 0, 0) || hrRecv(hrSock) != 'S')
+         makoprintf(TRUE,"Hot restart: no response from old server\n");
+      close(hrSock);
+      hrSock=-1;
+   }
+   hrSockaddr(&addr);
+   unlink(hrPath);
+   hrListenSock=socket(AF_UNIX, SOCK_STREAM, 0);
+   if(hrListenSock < 0 ||
+      bind(hrListenSock, (struct sockaddr*)&addr, sizeof(addr)) ||
+      listen(hrListenSock, 1))
+   {
+      makoprintf(TRUE,"Hot restart: cannot open %s: %s\n",
+                 hrPath, strerror(errno));
+      if(hrListenSock >= 0)
+         close(hrListenSock);
+      hrListenSock=-1;
+      return;
+   }
+   fcntl(hrListenSock, F_SETFD, FD_CLOEXEC);
+   Thread_constructor(&hrThread, hrRun, ThreadPrioNormal, BA_STACKSZ);
+   Thread_start(&hrThread);
+}
+
+
+/* Release 'path' unless handed to a new server */
+static void
+hrStop(void)
+{
+   int sock=hrListenSock;
+   if(sock >= 0)
+   {
+      hrListenSock=-1;
+      shutdown(sock, SHUT_RDWR); /* Wake up accept() in hrRun */
+      close(sock);
+      unlink(hrPath);
+   }
+}
+#else
+#define hrConnect(argc, argv)
+#define hrStart()
+#define hrStop()
+#endif
+
+
+/******************************** WORKERS *********************************/
+/* Multi-process mode: mako -w N [-W steering]
+   The Lua VM and the HttpServer run in one thread at a time, thus a
+   single server process uses one CPU core for Lua code. The supervisor
+   forks N worker processes (N=0: one per CPU core) that open the same
+   listen ports with SO_REUSEPORT; the kernel distributes the new
+   connections between the workers. The supervisor restarts a worker
+   that terminates and stops all workers on SIGTERM/SIGINT.
+
+   Steering, -W:
+     ip   (default) Connections from one client address go to the same
+          worker (a classic BPF program hashing the source address,
+          Linux only). An HttpSession exists in one worker only;
+          client address stickiness keeps the session cookie valid as
+          long as the client address and the set of workers do not
+          change.
+     cpu  Bind worker i to CPU core i (Linux only).
+     none Kernel default.
+
+   Each worker publishes its HttpStats data in memory shared with the
+   other workers, and HttpStats returns the sum of all workers
+   (including terminated workers) in all workers.
+*/
+#ifdef USE_WORKERS
+#include <sys/mman.h>
+#include <sys/wait.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/prctl.h>
+#include <linux/filter.h>
+#endif
+#include <HttpStats.h>
+
+#define WK_MAX 256
+
+typedef struct
+{
+   volatile U32 seq; /* Odd while the data is updated */
+   HttpStatsData data;
+} WkStats;
+
+static WkStats* wkStats; /* wkCount slots and one for terminated workers */
+static ThreadMutex wkMutex;
+static Thread wkThread;
+static int wkId=-1; /* Worker number, -1 if not a worker */
+static int wkCount;
+static int wkSteering; /* 0: none, 1: ip, 2: cpu */
+static volatile sig_atomic_t wkExit;
+
+
+static void
+wkWrite(WkStats* o, const HttpStatsData* data, BaBool merge)
+{
+   if(o->seq & 1)
+      o->seq++; /* Writer terminated while updating */
+   o->seq++;
+   __sync_synchronize();
+   if( ! data )
+      memset(&o->data, 0, sizeof(HttpStatsData));
+   else if(merge)
+      HttpStats_merge(&o->data, data);
+   else
+      o->data = *data;
+   __sync_synchronize();
+   o->seq++;
+}
+
+
+static int
+wkRead(WkStats* o, HttpStatsData* data)
+{
+   int retry;
+   for(retry=0 ; retry < 1000 ; retry++)
+   {
+      U32 seq=o->seq;
+      __sync_synchronize();
+      if( ! (seq & 1) )
+      {
+         *data = o->data;
+         __sync_synchronize();
+         if(seq == o->seq)
+            return 0;
+      }
+      Thread_sleep(0);
+   }
+   return -1;
+}
+
+
+/* HttpStats_setAggregate callback: publish the data recorded by this
+   worker and add the data from the other workers.
+*/
+static void
+wkAggregate(HttpStatsData* data)
+{
+   HttpStatsData* other = (HttpStatsData*)baMalloc(sizeof(HttpStatsData));
+   int i;
+   ThreadMutex_set(&wkMutex);
+   wkWrite(wkStats+wkId, data, FALSE);
+   for(i=0 ; other && i <= wkCount ; i++)
+   {
+      if(i != wkId && ! wkRead(wkStats+i, other))
+         HttpStats_merge(data, other);
+   }
+   ThreadMutex_release(&wkMutex);
+   if(other)
+      baFree(other);
+}
+
+
+/* Publish the statistics once a second */
+static void
+wkPublish(Thread* th)
+{
+   HttpStatsData* data = (HttpStatsData*)baMalloc(sizeof(HttpStatsData));
+   (void)th;
+   if(data)
+   {
+      for(;;)
+      {
+         HttpStats_collect(data);
+         Thread_sleep(1000);
+      }
+   }
+}
+
+
+/* Attach the steering program to the listen sockets opened by
+   '.openports'. One program is shared by all sockets bound to the
+   same port.
+*/
+static void
+wkSteer(void)
+{
+#if defined(SO_ATTACH_REUSEPORT_CBPF) && defined(SKF_NET_OFF)
+   struct sock_filter code[] = {
+      /* IP version */
+      BPF_STMT(BPF_LD|BPF_B|BPF_ABS, SKF_NET_OFF),
+      BPF_STMT(BPF_ALU|BPF_RSH|BPF_K, 4),
+      BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K, 6, 0, 2),
+      /* IPv6: low 32 bits of the source address */
+      BPF_STMT(BPF_LD|BPF_W|BPF_ABS, SKF_NET_OFF+20),
+      BPF_JUMP(BPF_JMP|BPF_JA, 1, 0, 0),
+      /* IPv4 source address */
+      BPF_STMT(BPF_LD|BPF_W|BPF_ABS, SKF_NET_OFF+12),
+      BPF_STMT(BPF_ALU|BPF_MUL|BPF_K, 0x9E3779B1),
+      BPF_STMT(BPF_ALU|BPF_RSH|BPF_K, 16),
+      BPF_STMT(BPF_ALU|BPF_MOD|BPF_K, 0), /* wkCount */
+      BPF_STMT(BPF_RET|BPF_A, 0)
+   };
+   struct sock_fprog prog;
+   int fd, maxfd;
+   if(wkId < 0 || wkSteering != 1)
+      return;
+   code[8].k=(U32)wkCount;
+   prog.len=sizeof(code)/sizeof(code[0]);
+   prog.filter=code;
+   maxfd=maxSocket();
+   for(fd=3 ; fd < maxfd ; fd++)
+   {
+      if(isListenSocket(fd) && setsockopt(
+            fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)))
+      {
+         makoprintf(TRUE,"Worker %d: cannot set steering program: %s\n",
+                    wkId+1, strerror(errno));
+         return;
+      }
+   }
+#endif
+}
+
+
+static void
+wkSigTerm(int sig)
+{
+   (void)sig;
+   wkExit=TRUE;
+}
+
+
+static pid_t
+wkFork(int id)
+{
+   pid_t pid=fork();
+   if(pid == 0)
+   {
+      wkId=id;
+#ifdef __linux__
+      prctl(PR_SET_PDEATHSIG, SIGTERM);
+      if(wkSteering == 2)
+      {
+         cpu_set_t set;
+         long ncpu=sysconf(_SC_NPROCESSORS_ONLN);
+         CPU_ZERO(&set);
+         CPU_SET(ncpu > 0 ? id % ncpu : 0, &set);
+         sched_setaffinity(0, sizeof(set), &set);
+      }
+#endif
+      setCtrlCHandler();
+      ThreadMutex_constructor(&wkMutex);
+      HttpStats_setAggregate(wkAggregate);
+      Thread_constructor(&wkThread, wkPublish, ThreadPrioNormal, BA_STACKSZ);
+      Thread_start(&wkThread);
+   }
+   else if(pid < 0)
+      makoprintf(TRUE,"Cannot fork worker: %s\n", strerror(errno));
+   return pid;
+}
+
+
+/* Returns in the worker processes. The supervisor process exits when
+   the workers have terminated.
+*/
+static void
+wkSupervise(int argc, char** argv)
+{
+   struct sigaction sa;
+   pid_t pids[WK_MAX];
+   time_t started[WK_MAX];
+   const char* arg;
+   int i, running;
+   if( ! findFlag(argc, argv, 'w', &arg) )
+      return;
+   wkCount = arg ? atoi(arg) : 0;
+   if(wkCount <= 0)
+      wkCount=(int)sysconf(_SC_NPROCESSORS_ONLN);
+   if(wkCount <= 0)
+      wkCount=1;
+   if(wkCount > WK_MAX)
+      wkCount=WK_MAX;
+   wkSteering=1;
+   if(findFlag(argc, argv, 'W', &arg))
+   {
+      if(arg && !strcmp(arg, "none"))
+         wkSteering=0;
+      else if(arg && !strcmp(arg, "cpu"))
+         wkSteering=2;
+      else if(!arg || strcmp(arg, "ip"))
+         errQuit("-W: expected ip, cpu, or none\n");
+   }
+   if(findFlag(argc, argv, 'r', 0))
+      errQuit("-r cannot be combined with -w\n");
+   if(HttpServCon_setReusePort(TRUE))
+      errQuit("-w: SO_REUSEPORT is not supported\n");
+   wkStats = (WkStats*)mmap(0, (wkCount+1)*sizeof(WkStats),
+                            PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS,
+                            -1, 0);
+   if(wkStats == MAP_FAILED)
+      errQuit("mmap: %s\n", strerror(errno));
+   memset(wkStats, 0, (wkCount+1)*sizeof(WkStats));
+
+   /* No SA_RESTART: the signals must interrupt waitpid */
+   memset(&sa, 0, sizeof(sa));
+   sa.sa_handler=wkSigTerm;
+   sigemptyset(&sa.sa_mask);
+   sigaction(SIGTERM, &sa, 0);
+   sigaction(SIGINT, &sa, 0);
+   makoprintf(FALSE,"Starting %d worker processes\n", wkCount);
+   for(i=0 ; i < wkCount ; i++)
+   {
+      started[i]=time(0);
+      if( (pids[i]=wkFork(i)) == 0 )
+         return;
+   }
+   running=wkCount;
+   while(running)
+   {
+      int status;
+      pid_t pid=waitpid(-1, &status, 0);
+      if(pid < 0)
+      {
+         if(errno != EINTR)
+            break;
+         if(wkExit == TRUE)
+         {
+            wkExit=2; /* Signal the workers once */
+            for(i=0 ; i < wkCount ; i++)
+               if(pids[i] > 0) kill(pids[i], SIGTERM);
+         }
+         continue;
+      }
+      for(i=0 ; i < wkCount && pids[i] != pid ; i++);
+      if(i == wkCount)
+         continue;
+      /* Keep the totals of the terminated worker */
+      wkWrite(wkStats+wkCount, &wkStats[i].data, TRUE);
+      wkWrite(wkStats+i, 0, FALSE);
+      pids[i]=-1;
+      running--;
+      if( ! wkExit )
+      {
+         makoprintf(TRUE,"Worker %d (pid %d) terminated; restarting\n",
+                    i+1, (int)pid);
+         if(time(0) - started[i] < 2)
+            sleep(1); /* Worker fails at startup */
+         started[i]=time(0);
+         if( (pids[i]=wkFork(i)) == 0 )
+            return;
+         if(pids[i] > 0)
+            running++;
+      }
+   }
+   HttpTrace_flush();
+   exit(0);
+}
+#else
+#define wkSupervise(argc, argv)
+#define wkSteer()
+#endif
+
+
 #ifdef NDEBUG
 #define xpcall(L,nargs) lua_pcall(L,nargs,0,0)
 #else
@@ -1121,6 +1778,13 @@ createLuaGlobals(
    }
    lua_pushboolean(L, daemonMode ? TRUE : FALSE);
    lua_setfield(L, -2, "daemon");
+#ifdef USE_WORKERS
+   if(wkId >= 0)
+   {
+      lua_pushinteger(L, wkId+1);
+      lua_setfield(L, -2, "worker");
+   }
+#endif
 
    balua_pushbatab(L);
    luaL_setfuncs(L, funcs, 1);
@@ -1162,6 +1826,16 @@ printUsage()
 " -d                       - Run in daemon mode by detatching from the console\n"
 " -s                       - Run in daemon mode without detatching from the console\n"
 " -u username              - Username to run as\n"
+" -r path                  - Hot restart: take over the listen sockets from\n"
+"                            the server listening on Unix socket 'path'\n"
+" -w workers               - Run 'workers' processes sharing the listen ports;\n"
+"                            0 starts one process per CPU core\n"
+" -W ip|cpu|none           - Worker steering: by client address (default),\n"
+"                            CPU affinity, or none\n"
+#endif
+#if USE_WRITEBEHIND
+" -b KB[:buffers[:sync]]   - Buffering for the write-behind I/O \"wbdisk\";\n"
+"                            sync is none, close (default), or each\n"
 #endif
 " script                   - Execute the script and exit\n"
    };
@@ -1170,6 +1844,45 @@ printUsage()
 }
 
 
+#if USE_WRITEBEHIND
+/* Create the write-behind I/O "wbdisk", the "disk" I/O with files
+   written by a background thread. Use ba.openio"wbdisk" as the I/O
+   for uploads to slow storage such as SD cards and NFS mounts.
+*/
+static void
+openWriteBehindIo(int argc, char** argv)
+{
+   const char* arg;
+   size_t bufSize=64*1024;
+   int buffers=2;
+   WriteBehindIo_Sync sync=WriteBehindIo_SyncOnClose;
+   if(findFlag(argc, argv, 'b', &arg))
+   {
+      const char* ptr;
+      if(!arg || atoi(arg) <= 0)
+         errQuit("-b: expected KB[:buffers[:sync]]\n");
+      bufSize=(size_t)atoi(arg)*1024;
+      if( (ptr=strchr(arg, ':')) != 0 )
+      {
+         buffers=atoi(++ptr);
+         if( (ptr=strchr(ptr, ':')) != 0 )
+         {
+            if(!strcmp(++ptr, "none"))
+               sync=WriteBehindIo_SyncNone;
+            else if(!strcmp(ptr, "each"))
+               sync=WriteBehindIo_SyncEachBuffer;
+            else if(strcmp(ptr, "close"))
+               errQuit("-b: sync must be none, close, or each\n");
+         }
+      }
+   }
+   WriteBehindIo_constructor(
+      &wbIo, (IoIntf*)&diskIo, bufSize, buffers, sync, 0);
+   balua_iointf(L, "wbdisk",  (IoIntf*)&wbIo);
+}
+#endif
+
+
 static IoIntf*
 checkMakoIo(IoIntf* io, const char* name)
 {
@@ -1515,7 +2228,7 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
 #ifdef BA_WIN32
    int sMode;
 #endif
-#ifdef USE_DLMALLOC
+#if defined(USE_DLMALLOC) || defined(USE_TCALLOC)
    static char poolBuf[4*1024*1024]; /* Set your required size */
 #endif
    BaBool limitedZip=FALSE;
@@ -1532,6 +2245,8 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
 #endif
 #ifdef USE_DLMALLOC
    init_dlmalloc(poolBuf, poolBuf + sizeof(poolBuf)); 
+#elif defined(USE_TCALLOC)
+   init_tcalloc(poolBuf, poolBuf + sizeof(poolBuf)); 
 #endif
 
    memset(&blp, 0, sizeof(blp));
@@ -1665,6 +2380,8 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
 #endif
    if( ! isWinService )
       setCtrlCHandler();
+   /* Fork the worker processes when in multi-process mode */
+   wkSupervise(argc, argv);
 
    /* Create the Socket dispatcher (SoDisp), the SoDisp mutex, and the server.
     */
@@ -1721,6 +2438,9 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
    NetIo_constructor(&netIo, &disp);
    balua_iointf(L, "net",  (IoIntf*)&netIo);
    balua_iointf(L, "disk",  (IoIntf*)&diskIo);
+#if USE_WRITEBEHIND
+   openWriteBehindIo(argc, argv);
+#endif
 #ifdef MAKO_HOME_DIR
    balua_iointf(L, "home",  homeIo);
 #endif
@@ -1752,6 +2472,21 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
 #if USE_UBJSON
    balua_ubjson(L);
 #endif
+#if USE_JSONDEC
+   balua_jsondec(L); /* src/ljsondec.c */
+#endif
+#if USE_BACBOR
+   balua_cbor(L); /* src/lcbor.c */
+#endif
+#if USE_HTTP_STATS
+   balua_httpstats(L); /* src/lhttpstats.c */
+#endif
+#ifdef BA_HEAP_PROFILE
+   balua_heapprof(L); /* src/lheapprof.c */
+#endif
+#if USE_BYTECACHE
+   balua_bytecache(L); /* src/lbytecache.c */
+#endif
 #if USE_LPEG
    luaL_requiref(L, "lpeg", luaopen_lpeg, FALSE);
    lua_pop(L,1); /* Pop lpeg obj: statically loaded, not dynamically. */
@@ -1779,6 +2514,9 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
     */
    ThreadMutex_set(&mutex);
 
+   /* Get the listen sockets from a running server when hot restarting */
+   hrConnect(argc, argv);
+
    /* (Ref-ports)
       Open web server listen ports by calling the Lua script
       '.openports'. Notice that we do this on Linux before downgrading
@@ -1789,6 +2527,8 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
 
    if(ecode)
       errQuit(".openports error: %s.\n", lua_tostring(L,-1)); 
+   HttpServCon_closeInherited(); /* Sockets not used by .openports */
+   wkSteer(); /* Distribute connections between the workers */
 
    /* On Linux, optionally downgrade from root to 'user'
       When run as: sudo mako -u `whoami`
@@ -1831,10 +2571,12 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
 #include "MakoExtM3.ch" /* Inject optional code */
    if( ! disp.doExit ) /* Can be set by debugger */
    {
+      hrStart(); /* Stop old server when hot restarting */
       /* Arg -1: Never returns unless CTRL-C handler (or debugger monitor)
           sets exit
       */
       SoDisp_run(&disp,-1);
+      hrStop();
    }
 
    /*Dispatcher mutex must be locked when terminating the following objects.*/
@@ -1855,6 +2597,9 @@ runMako(int isWinService, int argc, char* argv[], char* envp[])
    baFree(blp.vmio);
 #ifdef MAKO_HOME_DIR
    IoIntf_destructor(homeIo); /* Virtual destr */
+#endif
+#if USE_WRITEBEHIND
+   WriteBehindIo_destructor(&wbIo);
 #endif
    DiskIo_destructor(&diskIo);
    NetIo_destructor(&netIo);
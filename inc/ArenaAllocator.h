@@ -0,0 +1,120 @@
+/*
+ *     ____             _________                __                _     
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__  
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/  
+ *                                                       /____/          
+ *
+ *                  Barracuda Embedded Web-Server 
+ ****************************************************************************
+ *            HEADER
+ *
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic LLC, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *                                                                        
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *                                                                         
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+ *
+ */
+
+
+#ifndef __ArenaAllocator_h
+#define __ArenaAllocator_h
+
+#include <AllocatorIntf.h>
+
+
+/** This is a chunked bump allocator implementation for the abstract
+    interface class AllocatorIntf.
+
+    @ingroup DynamicMemory
+
+    The ArenaAllocator carves allocations out of large chunks obtained
+    from a backing allocator. Method free is a no-op, except for the
+    most recently allocated block, and all memory is released in one
+    shot when calling reset or the destructor. The allocator is
+    designed for short-lived trees with many small objects such as the
+    JVal nodes and strings created by JParserValFact. Using the same
+    ArenaAllocator instance as both the vAlloc and dAlloc argument
+    enables the JParserValFact arena mode, where termFirstVal resets
+    the arena instead of walking the syntax tree.
+
+    The ArenaAllocator is not thread safe.
+*/
+typedef struct ArenaAllocator
+#ifdef __cplusplus
+: public AllocatorIntf
+{
+      ArenaAllocator() {}
+
+      /** Create an arena allocator.
+          \param alloc the backing allocator used when allocating chunks.
+          \param chunkSize the size of each chunk. Allocations larger
+          than the chunk size get a dedicated chunk.
+       */
+      ArenaAllocator(AllocatorIntf* alloc, size_t chunkSize);
+
+      /** Releases all memory allocated from the arena.
+       */
+      ~ArenaAllocator();
+
+      /** Invalidate all memory allocated from the arena. The
+          smallest chunk, normally a regular chunk of chunkSize
+          bytes, is kept for reuse and all other chunks are released.
+       */
+      void reset();
+      
+#else
+{
+   AllocatorIntf super;
+#endif
+   AllocatorIntf* alloc;
+   struct ArenaAllocatorChunk* chunks;
+   unsigned char* cur;
+   unsigned char* end;
+   unsigned char* last;
+   size_t chunkSize;
+} ArenaAllocator;
+
+
+#ifdef __cplusplus
+extern "C" {
+#endif 
+BA_API void ArenaAllocator_constructor(ArenaAllocator* o,
+                                       AllocatorIntf* alloc,
+                                       size_t chunkSize);
+BA_API void ArenaAllocator_reset(ArenaAllocator* o);
+BA_API void ArenaAllocator_destructor(ArenaAllocator* o);
+BA_API BaBool ArenaAllocator_isArena(AllocatorIntf* o);
+#ifdef __cplusplus
+}
+inline ArenaAllocator::ArenaAllocator(AllocatorIntf* alloc, size_t chunkSize) {
+   ArenaAllocator_constructor(this, alloc, chunkSize);
+}
+inline ArenaAllocator::~ArenaAllocator() {
+   ArenaAllocator_destructor(this);
+}
+inline void ArenaAllocator::reset() {
+   ArenaAllocator_reset(this);
+}
+#endif 
+
+
+#endif
@@ -242,6 +242,15 @@ typedef struct BufPrint
           \sa BufPrint::printf with format flag j
       */
       int jsonString(const char* str);
+
+      /** Print a double using the shortest representation that
+          converts back to the same value, e.g. 0.1 and 1.5e+300.
+          Integral values are printed with a ".0" suffix. The function
+          is much faster than printf and is used by JEncoder. The
+          printf conversions %f, %e, and %g do not use it since they
+          must follow the C precision rules.
+      */
+      int dtoa(double v);
 #endif
       BufPrint_Flush flushCB;
       void *userData;
@@ -283,6 +292,9 @@ BA_API int BufPrint_b64urlEncode(
    BufPrint* o, const void* source, S32 slen, BaBool padding);
 
 BA_API int BufPrint_jsonString(BufPrint* o, const char* str);
+#ifndef NO_DOUBLE
+BA_API int BufPrint_dtoa(BufPrint* o, double v);
+#endif
 #ifdef __cplusplus
 }
 inline void* BufPrint::getUserData() {
@@ -328,6 +340,11 @@ inline int BufPrint::b64urlEncode(const void* source, S32 slen, bool padding){
 inline int BufPrint::jsonString(const char* str){
    return BufPrint_jsonString(this, str);
 }
+#ifndef NO_DOUBLE
+inline int BufPrint::dtoa(double v){
+   return BufPrint_dtoa(this, v);
+}
+#endif
 #endif
 
 /** @} */ /* end of BufPrint */
@@ -0,0 +1,144 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ *
+ ****************************************************************************
+ *			      HEADER
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic LLC, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Sampling heap profiler for baMalloc, baRealloc, and baFree.
+
+Compile the code with BA_HEAP_PROFILE and add src/HeapProfiler.c to
+the build. The macros below then route baMalloc, baRealloc, and
+baFree through the profiler, which forwards the requests to the
+allocator selected in TargConfig.h (dlmalloc, tcalloc, or the C
+library). Nothing is recorded until baHeapProf_start is called.
+
+Allocations are sampled on average once every 'sampleRate' bytes
+(Poisson sampling, as in tcmalloc), so the cost for the requests not
+sampled is a thread local counter update. For a sampled allocation,
+the profiler records the call stack and keeps track of the block until
+it is released. A release only takes the profiler lock when the block
+may have been sampled.
+
+The profile, printed with baHeapProf_print, uses the legacy heap
+profile text format (heap_v2) understood by pprof:
+\code
+pprof --text mako heap.prof
+\endcode
+
+Allocations can be attributed to a subsystem by tagging them. A tag
+is set for the calling thread with baHeapProf_setTag, or for all
+allocations made through an AllocatorIntf by using a
+HeapProfAllocator. baHeapProf_print can limit the profile to one tag,
+and baHeapProf_printTags prints the estimated live heap and total
+allocations per tag.
+*/
+#ifndef __HeapProfiler_h
+#define __HeapProfiler_h
+
+#include <AllocatorIntf.h>
+#include <BufPrint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void* baHeapProfMalloc(size_t n);
+void* baHeapProfRealloc(void* p, size_t n);
+void baHeapProfFree(void* p);
+
+/* Start sampling. A 'sampleRate' of zero selects 512 Kbytes. */
+BA_API int baHeapProf_start(size_t sampleRate);
+/* Stop sampling. Sampled blocks are still tracked until released. */
+BA_API void baHeapProf_stop(void);
+/* Set the calling thread's tag and return the previous tag. The
+   string must stay valid while the profiler is in use. */
+BA_API const char* baHeapProf_setTag(const char* tag);
+/* Print the live heap profile in the pprof heap_v2 format. All tags
+   are included when 'tag' is NULL. */
+BA_API int baHeapProf_print(BufPrint* out, const char* tag);
+/* Print the estimated live heap and allocation totals per tag. */
+BA_API int baHeapProf_printTags(BufPrint* out);
+#ifdef __cplusplus
+}
+#endif
+
+
+/** An AllocatorIntf that tags the allocations made by its owner.
+    The HeapProfAllocator forwards the requests to another allocator,
+    by default AllocatorIntf::getDefault, and sets the heap profiler
+    tag for the duration of each request.
+    \code
+    static HeapProfAllocator jsonAlloc;
+    HeapProfAllocator_constructor(&jsonAlloc, "json", 0);
+    JParser_constructor(&parser, .., (AllocatorIntf*)&jsonAlloc, ..);
+    \endcode
+ */
+typedef struct HeapProfAllocator
+#ifdef __cplusplus
+: public AllocatorIntf
+{
+      HeapProfAllocator() {}
+      /** Create a tagged allocator.
+          \param tag the tag, a string that must stay valid.
+          \param backend the allocator used, or NULL for the default.
+      */
+      HeapProfAllocator(const char* tag, AllocatorIntf* backend=0);
+#else
+{
+      AllocatorIntf super;
+#endif
+      AllocatorIntf* backend;
+      const char* tag;
+} HeapProfAllocator;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+BA_API void HeapProfAllocator_constructor(
+   HeapProfAllocator* o, const char* tag, AllocatorIntf* backend);
+#ifdef __cplusplus
+}
+inline HeapProfAllocator::HeapProfAllocator(
+   const char* tag, AllocatorIntf* backend) {
+   HeapProfAllocator_constructor(this, tag, backend); }
+#endif
+
+
+#ifndef HEAPPROF_IMPL
+#undef baMalloc
+#undef baRealloc
+#undef baFree
+#define baMalloc(n) baHeapProfMalloc(n)
+#define baRealloc(p,n) baHeapProfRealloc(p, n)
+#define baFree(p) baHeapProfFree(p)
+#endif
+
+#endif
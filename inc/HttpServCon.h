@@ -152,6 +152,49 @@ typedef struct HttpServCon
       int setPort(U16 portNumber, bool setIp6=false,
                   const void* interfaceName=0);
 
+      /** Make a listen socket created by another process available
+          to the HttpServCon objects created by this process. A
+          server connection object uses an inherited socket bound to
+          the same port, protocol version, and interface instead of
+          creating a new listen socket. This makes it possible for a
+          new server process to take over the listen sockets from a
+          running server without refusing connections, e.g. by
+          receiving the sockets over a Unix domain socket.
+          \param hndl the socket handle.
+          \return 0 on success or -1 if the platform does not
+          support inherited sockets or if the internal table is full.
+          \sa closeInherited
+      */
+      static int inheritSocket(int hndl);
+
+      /** Close the inherited sockets not used by any HttpServCon
+          object. Call this function when all server connection
+          objects are created.
+      */
+      static void closeInherited();
+
+      /** Stop accepting new connections on all HttpServCon and
+          HttpSharkSslServCon objects. A server connection object
+          stops reading its listen socket the next time a client
+          connects, leaving the connection in the socket's backlog.
+          The function is used by a server that has handed its listen
+          sockets to a new server process and that is about to
+          terminate. The function must be called with the dispatcher
+          mutex locked.
+          \sa HttpServer::termIdleCons HttpServer::getNoOfActiveRequests
+      */
+      static void stopAccepting();
+
+      /** Enable or disable SO_REUSEPORT for the listen sockets
+          created after this call. Several processes can then listen
+          on the same port, and the TCP/IP stack distributes the new
+          connections between the processes. This makes it possible
+          to use all CPU cores by running several server processes.
+          \return 0 on success or -1 if the platform does not support
+          SO_REUSEPORT.
+      */
+      static int setReusePort(BaBool enable);
+
       ~HttpServCon();
       HttpServCon() {}
    private:
@@ -176,6 +219,10 @@ BA_API void HttpServCon_constructor(HttpServCon* o,
 BA_API int HttpServCon_setPort(HttpServCon* o, U16 portNumber,
                                BaBool setIp6, const void* interfaceName);
 BA_API void HttpServCon_destructor(HttpServCon* o);
+BA_API int HttpServCon_inheritSocket(int hndl);
+BA_API void HttpServCon_closeInherited(void);
+BA_API void HttpServCon_stopAccepting(void);
+BA_API int HttpServCon_setReusePort(BaBool enable);
 BA_API int HttpServCon_init(
    HttpServCon* o,
    struct HttpServer* server,
@@ -205,6 +252,12 @@ inline int HttpServCon::setPort(
    U16 portNumber,bool setIp6,const void* interfaceName) {
    return HttpServCon_setPort(this,portNumber,setIp6?TRUE:FALSE,interfaceName);
 }
+inline int HttpServCon::inheritSocket(int hndl) {
+   return HttpServCon_inheritSocket(hndl); }
+inline void HttpServCon::closeInherited() { HttpServCon_closeInherited(); }
+inline void HttpServCon::stopAccepting() { HttpServCon_stopAccepting(); }
+inline int HttpServCon::setReusePort(BaBool enable) {
+   return HttpServCon_setReusePort(enable); }
 
 
 #endif
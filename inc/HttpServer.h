@@ -1094,6 +1094,8 @@ BA_API const char* HttpRequest_getParameter(
    HttpRequest* o, const char* paramName);
 BA_API HttpHeader* HttpRequest_getHeaders(HttpRequest* o, int* len);
 BA_API int HttpRequest_wsUpgrade(HttpRequest* o);
+/* wsUpgrade with a Sec-WebSocket-Extensions response header value */
+BA_API int HttpRequest_wsUpgrade2(HttpRequest* o, const char* extensions);
 BA_API BaBool HttpRequest_enableKeepAlive(HttpRequest* o);
 BA_API int HttpRequest_pushBackData(HttpRequest* o);
 #ifndef NO_HTTP_SESSION
@@ -1852,6 +1854,7 @@ typedef struct HttpCommand
       struct HttpConnection* con;
       struct LHttpCommand* lcmd; /* Used by LSP plugin */
 	  BaTime requestTime;
+      U32 statsTime; /* HttpStats_clock() time stamp */
       BaBool runningInThread;
 }HttpCommand;
 
@@ -3006,6 +3009,25 @@ address}/start.html <b>(*)</b></td></tr>
 
       int setUserObj(void* userObj, bool overwrite=false);
 
+      /** Returns the number of connections with request data
+          waiting to be processed or with a request being processed.
+          Idle persistent (keep-alive) connections and connections
+          upgraded to WebSockets are not included. A server that
+          stops accepting new connections can use this function to
+          find out when all requests have completed; see
+          HttpServCon::stopAccepting.
+      */
+      int getNoOfActiveRequests();
+
+      /** Close the connections waiting for a request, i.e. idle
+          persistent connections and new connections, except those
+          that have received request data not yet processed. A
+          server that stops accepting new connections calls this
+          function until getNoOfActiveRequests returns zero.
+          \return the number of connections left open.
+      */
+      int termIdleCons();
+
       /** The only purpose with this function is to clean all static
           variables that are in the BSS section; i.e., you do not need
           to call this function if you properly clear your static
@@ -3103,6 +3125,8 @@ BA_API void HttpServer_installNewCon(HttpServer* o, HttpConnection* con);
 BA_API void HttpServer_setErrHnd(UserDefinedErrHandler e);
 void HttpServer_initStatic(void);
 int HttpServer_termOldestIdleCon(HttpServer* o);
+BA_API int HttpServer_getNoOfActiveRequests(HttpServer* o);
+BA_API int HttpServer_termIdleCons(HttpServer* o);
 BA_API void HttpServer_set404Page(HttpServer*o, const char* page404);
 #define HttpServer_get404Page(o) (o)->rootDirContainer.page404
 BA_API int HttpServer_setUserObj(
@@ -3149,6 +3173,10 @@ inline const char* HttpServer::get404Page() {
    return HttpServer_get404Page(this); }
 inline int HttpServer::setUserObj(void* userObj, bool overwrite) {
    return HttpServer_setUserObj(this, userObj, overwrite); }
+inline int HttpServer::getNoOfActiveRequests() {
+   return HttpServer_getNoOfActiveRequests(this); }
+inline int HttpServer::termIdleCons() {
+   return HttpServer_termIdleCons(this); }
 inline const char* HttpServer::getStatusCode(int code) {
    return HttpServer_getStatusCode(code);
 }
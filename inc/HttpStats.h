@@ -0,0 +1,292 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ *
+ ****************************************************************************
+ *			      HEADER
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic LLC, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+ *
+ *
+ */
+
+#ifndef __HttpStats_h
+#define __HttpStats_h
+
+#include <HttpServer.h>
+
+#ifndef USE_HTTP_STATS
+#define USE_HTTP_STATS 0
+#endif
+#if USE_HTTP_STATS
+#ifndef HTTP_STATS
+#define HTTP_STATS
+#endif
+#ifndef HTTPSTATS_TLS
+#if defined(__GNUC__) || defined(__clang__)
+#define HTTPSTATS_TLS __thread
+#elif defined(_MSC_VER)
+#define HTTPSTATS_TLS __declspec(thread)
+#else
+#define HTTPSTATS_TLS
+#define HTTPSTATS_NO_TLS
+#endif
+#endif
+#endif
+
+/** Counter index for HttpStatsData::counters */
+typedef enum {
+   HttpStats_Accepted=0,  /**< Accepted server connections */
+   HttpStats_AcceptFailed,/**< Failed accept or no free HttpConnection */
+   HttpStats_BytesIn,     /**< Bytes received on all sockets */
+   HttpStats_BytesOut,    /**< Bytes sent on all sockets */
+   HttpStats_Status1xx,   /**< Responses with status 100 to 199 */
+   HttpStats_Status2xx,   /**< Responses with status 200 to 299 */
+   HttpStats_Status3xx,   /**< Responses with status 300 to 399 */
+   HttpStats_Status4xx,   /**< Responses with status 400 to 499 */
+   HttpStats_Status5xx,   /**< Responses with status 500 to 599 */
+   HttpStats_NoOfCounters
+} HttpStats_Counter;
+
+/** Histogram index for HttpStatsData::hist */
+typedef enum {
+   /** Time from when a connection has request data until the
+       request header is parsed. */
+   HttpStats_Parse=0,
+   /** Time from parsed request header to the HttpDir service
+       call. Includes the time spent in the HttpCmdThreadPool queue. */
+   HttpStats_Dispatch,
+   /** Time spent in the HttpDir/HttpPage service functions. */
+   HttpStats_Service,
+   /** Time from TCP accept until the TLS handshake completes. */
+   HttpStats_TlsHandshake,
+   HttpStats_NoOfHistograms
+} HttpStats_Histogram;
+
+/* Log linear buckets: 8 sub-buckets per power of two, giving a
+ * maximum relative error of 12.5% for values up to 2^32 microseconds.
+ */
+#define HttpStatsHist_SUBBITS 3
+#define HttpStatsHist_BUCKETS ((32-HttpStatsHist_SUBBITS+1)<<HttpStatsHist_SUBBITS)
+
+/** A latency histogram. All values are in microseconds.
+ */
+typedef struct
+{
+   U64 count; /**< Number of recorded values */
+   U64 sum; /**< Sum of all recorded values */
+   U32 max; /**< Largest recorded value */
+   U32 buckets[HttpStatsHist_BUCKETS];
+} HttpStatsHist;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+BA_API U32 HttpStatsHist_percentile(const HttpStatsHist* o, U32 perMille);
+#ifdef __cplusplus
+}
+#endif
+
+struct HttpStatsData;
+
+/** Aggregation callback, see HttpStats::setAggregate.
+ */
+typedef void (*HttpStats_Aggregate)(struct HttpStatsData* data);
+
+
+/** The counters and histograms collected by HttpStats.
+    \sa HttpStats::collect
+ */
+typedef struct HttpStatsData
+{
+   U64 counters[HttpStats_NoOfCounters];
+   HttpStatsHist hist[HttpStats_NoOfHistograms];
+#ifdef __cplusplus
+   /** Returns the value below which 'perMille'/1000 of the recorded
+       values in histogram 'ix' fall, e.g. 990 for the 99th
+       percentile. The value is in microseconds and is an upper bound
+       of the log linear bucket holding the value.
+   */
+   U32 percentile(HttpStats_Histogram ix, U32 perMille) {
+      return HttpStatsHist_percentile(hist+ix, perMille); }
+#endif
+} HttpStatsData;
+
+
+/** Low overhead server metrics.
+    @ingroup HttpStack
+
+    HttpStats complements the text based HttpTrace with counters and
+    latency histograms suitable for production use. The web-server
+    records accepted connections, socket bytes, response status
+    classes, request parse time, dispatch time, service time, and TLS
+    handshake time. Nothing is formatted on the request path; each
+    thread updates its own private copy of the data without taking
+    a lock, and the copies are summed on demand by HttpStats::collect.
+
+    The statistics are compiled in when the library is compiled with
+    USE_HTTP_STATS=1, and recording starts when the first HttpServer
+    is constructed. Recording can be paused with
+    HttpStats::setEnabled. Without USE_HTTP_STATS, the recording
+    macros expand to nothing and HttpStats::collect returns zeros.
+
+    Thread private data requires compiler thread local storage
+    (HTTPSTATS_TLS). Without thread local storage, all threads update
+    one shared copy. The values are still correct when requests run
+    in the dispatcher thread or in an HttpCmdThreadPool, since these
+    threads hold the dispatcher mutex.
+
+    The data can be printed in the Prometheus text exposition format
+    with HttpStats::printPrometheus. HttpStats_prometheusService is
+    an HttpPage service function that sends this text; install the
+    page where your scraper expects it:
+    \code
+    HttpPage metricsPage;
+    HttpPage_constructor(&metricsPage, HttpStats_prometheusService, "metrics");
+    HttpDir_insertPage(rootDir, &metricsPage);
+    \endcode
+ */
+typedef struct HttpStats
+{
+#ifdef __cplusplus
+      /** Enable or disable recording.
+       */
+      static void setEnabled(bool enable);
+
+      /** Returns true if recording is enabled.
+       */
+      static bool isEnabled();
+
+      /** Sum the data recorded by all threads. The values recorded
+          by threads running concurrently with this call may be
+          partially included.
+          \param data the aggregated counters and histograms.
+       */
+      static void collect(HttpStatsData* data);
+
+      /** Print the data in the Prometheus text exposition format.
+          \param out the output buffer.
+          \param prefix the metric name prefix, defaults to "bas_".
+          \return zero on success or E_MALLOC. Write errors are
+          reported by the BufPrint implementation.
+      */
+      static int printPrometheus(BufPrint* out, const char* prefix=0);
+
+      /** Add the counters and histograms in 'data' to 'o'.
+       */
+      static void merge(HttpStatsData* o, const HttpStatsData* data);
+
+      /** Install a callback that HttpStats::collect calls with the
+          data recorded by this process. The callback can add the
+          data recorded by other processes with HttpStats::merge, for
+          example the data published by the other worker processes
+          in a multi-process server. The aggregated data is then
+          used by all functions returning or printing the statistics.
+          \param aggregate the callback or NULL to remove it.
+      */
+      static void setAggregate(HttpStats_Aggregate aggregate);
+
+      /** Returns the Prometheus name of counter 'ix' without the prefix.
+       */
+      static const char* counterName(HttpStats_Counter ix);
+
+      /** Returns the Prometheus name of histogram 'ix' without the prefix.
+       */
+      static const char* histName(HttpStats_Histogram ix);
+   private:
+      HttpStats() {}
+#endif
+      int notUsed;
+} HttpStats;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+BA_API void HttpStats_setEnabled(BaBool enable);
+BA_API BaBool HttpStats_isEnabled(void);
+BA_API void HttpStats_collect(HttpStatsData* data);
+BA_API int HttpStats_printPrometheus(BufPrint* out, const char* prefix);
+BA_API void HttpStats_merge(HttpStatsData* o, const HttpStatsData* data);
+BA_API void HttpStats_setAggregate(HttpStats_Aggregate aggregate);
+BA_API const char* HttpStats_counterName(HttpStats_Counter ix);
+BA_API const char* HttpStats_histName(HttpStats_Histogram ix);
+BA_API void HttpStats_prometheusService(
+   HttpPage* page, HttpRequest* request, HttpResponse* response);
+
+/* Private Barracuda functions and data */
+BA_API void HttpStats_init(void);
+BA_API U32 HttpStats_clock(void);
+BA_API void HttpStats_record(HttpStats_Histogram ix, U32 usec);
+#ifdef HTTP_STATS
+BA_API HttpStatsData* HttpStats_newThreadData(void);
+extern BaBool httpStatsEnabled;
+#ifdef HTTPSTATS_NO_TLS
+extern HttpStatsData* httpStatsThreadData;
+#else
+extern HTTPSTATS_TLS HttpStatsData* httpStatsThreadData;
+#endif
+#endif
+#ifdef __cplusplus
+}
+inline void HttpStats::setEnabled(bool enable) {
+   HttpStats_setEnabled(enable ? TRUE : FALSE); }
+inline bool HttpStats::isEnabled() {
+   return HttpStats_isEnabled() ? true : false; }
+inline void HttpStats::collect(HttpStatsData* data) {
+   HttpStats_collect(data); }
+inline int HttpStats::printPrometheus(BufPrint* out, const char* prefix) {
+   return HttpStats_printPrometheus(out, prefix); }
+inline void HttpStats::merge(HttpStatsData* o, const HttpStatsData* data) {
+   HttpStats_merge(o, data); }
+inline void HttpStats::setAggregate(HttpStats_Aggregate aggregate) {
+   HttpStats_setAggregate(aggregate); }
+inline const char* HttpStats::counterName(HttpStats_Counter ix) {
+   return HttpStats_counterName(ix); }
+inline const char* HttpStats::histName(HttpStats_Histogram ix) {
+   return HttpStats_histName(ix); }
+#endif
+
+#ifdef HTTP_STATS
+/* Add 'n' to counter 'ix' in the calling thread's copy of the data. */
+#define HttpStats_count(ix, n) do {                                     \
+      if(httpStatsEnabled)                                              \
+      {                                                                 \
+         HttpStatsData* statsData = httpStatsThreadData ?               \
+            httpStatsThreadData : HttpStats_newThreadData();            \
+         if(statsData)                                                  \
+            statsData->counters[ix] += (U32)(n);                        \
+      }                                                                 \
+   } while(0)
+#define HttpStats_time(ix, start) HttpStats_record(ix, HttpStats_clock()-(start))
+#else
+#define HttpStats_count(ix, n) ((void)0)
+#define HttpStats_time(ix, start) ((void)0)
+#endif
+
+#endif
@@ -40,6 +40,7 @@
 #define __HttpTrace_h
 
 #include <HttpServer.h>
+#include <HttpStats.h>
 
 #ifdef __cplusplus
 #undef printf
@@ -119,6 +120,9 @@ typedef void (*HttpTrace_Flush)(char* buf, int bufLen);
     HttpTrace::setFLushCallback and HttpTrace::setBufSize. These two
     functions, if used, must be called at system startup.
 
+    See HttpStats for counters and latency histograms that can be
+    left enabled in production.
+
 */
 typedef struct HttpTrace
 {
@@ -298,6 +298,11 @@ typedef ResIntfPtr (*IoIntf_DeflateGzip)(
   name: pwd
   a:    pointer to 'const char*', the password.
 
+  name: mmap (ZipIo)
+  a:    pointer to 'const char*'. The resource name.
+  b:    pointer to a ZipIoMapping, set to the entry data in a
+        memory mapped ZIP file. See ZipIoMapping.
+
 */
 typedef int (*IoIntf_Property)(IoIntfPtr o,const char* name,void* a,void* b);
 
@@ -79,7 +79,9 @@ typedef struct JEncoder
       int setLong(S64 val);
 #ifndef NO_DOUBLE
 
-      /** Format a double value.
+      /** Format a double value using the shortest form that converts
+          back to the same value, e.g. 0.1, 1.0, and 1e+21.
+          \sa BufPrint::dtoa
        */
       int setDouble(double val);
 #endif
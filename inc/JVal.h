@@ -39,6 +39,7 @@
 #define __JVal_h
 
 #include <JParser.h>
+#include <ArenaAllocator.h>
 #include <stdarg.h>
 
 /** @addtogroup JSONRef
@@ -117,6 +118,14 @@ struct JVal
       <td>All getXXX methods</td></tr>
       </table>
 
+      Objects created by JParserValFact with at least
+      JVAL_INDEX_THRESHOLD (default 16) members get a member index.
+      The first member lookup builds the index, and later lookups in
+      the object are O(1). Adding or removing members with the JVal
+      methods releases the index, and the next lookup rebuilds it.
+      Since a lookup may build the index, threads sharing a JVal
+      tree must serialize their calls to get.
+
       See the JSON tutorial, section
       [Using JParserValFact](@ref UsingJParserValFact)
       , for examples on how to use JVal.
@@ -307,6 +316,7 @@ struct JVal
 
       char* memberName;
       struct JVal* next;
+      struct JValIndex* index; /* If object: member index or NULL */
       JVType type;
 };
 
@@ -439,7 +449,15 @@ typedef enum
     can manage the values by calling JParserValFact::manageFirstVal or
     by calling JVal::manageJ on any of the children.
 
+    Arena mode: pass the same ArenaAllocator instance as the vAlloc and
+    dAlloc argument to bump-allocate nodes and strings. Method
+    termFirstVal then releases the complete tree in one shot by
+    resetting the arena. A tree detached with manageFirstVal remains
+    valid until the arena is reset or destroyed, but children detached
+    with JVal::manageJ are released by termFirstVal.
+
     \sa JValFact
+    \sa ArenaAllocator
     \sa JDecode
 */
 #ifdef __cplusplus
@@ -0,0 +1,128 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ *
+ ****************************************************************************
+ *			      HEADER
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic LLC, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+ *
+ *
+ */
+#ifndef __MMapZipReader_h
+#define __MMapZipReader_h
+
+#include <ZipFileIterator.h>
+
+/** A ZipReader that maps the complete ZIP file into memory.
+@ingroup IO
+
+The MMapZipReader maps the ZIP file read-only and sets ZipReader::map.
+A ZipIo using this reader serves stored entries and GZIP encoded
+entries by copying directly from the mapping and inflates deflated
+entries without an intermediate input buffer. The reader never
+issues a read system call after construction; pages are loaded on
+demand by the kernel and shared between processes serving the
+same file.
+
+Resources opened with the ZipIo, including those sent by
+HttpResRdr, are still copied from the mapping into the caller's
+buffer. Use the ZipIo "mmap" property (ZipIoMapping) to send the
+entry data without copying.
+
+The implementation is available for POSIX systems (mmap) in
+src/arch/Posix/MMapZipReader.c. Offsets and sizes are 32 bit, like
+for all ZipReader implementations: the constructor fails if the ZIP
+file is 4GB or larger, and see ZipContainer for the ZIP64 limits.
+
+\code
+MMapZipReader reader;
+MMapZipReader_constructor(&reader, "/usr/share/www/www.zip");
+if(CspReader_isValid((CspReader*)&reader))
+   ZipIo_constructor(&zipIo, (ZipReader*)&reader, 2048, 0);
+\endcode
+ */
+typedef struct MMapZipReader
+#ifdef __cplusplus
+: public ZipReader
+{
+      MMapZipReader() {}
+
+   /** The constructor maps the ZIP file into memory.
+       You must call CspReader::isValid, which informs you if the
+       constructor successfully mapped the ZIP file.
+       \param pathName is the native path and name to the ZIP file.
+   */
+   MMapZipReader(const char* pathName);
+
+   /** The destructor unmaps the ZIP file.
+    */
+   ~MMapZipReader();
+
+   /** Unmap the ZIP file. The ZipIo using this reader must be
+       terminated before calling this method.
+    */
+   int close();
+
+   /** Returns the last error code, if any.
+    */
+   int getECode();
+
+   private:
+#else
+{
+   ZipReader reader;
+#endif
+      void* addr;
+      BaFileSize mapSize;
+      int lastECode;
+} MMapZipReader;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+BA_API void MMapZipReader_constructor(MMapZipReader* o,
+                                      const char* pathName);
+BA_API int MMapZipReader_close(MMapZipReader* o);
+#define MMapZipReader_destructor(o) MMapZipReader_close(o)
+#define MMapZipReader_getECode(o) (o)->lastECode
+#ifdef __cplusplus
+}
+inline MMapZipReader::MMapZipReader(const char* pathName) {
+   MMapZipReader_constructor(this, pathName); }
+inline MMapZipReader::~MMapZipReader() {
+   MMapZipReader_destructor(this); }
+inline int MMapZipReader::close() {
+   return MMapZipReader_close(this); }
+inline int MMapZipReader::getECode() {
+   return MMapZipReader_getECode(this); }
+#endif
+
+
+#endif
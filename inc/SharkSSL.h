@@ -283,6 +283,21 @@ typedef struct SharkSslSessionCache
 #endif
 
 
+#if ((SHARKSSL_ENABLE_RSA || SHARKSSL_ENABLE_ECDSA) && SHARKSSL_ENABLE_CERT_CACHE) || SHARKSSL_NOPACK
+#ifndef _DOXYGEN
+typedef struct SharkSslCertCacheEntry SharkSslCertCacheEntry;
+
+typedef struct SharkSslCertCache
+{
+   SharkSslCertCacheEntry *cache;
+   ThreadMutexBase  cacheMutex;
+   U32 useCnt;
+   U16 cacheSize;
+} SharkSslCertCache;
+#endif
+#endif
+
+
 /** \addtogroup SharkSslInfoAndCodes
 @{
 */
@@ -583,6 +598,7 @@ SharkSsl
    SharkSslCon *createCon(void);
    U8 setCAList(SharkSslCAList caList);
    U8 addCertificate(SharkSslCert cert);
+   U8 setCertCacheSize(U16 size);
    void terminateCon(SharkSslCon *sslCon);
 #endif
    #if (SHARKSSL_SSL_SERVER_CODE && SHARKSSL_SSL_CLIENT_CODE) || SHARKSSL_NOPACK
@@ -596,6 +612,9 @@ SharkSsl
    #if SHARKSSL_ENABLE_CA_LIST || SHARKSSL_NOPACK
    SharkSslCAList caList;
    #endif
+   #if SHARKSSL_ENABLE_CERT_CACHE || SHARKSSL_NOPACK
+   SharkSslCertCache certCache;
+   #endif
    #endif
    #if SHARKSSL_ENABLE_SESSION_CACHE  || SHARKSSL_NOPACK
    SharkSslSessionCache sessionCache;
@@ -1429,6 +1448,38 @@ SHARKSSL_API U8 SharkSsl_addCertificate(SharkSsl *o, SharkSslCert cert);
     \sa #SharkSslCAList and SharkSslCon_trusted.
  */
 SHARKSSL_API U8  SharkSsl_setCAList(SharkSsl *o, SharkSslCAList caList);
+#endif
+
+#if SHARKSSL_ENABLE_CERT_CACHE
+
+/** Enable the certificate verification cache. The cache remembers,
+    by SHA-256 hash, certificate chains received from peers that
+    passed signature verification. A peer presenting the same chain
+    again, such as a returning mTLS client, is then validated without
+    repeating the signature checks. All other checks, including the
+    lookup in the CA list, are performed as usual. Chains that fail
+    verification are never cached.
+
+    \param o the SharkSsl object.
+
+    \param size the maximum number of cached chains. The least
+    recently used chain is replaced when the cache is full. Set to 0
+    to disable the cache.
+
+    \return TRUE on success or FALSE if the SharkSsl object has
+    existing connections or if the memory allocation failed.
+
+    \sa #SharkSsl_flushCertCache and #SHARKSSL_ENABLE_CERT_CACHE
+ */
+SHARKSSL_API U8 SharkSsl_setCertCacheSize(SharkSsl *o, U16 size);
+
+/** Remove all chains from the certificate verification cache.
+    \sa #SharkSsl_setCertCacheSize
+ */
+SHARKSSL_API void SharkSsl_flushCertCache(SharkSsl *o);
+#endif
+
+#if SHARKSSL_ENABLE_CA_LIST
 
 /** Returns TRUE if the certificate is valid and is signed with a root
     certificate trusted by SharkSSL. Root certificates can optionally
@@ -2697,6 +2748,11 @@ inline U8 SharkSsl::setCAList(SharkSslCAList caList) {
    return SharkSsl_setCAList(this, caList);
 }
 #endif  /* SHARKSSL_ENABLE_CA_LIST */
+#if SHARKSSL_ENABLE_CERT_CACHE
+inline U8 SharkSsl::setCertCacheSize(U16 size) {
+   return SharkSsl_setCertCacheSize(this, size);
+}
+#endif  /* SHARKSSL_ENABLE_CERT_CACHE */
 #endif  /* SHARKSSL_ENABLE_RSA || SHARKSSL_ENABLE_ECDSA */
 
 #endif  /* __cplusplus */
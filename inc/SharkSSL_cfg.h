@@ -238,6 +238,14 @@
 #endif
 
 
+/** Select 1 to enable the certificate verification cache,
+ *  see #SharkSsl_setCertCacheSize
+ */
+#ifndef SHARKSSL_ENABLE_CERT_CACHE
+#define SHARKSSL_ENABLE_CERT_CACHE                       1
+#endif
+
+
 /** Select 1 to enable renegotiation
  *  Only secure renegotiation (RFC 5746) is supported
  *  Note: with the default define below, it is enabled
@@ -429,6 +437,16 @@
 #endif
 
 
+/** Select 1 to use the CPU's SHA-256 instructions (x86 SHA-NI or
+ *  ARMv8 SHA2) when the processor supports them. Support is detected
+ *  at runtime and the portable C code is used as fallback. Requires
+ *  GCC or Clang
+ */
+#ifndef SHARKSSL_SHA256_USE_HW
+#define SHARKSSL_SHA256_USE_HW                           1
+#endif
+
+
 /** Select a window size between 1 (slower, less RAM) and 5
  */
 #ifndef SHARKSSL_BIGINT_EXP_SLIDING_WINDOW_K
@@ -318,6 +318,21 @@ SHARKSSL_API void  SharkSslSha256Ctx_finish(SharkSslSha256Ctx*, U8 digest[SHARKS
     \ingroup RayCryptoSHA256
 */
 SHARKSSL_API int   sharkssl_sha256(const U8*, U32, U8*);
+
+/** Calculate the SHA-256 digest of n independent messages. Small
+    messages, such as MQTT payloads or HMAC inputs, are hashed
+    several at a time in interleaved lanes, which is considerably
+    faster than calling #sharkssl_sha256 for each message.
+    \ingroup RayCryptoSHA256
+
+    \param n the number of messages.
+    \param data array of n message pointers.
+    \param len array of n message lengths.
+    \param digest array of n pointers to buffers of size
+    SHARKSSL_SHA256_HASH_LEN.
+*/
+SHARKSSL_API int   sharkssl_sha256_multi(
+   U16 n, const U8 *const *data, const U32 *len, U8 *const *digest);
 #endif
 
 #if SHARKSSL_USE_SHA_384
@@ -65,6 +65,7 @@ struct SharkSslCon;
    ExStateClose:    Close connection.
    ExStateMoveCon:  Moving the active connection to another SoDispCon obj.
    ExStateDispEv:   The socket dispatcher signals that data is ready.
+   ExTypeCork:      Coalesce (cork) or flush (uncork) written data.
 */
 typedef enum {
    SoDispCon_ExTypeRead=1,
@@ -74,7 +75,8 @@ typedef enum {
    SoDispCon_ExTypeMoveCon,
    SoDispCon_ExTypeAllocAsynchBuf,
    SoDispCon_ExTypeAsyncReady,
-   SoDispCon_ExTypeIdle
+   SoDispCon_ExTypeIdle,
+   SoDispCon_ExTypeCork
 } SoDispCon_ExType;
 
 
@@ -91,6 +93,11 @@ The arguments to the SoDispCon_Execute callback function:
       d1 not used, d2 not used, ret is void.
    SoDispCon_ExTypeMoveCon:
       d1 is a pointer to a SoDispCon object.
+   SoDispCon_ExTypeCork:
+      d1 not used, d2 TRUE: cork, FALSE: uncork and send pending data,
+      ret < 0 if failed.
+      A corked secure connection coalesces written data into full TLS
+      records instead of encrypting each write as a separate record.
 */
  
 struct SoDispCon;
@@ -296,6 +303,11 @@ typedef struct SoDispCon
 #define SoDispCon_setDispRecEvent(o, dispRecEvFp) \
    (o)->dispRecEv=dispRecEvFp
 
+#define SoDispCon_cork(o) \
+   (o)->exec(o,0,SoDispCon_ExTypeCork,0,TRUE)
+#define SoDispCon_uncork(o) \
+   (o)->exec(o,SoDisp_getMutex((o)->dispatcher),SoDispCon_ExTypeCork,0,FALSE)
+
 #define SoDispCon_readData(o, data, len, relmutex) \
    (o)->exec(o, (relmutex) ? SoDisp_getMutex((o)->dispatcher) : 0, \
            SoDispCon_ExTypeRead,data,len)
@@ -54,8 +54,30 @@
     <a href="../../../lua/SockLib.html#AsynchronousSockets">consult the Lua documentation</a>
     for an introduction to asynchronous sockets.
 
-    The library is limited to sending and receiving data less to or
-    equal 0xFFFF.
+    The library is limited to receiving data less to or equal
+    0xFFFF. Frames created with WSSFrame_create have no size limit.
+
+    ### Queued (non-blocking) sending:
+
+    A connection can optionally be configured with a bounded outbound
+    queue by calling WSS::setQueue. The socket is then set in
+    non-blocking mode and WSS::write, WSS::send, and the internally
+    generated control frames never block: data the socket cannot
+    accept is kept in the queue and sent when the socket dispatcher
+    reports that the socket is writable. A slow client therefore no
+    longer stalls the code sending to other clients. What happens when
+    the queue is full is controlled by the #WSS_QueuePolicy.
+
+    To broadcast a message, create a #WSSFrame and send the frame to
+    all connections. The frame header is created once and the frame is
+    shared, not copied, by the connection queues.
+
+    ### Compression:
+
+    The permessage-deflate extension (RFC 7692) is negotiated by
+    WSS::upgrade when the connection is configured with a #WSSDeflate
+    object and the client offers the extension. See WSSDeflate for
+    details.
 
     ### Example:
 
@@ -140,6 +162,198 @@ inline WSSCB::WSSCB(
 #endif 
 
 
+/** A reference counted WebSocket frame, including the frame header,
+    that can be sent to any number of connections without copying the
+    data. The frame is created with a reference count of one and
+    deleted when the count reaches zero. Each connection queue
+    holding the frame has one reference.
+
+    The reference count is not thread safe. Frames must be created,
+    sent, and released by code holding the dispatcher mutex, e.g. in
+    a WebSocket callback.
+    \code
+    WSSFrame* f = WSSFrame_create(msg, len, TRUE);
+    if(f)
+    {
+       for(each connection)
+          WSS_send(wss, f);
+       WSSFrame_release(f);
+    }
+    \endcode
+    \sa WSS::send
+ */
+typedef struct WSSFrame
+{
+#ifdef __cplusplus
+   /** Create a text or binary frame.
+       \param data the payload.
+       \param len payload length.
+       \param isTxt true for a text frame and false for a binary frame.
+       \returns the frame or NULL if out of memory.
+   */
+   static WSSFrame* create(const void* data, int len, bool isTxt);
+   /** Increment the reference count. */
+   void retain();
+   /** Decrement the reference count and delete the frame when the
+       count reaches zero. */
+   void release();
+   /** Returns the frame size, including the header. */
+   int getSize();
+#endif
+   U32 refCnt;
+   int len;
+   /* The compressed frame or NULL, valid when deflatedBy is set */
+   struct WSSFrame* deflated;
+   struct WSSDeflate* deflatedBy;
+   U8 data[1];
+} WSSFrame;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+BA_API WSSFrame* WSSFrame_rawCreate(const void* data, int len, int opCode);
+#define WSSFrame_create(data, len, isTxt) \
+   WSSFrame_rawCreate(data, len, (isTxt) ? 1 : 2)
+#define WSSFrame_retain(o) (o)->refCnt++
+BA_API void WSSFrame_release(WSSFrame* o);
+#define WSSFrame_getSize(o) (o)->len
+#ifdef __cplusplus
+}
+inline WSSFrame* WSSFrame::create(const void* data, int len, bool isTxt) {
+   return WSSFrame_create(data, len, isTxt); }
+inline void WSSFrame::retain() {
+   WSSFrame_retain(this); }
+inline void WSSFrame::release() {
+   WSSFrame_release(this); }
+inline int WSSFrame::getSize() {
+   return WSSFrame_getSize(this); }
+#endif
+
+
+/** A permessage-deflate (RFC 7692) configuration shared by any
+    number of WebSocket connections. The configuration is installed
+    with WSS::setDeflate before calling WSS::upgrade.
+
+    Messages smaller than 'minSize' are sent uncompressed. Received
+    compressed messages are decompressed into a buffer shared by the
+    connections, and messages larger than 'maxMessageSize' when
+    decompressed make the server close the connection with status
+    1009.
+
+    The per connection memory is controlled by the context takeover
+    settings and the window sizes:
+
+    \li With server context takeover, the default, each connection
+    keeps its own compressor with a memory use of roughly
+    (1 << (serverWindowBits+2)) + (1 << (memLevel+9)) bytes.
+    \li With server no context takeover, each message is compressed
+    independently by one compressor shared by the connections. A
+    #WSSFrame sent to several connections is then compressed once
+    and the compressed frame is shared by all connections using the
+    same WSSDeflate object and window size. Use this mode for
+    broadcasting.
+    \li Each connection decompressing messages keeps roughly
+    7 Kbytes + (1 << clientWindowBits) bytes of decompressor state.
+    With client no context takeover, the state is released after
+    each message. Clients not accepting the client window size are
+    served without compression.
+
+    All connections using the same WSSDeflate object must be served
+    by the same dispatcher, since the shared state is protected by
+    the dispatcher mutex.
+ */
+typedef struct WSSDeflate
+{
+#ifdef __cplusplus
+   /** Create a permessage-deflate configuration.
+       \param level the zlib compression level, 1 to 9.
+       \param serverNoContextTakeover compress each message
+       independently; see the class documentation.
+   */
+   WSSDeflate(int level=6, bool serverNoContextTakeover=false);
+   ~WSSDeflate();
+   /** Set the largest LZ77 window, 9 to 15, used by the compressor
+       and the largest window, 8 to 15, accepted for client messages.
+       The defaults are 15.
+   */
+   void setWindowBits(int serverBits, int clientBits);
+   /** Set the compressor memory level, 1 to 9. The default is 8. */
+   void setMemLevel(int memLevel);
+   /** Require the client to compress each message independently. */
+   void setClientNoContextTakeover(bool enable);
+   /** Set the size limit for decompressed messages. The default is
+       64 Kbytes. */
+   void setMaxMessageSize(U32 size);
+   /** Messages smaller than 'size' are not compressed. The default
+       is 64 bytes. */
+   void setMinSize(U32 size);
+#endif
+   void* strm; /* Shared compressor: server no context takeover */
+   U8* outBuf; /* Compressor output */
+   U8* inBuf; /* Decompressor output */
+   U32 outBufSize;
+   U32 inBufSize;
+   U32 maxMessageSize;
+   U32 minSize;
+   U8 level;
+   U8 memLevel;
+   U8 serverWindowBits;
+   U8 clientWindowBits;
+   U8 serverNoContextTakeover;
+   U8 clientNoContextTakeover;
+} WSSDeflate;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+BA_API void WSSDeflate_constructor(
+   WSSDeflate* o, int level, BaBool serverNoContextTakeover);
+BA_API void WSSDeflate_destructor(WSSDeflate* o);
+BA_API void WSSDeflate_setWindowBits(WSSDeflate* o,int serverBits,int clientBits);
+#define WSSDeflate_setMemLevel(o, memLvl) \
+   (o)->memLevel=(U8)((memLvl) < 1 ? 1 : ((memLvl) > 9 ? 9 : (memLvl)))
+#define WSSDeflate_setClientNoContextTakeover(o, enable) \
+   (o)->clientNoContextTakeover=(U8)((enable) ? TRUE : FALSE)
+#define WSSDeflate_setMaxMessageSize(o, size) (o)->maxMessageSize=(size)
+#define WSSDeflate_setMinSize(o, size) (o)->minSize=(size)
+#ifdef __cplusplus
+}
+inline WSSDeflate::WSSDeflate(int level, bool serverNoContextTakeover) {
+   WSSDeflate_constructor(this, level, serverNoContextTakeover?TRUE:FALSE); }
+inline WSSDeflate::~WSSDeflate() {
+   WSSDeflate_destructor(this); }
+inline void WSSDeflate::setWindowBits(int serverBits, int clientBits) {
+   WSSDeflate_setWindowBits(this, serverBits, clientBits); }
+inline void WSSDeflate::setMemLevel(int memLevel) {
+   WSSDeflate_setMemLevel(this, memLevel); }
+inline void WSSDeflate::setClientNoContextTakeover(bool enable) {
+   WSSDeflate_setClientNoContextTakeover(this, enable); }
+inline void WSSDeflate::setMaxMessageSize(U32 size) {
+   WSSDeflate_setMaxMessageSize(this, size); }
+inline void WSSDeflate::setMinSize(U32 size) {
+   WSSDeflate_setMinSize(this, size); }
+#endif
+
+
+/** The action taken when a frame is sent to a connection with a full
+    queue. \sa WSS::setQueue
+ */
+typedef enum {
+   /** Drop the new frame. The send function returns E_TOO_MUCH_DATA. */
+   WSS_QueueDrop,
+   /** Close the connection and call the WSSCB_Close callback with
+       status E_TOO_MUCH_DATA. The callback is called before the send
+       function returns, except when sending from the connection's
+       own WSSCB_Frame or WSSCB_Ping callback; the close callback is
+       then called when that callback returns. */
+   WSS_QueueDisconnect,
+   /** Drop the queued frames not yet being sent and queue the new
+       frame. Use this policy when only the latest message matters,
+       e.g. for state updates. */
+   WSS_QueueCoalesce
+} WSS_QueuePolicy;
+
+
 /** WebSocket Server (WSS)
  */
 typedef struct WSS
@@ -166,7 +380,8 @@ typedef struct WSS
        HttpPage or HttpDir service function. The function performs a
        WebSocket handshake by calling HttpRequest::wsUpgrade. The
        function then calls WSS::connect if the WebSocket handshake was
-       successful.
+       successful. The permessage-deflate extension is negotiated if
+       the connection has a WSSDeflate configuration.
        \param req method HttpRequest::getConnection returns the
        connection object used as a parameter for this method.
        \returns 0 on success and a negative value on error.
@@ -181,13 +396,51 @@ typedef struct WSS
     */
    int connect(HttpConnection* con);
 
-   /** Write/send a WebSocket frame.
+   /** Write/send a WebSocket frame. The function blocks until the
+       data is sent unless the connection has a queue.
        \param data the data to send
        \param len data length
        \param isTxt set to true for text frames and false for binary frames.
+       \sa setQueue
    */
    int write(const void* data, int len, bool isTxt);
 
+   /** Send a frame created with WSSFrame::create. The frame is
+       queued and sent when the socket is writable if the connection
+       has a queue; the function blocks until the frame is sent if
+       not.
+       \returns 0 on success, E_TOO_MUCH_DATA if the queue is full
+       and the frame is dropped or the connection closed, and another
+       negative value on socket errors.
+   */
+   int send(WSSFrame* frame);
+
+   /** Enable non-blocking sending with a bounded outbound queue. The
+       function can be called before or after the connection is
+       established. The queue is full when it holds 'maxFrames'
+       frames or when the size of the queued frames exceeds
+       'maxBytes'; one frame is always accepted by an empty queue.
+       \param maxFrames the queue length, zero disables the queue. A
+       queue can only be disabled when empty.
+       \param maxBytes the maximum number of queued bytes.
+       \param policy the action taken when the queue is full.
+       \returns 0 on success, E_MALLOC, or E_INCORRECT_USE.
+   */
+   int setQueue(int maxFrames, U32 maxBytes,
+                WSS_QueuePolicy policy=WSS_QueueDrop);
+
+   /** Returns the number of bytes in the outbound queue. */
+   U32 getQueuedBytes();
+
+   /** Enable permessage-deflate negotiation in WSS::upgrade.
+       \param deflate the configuration, which must be valid for the
+       lifetime of the connection, or NULL to disable compression.
+   */
+   void setDeflate(WSSDeflate* deflate);
+
+   /** Returns true if permessage-deflate was negotiated. */
+   bool isDeflate();
+
    /** Gracefully close the WebSocket connection by sending WebSocket
        status code N to the client prior to closing the active socket
        connection.
@@ -204,6 +457,23 @@ typedef struct WSS
    DynBuffer db;
    WSSCB* cb;
    int endOfPacketIx;
+   WSSFrame** queue; /* Ring buffer with 'queueSize' entries */
+   U32 queuedBytes;
+   U32 maxQueuedBytes;
+   int queueSize;
+   int queueHead;
+   int queueLen;
+   int sent; /* Bytes of the frame at queueHead passed to the socket */
+   int pendingClose; /* closeFp status, set while in a receive event */
+   U8 policy;
+   U8 asyncPending; /* TLS: the socket's asynch buffer is not sent */
+   U8 inRecEv; /* Set while calling frameFp and pingFp */
+   struct WSSDeflate* deflate;
+   void* defStrm; /* Compressor, server context takeover */
+   void* infStrm; /* Decompressor */
+   U8 pmd; /* Negotiated permessage-deflate flags; zero if not in use */
+   U8 serverWindowBits;
+   U8 clientWindowBits;
 } WSS;
 
 
@@ -218,6 +488,12 @@ BA_API int WSS_connect(WSS* o, HttpConnection* con);
 BA_API int WSS_rawWrite(WSS* o, const void* data, int len, int opCode);
 #define WSS_write(o, data, len, isTxt) WSS_rawWrite(o, data, len, isTxt?1:2)
 BA_API int WSS_close(WSS* o, int statusCode);
+BA_API int WSS_send(WSS* o, WSSFrame* frame);
+BA_API int WSS_setQueue(
+   WSS* o, int maxFrames, U32 maxBytes, WSS_QueuePolicy policy);
+#define WSS_getQueuedBytes(o) (o)->queuedBytes
+#define WSS_setDeflate(o, deflateCfg) (o)->deflate=(deflateCfg)
+#define WSS_isDeflate(o) ((o)->pmd ? TRUE : FALSE)
 #define WSS_isValid(o) SoDispCon_isValid((SoDispCon*)o)
 #ifdef __cplusplus
 }
@@ -237,6 +513,21 @@ inline int WSS::connect(HttpConnection* con) {
 inline int WSS::write(const void* data, int len, bool isTxt) {
    return WSS_write(this, data, len,isTxt);
 }
+inline int WSS::send(WSSFrame* frame) {
+   return WSS_send(this, frame);
+}
+inline int WSS::setQueue(int maxFrames, U32 maxBytes, WSS_QueuePolicy policy) {
+   return WSS_setQueue(this, maxFrames, maxBytes, policy);
+}
+inline U32 WSS::getQueuedBytes() {
+   return WSS_getQueuedBytes(this);
+}
+inline void WSS::setDeflate(WSSDeflate* deflate) {
+   WSS_setDeflate(this, deflate);
+}
+inline bool WSS::isDeflate() {
+   return WSS_isDeflate(this) ? true : false;
+}
 inline int WSS::close(int statusCode) {
    return  WSS_close(this, statusCode);
 }
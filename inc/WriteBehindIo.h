@@ -0,0 +1,153 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ *
+ ****************************************************************************
+ *			      HEADER
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic LLC, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+ *
+ *
+ */
+#ifndef __WriteBehindIo_h
+#define __WriteBehindIo_h
+
+#include <IoIntf.h>
+#include <AllocatorIntf.h>
+#include <DoubleList.h>
+#include <ThreadLib.h>
+
+/** Flush policy for files written through a WriteBehindIo.
+    A flush calls the ResIntf flush method of the wrapped I/O; see the
+    I/O documentation for what a flush guarantees, e.g. FatFs f_sync.
+ */
+typedef enum {
+   WriteBehindIo_SyncNone=0, /**< Flush when requested by the user */
+   WriteBehindIo_SyncOnClose, /**< Flush before closing the file */
+   WriteBehindIo_SyncEachBuffer /**< Flush after writing each buffer */
+} WriteBehindIo_Sync;
+
+/** An IoIntf that writes files in a background thread.
+
+    WriteBehindIo wraps another IoIntf, typically a DiskIo on an SD
+    card or a network file system, and is used as the I/O for an
+    HttpUpload or any other code writing large files. A file opened
+    for writing gets a fixed number of buffers. ResIntf::writeFp
+    copies the data to a buffer and returns; a full buffer is written
+    to the wrapped I/O by the WriteBehindIo thread while the caller
+    receives the next chunk from the network. With two buffers per
+    file, the upload throughput is the slower of the network and the
+    storage instead of the sum of their latencies. The caller only
+    waits when all of the file's buffers are queued, thus the memory
+    used per file is bounded.
+
+    An error returned by the wrapped I/O in the background is
+    returned by the next write, flush, or close, and the remaining
+    queued data for the file is discarded. HttpUpload reports such an
+    error to the HttpUploadCbIntf as for a synchronous write. An error
+    in the last buffer of a file can only be returned by close.
+
+    The Mako Server, compiled with WRITEBEHIND=true (mako.mk), installs
+    a WriteBehindIo wrapping the "disk" I/O as ba.openio"wbdisk". The
+    buffers are set with the -b option.
+
+    Files opened for reading, or for reading and writing, are opened
+    directly in the wrapped I/O. All other methods are delegated to
+    the wrapped I/O. Files must be closed before the WriteBehindIo is
+    destroyed.
+    \code
+    static DiskIo sdIo;
+    static WriteBehindIo wbIo;
+    WriteBehindIo_constructor(&wbIo, (IoIntf*)&sdIo, 16*1024, 2,
+                              WriteBehindIo_SyncOnClose, 0);
+    HttpUpload_constructor(&upload, (IoIntf*)&wbIo, alloc, &uploadCb, 2);
+    \endcode
+ */
+typedef struct WriteBehindIo
+#ifdef __cplusplus
+: public IoIntf
+{
+      void *operator new(size_t s) { return ::baMalloc(s); }
+      void operator delete(void* d) { if(d) ::baFree(d); }
+      void *operator new(size_t, void *place) { return place; }
+      void operator delete(void*, void *) { }
+      WriteBehindIo() {}
+
+      /** Create a WriteBehindIo and start its thread.
+          \param io the wrapped I/O.
+          \param bufSize the size of each buffer.
+          \param buffers the number of buffers per open file, at
+          least 2.
+          \param sync the flush policy.
+          \param alloc the allocator for the buffers, or NULL for
+          AllocatorIntf::getDefault.
+      */
+      WriteBehindIo(IoIntfPtr io, size_t bufSize, int buffers,
+                    WriteBehindIo_Sync sync, AllocatorIntf* alloc=0);
+
+      /** Stop the thread. All files must be closed. */
+      ~WriteBehindIo();
+#if 0
+}
+#endif
+#else
+{
+      IoIntf super; /* Inherits from IoIntf */
+#endif
+      Thread thread;
+      ThreadMutex mutex;
+      ThreadSemaphore workSem; /* Signaled when queue is not empty */
+      ThreadSemaphore stoppedSem;
+      DoubleList queue; /* Buffers waiting to be written */
+      IoIntfPtr io; /* The wrapped I/O */
+      AllocatorIntf* alloc;
+      size_t bufSize;
+      int buffers;
+      WriteBehindIo_Sync sync;
+      BaBool stop;
+} WriteBehindIo;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+BA_API void WriteBehindIo_constructor(
+   WriteBehindIo* o, IoIntfPtr io, size_t bufSize, int buffers,
+   WriteBehindIo_Sync sync, AllocatorIntf* alloc);
+BA_API void WriteBehindIo_destructor(WriteBehindIo* o);
+#ifdef __cplusplus
+}
+inline WriteBehindIo::WriteBehindIo(
+   IoIntfPtr io, size_t bufSize, int buffers, WriteBehindIo_Sync sync,
+   AllocatorIntf* alloc) {
+   WriteBehindIo_constructor(this, io, bufSize, buffers, sync, alloc); }
+inline WriteBehindIo::~WriteBehindIo() {
+   WriteBehindIo_destructor(this); }
+#endif
+
+#endif
@@ -65,6 +65,13 @@ struct ZipFileHeaderData;
     You can also use the <a href="../../CspTools.html#bin2c">
     bin2c</a> tool if you want to embed the ZIP file in the
     application executable or firmware.
+
+    A ZipReader that keeps the complete ZIP file in memory, such as
+    the MMapZipReader, sets 'map' after calling the ZipReader
+    constructor. The ZipIo then copies stored data and feeds the
+    inflater directly from memory, bypassing the read callback, and
+    hands out direct pointers to entry data via the ZipIo "mmap"
+    property.
 */
 typedef struct ZipReader
 #ifdef __cplusplus
@@ -77,6 +84,7 @@ typedef struct ZipReader
       CspReader super; /* As if inherited. */
 #endif
       U32 size;
+      const U8* map; /* The ZIP file in memory or NULL */
 } ZipReader;
 
 #ifdef __cplusplus
@@ -330,8 +338,8 @@ typedef struct CentralDirIterator
       ZipFileHeader fileHeader;
       U32 curFileHeaderOffs;
       ZipErr err;
-      U16 entriesInCd;
-      U16 curEntry;
+      U32 entriesInCd;
+      U32 curEntry;
 } CentralDirIterator;
 
 #ifdef __cplusplus
@@ -374,6 +382,12 @@ inline bool CentralDirIterator::nextElement() {
     a ZipReader. You do not directly use a ZipContainer unless you use
     the internal ZIP CentralDirIterator class. See the ZipFileIterator.h
     header file for more information.
+
+    ZIP64 archives are accepted when every offset and size in the
+    ZIP64 records fits in 32 bits, such as archives with more than
+    65535 entries or archives from tools that always write ZIP64
+    records. Larger values give ZipErr_Incompatible since the
+    ZipReader interface uses 32 bit offsets.
 */
 typedef struct ZipContainer
 {
@@ -400,7 +414,7 @@ typedef struct ZipContainer
       U32 bufSize;
       U32 cdOffset;
       ZipErr errCode;
-      U16 entriesInCd;
+      U32 entriesInCd; /* U32: ZIP64 archives */
 } ZipContainer;
 
 #ifdef __cplusplus
@@ -40,6 +40,10 @@
 #include "VirDir.h"
 #include "ZipFileIterator.h"
 
+#ifndef __DOXYGEN__
+struct ZipIoIndexEntry;
+#endif
+
 /** @addtogroup IO
     @{
  */
@@ -85,6 +89,10 @@ Zip-File from the virtual file system. The ZIP-File uses a ZipReader
 class, which inherits from CspReader, as the interface to the
 Zip-File.  The example directory contains the FileZipReader which is
 an example implementation of a ZipReader.
+
+The constructor indexes the full path of every file and directory in a
+hash table, so a lookup costs the same for an archive with ten
+thousand files as for one with ten.
  */
 typedef struct ZipIo
 #ifdef __cplusplus
@@ -139,6 +147,8 @@ is run.
       VirDirNode root;
       ZipContainer zc;
       AllocatorIntf* alloc;
+      struct ZipIoIndexEntry* index; /* Path hash index, see ZipIo_find */
+      U32 indexMask;
       char* password;
       U16   passwordLen;
       ZipErr ecode;
@@ -146,6 +156,32 @@ is run.
       BaBool passwordBin;
 } ZipIo;
 
+/** Direct view of a ZIP entry, returned by the ZipIo property "mmap"
+    when the ZipReader has the ZIP file mapped into memory.
+
+    \code
+    ZipIoMapping m;
+    if( ! io->propertyFp(io, "mmap", (void*)"www/index.html", &m) )
+    {
+       if(m.zfi->comprMethod == ZipComprMethod_Stored)
+          HttpResponse_send(resp, m.data, (int)m.zfi->uncompressedSize);
+    }
+    \endcode
+
+    Deflated entries can be sent as is to a client that accepts GZIP
+    encoding by framing m.data with initGZipHeader and a GZIP trailer
+    (CRC32 and uncompressed size). The property returns
+    IOINTF_NOIMPLEMENTATION if the ZIP file is not mapped or if the
+    entry is AES encrypted.
+ */
+typedef struct
+{
+      /** Stored or raw deflate data, zfi->compressedSize bytes. */
+      const U8* data;
+      /** Entry information: compression method, sizes, and CRC32. */
+      const ZipFileInfo* zfi;
+} ZipIoMapping;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
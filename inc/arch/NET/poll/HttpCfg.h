@@ -0,0 +1,71 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ *
+ ****************************************************************************
+ *			      HEADER
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *                                                                        
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *                                                                         
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+ *
+ *
+ *  Posix -> poll implementation
+ */
+#ifndef _HttpConfig_h
+#include "../Posix/HttpCfg.h"
+#include <poll.h>
+
+
+#undef DISPATCHER_DATA
+#undef CONNECTION_DISPATCHER_OBJ
+
+struct SoDispCon;
+
+/* The pollfd array is updated when a connection's receive or send
+ * event is activated or deactivated; entry 'ix' in 'fds' is
+ * connection cons[ix], and the connection's pollIx is ix+1.
+ */
+#define DISPATCHER_DATA \
+  struct pollfd* fds;\
+  struct SoDispCon** cons;\
+  DoubleList termList;\
+  int nfds;\
+  int maxfds;\
+  int defaultPollDelay; \
+  int pollDelay
+
+
+#define CONNECTION_DISPATCHER_OBJ DoubleLink dispatcherLink;int pollIx;
+
+#define SoDisp_destructor _SoDisp_destructor
+struct SoDisp;
+void _SoDisp_destructor(struct SoDisp* o);
+#define BaAddrinfo_connect BaAddrinfo_platConnect
+int BaAddrinfo_platConnect(BaAddrinfo* addr, HttpSocket* s, U32 timeout);
+
+#endif
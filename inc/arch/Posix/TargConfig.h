@@ -175,6 +175,8 @@
 #else
 #ifdef USE_DLMALLOC
 #include <dlmalloc.h>
+#elif defined(USE_TCALLOC)
+#include <tcalloc.h>
 #else
 #define baMalloc(size) malloc(size)
 #define baRealloc(ptr,size) realloc(ptr,size)
@@ -220,4 +222,11 @@ extern "C" {
 #define bIsxdigit isxdigit
 
 
+/***********************************************************************
+ *  Sampling heap profiler, see inc/HeapProfiler.h
+ ***********************************************************************/
+#if defined(BA_HEAP_PROFILE) && !defined(BA_LEAK_CHECK)
+#include <HeapProfiler.h>
+#endif
+
 #endif
@@ -407,6 +407,21 @@ BA_API int LHttpResRdr_loadLsp(
    lua_State* L, IoIntf* io, const char* pathname, IoStat* st);
 /** Install the \ref UBJSONRef "UBJSON" Lua API. */
 BA_API void balua_ubjson(lua_State* L);
+/** Install ba.json.fastdecode and ba.json.fastparser, which decode
+    JSON directly to Lua tables without building a JVal tree. */
+BA_API void balua_jsondec(lua_State* L);
+/** Install ba.cbor.encode and ba.cbor.decode, the CBOR codec
+    including RFC 8746 typed arrays. */
+BA_API void balua_cbor(lua_State* L);
+/** Install ba.httpstats, the Lua interface to the HttpStats
+    counters and latency histograms. */
+BA_API void balua_httpstats(lua_State* L);
+/** Install ba.heapprof, the Lua interface to the sampling heap
+    profiler. Requires BA_HEAP_PROFILE. */
+BA_API void balua_heapprof(lua_State* L);
+/** Install ba.bytecache, a persistent cache for the compiled Lua
+    scripts and LSP pages. */
+BA_API void balua_bytecache(lua_State* L);
 BA_API void balua_luaio(lua_State* L);
 BA_API void luaopen_ba_redirector(lua_State *L);
 BA_API void ba_ldbgmon(
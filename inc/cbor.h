@@ -0,0 +1,417 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Application Server
+ *
+ ****************************************************************************
+ *			      HEADER
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic LLC, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://realtimelogic.com
+ ****************************************************************************
+
+ Concise Binary Object Representation (CBOR) RFC 8949, including the
+ typed arrays defined in RFC 8746.
+
+ The CBOR parser reports values using the same callback interface as
+ the UBJSON parser (UBJPIntf and UBJVal); an object implementing
+ UBJPIntf can therefore consume both UBJSON and CBOR. The encoder
+ writes to a UBJEBuf.
+
+*/
+
+#ifndef __cbor_h
+#define __cbor_h
+
+#include "ubjson.h"
+
+/** @addtogroup CBORRef
+@{
+*/
+
+#define CBORPARS_STACK_LEN 3
+
+/** Size of the internal buffer used by the parser when typed array
+    data must be converted (byte swapped or aligned) before it is
+    passed to the typed array callback.
+*/
+#ifndef CBORPARS_SCRATCH_LEN
+#define CBORPARS_SCRATCH_LEN 256
+#endif
+
+/** CBOR typed array element type (RFC 8746).
+ */
+typedef enum {
+   CBORAT_Uint8=0, /**< U8 */
+   CBORAT_Int8, /**< S8 */
+   CBORAT_Uint16, /**< U16 */
+   CBORAT_Int16, /**< S16 */
+   CBORAT_Uint32, /**< U32 */
+   CBORAT_Int32, /**< S32 */
+   CBORAT_Uint64, /**< U64 */
+   CBORAT_Int64, /**< S64 */
+   CBORAT_Float16, /**< Half precision, decoded as float */
+   CBORAT_Float32, /**< float */
+   CBORAT_Float64, /**< double */
+   CBORAT_InvalidType
+} CBORAT;
+
+/** Returns the size in bytes of one typed array element. */
+#define CBORAT_size(t) \
+   ((t) <= CBORAT_Int8 ? 1 : (t) <= CBORAT_Int16 || (t) == CBORAT_Float16 ? \
+    2 : (t) <= CBORAT_Int32 || (t) == CBORAT_Float32 ? 4 : 8)
+
+struct CBORParser;
+
+/** Optional typed array callback.
+
+    When installed with CBORParser_setArrayCB, typed arrays are
+    delivered in bulk as native C arrays instead of as one UBJVal per
+    element. The data points directly into the buffer passed to
+    CBORParser_parse when the array is in host byte order and
+    properly aligned; otherwise, the data is converted in chunks using
+    an internal buffer. The callback may therefore be called several
+    times for one array.
+
+    \param o the parser.
+    \param name the member name if the parent is an object, otherwise NULL.
+    \param t the element type. Float16 arrays are delivered as
+    CBORAT_Float32.
+    \param data the elements.
+    \param n the number of elements in 'data'.
+    \param remaining the number of elements not yet delivered; zero
+    for the last call.
+    \param recLevel the nesting level of the array.
+    \returns 0 on success; a non zero value aborts the parser.
+*/
+typedef int (*CBORParser_ArrayCB)(
+   struct CBORParser* o, const char* name, CBORAT t, const void* data,
+   S32 n, S32 remaining, int recLevel);
+
+
+/** The parser uses a stack instead of recursion and the
+ * CBORPStackNode type represent one entry in the stack.
+ */
+typedef struct
+{
+   S64 count; /* Items left (keys and values), -1 if indefinite */
+   U8 isObj; /* TRUE for map, FALSE for array */
+   U8 isKey; /* Map: the next item is a member name */
+} CBORPStackNode;
+
+
+/** The CBOR parser parses a binary CBOR stream and calls the UBJPIntf
+    callback interface for each parsed object/primitive type.
+
+    The events are the same as the ones produced by the UBJSON parser:
+
+    \li Integers are reported using the smallest UBJSON integer type
+    that can hold the value. Unsigned values larger than 2^63-1 are
+    rejected with UBJPStatus_Overflow.
+    \li Text and byte strings are reported as UBJT_String chunks, where
+    UBJVal::len is the chunk length and UBJVal::x is the number of
+    bytes remaining. Indefinite length strings set UBJVal::x to -1 and
+    are terminated by a zero length chunk where UBJVal::x is 0.
+    \li Arrays and maps start with UBJT_BeginArray and
+    UBJT_BeginObject. A definite length container is followed by a
+    UBJT_Count event, where UBJVal::len is the number of elements
+    (members for maps).
+    \li Map keys must be strings or integers and are stored in the
+    member name buffer provided in the constructor.
+    \li Half precision and single precision floats are reported as
+    UBJT_Float32.
+    \li Tags are ignored except for the typed array tags 64 to 87,
+    which are reported as a strongly typed array, or via the typed
+    array callback if installed.
+
+    \sa UBJParser
+ */
+typedef struct CBORParser
+{
+#ifdef __cplusplus
+   /** Create the parser.
+       \param intf the callback interface object.
+       \param name is a buffer used for storing an object member name
+       during parsing.
+       \param memberNameLen is the length of the object member name
+       buffer. The length must be no less than the largest member name
+       expected.
+       \param extraStackLen informs the parser that it can use a stack
+       larger than the default depth of 3. The memory for the
+       CBORParser object must be constructed as follows:
+       malloc(sizeof(CBORParser) + extraStackLen *
+       sizeof(CBORPStackNode))
+   */
+   CBORParser(UBJPIntf* intf,char* name,int memberNameLen,int extraStackLen=0);
+
+   /** Parse a CBOR chunk.
+       \param buf a pointer to the CBOR chunk.
+       \param size is the buffer length.
+       \returns
+       \li 0: Needs more data. The CBOR chunk parsed was only a
+       partial object.
+       \li > 0: A complete CBOR object is assembled. If the status
+       is UBJPStatus_Done, call parse again (the arguments are
+       ignored) to parse the next object in the buffer.
+       \li < 0: Parse error.
+       \sa getStatus
+   */
+   int parse(const U8* buf, U32 size);
+
+   /** Install the optional typed array callback. */
+   void setArrayCB(CBORParser_ArrayCB cb);
+
+   /** Destructor */
+   ~CBORParser();
+
+   /** Returns the parser status (UBJPStatus). Typically used when method
+       parse returns a value less than zero.
+       \sa parse
+   */
+   int getStatus();
+#endif
+   UBJVal val;
+   UBJPIntf* intf;
+   CBORParser_ArrayCB arrayCB;
+   const U8* bufPtr;
+   const U8* bufEnd;
+   char* name;
+   U64 remaining; /* Bytes left in string or typed array segment */
+   S32 taLeft; /* Typed array elements not yet delivered */
+   int memberNameLen;
+   int nameLen;
+   int stackIx; /* Number of open containers */
+   int stackLen;
+   union {
+      U64 align;
+      U8 buf[CBORPARS_SCRATCH_LEN];
+   } scratch;
+   U8 head[9]; /* Head split between two chunks */
+   U8 headLen;
+   U8 elem[8]; /* Typed array element split between two chunks */
+   U8 elemLen;
+   U8 state;
+   U8 status; /* UBJPStatus */
+   U8 strMajor; /* Major type of the string being parsed */
+   U8 indefStr; /* Parsing an indefinite length string */
+   U8 isKey; /* The string being parsed is a member name */
+   U8 taType; /* CBORAT if a typed array tag is pending */
+   U8 taLE; /* Typed array data is little endian */
+   CBORPStackNode stack[CBORPARS_STACK_LEN];
+} CBORParser;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void CBORParser_constructor(CBORParser* o, UBJPIntf* intf, char* name,
+                            int memberNameLen, int extraStackLen);
+#define CBORParser_destructor(o)
+int CBORParser_parse(CBORParser* o, const U8* buf, U32 size);
+#define CBORParser_setArrayCB(o, cb) (o)->arrayCB=cb
+#define CBORParser_getStatus(o) (o)->status
+#ifdef __cplusplus
+}
+inline CBORParser::CBORParser(
+   UBJPIntf* intf, char* name, int memberNameLen, int extraStackLen) {
+   CBORParser_constructor(this, intf, name, memberNameLen, extraStackLen);
+}
+inline CBORParser::~CBORParser() {
+   CBORParser_destructor(this);
+}
+inline int CBORParser::parse(const U8* buf, U32 size) {
+   return CBORParser_parse(this, buf, size);
+}
+inline void CBORParser::setArrayCB(CBORParser_ArrayCB cb) {
+   CBORParser_setArrayCB(this, cb);
+}
+inline int CBORParser::getStatus() {
+   return CBORParser_getStatus(this);
+}
+#endif
+
+
+/** CBOR Encoder.
+    The encoder performs limited error checking and you can produce
+    incorrect CBOR data if you incorrectly use the methods in this
+    class. Errors are reported using the UBJEStatus codes.
+ */
+typedef struct CBOREncoder
+{
+#ifdef __cplusplus
+   /** Create/initialize a CBOREncoder instance.
+       \param buf a buffer that either buffers all produced CBOR
+       data or small chunks, which are then flushed out to a stream
+       when the buffer is full.
+    */
+   CBOREncoder(UBJEBuf* buf);
+
+   /** Destructor */
+   ~CBOREncoder();
+
+   /** Set null */
+   int null();
+
+   /** Set boolean */
+   int boolean(bool b);
+
+   /** Set a signed integer using the smallest encoding */
+   int integer(S64 v);
+
+   /** Set an unsigned integer using the smallest encoding */
+   int uinteger(U64 v);
+
+   /** Set float32 */
+   int float32(float v);
+
+   /** Set float64 */
+   int float64(double v);
+
+   /** Set text string (or a map member name) */
+   int string(const char* s, S32 len);
+
+   /** Set byte string */
+   int bytes(const void* data, S32 len);
+
+   /** Set a tag; the next value is the tag content. */
+   int tag(U64 tag);
+
+   /** Begin an array.
+       \param count the number of elements or -1 for an indefinite
+       length array, which must be terminated with end().
+   */
+   int beginArray(S32 count=-1);
+
+   /** Begin a map.
+       \param count the number of members or -1 for an indefinite
+       length map, which must be terminated with end().
+   */
+   int beginObject(S32 count=-1);
+
+   /** End an indefinite length array or map. */
+   int end();
+
+   /** Encode a C array as an RFC 8746 typed array. The data is
+       copied as is, using the typed array tag for the host byte
+       order.
+       \param t the element type; CBORAT_Float16 is not supported.
+       \param data the array.
+       \param count the number of elements.
+   */
+   int typedArray(CBORAT t, const void* data, S32 count);
+
+   /** Resets the UBJEBuf cursor (the buffer provided in the constructor) */
+   void reset();
+#endif
+   UBJEBuf* buf;
+   int status;
+} CBOREncoder;
+
+#define CBOREncoder_constructor(o, cborBuf) (o)->buf=cborBuf,(o)->status=0
+#define CBOREncoder_destructor(o)
+#define CBOREncoder_reset(o) ((o)->status=0,(o)->buf->cursor=0,0)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+int CBOREncoder_head(CBOREncoder* o, U8 major, U64 arg);
+int CBOREncoder_indef(CBOREncoder* o, U8 major);
+int CBOREncoder_integer(CBOREncoder* o, S64 v);
+int CBOREncoder_float32(CBOREncoder* o, float v);
+int CBOREncoder_float64(CBOREncoder* o, double v);
+int CBOREncoder_write(CBOREncoder* o, U8 major, const void* data, S32 len);
+int CBOREncoder_typedArray(
+   CBOREncoder* o, CBORAT t, const void* data, S32 count);
+#ifdef __cplusplus
+}
+#endif
+
+#define CBOREncoder_null(o) CBOREncoder_head(o, 7, 22)
+#define CBOREncoder_boolean(o,b) CBOREncoder_head(o, 7, (b) ? 21 : 20)
+#define CBOREncoder_uinteger(o,v) CBOREncoder_head(o, 0, v)
+#define CBOREncoder_string(o,s,len) CBOREncoder_write(o, 3, s, len)
+#define CBOREncoder_bytes(o,data,len) CBOREncoder_write(o, 2, data, len)
+#define CBOREncoder_tag(o,t) CBOREncoder_head(o, 6, t)
+#define CBOREncoder_beginArray(o,count) \
+   ((count) < 0 ? CBOREncoder_indef(o,4) : CBOREncoder_head(o,4,(U64)(count)))
+#define CBOREncoder_beginObject(o,count) \
+   ((count) < 0 ? CBOREncoder_indef(o,5) : CBOREncoder_head(o,5,(U64)(count)))
+#define CBOREncoder_end(o) CBOREncoder_indef(o, 7)
+
+#ifdef __cplusplus
+inline CBOREncoder::CBOREncoder(UBJEBuf* b) {
+   CBOREncoder_constructor(this, b);
+}
+inline CBOREncoder::~CBOREncoder() {
+   CBOREncoder_destructor(this);
+}
+inline int CBOREncoder::null() {
+   return CBOREncoder_null(this);
+}
+inline int CBOREncoder::boolean(bool b) {
+   return CBOREncoder_boolean(this, b);
+}
+inline int CBOREncoder::integer(S64 v) {
+   return CBOREncoder_integer(this, v);
+}
+inline int CBOREncoder::uinteger(U64 v) {
+   return CBOREncoder_uinteger(this, v);
+}
+inline int CBOREncoder::float32(float v) {
+   return CBOREncoder_float32(this, v);
+}
+inline int CBOREncoder::float64(double v) {
+   return CBOREncoder_float64(this, v);
+}
+inline int CBOREncoder::string(const char* s, S32 len) {
+   return CBOREncoder_string(this, s, len);
+}
+inline int CBOREncoder::bytes(const void* data, S32 len) {
+   return CBOREncoder_bytes(this, data, len);
+}
+inline int CBOREncoder::tag(U64 t) {
+   return CBOREncoder_tag(this, t);
+}
+inline int CBOREncoder::beginArray(S32 count) {
+   return CBOREncoder_beginArray(this, count);
+}
+inline int CBOREncoder::beginObject(S32 count) {
+   return CBOREncoder_beginObject(this, count);
+}
+inline int CBOREncoder::end() {
+   return CBOREncoder_end(this);
+}
+inline int CBOREncoder::typedArray(CBORAT t, const void* data, S32 count) {
+   return CBOREncoder_typedArray(this, t, data, count);
+}
+inline void CBOREncoder::reset() {
+   CBOREncoder_reset(this);
+}
+#endif
+
+/** @} */ /* end of CBORRef */
+
+
+#endif
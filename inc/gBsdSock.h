@@ -489,6 +489,16 @@ do { \
 #endif
 #endif
 
+#ifndef HttpSocket_soReuseport
+#ifdef SO_REUSEPORT
+#define HttpSocket_soReuseport(o, status) do { \
+   int enableFlag = 1; \
+   *(status) = socketSetsockopt((o)->hndl, SOL_SOCKET, SO_REUSEPORT, \
+                               (char*)&enableFlag, sizeof(int)); \
+}while(0)
+#endif
+#endif
+
 #ifndef HttpSocket_soDontroute
 #define HttpSocket_soDontroute(o, enableFlag, status) do {       \
    *(status) = socketSetsockopt((o)->hndl, SOL_SOCKET, SO_DONTROUTE, \
@@ -0,0 +1,87 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ *
+ ****************************************************************************
+ *			      HEADER
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic LLC, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Thread caching allocator. An alternative to dlmalloc for servers
+running many threads (HttpCmdThreadPool, LThreadMgr).
+
+Objects up to 8 Kbytes are rounded up to one of 32 size classes and
+carved from spans, runs of 4 Kbyte pages. Each thread keeps a small
+free list per size class, making most allocations and releases lock
+free. The thread caches exchange objects in batches with a central
+free list per size class, and the central lists obtain spans from a
+page heap that coalesces free neighbor spans. Larger allocations are
+served directly by the page heap.
+
+Like dlmalloc, the allocator manages a fixed memory region given to
+init_tcalloc. Compile the code with USE_TCALLOC to make baMalloc,
+baRealloc, and baFree use the allocator.
+
+Thread caches use compiler thread local storage. The storage class
+keyword is detected for GCC, Clang, and Visual C++; other compilers
+can set it with TCALLOC_TLS, e.g. -DTCALLOC_TLS=_Thread_local. A
+platform without thread local storage must compile the code with
+TCALLOC_NO_CACHE, in which case all requests go to the central free
+lists. The caches are also disabled when TCALLOC_TLS is not set and
+the compiler is not detected. On POSIX, a thread's cache is returned
+to the central lists when the thread exits; on other platforms, call
+tcalloc_flushThreadCache before a thread terminates.
+*/
+#ifndef __tcalloc_h
+#define __tcalloc_h
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+void init_tcalloc(char* heapstart, char* heapend);
+void tcalloc_setExhaustedCB(void (*cb)(void));
+void* tcalloc(size_t bytes);
+void* tcrealloc(void* oldmem, size_t bytes);
+void tcfree(void* mem);
+/* Return the calling thread's cached objects to the central lists. */
+void tcalloc_flushThreadCache(void);
+/* Number of bytes in the region not used by spans or large objects. */
+size_t tcalloc_freePages(void);
+#ifdef __cplusplus
+}
+#endif
+
+#ifdef USE_TCALLOC
+#define baMalloc(size) tcalloc(size)
+#define baRealloc(ptr, size) tcrealloc(ptr, size)
+#define baFree(ptr) tcfree(ptr)
+#endif
+
+#endif
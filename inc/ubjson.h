@@ -478,6 +478,19 @@ typedef struct UBJEncoder
    /** End of object */
    int endObject();
 
+   /** Encode a C array as an optimized strongly typed array
+       ([$type#count). The elements are converted to big endian and
+       copied in bulk to the UBJEBuf, without the per value overhead
+       of the other methods.
+       \param type one of the fixed size number types: UBJT_Int8,
+       UBJT_Uint8, UBJT_Char, UBJT_Int16, UBJT_Int32, UBJT_Int64,
+       UBJT_Float32, or UBJT_Float64.
+       \param data the C array.
+       \param count the number of elements.
+       \sa UBJ_typedArrayHeader
+   */
+   int typedArray(UBJT type, const void* data, S32 count);
+
    /** Resets the UBJEBuf cursor (the buffer provided in the constructor) */
    void reset();
 
@@ -544,10 +557,40 @@ int UBJEncoder_setStatus(UBJEncoder* o, UBJEStatus s);
 int UBJEncoder_val(UBJEncoder* o);
 int UBJEncoder_vset(UBJEncoder* o,const char** fmt,va_list* argList,int isObj);
 int UBJEncoder_set(UBJEncoder* o, const char* fmt, ...);
+int UBJEncoder_typedArray(
+   UBJEncoder* o, UBJT type, const void* data, S32 count);
+
+/** Parse the header of an optimized strongly typed array
+    ([$type#count) where type is a fixed size number type. The
+    elements follow the header and can be copied in bulk with
+    UBJ_typedArrayCopy, or used directly from the buffer on big
+    endian hosts.
+    \param buf the UBJSON data, starting with '['.
+    \param size the buffer length.
+    \param type set to the element type.
+    \param count set to the number of elements.
+    \returns the header length, 0 if more data is needed, or -1 if
+    the data is not a strongly typed array of numbers.
+*/
+int UBJ_typedArrayHeader(const U8* buf, U32 size, UBJT* type, S32* count);
+
+/** Copy 'count' UBJSON (big endian) elements of 'type' from 'src'
+    to the C array 'dest' in host byte order.
+    \sa UBJ_typedArrayHeader
+*/
+void UBJ_typedArrayCopy(void* dest, const U8* src, UBJT type, S32 count);
 #ifdef __cplusplus
 }
 #endif
 
+/** Returns the size of one element of a fixed size number type and 0
+    for the other types.
+*/
+#define UBJT_size(t) \
+   ((t) == UBJT_Int8 || (t) == UBJT_Uint8 || (t) == UBJT_Char ? 1 :     \
+    (t) == UBJT_Int16 ? 2 : (t) == UBJT_Int32 || (t) == UBJT_Float32 ? 4 : \
+    (t) == UBJT_Int64 || (t) == UBJT_Float64 ? 8 : 0)
+
 #define UBJEncoder_setName(o,v) ((o)->val.name=(char*)v)
 #define UBJEncoder_null(o) ((o)->val.t=UBJT_Null,UBJEncoder_val(o))
 #define UBJEncoder_boolean(o,v)                                         \
@@ -634,6 +677,9 @@ inline int UBJEncoder::endArray() {
 inline int UBJEncoder::endObject() {
    return UBJEncoder_endObject(this);
 }
+inline int UBJEncoder::typedArray(UBJT t, const void* data, S32 count) {
+   return UBJEncoder_typedArray(this, t, data, count);
+}
 inline void UBJEncoder::reset() {
    UBJEncoder_reset(this);
 }
@@ -2,7 +2,10 @@
 # with GNU Make Example:
 # make -f mako.mk EPOLL=true
 # The above compiles mako using the 'epoll' socket dispatcher for Linux. The
-# default is to use the 'select' socket dispatcher.
+# default is to use the 'select' socket dispatcher, which is limited to
+# FD_SETSIZE sockets. Use POLL=true for the 'poll' dispatcher (QNX and
+# other POSIX systems without epoll) or KQUEUE=true for the 'kqueue'
+# dispatcher (macOS and BSD).
 # The makefile is designed for the "Embedded Linux Web Based Device
 # Management" tutorial and will auto include the generated Lua
 # bindings if found. The makefile will also auto include SQLite, Lua
@@ -85,6 +88,12 @@ CFLAGS += $(I)inc $(I)inc/arch/Posix
 ifdef EPOLL
 SODISP = epoll
 CFLAGS += $(I)inc/arch/NET/epoll
+else ifdef POLL
+SODISP = poll
+CFLAGS += $(I)inc/arch/NET/poll
+else ifdef KQUEUE
+SODISP = kqueue
+CFLAGS += $(I)inc/arch/NET/kqueue
 else
 SODISP = generic
 CFLAGS += $(I)inc/arch/NET/Posix
@@ -94,6 +103,18 @@ VPATH = src src/arch/Posix src/arch/NET/$(SODISP) src/DiskIo/posix examples/Mako
 
 SOURCE = BAS.c ThreadLib.c SoDisp.c BaFile.c MakoMain.c
 
+# Thread caching allocator (src/tcalloc.c): make -f mako.mk TCALLOC=true
+ifdef TCALLOC
+CFLAGS += $(D)USE_TCALLOC=1
+SOURCE += tcalloc.c
+endif
+
+# Sampling heap profiler (ba.heapprof): make -f mako.mk HEAPPROF=true
+ifdef HEAPPROF
+CFLAGS += $(D)BA_HEAP_PROFILE=1
+SOURCE += HeapProfiler.c lheapprof.c
+endif
+
 endif
 
 # Add common macros.
@@ -109,6 +130,40 @@ endif
 CFLAGS += $(D)USE_LUAINTF=1
 CFLAGS += $(D)USE_DBGMON=1
 
+# Direct JSON to Lua table decoder (ba.json.fastdecode, ba.json.fastparser):
+# make -f mako.mk JSONDEC=true
+ifdef JSONDEC
+CFLAGS += $(D)USE_JSONDEC=1
+SOURCE += ljsondec.c
+endif
+
+# CBOR codec (ba.cbor.encode, ba.cbor.decode) and UBJSON typed arrays:
+# make -f mako.mk BACBOR=true
+ifdef BACBOR
+CFLAGS += $(D)USE_BACBOR=1
+SOURCE += cbor.c lcbor.c ubjtarray.c
+endif
+
+# Server counters and latency histograms (ba.httpstats):
+# make -f mako.mk HTTPSTATS=true
+ifdef HTTPSTATS
+CFLAGS += $(D)USE_HTTP_STATS=1
+SOURCE += lhttpstats.c
+endif
+
+# Lua bytecode cache (ba.bytecache): make -f mako.mk BYTECACHE=true
+ifdef BYTECACHE
+CFLAGS += $(D)USE_BYTECACHE=1
+SOURCE += lbytecache.c
+endif
+
+# Write-behind I/O for uploads to slow storage (ba.openio"wbdisk", see
+# mako -b): make -f mako.mk WRITEBEHIND=true
+ifdef WRITEBEHIND
+CFLAGS += $(D)USE_WRITEBEHIND=1
+SOURCE += WriteBehindIo.c
+endif
+
 ifeq ($(USE_OPCUA),1)
 CFLAGS += $(D)USE_OPCUA=1
 else
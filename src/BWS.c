@@ -5606,6 +5606,23 @@ SharkSslSession *latchgpiochip(SharkSslSessionCache*, SharkSslCon*, U8*, U16);
 #endif
 
 
+#if ((SHARKSSL_ENABLE_RSA || SHARKSSL_ENABLE_ECDSA) && SHARKSSL_ENABLE_CERT_CACHE)
+/* A peer certificate chain, identified by the SHA-256 hash of the
+   handshake's certificate_list, whose signatures verified against
+   caList.
+*/
+struct SharkSslCertCacheEntry
+{
+   U8 digest[SHARKSSL_SHA256_HASH_LEN];
+   const U8 *caList;
+   U32 lastUse;  /* 0: unused entry */
+};
+
+static U8   SharkSslCertCache_find(SharkSslCertCache*, const U8*, const U8*);
+static void SharkSslCertCache_add(SharkSslCertCache*, const U8*, const U8*);
+#endif
+
+
 struct SharkSslCon   
 {
    #if SHARKSSL_MAX_BLOCK_LEN
@@ -6086,7 +6103,7 @@ U8 SharkSslCon_setALPNFunction(SharkSslCon *o, ALPNFunction func0fixup, void *wr
 
 
 
-int SharkSslCertParam_validateCertChain(SharkSslCertParam *certParam, SharkSslSignParam *tmpSignParam
+int SharkSslCertParam_validateCertChain(SharkSslCertParam *certParam, SharkSslSignParam *tmpSignParam, U8 sigVerified
    #if SHARKSSL_ENABLE_CA_LIST
    , U32 *driverchipcommon, SharkSslCAList displaysetup, U8 *afterhandler
    #endif
@@ -6290,13 +6307,16 @@ int SharkSslCertParam_validateCertChain(SharkSslCertParam *certParam, SharkSslSi
          }
 
          
-         tmpSignParam->pCertKey = &(((SharkSslCertParam*)certParam->certInfo.parent)->certKey);
-         
-         memcpy(&(tmpSignParam->signature), &(certParam->signature), sizeof(SharkSslSignature));
-         if (systemcapabilities(tmpSignParam) < 0)
+         if (!sigVerified)
          {
-            SHARKDBG_PRINTF(("\045\163\072\040\045\144\012", __FILE__, __LINE__));
-            return 1;  
+            tmpSignParam->pCertKey = &(((SharkSslCertParam*)certParam->certInfo.parent)->certKey);
+            
+            memcpy(&(tmpSignParam->signature), &(certParam->signature), sizeof(SharkSslSignature));
+            if (systemcapabilities(tmpSignParam) < 0)
+            {
+               SHARKDBG_PRINTF(("\045\163\072\040\045\144\012", __FILE__, __LINE__));
+               return 1;  
+            }
          }
 
          #if SHARKSSL_ENABLE_CA_LIST
@@ -7253,6 +7273,9 @@ SharkSslCon_RetVal configdword(SharkSslCon *o,
    SharkSslHSParam *sharkSslHSParam;
    #if ((SHARKSSL_SSL_CLIENT_CODE || SHARKSSL_SSL_SERVER_CODE) && (SHARKSSL_ENABLE_RSA || SHARKSSL_ENABLE_ECDSA))
    SharkSslCertParam *certParam;
+   #if SHARKSSL_ENABLE_CERT_CACHE
+   U8 *certList;
+   #endif
    #if (SHARKSSL_SSL_SERVER_CODE || SHARKSSL_ENABLE_CLIENT_AUTH)
    SingleListEnumerator e;
    SingleLink *link;
@@ -11171,6 +11194,9 @@ SharkSslCon_RetVal configdword(SharkSslCon *o,
 
          ics = 0; 
          certParam = &(sharkSslHSParam->certParam);
+         #if SHARKSSL_ENABLE_CERT_CACHE
+         certList = registeredevent;
+         #endif
          while (crLen > 0)
          {
             
@@ -11270,6 +11296,11 @@ SharkSslCon_RetVal configdword(SharkSslCon *o,
          if (!(o->flags & serialreset))  
          #endif
          {
+            #if SHARKSSL_ENABLE_CERT_CACHE
+            U8 certDigest[SHARKSSL_SHA256_HASH_LEN];
+            const U8 *certCaList = 0;
+            U8 sigVerified = 0;
+            #endif
             #if (SHARKSSL_ENABLE_CA_EXTENSION && SHARKSSL_ENABLE_CA_LIST)
             SharkSslCAList displaysetup;
 
@@ -11282,7 +11313,30 @@ SharkSslCon_RetVal configdword(SharkSslCon *o,
                displaysetup = o->sharkSsl->caList;
             }
             #endif
+            #if SHARKSSL_ENABLE_CERT_CACHE
+            if (o->sharkSsl->certCache.cacheSize)
+            {
+               #if (SHARKSSL_ENABLE_CA_EXTENSION && SHARKSSL_ENABLE_CA_LIST)
+               certCaList = displaysetup;
+               #elif SHARKSSL_ENABLE_CA_LIST
+               certCaList = o->sharkSsl->caList;
+               #endif
+               if (0 == sharkssl_sha256(certList, (U32)(registeredevent - certList), certDigest))
+               {
+                  sigVerified = SharkSslCertCache_find(&o->sharkSsl->certCache, certDigest, certCaList);
+               }
+               else
+               {
+                  certList = 0;
+               }
+            }
+            #endif
             if (SharkSslCertParam_validateCertChain(&(sharkSslHSParam->certParam), &(sharkSslHSParam->signParam)
+               #if SHARKSSL_ENABLE_CERT_CACHE
+               , sigVerified
+               #else
+               , 0
+               #endif
                #if SHARKSSL_ENABLE_CA_LIST
                , &o->flags
                #if SHARKSSL_ENABLE_CA_EXTENSION
@@ -11297,6 +11351,12 @@ SharkSslCon_RetVal configdword(SharkSslCon *o,
                SHARKDBG_PRINTF(("\045\163\072\040\045\144\012", __FILE__, __LINE__));
                return savedconfig(o, SHARKSSL_ALERT_BAD_CERTIFICATE);
             }
+            #if SHARKSSL_ENABLE_CERT_CACHE
+            if (o->sharkSsl->certCache.cacheSize && certList && !sigVerified)
+            {
+               SharkSslCertCache_add(&o->sharkSsl->certCache, certDigest, certCaList);
+            }
+            #endif
          }
 
          baAssert((SharkSslClonedCertInfo*)0 == o->clonedCertInfo);
@@ -13958,6 +14018,338 @@ BufPrint_b64urlEncode(BufPrint* o, const void* panicblock, S32 allockuser, BaBoo
 
 
 
+#ifndef NO_DOUBLE
+
+/* Shortest round-trip double to string conversion: the Grisu2
+   algorithm by Florian Loitsch, producing JavaScript style output.
+*/
+
+typedef struct
+{
+   U64 f;
+   int e;
+} BaDiyFp;
+
+static const U64 baCachedPowF[] = {
+   0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+   0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+   0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+   0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+   0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+   0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+   0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+   0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+   0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+   0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+   0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+   0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+   0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+   0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+   0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+   0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+   0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+   0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+   0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+   0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+   0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+   0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+   0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+   0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+   0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+   0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+   0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+   0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+   0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+static const S16 baCachedPowE[] = {
+   -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+   -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+   -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+   -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+   -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+   109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+   375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+   641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+   907, 933, 960, 986, 1013, 1039, 1066
+};
+
+static const U64 baPow10[] = {
+   1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL,
+   10000000ULL, 100000000ULL, 1000000000ULL, 10000000000ULL,
+   100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+   100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+   100000000000000000ULL, 1000000000000000000ULL, 10000000000000000000ULL
+};
+
+#define BA_DP_HIDDEN 0x0010000000000000ULL
+
+
+static BaDiyFp
+BaDiyFp_mul(BaDiyFp x, BaDiyFp y)
+{
+   BaDiyFp r;
+   U64 a = x.f >> 32, b = x.f & 0xFFFFFFFF;
+   U64 c = y.f >> 32, d = y.f & 0xFFFFFFFF;
+   U64 ac = a*c, bc = b*c, ad = a*d, bd = b*d;
+   U64 tmp = (bd >> 32) + (ad & 0xFFFFFFFF) + (bc & 0xFFFFFFFF);
+   tmp += 1U << 31; /* Round */
+   r.f = ac + (ad >> 32) + (bc >> 32) + (tmp >> 32);
+   r.e = x.e + y.e + 64;
+   return r;
+}
+
+
+static BaDiyFp
+baCachedPower(int e, int* k)
+{
+   BaDiyFp r;
+   double dk = (-61 - e) * 0.30102999566398114 + 347;
+   int ik = (int)dk;
+   int idx;
+   if(dk - ik > 0.0)
+      ik++;
+   idx = (ik >> 3) + 1;
+   *k = -(-348 + (idx << 3));
+   r.f = baCachedPowF[idx];
+   r.e = baCachedPowE[idx];
+   return r;
+}
+
+
+static void
+baGrisuRound(char* buf, int len, U64 delta, U64 rest, U64 tenKappa, U64 wpw)
+{
+   while(rest < wpw && delta - rest >= tenKappa &&
+         (rest + tenKappa < wpw || wpw - rest > rest + tenKappa - wpw))
+   {
+      buf[len-1]--;
+      rest += tenKappa;
+   }
+}
+
+
+static int
+baDigitGen(BaDiyFp w, BaDiyFp mp, U64 delta, char* buf, int* k)
+{
+   const int shift = -mp.e;
+   const U64 one = (U64)1 << shift;
+   const U64 wpw = mp.f - w.f;
+   U32 p1 = (U32)(mp.f >> shift);
+   U64 p2 = mp.f & (one - 1);
+   int kappa = 1;
+   int len = 0;
+   while(kappa < 10 && p1 >= (U32)baPow10[kappa])
+      kappa++;
+   while(kappa > 0)
+   {
+      U64 tmp;
+      U32 d;
+      /* Constant divisors let the compiler avoid the divide instruction */
+      switch(kappa)
+      {
+         case 10: d = p1 / 1000000000; p1 %= 1000000000; break;
+         case 9: d = p1 / 100000000; p1 %= 100000000; break;
+         case 8: d = p1 / 10000000; p1 %= 10000000; break;
+         case 7: d = p1 / 1000000; p1 %= 1000000; break;
+         case 6: d = p1 / 100000; p1 %= 100000; break;
+         case 5: d = p1 / 10000; p1 %= 10000; break;
+         case 4: d = p1 / 1000; p1 %= 1000; break;
+         case 3: d = p1 / 100; p1 %= 100; break;
+         case 2: d = p1 / 10; p1 %= 10; break;
+         default: d = p1; p1 = 0;
+      }
+      if(d || len)
+         buf[len++] = (char)('0' + d);
+      kappa--;
+      tmp = ((U64)p1 << shift) + p2;
+      if(tmp <= delta)
+      {
+         *k += kappa;
+         baGrisuRound(buf, len, delta, tmp, baPow10[kappa] << shift, wpw);
+         return len;
+      }
+   }
+   for(;;)
+   {
+      int d;
+      p2 *= 10;
+      delta *= 10;
+      d = (int)(p2 >> shift);
+      if(d || len)
+         buf[len++] = (char)('0' + d);
+      p2 &= one - 1;
+      kappa--;
+      if(p2 < delta)
+      {
+         *k += kappa;
+         baGrisuRound(buf, len, delta, p2, one,
+                      -kappa < 20 ? wpw * baPow10[-kappa] : 0);
+         return len;
+      }
+   }
+}
+
+
+/* Sets buf to the shortest digit string and *k to the decimal
+   exponent such that v = buf * 10^k. Returns the number of digits.
+*/
+static int
+baGrisu2(U64 bits, char* buf, int* k)
+{
+   BaDiyFp v, w, mp, mm, c;
+   int be = (int)((bits >> 52) & 0x7FF);
+   U64 frac = bits & (BA_DP_HIDDEN - 1);
+   if(be)
+   {
+      v.f = frac + BA_DP_HIDDEN;
+      v.e = be - 1075;
+   }
+   else
+   {
+      v.f = frac;
+      v.e = -1074;
+   }
+   /* Boundaries m+ and m-, normalized to the same exponent */
+   mp.f = (v.f << 1) + 1;
+   mp.e = v.e - 1;
+   while( ! (mp.f & (BA_DP_HIDDEN << 1)) )
+   {
+      mp.f <<= 1;
+      mp.e--;
+   }
+   mp.f <<= 10;
+   mp.e -= 10;
+   if(v.f == BA_DP_HIDDEN)
+   {
+      mm.f = (v.f << 2) - 1;
+      mm.e = v.e - 2;
+   }
+   else
+   {
+      mm.f = (v.f << 1) - 1;
+      mm.e = v.e - 1;
+   }
+   mm.f <<= mm.e - mp.e;
+   mm.e = mp.e;
+   w = v;
+   while( ! (w.f & 0x8000000000000000ULL) )
+   {
+      w.f <<= 1;
+      w.e--;
+   }
+   c = baCachedPower(mp.e, k);
+   w = BaDiyFp_mul(w, c);
+   mp = BaDiyFp_mul(mp, c);
+   mm = BaDiyFp_mul(mm, c);
+   mm.f++;
+   mp.f--;
+   return baDigitGen(w, mp, mp.f - mm.f, buf, k);
+}
+
+
+static int
+baWriteExp(int k, char* buf)
+{
+   int len=0;
+   if(k < 0)
+   {
+      buf[len++] = '-';
+      k = -k;
+   }
+   else
+      buf[len++] = '+';
+   if(k >= 100)
+   {
+      buf[len++] = (char)('0' + k / 100);
+      k %= 100;
+      buf[len++] = (char)('0' + k / 10);
+   }
+   else if(k >= 10)
+      buf[len++] = (char)('0' + k / 10);
+   buf[len++] = (char)('0' + k % 10);
+   return len;
+}
+
+
+/* Format the 'len' digits in buf with decimal exponent k. Integral
+   values get a ".0" suffix so a JSON parser reads them back as
+   floating point values.
+*/
+static int
+baPrettify(char* buf, int len, int k)
+{
+   const int kk = len + k; /* 10^(kk-1) <= v < 10^kk */
+   int i;
+   if(k >= 0 && kk <= 21)
+   {
+      for(i = len ; i < kk ; i++)
+         buf[i] = '0';
+      buf[kk] = '.';
+      buf[kk+1] = '0';
+      return kk + 2;
+   }
+   if(kk > 0 && kk <= 21)
+   {
+      memmove(buf + kk + 1, buf + kk, (size_t)(len - kk));
+      buf[kk] = '.';
+      return len + 1;
+   }
+   if(kk > -6 && kk <= 0)
+   {
+      const int offset = 2 - kk;
+      memmove(buf + offset, buf, (size_t)len);
+      buf[0] = '0';
+      buf[1] = '.';
+      for(i = 2 ; i < offset ; i++)
+         buf[i] = '0';
+      return len + offset;
+   }
+   if(len == 1)
+   {
+      buf[1] = 'e';
+      return 2 + baWriteExp(kk - 1, buf + 2);
+   }
+   memmove(buf + 2, buf + 1, (size_t)(len - 1));
+   buf[1] = '.';
+   buf[len+1] = 'e';
+   return len + 2 + baWriteExp(kk - 1, buf + len + 2);
+}
+
+
+BA_API int
+BufPrint_dtoa(BufPrint* o, double v)
+{
+   char buf[32];
+   char* ptr = buf;
+   int len, k;
+   U64 bits;
+   memcpy(&bits, &v, sizeof(bits));
+   if(bits >> 63)
+      *ptr++ = '-';
+   if(((bits >> 52) & 0x7FF) == 0x7FF)
+   {
+      /* Same as %f */
+      strcpy(ptr, (bits & (BA_DP_HIDDEN - 1)) ? "NaN" : "Inf");
+      return BufPrint_write(o, buf, -1);
+   }
+   bits &= 0x7FFFFFFFFFFFFFFFULL;
+   if( ! bits )
+   {
+      ptr[0]='0'; ptr[1]='.'; ptr[2]='0';
+      len = 3;
+   }
+   else
+   {
+      len = baGrisu2(bits, ptr, &k);
+      len = baPrettify(ptr, len, k);
+   }
+   return BufPrint_write(o, buf, (int)(ptr - buf) + len);
+}
+
+#endif /* NO_DOUBLE */
+
+
 BA_API int
 BufPrint_jsonString(BufPrint* o, const char* str)
 {
@@ -16785,6 +17177,7 @@ mcbsp3hwmod(SoDispCon* con, int len)
       (void)queueevent;
       if(len < 0 || !SoDispCon_isValid(con))
          return E_SOCKET_WRITE_FAILED; 
+      HttpStats_count(HttpStats_BytesOut, len);
       buf->cursor+=len;
       baAssert(buf->cursor <= buf->bufLen);
       if(buf->cursor == buf->bufLen)
@@ -16844,6 +17237,8 @@ uart0writel(SoDispCon* con,
             if(queueevent)
                return E_SOCKET_READ_FAILED;
             con->recTermPtr=0;
+            if(sffsdrnandflash > 0)
+               HttpStats_count(HttpStats_BytesIn, sffsdrnandflash);
             if( ! SoDispCon_socketHasNonBlockData(con) || sffsdrnandflash <= 0)
                SoDispCon_clearHasMoreData(con);
             return sffsdrnandflash;
@@ -16860,6 +17255,8 @@ uart0writel(SoDispCon* con,
          if(queueevent)
             return E_SOCKET_WRITE_FAILED;
          con->sendTermPtr=0;
+         if(sffsdrnandflash > 0)
+            HttpStats_count(HttpStats_BytesOut, sffsdrnandflash);
          return sffsdrnandflash < 0 ? E_SOCKET_WRITE_FAILED : sffsdrnandflash;
 
       case SoDispCon_GetSharkSslCon:
@@ -16898,24 +17295,50 @@ uart0writel(SoDispCon* con,
       case SoDispCon_ExTypeIdle:
          SoDispCon_releaseAsyncBuf(con);
          return TRUE;
+
+      case SoDispCon_ExTypeCork:
+         return 0; /* Nothing to coalesce on a non secure connection */
    }
    baAssert(0);
    return -1;
 }
 
+static BaBool servConStopAccepting;
+
+/* Returns TRUE and stops reading the listen socket when
+ * HttpServCon_stopAccepting has been called. The pending connections
+ * are left in the socket's backlog for the process that inherited the
+ * listen socket.
+ */
+static BaBool
+servConStopped(SoDispCon* con)
+{
+   if(servConStopAccepting)
+   {
+      if(SoDispCon_recEvActive(con))
+         SoDisp_deactivateRec(con->dispatcher, con);
+      return TRUE;
+   }
+   return FALSE;
+}
+
 #ifndef NO_BA_SERVER
 static void
 stackcritical(SoDispCon* fdc37m81xconfig)
 {
    int sffsdrnandflash;
    HttpServer* uarchbuild = HttpConnection_getServer((HttpConnection*)fdc37m81xconfig);
-   SoDispCon* boardmanufacturer = (SoDispCon*)HttpServer_getFreeCon(uarchbuild);
+   SoDispCon* boardmanufacturer;
+   if(servConStopped(fdc37m81xconfig))
+      return;
+   boardmanufacturer = (SoDispCon*)HttpServer_getFreeCon(uarchbuild);
    if(boardmanufacturer)
    {
      L_tryAgain:
       HttpSocket_accept(&fdc37m81xconfig->httpSocket, &boardmanufacturer->httpSocket, &sffsdrnandflash);
       if( ! sffsdrnandflash )
       {
+         HttpStats_count(HttpStats_Accepted, 1);
          if(SoDispCon_isIP6(fdc37m81xconfig))
             SoDispCon_setIP6(boardmanufacturer);
          boardmanufacturer->exec=uart0writel;
@@ -16930,6 +17353,7 @@ stackcritical(SoDispCon* fdc37m81xconfig)
       if( ! HttpServer_termOldestIdleCon(uarchbuild) )
          goto L_tryAgain;
       HttpServer_returnFreeCon(uarchbuild, (HttpConnection*)boardmanufacturer);
+      HttpStats_count(HttpStats_AcceptFailed, 1);
    }
    else
    {  
@@ -16938,6 +17362,7 @@ stackcritical(SoDispCon* fdc37m81xconfig)
       SoDispCon_constructor(&con,0,0);
       HttpSocket_accept(&fdc37m81xconfig->httpSocket, &con.httpSocket, &sffsdrnandflash);
       SoDispCon_destructor(&con);
+      HttpStats_count(HttpStats_AcceptFailed, 1);
       TRPR(("\123\145\162\166\145\162\040\143\157\156\156\145\143\164\151\157\156\163\040\145\170\150\141\165\163\164\145\144\012"));
    }
    TRPR(("\110\164\164\160\123\145\162\166\103\157\156\072\072\167\145\142\123\145\162\166\145\162\101\143\143\145\160\164\105\166\040\146\141\151\154\145\144\072\045\163\040\045\144\012",
@@ -16954,6 +17379,8 @@ offsetextended(SoDispCon* fdc37m81xconfig)
    SoDispCon* newConS = (SoDispCon*)&boardmanufacturer;
 
    int sffsdrnandflash;
+   if(servConStopped(fdc37m81xconfig))
+      return;
 #ifndef NO_BA_SERVER
 L_tryAgain:
 #endif
@@ -16961,6 +17388,7 @@ L_tryAgain:
    HttpSocket_accept(&fdc37m81xconfig->httpSocket, &newConS->httpSocket, &sffsdrnandflash);
    if( ! sffsdrnandflash )
    {
+      HttpStats_count(HttpStats_Accepted, 1);
       if(SoDispCon_isIP6(fdc37m81xconfig))
          SoDispCon_setIP6(newConS);
       newConS->exec=uart0writel;
@@ -17026,6 +17454,114 @@ HttpServCon_constructor(HttpServCon* o,
 }
 
 
+#ifdef BA_POSIX
+#ifndef SERVCON_MAX_INHERITED
+#define SERVCON_MAX_INHERITED 32
+#endif
+static int servConInherited[SERVCON_MAX_INHERITED];
+static int servConNoOfInherited;
+
+BA_API int
+HttpServCon_inheritSocket(int hndl)
+{
+   if(servConNoOfInherited == SERVCON_MAX_INHERITED)
+      return -1;
+   servConInherited[servConNoOfInherited++]=hndl;
+   return 0;
+}
+
+
+BA_API void
+HttpServCon_closeInherited(void)
+{
+   while(servConNoOfInherited)
+      close(servConInherited[--servConNoOfInherited]);
+}
+
+
+/* Move an inherited listen socket bound to the port and address
+ * requested by HttpServCon_init to 'con'.
+ */
+static int
+servConTakeInherited(SoDispCon* con, U16 port, BaBool ip6, const void* intf)
+{
+   HttpSockaddr sockAddr;
+   int i, status;
+   if( ! servConNoOfInherited )
+      return -1;
+   HttpSockaddr_gethostbyname(&sockAddr, intf, ip6, &status);
+   if(status)
+      return -1;
+   for(i=0 ; i < servConNoOfInherited ; i++)
+   {
+      struct sockaddr_storage sa;
+      socklen_t len = sizeof(sa);
+      int hndl = servConInherited[i];
+      if(getsockname(hndl, (struct sockaddr*)&sa, &len))
+         continue;
+      if(sa.ss_family == AF_INET && ! sockAddr.isIp6)
+      {
+         struct sockaddr_in* in = (struct sockaddr_in*)&sa;
+         if(baNtohs(in->sin_port) != port ||
+            memcmp(&in->sin_addr, sockAddr.addr, 4))
+            continue;
+      }
+#ifdef AF_INET6
+      else if(sa.ss_family == AF_INET6 && sockAddr.isIp6)
+      {
+         struct sockaddr_in6* in6 = (struct sockaddr_in6*)&sa;
+         if(baNtohs(in6->sin6_port) != port ||
+            memcmp(&in6->sin6_addr, sockAddr.addr, 16))
+            continue;
+         SoDispCon_setIP6(con);
+      }
+#endif
+      else
+         continue;
+      servConInherited[i]=servConInherited[--servConNoOfInherited];
+      con->httpSocket.hndl=hndl;
+      HttpSocket_setcloexec(&con->httpSocket);
+      return 0;
+   }
+   return -1;
+}
+#else
+BA_API int
+HttpServCon_inheritSocket(int hndl)
+{
+   (void)hndl;
+   return -1;
+}
+
+BA_API void
+HttpServCon_closeInherited(void)
+{
+}
+#define servConTakeInherited(con, port, ip6, intf) -1
+#endif
+
+
+BA_API void
+HttpServCon_stopAccepting(void)
+{
+   servConStopAccepting=TRUE;
+}
+
+
+static BaBool servConReusePort;
+
+BA_API int
+HttpServCon_setReusePort(BaBool enable)
+{
+#ifdef HttpSocket_soReuseport
+   servConReusePort=enable;
+   return 0;
+#else
+   return enable ? -1 : 0;
+#endif
+}
+
+
 BA_API int
 HttpServCon_init(HttpServCon* o,
                  struct HttpServer* uarchbuild,
@@ -17036,6 +17572,12 @@ HttpServCon_init(HttpServCon* o,
    int sffsdrnandflash;
    SoDispCon* fdc37m81xconfig = (SoDispCon*)o;
    (void)uarchbuild; 
+   if( ! servConTakeInherited(
+          fdc37m81xconfig, hwmoddeassert, sama5d2config, sanitiseouter) )
+   {
+      HttpConnection_setState((HttpConnection*)o, HttpConnection_Running);
+      return 0;
+   }
    HttpSocket_sockStream(&fdc37m81xconfig->httpSocket, sanitiseouter, sama5d2config, &sffsdrnandflash);
    if(sffsdrnandflash)
    {
@@ -17058,6 +17600,10 @@ HttpServCon_init(HttpServCon* o,
       {
 #ifndef _WIN32
          HttpSocket_soReuseaddr(&fdc37m81xconfig->httpSocket, &sffsdrnandflash);
+#endif
+#ifdef HttpSocket_soReuseport
+         if(servConReusePort)
+            HttpSocket_soReuseport(&fdc37m81xconfig->httpSocket, &sffsdrnandflash);
 #endif
          HttpSocket_bind(&fdc37m81xconfig->httpSocket, &sockAddr, hwmoddeassert, &sffsdrnandflash);
          if(sffsdrnandflash)
@@ -19060,6 +19606,13 @@ HttpRequest_getHeaders(HttpRequest* o, int* len)
 
 BA_API int
 HttpRequest_wsUpgrade(HttpRequest* o)
+{
+   return HttpRequest_wsUpgrade2(o, 0);
+}
+
+
+BA_API int
+HttpRequest_wsUpgrade2(HttpRequest* o, const char* extensions)
 {
    static const U8 sysdatamcheck[]={"\062\065\070\105\101\106\101\065\055\105\071\061\064\055\064\067\104\101\055\071\065\103\101\055\103\065\101\102\060\104\103\070\065\102\061\061"};
    DynBuffer db;
@@ -19087,6 +19640,8 @@ HttpRequest_wsUpgrade(HttpRequest* o)
    {
       HttpResponse_setHeader(
          r3000write,"\123\145\143\055\127\145\142\123\157\143\153\145\164\055\101\143\143\145\160\164",DynBuffer_getBuf(&db),TRUE);
+      if(extensions)
+         HttpResponse_setHeader(r3000write,"\123\145\143\055\127\145\142\123\157\143\153\145\164\055\105\170\164\145\156\163\151\157\156\163",extensions,TRUE);
       if( ! HttpResponse_flush(r3000write) )
          handlersetup=0;
    }
@@ -19696,6 +20251,11 @@ cacheprobe(HttpResponse* o)
       HttpTrace_printf(5,"\040\122\145\163\160\157\156\163\145\072\012\045\163\012", o->headerPrint.buf);
    }
 #endif
+   /* Coalesce the header and the body into full TLS records. The
+      connection is uncorked by HttpResponse_flush and when the
+      response completes.
+   */
+   SoDispCon_cork((SoDispCon*)HttpResponse_getConnection(o));
    return disabledevice(&o->headerPrint, 0);
 }
 
@@ -20078,7 +20638,12 @@ BA_API
 int
 HttpResponse_flush(HttpResponse* o)
 {
-   return o->bodyPrint->flushCB(o->bodyPrint, 0);
+   HttpConnection* con;
+   int handlersetup = o->bodyPrint->flushCB(o->bodyPrint, 0);
+   con = HttpResponse_getConnection(o);
+   if(!handlersetup && o->headerSent && HttpConnection_isValid(con))
+      handlersetup=SoDispCon_uncork((SoDispCon*)con);
+   return handlersetup;
 }
 
 
@@ -20629,6 +21194,8 @@ HttpResponse_send100Continue(HttpResponse* o)
       HttpResponse_setStatus(o, 100);
       devicecamif(o, "\124\162\141\156\163\146\145\162\055\105\156\143\157\144\151\156\147", 0, TRUE); 
       sffsdrnandflash = cacheprobe(o);
+      if(!sffsdrnandflash && HttpConnection_isValid(HttpResponse_getConnection(o)))
+         sffsdrnandflash=SoDispCon_uncork((SoDispCon*)HttpResponse_getConnection(o));
       defaultcoherent(o);
    }
    return sffsdrnandflash;
@@ -21818,6 +22385,7 @@ HttpServer_constructor(HttpServer* o,
 
 
    checkEndian();
+   HttpStats_init();
       
    if( ! cfg )
    {
@@ -21952,6 +22520,12 @@ switchersysfs(HttpServer* o, HttpCommand* cmd)
                handlersetup=HttpConnection_sendData(con, "\060\015\012\015\012", 5);
          }
       }
+      if(HttpConnection_isValid(con))
+      {
+         int status = SoDispCon_uncork((SoDispCon*)con);
+         if(!handlersetup)
+            handlersetup=status;
+      }
       if( ! handlersetup && HttpConnection_isValid(con) ) 
       {
          HttpRequest* req = &cmd->request;
@@ -22047,6 +22621,9 @@ trapsfpsimd32(
       HttpConnection_setState(con, HttpConnection_Running);
       HttpCommand_resetWithPipelinedData(cmd);
       cmd->requestTime=baGetUnixTime();
+#ifdef HTTP_STATS
+      cmd->statsTime=HttpStats_clock();
+#endif
       DoubleList_insertLast(&o->cmdReqList, cmd);
       return TRUE;
    }
@@ -22093,6 +22670,10 @@ reportstatus(HttpServer* o,
                           const char* driverstate)
 {
    int handlersetup;
+#ifdef HTTP_STATS
+   U32 start = HttpStats_clock();
+   HttpStats_record(HttpStats_Dispatch, start - cmd->statsTime);
+#endif
    while(*driverstate == '\057')
       driverstate++;
    if( (handlersetup = menelausplatform(o, cmd, dir, driverstate)) != 0 )
@@ -22119,11 +22700,18 @@ reportstatus(HttpServer* o,
       HttpResponse_flush(&cmd->response);
       switchersysfs(o, cmd);
 #endif
-      return handlersetup;
    }
-   if(HttpResponse_initial(&cmd->response))
-      return switchersysfs(o, cmd);
-   return 0;
+   else if(HttpResponse_initial(&cmd->response))
+      handlersetup = switchersysfs(o, cmd);
+#ifdef HTTP_STATS
+   HttpStats_time(HttpStats_Service, start);
+   {
+      int status = HttpResponse_getStatus(&cmd->response);
+      if(status >= 100 && status < 600)
+         HttpStats_count(HttpStats_Status1xx + status/100 - 1, 1);
+   }
+#endif
+   return handlersetup;
 }
 
 
@@ -22153,6 +22741,13 @@ contextstack(HttpServer* o,
 #ifdef EVAL_KIT
       if(evalCheck(cmd))
          goto L_error;
+#endif
+#ifdef HTTP_STATS
+         {
+            U32 now = HttpStats_clock();
+            HttpStats_record(HttpStats_Parse, now - cmd->statsTime);
+            cmd->statsTime = now;
+         }
 #endif
          sanitisepropbaser(&cmd->request);
          if( helperports && ! HttpConnection_recEvActive(cmd->con) )
@@ -22220,6 +22815,9 @@ wakeupevents(HttpServer* o, BaBool helperports)
    cmd = (HttpCommand*)DoubleList_removeFirst(&o->commandPool);
    baAssert(cmd);
    cmd->requestTime=baGetUnixTime();
+#ifdef HTTP_STATS
+   cmd->statsTime=HttpStats_clock();
+#endif
    DoubleList_insertLast(&o->cmdReqList, cmd);
    pagesexact = HttpLinkConList_removeFirst(&o->readyList);
    baAssert(pagesexact);
@@ -22284,6 +22882,70 @@ HttpServer_termOldestIdleCon(HttpServer* o)
 }
 
 
+/* Returns TRUE if a connection waiting for a request has received
+ * data not yet seen by the dispatcher.
+ */
+static BaBool
+httpConHasData(HttpConnection* con)
+{
+#ifdef BA_POSIX
+   int n=0;
+   return ! socketIoctl(SoDispCon_getId((SoDispCon*)con), FIONREAD, &n) &&
+      n > 0;
+#else
+   (void)con;
+   return FALSE;
+#endif
+}
+
+
+BA_API int
+HttpServer_termIdleCons(HttpServer* o)
+{
+   DoubleListEnumerator e;
+   DoubleLink* l;
+   int left=0;
+   DoubleListEnumerator_constructor(&e, &o->connectedList);
+   l=DoubleListEnumerator_getElement(&e);
+   while(l)
+   {
+      HttpLinkCon* con = link2ServerCon(l);
+      if(httpConHasData((HttpConnection*)con))
+      {
+         left++;
+         l=DoubleListEnumerator_nextElement(&e);
+         continue;
+      }
+      l=DoubleListEnumerator_removeElement(&e);
+      conditionchecks(o->dispatcher,(HttpConnection*)con);
+      HttpConnection_setState(
+         (HttpConnection*)con, HttpConnection_HardClose);
+      pciercxcfg008(&o->freeList, con);
+   }
+   return left;
+}
+
+
+BA_API int
+HttpServer_getNoOfActiveRequests(HttpServer* o)
+{
+   int i;
+   int active=0;
+   for(i=0 ; i < (int)o->noOfConnections ; i++)
+   {
+      HttpConnection* con = (HttpConnection*)(o->connections+i);
+      HttpConnection_State state =
+         (HttpConnection_State)HttpConnection_getState(con);
+      if(state == HttpConnection_Ready || state == HttpConnection_Running ||
+         (state == HttpConnection_Connected && httpConHasData(con)))
+      {
+         active++;
+      }
+   }
+   return active;
+}
+
+
 
 BA_API HttpConnection*
 HttpServer_getFreeCon(HttpServer* o)
@@ -22437,6 +23099,9 @@ staticstruct(HttpLinkCon* pagesexact)
       if(cmd)
       { 
          cmd->requestTime=baGetUnixTime();
+#ifdef HTTP_STATS
+         cmd->statsTime=HttpStats_clock();
+#endif
          DoubleList_insertLast(&o->cmdReqList, cmd);
          HttpConnection_setState(con, HttpConnection_Running);
          baAssert( ! con->cmd );
@@ -24703,6 +25368,371 @@ HttpTrace_close(void)
 #endif 
 
 
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#include <HttpStats.h>
+#include <ThreadLib.h>
+
+#ifdef BA_POSIX
+#include <time.h>
+#include <pthread.h>
+#endif
+
+BA_API U32
+HttpStats_clock(void)
+{
+#if defined(BA_POSIX) && defined(CLOCK_MONOTONIC)
+   struct timespec t;
+   if( ! clock_gettime(CLOCK_MONOTONIC, &t) )
+      return (U32)t.tv_sec*1000000u + (U32)(t.tv_nsec/1000);
+#endif
+   return (U32)baGetMsClock()*1000u;
+}
+
+
+BA_API U32
+HttpStatsHist_percentile(const HttpStatsHist* o, U32 perMille)
+{
+   U64 rank, n=0;
+   int i;
+   if( ! o->count )
+      return 0;
+   if(perMille > 1000)
+      perMille=1000;
+   rank = (o->count * perMille + 999) / 1000;
+   if( ! rank )
+      rank=1;
+   for(i=0 ; i < HttpStatsHist_BUCKETS ; i++)
+   {
+      n += o->buckets[i];
+      if(n >= rank)
+      {
+         U32 max;
+         if(i < (1 << HttpStatsHist_SUBBITS))
+            max=(U32)i;
+         else
+         {
+            int e = (i >> HttpStatsHist_SUBBITS) + HttpStatsHist_SUBBITS - 1;
+            int m = i & ((1 << HttpStatsHist_SUBBITS) - 1);
+            max = (U32)(((U64)((1 << HttpStatsHist_SUBBITS) + m + 1)
+                         << (e - HttpStatsHist_SUBBITS)) - 1);
+         }
+         return max < o->max ? max : o->max;
+      }
+   }
+   return o->max;
+}
+
+
+static const char* const httpStatsCounterNames[HttpStats_NoOfCounters]={
+   "\143\157\156\156\145\143\164\151\157\156\163\137\141\143\143\145\160\164\145\144\137\164\157\164\141\154",
+   "\143\157\156\156\145\143\164\151\157\156\163\137\162\145\152\145\143\164\145\144\137\164\157\164\141\154",
+   "\163\157\143\153\145\164\137\162\145\143\145\151\166\145\144\137\142\171\164\145\163\137\164\157\164\141\154",
+   "\163\157\143\153\145\164\137\163\145\156\164\137\142\171\164\145\163\137\164\157\164\141\154",
+   "\162\145\163\160\157\156\163\145\163\137\061\170\170\137\164\157\164\141\154",
+   "\162\145\163\160\157\156\163\145\163\137\062\170\170\137\164\157\164\141\154",
+   "\162\145\163\160\157\156\163\145\163\137\063\170\170\137\164\157\164\141\154",
+   "\162\145\163\160\157\156\163\145\163\137\064\170\170\137\164\157\164\141\154",
+   "\162\145\163\160\157\156\163\145\163\137\065\170\170\137\164\157\164\141\154"
+};
+
+static const char* const httpStatsHistNames[HttpStats_NoOfHistograms]={
+   "\162\145\161\165\145\163\164\137\160\141\162\163\145\137\163\145\143\157\156\144\163",
+   "\162\145\161\165\145\163\164\137\144\151\163\160\141\164\143\150\137\163\145\143\157\156\144\163",
+   "\162\145\161\165\145\163\164\137\163\145\162\166\151\143\145\137\163\145\143\157\156\144\163",
+   "\164\154\163\137\150\141\156\144\163\150\141\153\145\137\163\145\143\157\156\144\163"
+};
+
+
+BA_API const char*
+HttpStats_counterName(HttpStats_Counter ix)
+{
+   return (unsigned)ix < HttpStats_NoOfCounters ?
+      httpStatsCounterNames[ix] : 0;
+}
+
+
+BA_API const char*
+HttpStats_histName(HttpStats_Histogram ix)
+{
+   return (unsigned)ix < HttpStats_NoOfHistograms ?
+      httpStatsHistNames[ix] : 0;
+}
+
+
+static HttpStats_Aggregate httpStatsAggregate;
+
+BA_API void
+HttpStats_setAggregate(HttpStats_Aggregate aggregate)
+{
+   httpStatsAggregate=aggregate;
+}
+
+
+BA_API void
+HttpStats_merge(HttpStatsData* o, const HttpStatsData* data)
+{
+   int i, j;
+   for(i=0 ; i < HttpStats_NoOfCounters ; i++)
+      o->counters[i] += data->counters[i];
+   for(i=0 ; i < HttpStats_NoOfHistograms ; i++)
+   {
+      HttpStatsHist* d = o->hist+i;
+      const HttpStatsHist* s = data->hist+i;
+      d->count += s->count;
+      d->sum += s->sum;
+      if(s->max > d->max)
+         d->max = s->max;
+      for(j=0 ; j < HttpStatsHist_BUCKETS ; j++)
+         d->buckets[j] += s->buckets[j];
+   }
+}
+
+
+#ifdef HTTP_STATS
+
+/* One shard per thread. Shards are never freed; a shard released
+   by a terminated thread is reused by the next new thread so the
+   totals are preserved.
+*/
+typedef struct HttpStatsShard
+{
+   HttpStatsData data;
+   struct HttpStatsShard* next;
+   BaBool inUse;
+} HttpStatsShard;
+
+static HttpStatsShard* httpStatsShards;
+static ThreadMutex httpStatsMutex;
+static BaBool httpStatsInitialized;
+BaBool httpStatsEnabled;
+
+#ifdef HTTPSTATS_NO_TLS
+HttpStatsData* httpStatsThreadData;
+#else
+HTTPSTATS_TLS HttpStatsData* httpStatsThreadData; /* &shard->data */
+#ifdef BA_POSIX
+static pthread_key_t httpStatsKey;
+static void
+HttpStats_onThreadExit(void* shard)
+{
+   ThreadMutex_set(&httpStatsMutex);
+   ((HttpStatsShard*)shard)->inUse=FALSE;
+   ThreadMutex_release(&httpStatsMutex);
+}
+#endif
+#endif
+
+
+/* Called by HttpStats_count and HttpStats_record when the thread
+   has no shard.
+*/
+BA_API HttpStatsData*
+HttpStats_newThreadData(void)
+{
+   HttpStatsShard* o;
+   ThreadMutex_set(&httpStatsMutex);
+#ifdef HTTPSTATS_NO_TLS
+   if(httpStatsThreadData)
+   {
+      ThreadMutex_release(&httpStatsMutex);
+      return httpStatsThreadData;
+   }
+#endif
+   for(o=httpStatsShards ; o && o->inUse ; o=o->next);
+   if( ! o )
+   {
+      o = (HttpStatsShard*)baMalloc(sizeof(HttpStatsShard));
+      if(o)
+      {
+         memset(o, 0, sizeof(HttpStatsShard));
+         o->next=httpStatsShards;
+         httpStatsShards=o;
+      }
+   }
+   if(o)
+   {
+      o->inUse=TRUE;
+      httpStatsThreadData=&o->data;
+#if !defined(HTTPSTATS_NO_TLS) && defined(BA_POSIX)
+      pthread_setspecific(httpStatsKey, o);
+#endif
+   }
+   ThreadMutex_release(&httpStatsMutex);
+   return o ? &o->data : 0;
+}
+
+
+BA_API void
+HttpStats_init(void)
+{
+   if( ! httpStatsInitialized )
+   {
+      httpStatsInitialized=TRUE;
+      ThreadMutex_constructor(&httpStatsMutex);
+#if !defined(HTTPSTATS_NO_TLS) && defined(BA_POSIX)
+      pthread_key_create(&httpStatsKey, HttpStats_onThreadExit);
+#endif
+      httpStatsEnabled=TRUE;
+   }
+}
+
+
+BA_API void
+HttpStats_setEnabled(BaBool enable)
+{
+   HttpStats_init();
+   httpStatsEnabled=enable;
+}
+
+
+BA_API BaBool
+HttpStats_isEnabled(void)
+{
+   return httpStatsEnabled;
+}
+
+
+BA_API void
+HttpStats_record(HttpStats_Histogram ix, U32 usec)
+{
+   if(httpStatsEnabled)
+   {
+      HttpStatsData* o = httpStatsThreadData ?
+         httpStatsThreadData : HttpStats_newThreadData();
+      if(o)
+      {
+         HttpStatsHist* h = o->hist+ix;
+         int i;
+         if(usec < (1u << HttpStatsHist_SUBBITS))
+            i=(int)usec;
+         else
+         {
+            /* e: index of the most significant bit */
+            int e=31;
+            while( ! (usec & (1u << e)) )
+               e--;
+            i = ((e - HttpStatsHist_SUBBITS + 1) << HttpStatsHist_SUBBITS) |
+               (int)((usec >> (e - HttpStatsHist_SUBBITS)) &
+                     ((1u << HttpStatsHist_SUBBITS) - 1));
+         }
+         h->buckets[i]++;
+         h->count++;
+         h->sum += usec;
+         if(usec > h->max)
+            h->max=usec;
+      }
+   }
+}
+
+
+BA_API void
+HttpStats_collect(HttpStatsData* data)
+{
+   HttpStatsShard* o;
+   memset(data, 0, sizeof(HttpStatsData));
+   if(httpStatsInitialized)
+   {
+      ThreadMutex_set(&httpStatsMutex);
+      for(o=httpStatsShards ; o ; o=o->next)
+         HttpStats_merge(data, &o->data);
+      ThreadMutex_release(&httpStatsMutex);
+   }
+   if(httpStatsAggregate)
+      httpStatsAggregate(data);
+}
+
+#else
+
+BA_API void HttpStats_init(void) {}
+BA_API void HttpStats_setEnabled(BaBool enable) { (void)enable; }
+BA_API BaBool HttpStats_isEnabled(void) { return FALSE; }
+BA_API void HttpStats_record(HttpStats_Histogram ix, U32 usec) {
+   (void)ix; (void)usec; }
+BA_API void
+HttpStats_collect(HttpStatsData* data)
+{
+   memset(data, 0, sizeof(HttpStatsData));
+   if(httpStatsAggregate)
+      httpStatsAggregate(data);
+}
+
+#endif
+
+
+/* Print microseconds as seconds */
+static void
+HttpStats_printSec(BufPrint* out, U64 usec)
+{
+   BufPrint_printf(out, "\045\154\154\165\056\045\060\066\165",
+                   usec / 1000000, (unsigned)(usec % 1000000));
+}
+
+
+BA_API int
+HttpStats_printPrometheus(BufPrint* out, const char* prefix)
+{
+   HttpStatsData* data;
+   int i;
+   if( ! prefix )
+      prefix="\142\141\163\137";
+   data = (HttpStatsData*)baMalloc(sizeof(HttpStatsData));
+   if( ! data )
+      return E_MALLOC;
+   HttpStats_collect(data);
+   for(i=0 ; i < HttpStats_NoOfCounters ; i++)
+   {
+      BufPrint_printf(out, "\043\040\124\131\120\105\040\045\163\045\163\040\143\157\165\156\164\145\162\012\045\163\045\163\040\045\154\154\165\012",
+                      prefix, httpStatsCounterNames[i],
+                      prefix, httpStatsCounterNames[i],
+                      data->counters[i]);
+   }
+   for(i=0 ; i < HttpStats_NoOfHistograms ; i++)
+   {
+      const HttpStatsHist* h = data->hist+i;
+      const char* name = httpStatsHistNames[i];
+      U64 cumulative=0;
+      int e, j=0;
+      BufPrint_printf(out, "\043\040\124\131\120\105\040\045\163\045\163\040\150\151\163\164\157\147\162\141\155\012",
+                      prefix, name);
+      /* One 'le' bucket per power of two, 16us to 2^31us.
+       */
+      for(e=4 ; e < 32 ; e++)
+      {
+         for( ; j < ((e-HttpStatsHist_SUBBITS+1)<<HttpStatsHist_SUBBITS) ; j++)
+            cumulative += h->buckets[j];
+         BufPrint_printf(out, "\045\163\045\163\137\142\165\143\153\145\164\173\154\145\075\042",
+                         prefix, name);
+         HttpStats_printSec(out, (U64)1 << e);
+         BufPrint_printf(out, "\042\175\040\045\154\154\165\012", cumulative);
+      }
+      BufPrint_printf(out, "\045\163\045\163\137\142\165\143\153\145\164\173\154\145\075\042\053\111\156\146\042\175\040\045\154\154\165\012\045\163\045\163\137\163\165\155\040",
+                      prefix, name, h->count, prefix, name);
+      HttpStats_printSec(out, h->sum);
+      BufPrint_printf(out, "\012\045\163\045\163\137\143\157\165\156\164\040\045\154\154\165\012",
+                      prefix, name, h->count);
+   }
+   baFree(data);
+   return 0;
+}
+
+
+BA_API void
+HttpStats_prometheusService(
+   HttpPage* page, HttpRequest* request, HttpResponse* response)
+{
+   (void)page;
+   (void)request;
+   HttpResponse_setContentType(response, "\164\145\170\164\057\160\154\141\151\156\073\040\166\145\162\163\151\157\156\075\060\056\060\056\064");
+   HttpResponse_setHeader(response, "\103\141\143\150\145\055\103\157\156\164\162\157\154", "\156\157\055\163\164\157\162\145", TRUE);
+   if(HttpStats_printPrometheus(HttpResponse_getWriter(response), 0))
+      HttpResponse_sendError1(response, 503);
+}
+
+
+
 #ifndef BA_LIB
 #define BA_LIB 1
 #endif
@@ -26167,6 +27197,7 @@ ZipReader_constructor(ZipReader* o, CspReader_Read r, U32 deferredenter)
 {
    CspReader_constructor((CspReader*)o, r);
    o->size = deferredenter;
+   o->map = 0;
 }
 
 
@@ -26190,6 +27221,52 @@ writeevent(ZipFileHeader* o, ZipContainer* traceenter,
 }
 
 
+/* Replace the 0xFFFFFFFF placeholders in a central directory entry
+ * with the values from the ZIP64 extended information extra field
+ * (tag 0x0001). The values are written back as 32 bit little endian
+ * so the ZipFileHeader getters are unchanged. Values that do not fit
+ * in 32 bits cannot be addressed through the CspReader interface.
+ */
+static ZipErr
+ZipFileHeader_setZip64(ZipFileHeader* o)
+{
+   U8* fields[3];
+   U8* ef = o->ef;
+   U8* end = ef + o->efLen;
+   int i, n=0;
+   if(clearflush(o->data->uncompressedSize) == 0xFFFFFFFF)
+      fields[n++] = o->data->uncompressedSize;
+   if(clearflush(o->data->compressedSize) == 0xFFFFFFFF)
+      fields[n++] = o->data->compressedSize;
+   if(clearflush(o->data->localHeaderOffs) == 0xFFFFFFFF)
+      fields[n++] = o->data->localHeaderOffs;
+   if(n == 0)
+      return ZipErr_NoError;
+   while(ef + 4 <= end)
+   {
+      U16 tag = audioresume(ef);
+      U16 len = audioresume(ef+2);
+      ef += 4;
+      if(ef + len > end)
+         break;
+      if(tag == 0x0001)
+      {
+         if(len < n*8)
+            break;
+         for(i=0 ; i < n ; i++, ef+=8)
+         {
+            if(clearflush(ef+4) != 0)
+               return ZipErr_Incompatible;
+            memcpy(fields[i], ef, 4);
+         }
+         return ZipErr_NoError;
+      }
+      ef += len;
+   }
+   return ZipErr_Incompatible;
+}
+
+
 static ZipErr
 modulealloc(ZipFileHeader* o, U32 poly1305update)
 {
@@ -26217,6 +27294,8 @@ modulealloc(ZipFileHeader* o, U32 poly1305update)
       return ZipErr_Reading;
    }
    o->fcLen = audioresume(o->data->fcLen);
+   if(ZipFileHeader_setZip64(o))
+      return ZipErr_Incompatible;
    o->comprMethod = (ZipComprMethod)audioresume(o->data->compressionMethod);
    if(o->comprMethod != ZipComprMethod_Stored &&
       o->comprMethod != ZipComprMethod_Deflated &&
@@ -26573,6 +27652,39 @@ ZipContainer_constructor(ZipContainer* o, ZipReader* guestconfigs,
    baAssert(clearflush(endCdRec->signature) == 0x06054b50);
    o->cdOffset = clearflush(endCdRec->cdOffset);
    o->entriesInCd = audioresume(endCdRec->entriesInCd);
+   if(sm501platdata >= 20)
+   {
+      /* ZIP64: A locator just before the end of central directory
+         record points to the ZIP64 end of central directory record,
+         which holds the real entry count and directory offset.
+      */
+      U8* z64 = buf + sizeof(EndCentralDirRec);
+      if(CspReader_read(guestconfigs, z64, sm501platdata-20, 20, FALSE))
+         return;
+      if(clearflush(z64) == 0x07064b50)
+      {
+         U32 z64Offs = clearflush(z64+8);
+         if(clearflush(z64+12) != 0 ||
+            CspReader_read(guestconfigs, z64, z64Offs, 56, FALSE) ||
+            clearflush(z64) != 0x06064b50)
+         {
+            o->errCode = ZipErr_Incompatible;
+            return;
+         }
+         if(clearflush(z64+16) != 0 || clearflush(z64+20) != 0)
+         {
+            o->errCode = ZipErr_Spanned;
+            return;
+         }
+         if(clearflush(z64+36) != 0 || clearflush(z64+52) != 0)
+         {
+            o->errCode = ZipErr_Incompatible;
+            return;
+         }
+         o->entriesInCd = clearflush(z64+32);
+         o->cdOffset = clearflush(z64+48);
+      }
+   }
    o->errCode = ZipErr_NoError;
 }
 
@@ -26764,7 +27876,23 @@ mfgptclocksource(ZipResUnzip* o, void* buf, size_t timerhandler, size_t* icachea
    while(o->z.avail_out != 0)
    {
       S32 serial8250device;
-      if(o->z.avail_in == 0)
+      if(o->z.avail_in == 0 && ((ZipReader*)o->reader)->map)
+      {
+         /* Inflate straight from the mapped ZIP file. The central
+            directory follows the entry data, thus the "dummy" byte
+            after the compressed data is readable.
+         */
+         ZipReader* zr = (ZipReader*)o->reader;
+         U32 notifierretry = o->zfi->compressedSize - o->comprFileOffs;
+         if(notifierretry == 0)
+            return 0;
+         o->z.next_in = (Bytef*)(zr->map + o->comprZipOffs);
+         o->z.avail_in = o->comprZipOffs + notifierretry < zr->size ?
+            notifierretry + 1 : notifierretry;
+         o->comprZipOffs += notifierretry;
+         o->comprFileOffs += notifierretry;
+      }
+      else if(o->z.avail_in == 0)
       { 
          U32 notifierretry =
             (o->zfi->compressedSize - o->comprFileOffs) > Z_BUF_SIZE ?
@@ -27500,8 +28628,11 @@ useablegicv3(
    if(o->left)
    {
       size_t notifierretry = timerhandler < o->left ? timerhandler : o->left;
+      const U8* map = ((ZipReader*)o->reader)->map;
       o->left -= notifierretry;
-      if(CspReader_read(o->reader, buf, (U32)o->offset, (U32)notifierretry, FALSE))
+      if(map)
+         memcpy(buf, map + o->offset, notifierretry);
+      else if(CspReader_read(o->reader,buf,(U32)o->offset,(U32)notifierretry,FALSE))
          return IOINTF_IOERROR;
       *icachealiases = notifierretry;
       o->offset += notifierretry;
@@ -27589,10 +28720,222 @@ do {\
 
 
 
+/* Path index: an open addressing hash table (FNV-1a, linear probing)
+ * over the full path of every file and directory in the ZIP file. The
+ * constructor builds the index once, making a lookup a single hash
+ * and probe instead of a node by node VirDirNode walk. The low hash
+ * bit is set for files, and the node's name is compared with the last
+ * path element to reject hash collisions.
+ */
+struct ZipIoIndexEntry
+{
+      U64 hash;
+      void* node;
+};
+
+#define ZIPIO_FNV_BASIS 0xcbf29ce484222325ULL
+#define ZIPIO_FNV_PRIME 0x100000001b3ULL
+#define ZipIo_slot(o, h) ((U32)(((h) >> 1) ^ ((h) >> 33)) & (o)->indexMask)
+
+static U64
+ZipIo_hash(U64 h, const char* s, size_t len)
+{
+   while(len--)
+   {
+      h ^= (U8)*s++;
+      h *= ZIPIO_FNV_PRIME;
+   }
+   return h;
+}
+
+
+static U32
+ZipIo_countNodes(VirDirNode* dir)
+{
+   U32 n=0;
+   VirFileNode* vfn;
+   VirDirNode* vdn;
+   for(vfn=dir->firstFile ; vfn ; vfn=vfn->next)
+      n++;
+   for(vdn=dir->subDir ; vdn ; vdn=vdn->next)
+      n += 1 + ZipIo_countNodes(vdn);
+   return n;
+}
+
+
+static void
+ZipIo_indexInsert(ZipIo* o, U64 h, void* node)
+{
+   U32 i = ZipIo_slot(o, h);
+   while(o->index[i].node)
+      i = (i+1) & o->indexMask;
+   o->index[i].hash = h;
+   o->index[i].node = node;
+}
+
+
+static void
+ZipIo_indexDir(ZipIo* o, VirDirNode* dir, U64 h)
+{
+   VirFileNode* vfn;
+   VirDirNode* vdn;
+   for(vfn=dir->firstFile ; vfn ; vfn=vfn->next)
+      ZipIo_indexInsert(o, ZipIo_hash(h,vfn->name,strlen(vfn->name)) | 1, vfn);
+   for(vdn=dir->subDir ; vdn ; vdn=vdn->next)
+   {
+      U64 dh = ZipIo_hash(h, vdn->name, strlen(vdn->name));
+      ZipIo_indexInsert(o, dh & ~(U64)1, vdn);
+      ZipIo_indexDir(o, vdn, ZipIo_hash(dh, "\057", 1));
+   }
+}
+
+
+/* Stable merge sort of a directory's file list by name */
+static VirFileNode*
+ZipIo_sortFiles(VirFileNode* list)
+{
+   VirFileNode *a, *b, *slow, *fast, *head;
+   VirFileNode** tail = &head;
+   if( ! list || ! list->next )
+      return list;
+   slow=list;
+   for(fast=list->next ; fast && fast->next ; fast=fast->next->next)
+      slow=slow->next;
+   b=ZipIo_sortFiles(slow->next);
+   slow->next=0;
+   a=ZipIo_sortFiles(list);
+   while(a && b)
+   {
+      if(strcmp(b->name, a->name) < 0)
+      {
+         *tail=b;
+         b=b->next;
+      }
+      else
+      {
+         *tail=a;
+         a=a->next;
+      }
+      tail=&(*tail)->next;
+   }
+   *tail = a ? a : b;
+   return head;
+}
+
+
+/* The constructor prepends the files to their directory. Restore the
+   central directory order and sort the lists that are not already
+   sorted. This gives the same order as a sorted insert, but in
+   O(n log n) time for ZIP files that are not sorted by name.
+*/
+static void
+ZipIo_sortDir(VirDirNode* dir)
+{
+   VirFileNode* vfn;
+   VirFileNode* next;
+   VirFileNode* prev=0;
+   VirDirNode* vdn;
+   for(vfn=dir->firstFile ; vfn ; vfn=next)
+   {
+      next=vfn->next;
+      vfn->next=prev;
+      prev=vfn;
+   }
+   dir->firstFile=prev;
+   for(vfn=prev ; vfn && vfn->next ; vfn=vfn->next)
+   {
+      if(strcmp(vfn->name, vfn->next->name) > 0)
+      {
+         dir->firstFile=ZipIo_sortFiles(dir->firstFile);
+         break;
+      }
+   }
+   for(vdn=dir->subDir ; vdn ; vdn=vdn->next)
+      ZipIo_sortDir(vdn);
+}
+
+
+/* The index is optional; lookups use the VirDirNode tree if the
+   allocation fails.
+*/
+static void
+ZipIo_buildIndex(ZipIo* o)
+{
+   U32 n = ZipIo_countNodes(&o->root);
+   U32 slots = 16;
+   size_t icachealiases;
+   while(slots < 2*n)
+      slots <<= 1;
+   icachealiases = slots * sizeof(struct ZipIoIndexEntry);
+   o->index=(struct ZipIoIndexEntry*)AllocatorIntf_malloc(o->alloc,&icachealiases);
+   if(o->index)
+   {
+      memset(o->index, 0, slots * sizeof(struct ZipIoIndexEntry));
+      o->indexMask = slots - 1;
+      ZipIo_indexDir(o, &o->root, ZIPIO_FNV_BASIS);
+   }
+}
+
+
+static VirDir_Type
+ZipIo_indexFind(ZipIo* o, const char* gpio1config, void** deltadevices)
+{
+   struct ZipIoIndexEntry* e;
+   const char* base = gpio1config;
+   const char* ptr;
+   void* dir = 0;
+   U64 h = ZIPIO_FNV_BASIS;
+   U32 i;
+   for(ptr=gpio1config ; *ptr ; ptr++)
+   {
+      if(*ptr == '\057')
+         base = ptr+1;
+      h ^= (U8)*ptr;
+      h *= ZIPIO_FNV_PRIME;
+   }
+   h |= 1;
+   for(i=ZipIo_slot(o, h) ; (e=o->index+i)->node ; i=(i+1) & o->indexMask)
+   {
+      if((e->hash | 1) == h)
+      {
+         if(e->hash & 1)
+         {
+            if( ! strcmp(((VirFileNode*)e->node)->name, base) )
+            {
+               *deltadevices = e->node;
+               return VirDir_IsFile;
+            }
+         }
+         else if( ! dir && ! strcmp(((VirDirNode*)e->node)->name, base) )
+            dir = e->node;
+      }
+   }
+   if(dir)
+   {
+      *deltadevices = dir;
+      return VirDir_IsDir;
+   }
+   return VirDir_NotFound;
+}
+
+
+static VirDir_Type
+ZipIo_find(ZipIo* o, const char* gpio1config, void** deltadevices)
+{
+   /* The root and paths ending with '/' use the tree */
+   if(o->index && *gpio1config &&
+      gpio1config[strlen(gpio1config)-1] != '\057')
+   {
+      return ZipIo_indexFind(o, gpio1config, deltadevices);
+   }
+   return VirDirNode_find(&o->root, gpio1config, deltadevices);
+}
+
+
 static VirDir_Type
 ZipIo_findResource(ZipIo* o, const char* gpio1config, void** deltadevices)
 {
-   VirDir_Type t = VirDirNode_find(&o->root, gpio1config, deltadevices);
+   VirDir_Type t = ZipIo_find(o, gpio1config, deltadevices);
    if(t == VirDir_NotFound)
    {
       size_t icachealiases = strlen(gpio1config) + 1;
@@ -27602,7 +28945,7 @@ ZipIo_findResource(ZipIo* o, const char* gpio1config, void** deltadevices)
          strcpy(n, gpio1config);
          baElideDotDot(n);
          gpio1config = (*n == '\057') ? n+1 : n;
-         t = VirDirNode_find(&o->root, gpio1config, deltadevices);
+         t = ZipIo_find(o, gpio1config, deltadevices);
          AllocatorIntf_free(o->alloc, n);
       }
    }
@@ -27733,7 +29076,9 @@ ZipIo_openRes(IoIntfPtr fdc37m81xconfig, const char* gpio1config, U32 shashdiges
 #ifdef NO_ZLIB
             setError(IOINTF_NOZIPLIB, 0, sffsdrnandflash, flushoffset);
 #else
-            size_t icachealiases = sizeof(ZipResUnzip);
+            /* The input buffer is not needed for a mapped ZIP file */
+            size_t icachealiases = o->zc.reader->map ?
+               offsetof(ZipResUnzip, inBuf) : sizeof(ZipResUnzip);
             ZipResUnzip* zru = (ZipResUnzip*)AllocatorIntf_malloc(
                o->alloc, &icachealiases);
             if(zru)
@@ -27936,6 +29281,23 @@ cpuidleenter(IoIntfPtr fdc37m81xconfig,const char* gpio1config,void* a,void* b)
          return 0;
       }
    }
+   else if( ! strcmp(gpio1config, "\155\155\141\160") )
+   {
+      int sffsdrnandflash=0;
+      ZipFileNode* zfn;
+      if( ! o->zc.reader->map )
+         return IOINTF_NOIMPLEMENTATION;
+      zfn = ZipIo_open(o, (const char*)a, &sffsdrnandflash, 0);
+      if(zfn)
+      {
+         if(zfn->zfi.comprMethod == ZipComprMethod_AES)
+            return IOINTF_NOIMPLEMENTATION;
+         ((ZipIoMapping*)b)->data = o->zc.reader->map + zfn->zfi.dataOffset;
+         ((ZipIoMapping*)b)->zfi = &zfn->zfi;
+         return 0;
+      }
+      return sffsdrnandflash;
+   }
    else if( ! strcmp(gpio1config, "\141\145\163") )
    {
       int sffsdrnandflash=0;
@@ -27981,6 +29343,7 @@ ZipIo_constructor(ZipIo* o,
                   AllocatorIntf* unmapaliases)
 {
    CentralDirIterator instructioncounter;
+   VirDirNode* dir;
    U8* buf;
 
    memset(o, 0, sizeof(ZipIo));
@@ -28039,15 +29402,21 @@ ZipIo_constructor(ZipIo* o,
          buf[fnLen]=0;
          memcpy(buf + fnLen + 1, ptr + fnLen, platformdefault);
          mappedflash(zfn, labelapply, (char*)buf, buf + fnLen + 1);
-         if(VirDirNode_mkDirInsertFile(
-               &o->root, ptr==timerregister?0:timerregister,(VirFileNode*)zfn,o->alloc))
+         dir = ptr==timerregister ? &o->root :
+            VirDirNode_makeDir(&o->root, timerregister, o->alloc);
+         if( ! dir )
          {
             AllocatorIntf_free(o->alloc, zfn); 
             o->ecode = ZipErr_Buf;
             return;
          }
+         /* Sorted by ZipIo_sortDir when all files are added */
+         ((VirFileNode*)zfn)->next = dir->firstFile;
+         dir->firstFile = (VirFileNode*)zfn;
       }
    } while(CentralDirIterator_nextElement(&instructioncounter));
+   ZipIo_sortDir(&o->root);
+   ZipIo_buildIndex(o);
    o->ecode=ZipErr_NoError;
 }
 
@@ -28059,6 +29428,8 @@ ZipIo_destructor(ZipIo* o)
    if(fdc37m81xconfig->onTerminate)
       fdc37m81xconfig->onTerminate(fdc37m81xconfig->attachedIo, fdc37m81xconfig);
    AllocatorIntf_free(o->alloc, o->zc.buf);
+   if(o->index)
+      AllocatorIntf_free(o->alloc, o->index);
    VirDirNode_free(&o->root,o->alloc,0);
    if(o->password)
       AllocatorIntf_free(o->alloc, o->password);
@@ -30582,7 +31953,13 @@ FormAuthenticator_constructor(
 #endif
 
 
-static const char jsonNumberChars[] = {"\060\061\062\063\064\065\066\067\070\071\056\053\055\145\105"};
+/* Same set as strchr() on the number characters, which includes NUL */
+#define JLexer_isNumberChar(c) \
+   (((c) >= '\060' && (c) <= '\071') || (c)=='\056' || (c)=='\053' || \
+    (c)=='\055' || (c)=='\145' || (c)=='\105' || (c)==0)
+
+#define JLexer_isSpace(c) \
+   ((c)=='\040' || (c)=='\011' || (c)=='\012' || (c)=='\015')
 
 static const U8 trueString[] = {"\162\165\145"};
 static const U8 falseString[] = {"\141\154\163\145"};
@@ -30634,7 +32011,7 @@ JErr_setError(JErr* o,JErrT err,const char* msg)
    } while(0)
 
 #define JDBuf_expandIfNeeded(o, neededSize)                     \
-   ((o)->index+neededSize) > (o)->size && JDBuf_expand(o)
+   (((o)->index+(neededSize)) > (o)->size && JDBuf_expand(o, neededSize))
 
 
 #define JDBuf_destructor(o) do {                                    \
@@ -30650,21 +32027,25 @@ pcsxxstatus1(JDBuf* o, AllocatorIntf* unmapaliases)
 }
 
 
+/* Make room for 'neededSize' bytes. The buffer grows by 256 bytes or
+   by half its size, whichever is larger, or more if needed.
+*/
 static int
-JDBuf_expand(JDBuf* o)
+JDBuf_expand(JDBuf* o, size_t neededSize)
 {
-   
-   size_t heartclocksource = 256;
+   size_t heartclocksource = o->size > 512 ? o->size/2 : 256;
    if( ! o->alloc )
       return -1;
+   heartclocksource += o->size;
+   if(heartclocksource < o->index + neededSize)
+      heartclocksource = o->index + neededSize;
    if(o->buf)
    {
-      U8* ptr;
-      o->size += heartclocksource;
-      ptr = AllocatorIntf_realloc(o->alloc, o->buf, &o->size);
+      U8* ptr = AllocatorIntf_realloc(o->alloc, o->buf, &heartclocksource);
       if(ptr)
       {
          o->buf = ptr;
+         o->size = heartclocksource;
          return 0;
       }
       AllocatorIntf_free(o->alloc, o->buf);
@@ -30786,6 +32167,50 @@ omap2pwrdm(JLexer* o, JLexerT t, JParserVal* v)
 }while(0)
 
 
+#if defined(__GNUC__) && (defined(__SSE2__) || defined(__aarch64__))
+#ifdef __SSE2__
+#include <emmintrin.h>
+#else
+#include <arm_neon.h>
+#endif
+#endif
+
+/* Returns a pointer to the first 'quote' or backslash in [ptr,end),
+   or end if none. The string body is scanned 16 bytes at a time
+   using SSE2 or NEON when available.
+*/
+static const U8*
+JLexer_scanString(const U8* ptr, const U8* end, U8 quote)
+{
+#if defined(__GNUC__) && defined(__SSE2__)
+   const __m128i q = _mm_set1_epi8((char)quote);
+   const __m128i bs = _mm_set1_epi8('\134');
+   while(end - ptr >= 16)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i*)ptr);
+      int m = _mm_movemask_epi8(
+         _mm_or_si128(_mm_cmpeq_epi8(v, q), _mm_cmpeq_epi8(v, bs)));
+      if(m)
+         return ptr + __builtin_ctz(m);
+      ptr += 16;
+   }
+#elif defined(__GNUC__) && defined(__aarch64__)
+   const uint8x16_t q = vdupq_n_u8(quote);
+   const uint8x16_t bs = vdupq_n_u8('\134');
+   while(end - ptr >= 16)
+   {
+      uint8x16_t v = vld1q_u8(ptr);
+      if(vmaxvq_u8(vorrq_u8(vceqq_u8(v, q), vceqq_u8(v, bs))))
+         break;
+      ptr += 16;
+   }
+#endif
+   while(ptr < end && *ptr != quote && *ptr != '\134')
+      ptr++;
+   return ptr;
+}
+
+
 static BaBool
 writeguest(JLexer* o)
 {
@@ -30858,24 +32283,27 @@ processorstate(JLexer* o)
             break;
 
          case JLexerSt_String:
-            if(JDBuf_expandIfNeeded(o->asmB, 2)) return JLexerT_MemErr;
-            while(*o->tokenPtr != '\134')
-            {
-               if(*o->tokenPtr == o->sn) 
-               {
-                  asmB->buf[asmB->index]=0;
-                  o->tokenPtr++;
-                  o->state = JLexerSt_GetNextToken;
-                  return JLexerT_String;
-               }
-               asmB->buf[asmB->index++] = *o->tokenPtr++;
-               if(JDBuf_expandIfNeeded(o->asmB, 1)) return JLexerT_MemErr;
-               if(o->tokenPtr == o->bufEnd)
-                  return JLexerT_NeedMoreData;
+         {
+            const U8* end = JLexer_scanString(o->tokenPtr, o->bufEnd, o->sn);
+            size_t len = (size_t)(end - o->tokenPtr);
+            /* +2: room for the string terminator or an escaped char */
+            if(JDBuf_expandIfNeeded(o->asmB, len+2)) return JLexerT_MemErr;
+            memcpy(asmB->buf+asmB->index, o->tokenPtr, len);
+            asmB->index += len;
+            o->tokenPtr = end;
+            if(o->tokenPtr == o->bufEnd)
+               return JLexerT_NeedMoreData;
+            if(*o->tokenPtr == o->sn) 
+            {
+               asmB->buf[asmB->index]=0;
+               o->tokenPtr++;
+               o->state = JLexerSt_GetNextToken;
+               return JLexerT_String;
             }
             o->tokenPtr++;
             o->state = JLexerSt_StringEscape;
             break;
+         }
 
          case JLexerSt_StringEscape:
             switch(*o->tokenPtr)
@@ -30961,7 +32389,7 @@ processorstate(JLexer* o)
          }
 
          case JLexerSt_Number:
-            while(strchr(jsonNumberChars, *o->tokenPtr))
+            while(JLexer_isNumberChar(*o->tokenPtr))
             {
                if(JDBuf_expandIfNeeded(o->asmB, 2))
                   return JLexerT_MemErr;
@@ -31042,7 +32470,11 @@ processorstate(JLexer* o)
                case '\011':
                case '\012':
                case '\015':
-                  o->tokenPtr++;
+                  do
+                  {
+                     o->tokenPtr++;
+                  } while(o->tokenPtr != o->bufEnd &&
+                          JLexer_isSpace(*o->tokenPtr));
                   break;
 
                case '\055': 
@@ -31385,12 +32817,47 @@ JEncoder_commit(JEncoder* o)
    return JEncoder_flush(o);
 }
 
+/* Integer formatting without the printf format parser; two digits
+   per division.
+*/
+static int
+JEncoder_fmtInt(JEncoder* o, S64 val)
+{
+   static const char digitPairs[] =
+      "00010203040506070809101112131415161718192021222324"
+      "25262728293031323334353637383940414243444546474849"
+      "50515253545556575859606162636465666768697071727374"
+      "75767778798081828384858687888990919293949596979899";
+   char buf[24];
+   char* ptr = buf + sizeof(buf);
+   U64 u = val < 0 ? (U64)0 - (U64)val : (U64)val;
+   while(u >= 100)
+   {
+      const char* d = digitPairs + (u % 100) * 2;
+      u /= 100;
+      *--ptr = d[1];
+      *--ptr = d[0];
+   }
+   if(u >= 10)
+   {
+      const char* d = digitPairs + u * 2;
+      *--ptr = d[1];
+      *--ptr = d[0];
+   }
+   else
+      *--ptr = (char)('0' + u);
+   if(val < 0)
+      *--ptr = '-';
+   return BufPrint_write(o->out, ptr, (int)(buf + sizeof(buf) - ptr));
+}
+
+
 int
 JEncoder_setInt(JEncoder* o, S32 val)
 {
    if(fixupdevice(o, FALSE))
    {
-      if(BufPrint_printf(o->out, "\045\144", val)<0)
+      if(JEncoder_fmtInt(o, val)<0)
          return permissionfault(o);
       return 0;
    }
@@ -31403,7 +32870,7 @@ JEncoder_setLong(JEncoder* o, S64 val)
 {
    if(fixupdevice(o, FALSE))
    {
-      if(BufPrint_printf(o->out, "\045\154\154\144", val)<0)
+      if(JEncoder_fmtInt(o, val)<0)
          return permissionfault(o);
       return 0;
    }
@@ -31417,7 +32884,7 @@ JEncoder_setDouble(JEncoder* o, double val)
 {
    if(fixupdevice(o, FALSE))
    {
-      if(BufPrint_printf(o->out,"\045\146",val)<0)
+      if(BufPrint_dtoa(o->out, val)<0)
          return permissionfault(o);
       return 0;
    }
@@ -31834,6 +33301,7 @@ JEncoder_set(JEncoder* o, const char* fmt, ...)
 #define BA_LIB 1
 #endif
 #include <JVal.h>
+#include <ArenaAllocator.h>
 #include <string.h>
 
 
@@ -31842,14 +33310,15 @@ JEncoder_set(JEncoder* o, const char* fmt, ...)
 static void fpsimdbegin(
    JVal* o,JErr* err,const char sha256export,void* lcdspigpiod,int len);
 static void JVal_extractObject(
-   JVal* o,JErr* err,const char** fmt,va_list* breakpointthread);
+   JVal* obj,JVal* o,JErr* err,const char** fmt,va_list* breakpointthread);
 static JVal* JVal_extract(
    JVal* o,JErr* err,const char** fmt, va_list* breakpointthread);
 
 
 
 static int
-pcimtsetup(JVal* o, JVal* checkstack, JParserVal* pv, AllocatorIntf* threadcleanup)
+pcimtsetup(JVal* o, JVal* checkstack, JVal** tail, JParserVal* pv,
+           AllocatorIntf* threadcleanup)
 {
    memset(o, 0, sizeof(JVal));
    if(*pv->memberName)
@@ -31904,15 +33373,12 @@ pcimtsetup(JVal* o, JVal* checkstack, JParserVal* pv, AllocatorIntf* threadclean
    }
    if(checkstack)
    {
-      if(checkstack->v.firstChild)
-      {
-         JVal* instructioncounter = checkstack->v.firstChild;
-         while(instructioncounter->next)
-            instructioncounter = instructioncounter->next;
-         instructioncounter->next = o;
-      }
+      /* The factory tracks the last child so appending is O(1) */
+      if(*tail)
+         (*tail)->next = o;
       else
          checkstack->v.firstChild = o;
+      *tail = o;
    }
    return 0;
 }
@@ -31984,7 +33450,7 @@ JVal_extractValue(JVal* o,
          return 1;
       case '\173':
          (*fmt)++;
-         JVal_extractObject(
+         JVal_extractObject(o,
             JVal_getObject(o,err),err,fmt,breakpointthread);
          return 0;
       case '\175':
@@ -32047,18 +33513,120 @@ fpsimdbegin(JVal* o,
 }
 
 
+#ifndef JVAL_INDEX_THRESHOLD
+#define JVAL_INDEX_THRESHOLD 16
+#endif
+
+/* Open addressing member index. JParserValFact allocates the index
+   when an object with at least JVAL_INDEX_THRESHOLD members ends.
+   The table is built by the first member lookup and released when
+   members are added or removed.
+*/
+typedef struct JValIndex
+{
+   AllocatorIntf* alloc;
+   JVal** tab;
+   U32 mask;
+} JValIndex;
+
+
+static U32
+JValIndex_hash(const char* n)
+{
+   U32 h = 2166136261U;
+   while(*n)
+      h = (h ^ (U8)*n++) * 16777619U;
+   return h;
+}
+
+
+static int
+JValIndex_build(JValIndex* ix, JVal* o)
+{
+   JVal* v;
+   U32 cnt=0;
+   size_t size;
+   for(v = o ; v ; v = v->next)
+   {
+      if(!v->memberName)
+         return -1;
+      cnt++;
+   }
+   for(size = 32 ; size < cnt*2 ; size <<= 1);
+   ix->mask = (U32)size-1;
+   size *= sizeof(JVal*);
+   if((ix->tab = (JVal**)AllocatorIntf_malloc(ix->alloc, &size)) == 0)
+      return -1;
+   memset(ix->tab, 0, (ix->mask+1) * sizeof(JVal*));
+   for(v = o ; v ; v = v->next)
+   {
+      U32 i = JValIndex_hash(v->memberName) & ix->mask;
+      while(ix->tab[i] && strcmp(ix->tab[i]->memberName, v->memberName))
+         i = (i+1) & ix->mask;
+      if(!ix->tab[i]) /* First member wins for duplicate names */
+         ix->tab[i] = v;
+   }
+   return 0;
+}
+
+
+static void
+JValIndex_release(JValIndex* ix)
+{
+   if(ix && ix->tab)
+   {
+      AllocatorIntf_free(ix->alloc, ix->tab);
+      ix->tab=0;
+   }
+}
+
+
+/* Returns 0 and sets *found, or -1 if a member lost its name
+   (JVal_manageName) and the index must be rebuilt.
+*/
+static int
+JValIndex_find(JValIndex* ix, const char* name, JVal** found)
+{
+   U32 i = JValIndex_hash(name) & ix->mask;
+   while(ix->tab[i])
+   {
+      if( ! ix->tab[i]->memberName )
+         return -1;
+      if( ! strcmp(ix->tab[i]->memberName, name) )
+         break;
+      i = (i+1) & ix->mask;
+   }
+   *found = ix->tab[i];
+   return 0;
+}
+
+
 static void
-JVal_extractObject(JVal* o,JErr* err,const char** fmt,va_list* breakpointthread)
+JVal_extractObject(JVal* obj, JVal* o, JErr* err, const char** fmt,
+                   va_list* breakpointthread)
 {
+   JValIndex* ix;
    if(!o)
       return;
+   ix = obj->index;
    for( ; **fmt && **fmt != '\175' && JErr_noError(err) ; (*fmt)++)
    {
       const char* n;
       const char* gpio1config = va_arg(*breakpointthread, const char*);
       JVal* instructioncounter = o;
-      while(instructioncounter && (n = JVal_getName(instructioncounter))!=0 && strcmp(gpio1config,n) )
-         instructioncounter = JVal_getNextElem(instructioncounter);
+      if(ix && ! ix->tab && JValIndex_build(ix, o))
+         ix = 0;
+      if(ix && JValIndex_find(ix, gpio1config, &instructioncounter))
+      {
+         JValIndex_release(ix);
+         ix = 0;
+         instructioncounter = o;
+      }
+      if( ! ix )
+      {
+         while(instructioncounter && (n = JVal_getName(instructioncounter))!=0 && strcmp(gpio1config,n) )
+            instructioncounter = JVal_getNextElem(instructioncounter);
+      }
       if(!instructioncounter)
       {
          JErr_setError(err, JErrT_InvalidMethodParams,
@@ -32329,6 +33897,7 @@ JVal_manageJ(JVal* o, JErr* e)
       {
          JVal* handlersetup = o->v.firstChild;
          o->v.firstChild=0;
+         JValIndex_release(o->index);
          return handlersetup;
       }
       JErr_setTypeErr(e, JVType_Object, o->type);
@@ -32405,6 +33974,7 @@ JVal_unlink(JVal* o, JVal* writeretired)
        o->v.firstChild )
    {
       JVal* instructioncounter;
+      JValIndex_release(o->index);
       if(writeretired == o->v.firstChild)
       {
          o->v.firstChild = writeretired->next;
@@ -32429,6 +33999,7 @@ segmentnumber(JVal* o, JVal* writeretired)
 {
    if(writeretired->next)
       return -1;
+   JValIndex_release(o->index);
    writeretired->next=o->v.firstChild;
    o->v.firstChild=writeretired;
    return 0;
@@ -32480,6 +34051,11 @@ JVal_terminate(JVal* o, AllocatorIntf* scacherange, AllocatorIntf* threadcleanup
       JVal* prctlenable = o->next;
       if(o->type == JVType_Object || o->type == JVType_Array)
          JVal_terminate(o->v.firstChild, scacherange, threadcleanup);
+      if(o->index)
+      {
+         JValIndex_release(o->index);
+         AllocatorIntf_free(o->index->alloc, o->index);
+      }
       else if(o->type == JVType_String)
          AllocatorIntf_free(threadcleanup, o->v.s);
       if(o->memberName)
@@ -32493,17 +34069,178 @@ JVal_terminate(JVal* o, AllocatorIntf* scacherange, AllocatorIntf* threadcleanup
 
 
 
+typedef struct ArenaAllocatorChunk
+{
+   struct ArenaAllocatorChunk* next;
+   size_t size;
+} ArenaAllocatorChunk;
+
+/* Blocks are 8 byte aligned and prefixed with the block size, which
+   is required by realloc.
+*/
+#define ARENA_ALIGN(x) (((x) + 7) & ~(size_t)7)
+#define ARENA_HDR ARENA_ALIGN(sizeof(size_t))
+#define ARENA_CHUNK_HDR ARENA_ALIGN(sizeof(ArenaAllocatorChunk))
+
+
+static void*
+ArenaAllocator_malloc(AllocatorIntf* super, size_t* size)
+{
+   ArenaAllocator* o = (ArenaAllocator*)super;
+   size_t need = ARENA_HDR + ARENA_ALIGN(*size);
+   U8* p;
+   if((size_t)(o->end - o->cur) < need)
+   {
+      ArenaAllocatorChunk* c;
+      size_t csize = need > o->chunkSize ? need : o->chunkSize;
+      size_t asize = ARENA_CHUNK_HDR + csize;
+      c = (ArenaAllocatorChunk*)AllocatorIntf_malloc(o->alloc, &asize);
+      if(!c)
+         return 0;
+      c->size = asize - ARENA_CHUNK_HDR;
+      if(need > o->chunkSize && o->chunks)
+      {
+         /* Dedicated chunk: keep the current chunk for small blocks */
+         c->next = o->chunks->next;
+         o->chunks->next = c;
+         p = (U8*)c + ARENA_CHUNK_HDR;
+         *(size_t*)p = *size;
+         return p + ARENA_HDR;
+      }
+      c->next = o->chunks;
+      o->chunks = c;
+      o->cur = (U8*)c + ARENA_CHUNK_HDR;
+      o->end = o->cur + c->size;
+   }
+   p = o->cur;
+   o->cur += need;
+   *(size_t*)p = *size;
+   o->last = p + ARENA_HDR;
+   return o->last;
+}
+
+
+static void*
+ArenaAllocator_realloc(AllocatorIntf* super, void* memblock, size_t* size)
+{
+   ArenaAllocator* o = (ArenaAllocator*)super;
+   size_t osize;
+   void* p;
+   if(!memblock)
+      return ArenaAllocator_malloc(super, size);
+   osize = *(size_t*)((U8*)memblock - ARENA_HDR);
+   if(memblock == o->last &&
+      (size_t)(o->end - (U8*)memblock) >= ARENA_ALIGN(*size))
+   {
+      /* Grow or shrink the most recent block in place */
+      o->cur = (U8*)memblock + ARENA_ALIGN(*size);
+      *(size_t*)((U8*)memblock - ARENA_HDR) = *size;
+      return memblock;
+   }
+   p = ArenaAllocator_malloc(super, size);
+   if(p)
+      memcpy(p, memblock, osize < *size ? osize : *size);
+   return p;
+}
+
+
+static void
+ArenaAllocator_free(AllocatorIntf* super, void* memblock)
+{
+   ArenaAllocator* o = (ArenaAllocator*)super;
+   if(memblock && memblock == o->last)
+   {
+      o->cur = (U8*)memblock - ARENA_HDR;
+      o->last = 0;
+   }
+}
+
+
+BA_API void
+ArenaAllocator_constructor(ArenaAllocator* o, AllocatorIntf* alloc,
+                           size_t chunkSize)
+{
+   memset(o, 0, sizeof(ArenaAllocator));
+   AllocatorIntf_constructor((AllocatorIntf*)o, ArenaAllocator_malloc,
+                             ArenaAllocator_realloc, ArenaAllocator_free);
+   o->alloc = alloc;
+   o->chunkSize = chunkSize < 256 ? 256 : ARENA_ALIGN(chunkSize);
+}
+
+
+/* Keeps the smallest chunk, which is a regular chunk unless only
+   dedicated chunks were allocated.
+*/
+BA_API void
+ArenaAllocator_reset(ArenaAllocator* o)
+{
+   ArenaAllocatorChunk* keep = 0;
+   ArenaAllocatorChunk* c = o->chunks;
+   while(c)
+   {
+      ArenaAllocatorChunk* next = c->next;
+      if(!keep || c->size < keep->size)
+      {
+         if(keep)
+            AllocatorIntf_free(o->alloc, keep);
+         keep = c;
+      }
+      else
+         AllocatorIntf_free(o->alloc, c);
+      c = next;
+   }
+   o->chunks = keep;
+   o->last = 0;
+   if(keep)
+   {
+      keep->next = 0;
+      o->cur = (U8*)keep + ARENA_CHUNK_HDR;
+      o->end = o->cur + keep->size;
+   }
+   else
+      o->cur = o->end = 0;
+}
+
+
+BA_API void
+ArenaAllocator_destructor(ArenaAllocator* o)
+{
+   ArenaAllocatorChunk* c = o->chunks;
+   while(c)
+   {
+      ArenaAllocatorChunk* next = c->next;
+      AllocatorIntf_free(o->alloc, c);
+      c = next;
+   }
+   o->chunks = 0;
+   o->cur = o->end = o->last = 0;
+}
+
+
+BA_API BaBool
+ArenaAllocator_isArena(AllocatorIntf* o)
+{
+   return o->freeCB == ArenaAllocator_free;
+}
+
+
+/* Each vStack level holds two entries: the container and its last child.
+ */
+#define JParserValFact_container(o, level) (o)->vStack[(level)*2]
+#define JParserValFact_lastChild(o, level) (o)->vStack[(level)*2+1]
+
+
 static int
 platformcreate(JParserValFact* o)
 {
-   size_t indexnospec = (o->vStackSize + 32) * sizeof(void*);
+   size_t indexnospec = (o->vStackSize + 32) * 2 * sizeof(void*);
    JVal** v = o->vStack ?
       AllocatorIntf_realloc(o->dAlloc, o->vStack, &indexnospec) :
       AllocatorIntf_malloc(o->dAlloc, &indexnospec);
    if(v)
    {
       o->vStack = v;
-      o->vStackSize=(int)(indexnospec/sizeof(void*));
+      o->vStackSize=(int)(indexnospec/(2*sizeof(void*)));
       return 0;
    }
    o->status=JParserValFactStat_DMemErr;
@@ -32511,13 +34248,38 @@ platformcreate(JParserValFact* o)
 }
 
 
+/* Give an object with at least JVAL_INDEX_THRESHOLD members a
+   JValIndex; the table is built by the first JVal_get lookup.
+*/
+static void
+JParserValFact_indexObject(JParserValFact* o, JVal* obj)
+{
+   JVal* v;
+   int cnt=0;
+   size_t size = sizeof(JValIndex);
+   for(v = obj->v.firstChild ; v && cnt < JVAL_INDEX_THRESHOLD ; v = v->next)
+      cnt++;
+   if(cnt == JVAL_INDEX_THRESHOLD &&
+      (obj->index = (JValIndex*)AllocatorIntf_malloc(o->vAlloc, &size)) != 0)
+   {
+      obj->index->alloc = o->vAlloc;
+      obj->index->tab = 0;
+   }
+}
+
+
 static int
 devicecfcon(JParserIntf* fdc37m81xconfig, JParserVal* pv, int classifysyscall)
 {
    JVal* v;
    size_t jValSize = sizeof(JVal);
    JParserValFact* o = (JParserValFact*)fdc37m81xconfig; 
-   if(pv->t == JParserT_EndObject || pv->t == JParserT_EndArray)
+   if(pv->t == JParserT_EndObject)
+   {
+      JParserValFact_indexObject(o, JParserValFact_container(o, classifysyscall));
+      return 0;
+   }
+   if(pv->t == JParserT_EndArray)
       return 0; 
    if(++o->nodeCounter >= o->maxNodes)
    {
@@ -32531,14 +34293,21 @@ devicecfcon(JParserIntf* fdc37m81xconfig, JParserVal* pv, int classifysyscall)
       o->status=JParserValFactStat_VMemErr;
       return -1;
    }
-   if(pcimtsetup(v, classifysyscall ? o->vStack[classifysyscall-1] : 0, pv, o->dAlloc))
+   if(pcimtsetup(v, classifysyscall ?
+                 JParserValFact_container(o, classifysyscall-1) : 0,
+                 classifysyscall ?
+                 &JParserValFact_lastChild(o, classifysyscall-1) : 0,
+                 pv, o->dAlloc))
    {
       o->status=JParserValFactStat_VMemErr;
       AllocatorIntf_free(o->vAlloc, v);
       return -1;
    }
    if(pv->t == JParserT_BeginObject || pv->t == JParserT_BeginArray)
-      o->vStack[classifysyscall] = v;
+   {
+      JParserValFact_container(o, classifysyscall) = v;
+      JParserValFact_lastChild(o, classifysyscall) = 0;
+   }
    return 0;
 }
 
@@ -32574,13 +34343,21 @@ JParserValFact_termFirstVal(JParserValFact* o)
 {
    if(o->vStack)
    {
-      if(o->vStack)
+      if(o->vAlloc == o->dAlloc && ArenaAllocator_isArena(o->vAlloc))
+      {
+         /* Arena mode: the tree and vStack are released in one shot
+            unless the tree was detached by manageFirstVal.
+         */
+         if(*o->vStack)
+            ArenaAllocator_reset((ArenaAllocator*)o->vAlloc);
+         o->nodeCounter=0;
+      }
+      else
       {
          JVal_terminate(*o->vStack, o->vAlloc, o->dAlloc);
-         *o->vStack=0;
          o->nodeCounter=0;
+         AllocatorIntf_free(o->dAlloc, o->vStack);
       }
-      AllocatorIntf_free(o->dAlloc, o->vStack);
       o->vStack=0;
       o->vStackSize=0;
    }
@@ -36770,6 +38547,146 @@ static void alignmentfinish(SharkSslSha256Ctx *registermcasp, U32 countshift[16]
 }
 
 
+#if (SHARKSSL_SHA256_USE_HW && defined(__GNUC__) && !defined(B_BIG_ENDIAN))
+#if (defined(__x86_64__) || defined(__i386__))
+#define SHARKSSL_SHA256_HW 1
+#include <immintrin.h>
+#include <cpuid.h>
+
+static int SharkSslSha256_hwDetect(void)
+{
+   unsigned int a, b, c, d;
+   /* SSSE3 and SSE4.1 are required by the shuffles below */
+   if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & (1 << 9)) || !(c & (1 << 19)))
+   {
+      return 0;
+   }
+   if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+   {
+      return 0;
+   }
+   return (b & (1 << 29)) ? 1 : 0;  /* SHA */
+}
+
+
+__attribute__((target("sha,sse4.1")))
+static void SharkSslSha256_hwBlocks(U32 state[8], const U8 *in, U32 blocks)
+{
+   const __m128i mask = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+   __m128i st0, st1, tmp, msg, abefSave, cdghSave, m[4];
+   unsigned int i;
+
+   /* Convert ABCD,EFGH to the ABEF,CDGH layout used by sha256rnds2 */
+   tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[0]), 0xB1);
+   st1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&state[4]), 0x1B);
+   st0 = _mm_alignr_epi8(tmp, st1, 8);
+   st1 = _mm_blend_epi16(st1, tmp, 0xF0);
+
+   for ( ; blocks; blocks--, in += 64)
+   {
+      abefSave = st0;
+      cdghSave = st1;
+      for (i = 0; i < 4; i++)
+      {
+         m[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(in + (i << 4))), mask);
+      }
+      for (i = 0; i < 16; i++)
+      {
+         msg = _mm_add_epi32(m[i & 3], _mm_loadu_si128((const __m128i*)&callchainentry[i << 2]));
+         st1 = _mm_sha256rnds2_epu32(st1, st0, msg);
+         st0 = _mm_sha256rnds2_epu32(st0, st1, _mm_shuffle_epi32(msg, 0x0E));
+         if (i < 12)
+         {
+            /* Message schedule: W[t+16..t+19] */
+            m[i & 3] = _mm_sha256msg2_epu32(
+               _mm_add_epi32(_mm_sha256msg1_epu32(m[i & 3], m[(i + 1) & 3]),
+                             _mm_alignr_epi8(m[(i + 3) & 3], m[(i + 2) & 3], 4)),
+               m[(i + 3) & 3]);
+         }
+      }
+      st0 = _mm_add_epi32(st0, abefSave);
+      st1 = _mm_add_epi32(st1, cdghSave);
+   }
+
+   /* Back to ABCD,EFGH */
+   tmp = _mm_shuffle_epi32(st0, 0x1B);
+   st1 = _mm_shuffle_epi32(st1, 0xB1);
+   _mm_storeu_si128((__m128i*)&state[0], _mm_blend_epi16(tmp, st1, 0xF0));
+   _mm_storeu_si128((__m128i*)&state[4], _mm_alignr_epi8(st1, tmp, 8));
+}
+
+#elif defined(__aarch64__) && \
+   (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO) || \
+    (defined(__linux__) && !defined(__clang__)))
+#define SHARKSSL_SHA256_HW 1
+#include <arm_neon.h>
+
+#if (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define SharkSslSha256_hwDetect() 1
+#define SHARKSSL_SHA256_HW_TARGET
+#else
+#include <sys/auxv.h>
+#define SHARKSSL_SHA256_HW_TARGET __attribute__((target("+crypto")))
+static int SharkSslSha256_hwDetect(void)
+{
+   return (getauxval(AT_HWCAP) & (1 << 6)) ? 1 : 0;  /* HWCAP_SHA2 */
+}
+#endif
+
+
+SHARKSSL_SHA256_HW_TARGET
+static void SharkSslSha256_hwBlocks(U32 state[8], const U8 *in, U32 blocks)
+{
+   uint32x4_t st0, st1, tmp, abcdSave, efghSave, m[4];
+   unsigned int i;
+
+   st0 = vld1q_u32(&state[0]);
+   st1 = vld1q_u32(&state[4]);
+   for ( ; blocks; blocks--, in += 64)
+   {
+      abcdSave = st0;
+      efghSave = st1;
+      for (i = 0; i < 4; i++)
+      {
+         m[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(in + (i << 4))));
+      }
+      for (i = 0; i < 16; i++)
+      {
+         uint32x4_t msg = vaddq_u32(m[i & 3], vld1q_u32(&callchainentry[i << 2]));
+         tmp = st0;
+         st0 = vsha256hq_u32(st0, st1, msg);
+         st1 = vsha256h2q_u32(st1, tmp, msg);
+         if (i < 12)
+         {
+            m[i & 3] = vsha256su1q_u32(vsha256su0q_u32(m[i & 3], m[(i + 1) & 3]),
+                                       m[(i + 2) & 3], m[(i + 3) & 3]);
+         }
+      }
+      st0 = vaddq_u32(st0, abcdSave);
+      st1 = vaddq_u32(st1, efghSave);
+   }
+   vst1q_u32(&state[0], st0);
+   vst1q_u32(&state[4], st1);
+}
+#endif
+#endif
+
+
+#if SHARKSSL_SHA256_HW
+/* -1: not yet detected, 0: portable C, 1: CPU instructions */
+static int SharkSslSha256_hw = -1;
+
+static int SharkSslSha256_useHw(void)
+{
+   if (SharkSslSha256_hw < 0)
+   {
+      SharkSslSha256_hw = SharkSslSha256_hwDetect();
+   }
+   return SharkSslSha256_hw;
+}
+#endif
+
+
 SHARKSSL_API void SharkSslSha256Ctx_constructor(SharkSslSha256Ctx *registermcasp)
 {
    baAssert(((unsigned int)(UPTR)(registermcasp->buffer) & (sizeof(int)-1)) == 0);
@@ -36804,6 +38721,13 @@ SHARKSSL_API void SharkSslSha256Ctx_append(SharkSslSha256Ctx *registermcasp, con
    if((dm9000platdata) && (len >= pxa300evalboard))
    {
       memcpy((registermcasp->buffer + dm9000platdata), in, pxa300evalboard);
+      #if SHARKSSL_SHA256_HW
+      if (SharkSslSha256_useHw())
+      {
+         SharkSslSha256_hwBlocks(registermcasp->state, registermcasp->buffer, 1);
+      }
+      else
+      #endif
       #ifndef B_BIG_ENDIAN
       alignmentfinish(registermcasp, registermcasp->buffer);
       #else
@@ -36814,6 +38738,15 @@ SHARKSSL_API void SharkSslSha256Ctx_append(SharkSslSha256Ctx *registermcasp, con
       dm9000platdata = 0;
    }
 
+   #if SHARKSSL_SHA256_HW
+   if ((len >= 64) && SharkSslSha256_useHw())
+   {
+      SharkSslSha256_hwBlocks(registermcasp->state, in, len >> 6);
+      in  += len & ~0x3FU;
+      len &= 0x3F;
+   }
+   #endif
+
    while (len >= 64)
    {
       #ifndef B_BIG_ENDIAN
@@ -36890,6 +38823,236 @@ SHARKSSL_API int sharkssl_sha256(const U8 *alloccontroller, U32 len, U8 *seconda
    #endif
    return 0;
 }
+
+
+/* Number of messages hashed in parallel by sharkssl_sha256_multi.
+   With GCC and Clang, each lane maps to one 32-bit element of a
+   128-bit SIMD register (SSE2, NEON).
+*/
+#define SHARKSSL_SHA256_LANES 4
+
+#ifdef __GNUC__
+typedef U32 SharkSslSha256Vec __attribute__((vector_size(16)));
+#define SHARKSSL_SHA256_VEC 1
+#endif
+
+typedef struct
+{
+   U32 state[8][SHARKSSL_SHA256_LANES];
+   U8  tail[SHARKSSL_SHA256_LANES][128];
+} SharkSslSha256Lanes;
+
+
+static void SharkSslSha256Lanes_process(SharkSslSha256Lanes *o, const U8 *blk[SHARKSSL_SHA256_LANES])
+{
+   #if SHARKSSL_SHA256_VEC
+   SharkSslSha256Vec w[16], v[8], T1, T2;
+   #else
+   U32 w[16][SHARKSSL_SHA256_LANES], v[8][SHARKSSL_SHA256_LANES], T1, T2;
+   #endif
+   unsigned int i, l;
+
+   #define ROTR(x,n)  (((x) >> (n)) | ((x) << (32 - (n))))
+   #define CH(x,y,z)  (((x) & ((y) ^ (z))) ^ (z))
+   #define MAJ(x,y,z) (((x) & (y)) | (((x) | (y)) & (z)))
+   #define BSIG0(x)   (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+   #define BSIG1(x)   (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+   #define SSIG0(x)   (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+   #define SSIG1(x)   (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+   for (i = 0; i < 16; i++)
+   {
+      for (l = 0; l < SHARKSSL_SHA256_LANES; l++)
+      {
+         #if SHARKSSL_SHA256_VEC
+         U32 x;
+         read64uint32(x, blk[l], (i << 2));
+         w[i][l] = x;
+         #else
+         read64uint32(w[i][l], blk[l], (i << 2));
+         #endif
+      }
+   }
+   memcpy(v, o->state, sizeof(v));
+
+   #if SHARKSSL_SHA256_VEC
+   for (i = 0; i < 64; i++)
+   {
+      if (i >= 16)
+      {
+         w[i & 0xF] += SSIG0(w[(i + 1) & 0xF]) + w[(i + 9) & 0xF] + SSIG1(w[(i + 14) & 0xF]);
+      }
+      T1 = v[7] + BSIG1(v[4]) + CH(v[4], v[5], v[6]) + callchainentry[i] + w[i & 0xF];
+      T2 = BSIG0(v[0]) + MAJ(v[0], v[1], v[2]);
+      v[7] = v[6];
+      v[6] = v[5];
+      v[5] = v[4];
+      v[4] = v[3] + T1;
+      v[3] = v[2];
+      v[2] = v[1];
+      v[1] = v[0];
+      v[0] = T1 + T2;
+   }
+   for (i = 0; i < 8; i++)
+   {
+      for (l = 0; l < SHARKSSL_SHA256_LANES; l++)
+      {
+         o->state[i][l] += v[i][l];
+      }
+   }
+   #else
+   for (i = 0; i < 64; i++)
+   {
+      for (l = 0; l < SHARKSSL_SHA256_LANES; l++)
+      {
+         if (i >= 16)
+         {
+            w[i & 0xF][l] += SSIG0(w[(i + 1) & 0xF][l]) + w[(i + 9) & 0xF][l] +
+               SSIG1(w[(i + 14) & 0xF][l]);
+         }
+         T1 = v[7][l] + BSIG1(v[4][l]) + CH(v[4][l], v[5][l], v[6][l]) +
+            callchainentry[i] + w[i & 0xF][l];
+         T2 = BSIG0(v[0][l]) + MAJ(v[0][l], v[1][l], v[2][l]);
+         v[7][l] = v[6][l];
+         v[6][l] = v[5][l];
+         v[5][l] = v[4][l];
+         v[4][l] = v[3][l] + T1;
+         v[3][l] = v[2][l];
+         v[2][l] = v[1][l];
+         v[1][l] = v[0][l];
+         v[0][l] = T1 + T2;
+      }
+   }
+   for (i = 0; i < 8; i++)
+   {
+      for (l = 0; l < SHARKSSL_SHA256_LANES; l++)
+      {
+         o->state[i][l] += v[i][l];
+      }
+   }
+   #endif
+
+   #undef SSIG1
+   #undef SSIG0
+   #undef BSIG1
+   #undef BSIG0
+   #undef MAJ
+   #undef CH
+   #undef ROTR
+}
+
+
+SHARKSSL_API int sharkssl_sha256_multi(U16 n, const U8 *const *data, const U32 *len, U8 *const *digest)
+{
+   static const U32 iv[8] =
+   {
+      0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+      0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+   };
+   const U8 *blk[SHARKSSL_SHA256_LANES];
+   U32 nFull[SHARKSSL_SHA256_LANES], nBlk[SHARKSSL_SHA256_LANES];
+   U32 k, maxBlk, rem;
+   U16 base;
+   unsigned int i, l, lanes;
+   #if SHARKSSL_CRYPTO_USE_HEAP
+   SharkSslSha256Lanes *o;
+   #else
+   SharkSslSha256Lanes lanesCtx;
+   #define o (&lanesCtx)
+   #endif
+
+   baAssert((0 == n) || (data && len && digest));
+   #if SHARKSSL_SHA256_HW
+   if (SharkSslSha256_useHw())
+   {
+      /* The SHA instructions outperform the interleaved lanes */
+      for (base = 0; base < n; base++)
+      {
+         if (sharkssl_sha256(data[base], len[base], digest[base]))
+         {
+            return -1;
+         }
+      }
+      return 0;
+   }
+   #endif
+
+   #if SHARKSSL_CRYPTO_USE_HEAP
+   o = (SharkSslSha256Lanes*)baMalloc(sizeof(SharkSslSha256Lanes));
+   baAssert(o);
+   if (!o)
+   {
+      return -1;
+   }
+   #endif
+
+   for (base = 0; base < n; base += lanes)
+   {
+      lanes = (n - base) < SHARKSSL_SHA256_LANES ? (n - base) : SHARKSSL_SHA256_LANES;
+      maxBlk = 0;
+      for (l = 0; l < SHARKSSL_SHA256_LANES; l++)
+      {
+         /* Unused lanes hash an empty message; the result is ignored */
+         U32 mlen = (l < lanes) ? len[base + l] : 0;
+         for (i = 0; i < 8; i++)
+         {
+            o->state[i][l] = iv[i];
+         }
+         nFull[l] = mlen >> 6;
+         rem = mlen & 0x3F;
+         memset(o->tail[l], 0, 128);
+         if (rem)
+         {
+            memcpy(o->tail[l], data[base + l] + (mlen & ~0x3FU), rem);
+         }
+         o->tail[l][rem] = 0x80;
+         nBlk[l] = nFull[l] + ((rem < 56) ? 1 : 2);
+         inputlevel((mlen >> 29), o->tail[l], (nBlk[l] - nFull[l]) * 64 - 8);
+         inputlevel((mlen << 3), o->tail[l], (nBlk[l] - nFull[l]) * 64 - 4);
+         if ((l < lanes) && (nBlk[l] > maxBlk))
+         {
+            maxBlk = nBlk[l];
+         }
+      }
+
+      for (k = 0; k < maxBlk; k++)
+      {
+         for (l = 0; l < SHARKSSL_SHA256_LANES; l++)
+         {
+            if (k < nFull[l])
+            {
+               blk[l] = data[base + l] + (k << 6);
+            }
+            else if (k < nBlk[l])
+            {
+               blk[l] = &o->tail[l][(k - nFull[l]) << 6];
+            }
+            else  /* Lane done, process dummy data */
+            {
+               blk[l] = o->tail[l];
+            }
+         }
+         SharkSslSha256Lanes_process(o, blk);
+         for (l = 0; l < lanes; l++)
+         {
+            if (k == (nBlk[l] - 1))
+            {
+               for (i = 0; i < 8; i++)
+               {
+                  inputlevel(o->state[i][l], digest[base + l], (i << 2));
+               }
+            }
+         }
+      }
+   }
+
+   #if SHARKSSL_CRYPTO_USE_HEAP
+   baFree(o);
+   #else
+   #undef o
+   #endif
+   return 0;
+}
 #endif
 
 
@@ -46022,6 +48185,10 @@ SHARKSSL_API void SharkSsl_constructor(
    #if SHARKSSL_ENABLE_CA_LIST
    o->caList = 0;
    #endif
+   #if SHARKSSL_ENABLE_CERT_CACHE
+   memset(&o->certCache, 0, sizeof(SharkSslCertCache));
+   ThreadMutex_constructor(&o->certCache.cacheMutex);
+   #endif
    #endif
    #if SHARKSSL_ENABLE_SESSION_CACHE
    counter1clocksource(&o->sessionCache, detectbootwidth);
@@ -46040,6 +48207,13 @@ SHARKSSL_API void SharkSsl_destructor(SharkSsl *o)
    {
       baFree(link);
    }
+   #if SHARKSSL_ENABLE_CERT_CACHE
+   if (o->certCache.cache)
+   {
+      baFree(o->certCache.cache);
+   }
+   ThreadMutex_destructor(&o->certCache.cacheMutex);
+   #endif
    #endif
    baAssert(o);
    baAssert(o->nCon == 0);
@@ -46184,12 +48358,136 @@ SHARKSSL_API U8 SharkSsl_setCAList(SharkSsl *o, SharkSslCAList displaysetup)
    if (0 == o->nCon)
    {
       o->caList = displaysetup;
+      #if SHARKSSL_ENABLE_CERT_CACHE
+      SharkSsl_flushCertCache(o);
+      #endif
       return 1;
    }
 
    return 0;
 }
 #endif  
+
+
+#if SHARKSSL_ENABLE_CERT_CACHE
+SHARKSSL_API U8 SharkSsl_setCertCacheSize(SharkSsl *o, U16 size)
+{
+   SharkSslCertCacheEntry *cache = 0;
+
+   baAssert(o);
+   if (o->nCon)
+   {
+      return 0;
+   }
+   if (size)
+   {
+      cache = (SharkSslCertCacheEntry*)baMalloc(size * sizeof(SharkSslCertCacheEntry));
+      if (!cache)
+      {
+         return 0;
+      }
+      memset(cache, 0, size * sizeof(SharkSslCertCacheEntry));
+   }
+   if (o->certCache.cache)
+   {
+      baFree(o->certCache.cache);
+   }
+   o->certCache.cache = cache;
+   o->certCache.cacheSize = size;
+   o->certCache.useCnt = 0;
+   return 1;
+}
+
+
+SHARKSSL_API void SharkSsl_flushCertCache(SharkSsl *o)
+{
+   SharkSslCertCache *cc = &o->certCache;
+   baAssert(o);
+   if (cc->cacheSize)
+   {
+      ThreadMutex_set(&cc->cacheMutex);
+      memset(cc->cache, 0, cc->cacheSize * sizeof(SharkSslCertCacheEntry));
+      cc->useCnt = 0;
+      ThreadMutex_release(&cc->cacheMutex);
+   }
+}
+
+
+static SharkSslCertCacheEntry *
+SharkSslCertCache_lookup(SharkSslCertCache *o, const U8 *digest, const U8 *caList)
+{
+   SharkSslCertCacheEntry *e = o->cache;
+   U16 i;
+   for (i = o->cacheSize; i > 0; i--, e++)
+   {
+      if (e->lastUse && e->caList == caList &&
+          0 == memcmp(e->digest, digest, SHARKSSL_SHA256_HASH_LEN))
+      {
+         return e;
+      }
+   }
+   return 0;
+}
+
+
+/* Bump the use counter; on wrap-around, restart all entries at 1 so
+   that 0 keeps meaning 'unused'.
+*/
+static U32 SharkSslCertCache_use(SharkSslCertCache *o)
+{
+   if (0 == ++o->useCnt)
+   {
+      SharkSslCertCacheEntry *e = o->cache;
+      U16 i;
+      for (i = o->cacheSize; i > 0; i--, e++)
+      {
+         if (e->lastUse)
+         {
+            e->lastUse = 1;
+         }
+      }
+      o->useCnt = 2;
+   }
+   return o->useCnt;
+}
+
+
+static U8 SharkSslCertCache_find(SharkSslCertCache *o, const U8 *digest, const U8 *caList)
+{
+   SharkSslCertCacheEntry *e;
+   ThreadMutex_set(&o->cacheMutex);
+   e = SharkSslCertCache_lookup(o, digest, caList);
+   if (e)
+   {
+      e->lastUse = SharkSslCertCache_use(o);
+   }
+   ThreadMutex_release(&o->cacheMutex);
+   return e ? 1 : 0;
+}
+
+
+static void SharkSslCertCache_add(SharkSslCertCache *o, const U8 *digest, const U8 *caList)
+{
+   SharkSslCertCacheEntry *e;
+   ThreadMutex_set(&o->cacheMutex);
+   if (o->cacheSize && !SharkSslCertCache_lookup(o, digest, caList))
+   {
+      SharkSslCertCacheEntry *lru = o->cache;
+      U16 i;
+      for (e = o->cache, i = o->cacheSize; i > 0; i--, e++)
+      {
+         if (e->lastUse < lru->lastUse)
+         {
+            lru = e;
+         }
+      }
+      memcpy(lru->digest, digest, SHARKSSL_SHA256_HASH_LEN);
+      lru->caList = caList;
+      lru->lastUse = SharkSslCertCache_use(o);
+   }
+   ThreadMutex_release(&o->cacheMutex);
+}
+#endif  
 #endif  
 
 #endif  
@@ -46202,6 +48500,24 @@ SHARKSSL_API U8 SharkSsl_setCAList(SharkSsl *o, SharkSslCAList displaysetup)
 
 #define MAX_SHARK_BUF_SIZE 0xFFFF 
 
+/* Dynamic TLS record sizing: a new or idle connection sends records
+   that fit in one TCP segment, letting the peer decrypt the first
+   bytes without waiting for a complete 16K record. Full size records
+   are used when BA_TLS_SMALL_REC_BYTES have been sent. The connection
+   falls back to small records after BA_TLS_SMALL_REC_IDLE
+   milliseconds without sending. Set BA_TLS_SMALL_REC_BYTES to 0 to
+   disable.
+*/
+#ifndef BA_TLS_SMALL_REC_SIZE
+#define BA_TLS_SMALL_REC_SIZE 1360
+#endif
+#ifndef BA_TLS_SMALL_REC_BYTES
+#define BA_TLS_SMALL_REC_BYTES (64*1024)
+#endif
+#ifndef BA_TLS_SMALL_REC_IDLE
+#define BA_TLS_SMALL_REC_IDLE 1000
+#endif
+
 #include <HttpSharkSslServCon.h>
 #include <HttpServer.h>
 #include <HttpTrace.h>
@@ -46211,13 +48527,46 @@ SHARKSSL_API U8 SharkSsl_setCAList(SharkSsl *o, SharkSslCAList displaysetup)
 #include <SharkSslSCMgr.h>
 #endif
 
+/* Linux kernel TLS (kTLS) transmit offload. When enabled, the
+   negotiated write keys are handed to the kernel after the handshake
+   and the application data is sent as plaintext on the socket.
+*/
+#ifndef USE_KTLS
+#define USE_KTLS 0
+#endif
+#if USE_KTLS
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TLS_SET_RECORD_TYPE
+#define TLS_SET_RECORD_TYPE 1
+#endif
+#endif
+
 typedef struct
 {
    SharkSslCon super;
    DoubleLink link;
    SoDispCon* con; /* Owner of BaSharkSslCon */
    char* host;
+   U32 recBytes; /* Bytes sent since entering small record mode */
+   U32 lastSendTime; /* baGetMsClock() when last record was sent */
    U16 port;
+   U16 corkLen; /* Pending plaintext in the SharkSSL output buffer */
+   U8 corked;
+#ifdef HTTP_STATS
+   U8 hsTimed; /* TRUE: record the handshake time when complete */
+   U32 hsStart; /* HttpStats_clock() when accepted */
+#endif
+#if USE_KTLS
+   U8 ktls; /* TRUE: the kernel encrypts the data we send */
+   U8 ktlsTried;
+#endif
 } BaSharkSslCon;
 
 #ifdef HTTP_TRACE
@@ -46250,6 +48599,41 @@ SoDispCon_getSharkAlert(SoDispCon* o, U8* disableerrgen, U8* local1irqdispatch)
 }
 
 
+#if USE_KTLS
+/* SharkSSL encrypts alerts with its own write state, which is stale
+   when the kernel encrypts the data. Send the plaintext alert to the
+   kernel as a record of type alert (21).
+*/
+static void
+BaSharkSslCon_sendKTLSAlert(SoDispCon* con)
+{
+   SharkSslCon* s = (SharkSslCon*)con->sslData;
+   struct msghdr msg;
+   struct iovec iov;
+   struct cmsghdr* cmsg;
+   char cbuf[CMSG_SPACE(sizeof(U8))];
+   U8 alert[2];
+   alert[0] = SharkSslCon_getAlertLevel(s);
+   alert[1] = SharkSslCon_getAlertDescription(s);
+   memset(&msg, 0, sizeof(msg));
+   memset(cbuf, 0, sizeof(cbuf));
+   iov.iov_base = alert;
+   iov.iov_len = sizeof(alert);
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = cbuf;
+   msg.msg_controllen = sizeof(cbuf);
+   cmsg = CMSG_FIRSTHDR(&msg);
+   cmsg->cmsg_level = SOL_TLS;
+   cmsg->cmsg_type = TLS_SET_RECORD_TYPE;
+   cmsg->cmsg_len = CMSG_LEN(sizeof(U8));
+   *CMSG_DATA(cmsg) = 21;
+   if(sendmsg(con->httpSocket.hndl, &msg, MSG_DONTWAIT) > 0)
+      HttpStats_count(HttpStats_BytesOut, sizeof(alert));
+}
+#endif
+
+
 static int
 tsx09parse(SoDispCon* con, int handlersetup)
 {
@@ -46270,6 +48654,13 @@ tsx09parse(SoDispCon* con, int handlersetup)
             "\040\123\150\141\162\153\123\123\114\040\072\040\123\145\156\164\040\141\154\145\162\164\040\155\145\163\163\141\147\145\054\040\154\145\166\145\154\040\045\144\054\040\144\145\163\143\162\151\160\164\151\157\156\040\045\144\012",
             SharkSslCon_getAlertLevel(s),
             SharkSslCon_getAlertDescription(s));
+#endif
+#if USE_KTLS
+         if(((BaSharkSslCon*)s)->ktls)
+         {
+            BaSharkSslCon_sendKTLSAlert(con);
+            return E_SOCKET_WRITE_FAILED;
+         }
 #endif
          x = SharkSslCon_getAlertDataLen(s);
          baAssert(x);
@@ -46359,6 +48750,7 @@ belowstart(SoDispCon* con, ThreadMutex* m, void* buf, int masterclock)
                SoDispCon_clearHasMoreData(con);
                return sockLen;
             }
+            HttpStats_count(HttpStats_BytesIn, sockLen);
             break; 
 
          case SharkSslCon_Decrypted:
@@ -46379,8 +48771,16 @@ belowstart(SoDispCon* con, ThreadMutex* m, void* buf, int masterclock)
          case SharkSslCon_Handshake:
             if ((nb = SharkSslCon_getHandshakeDataLen(s)) != 0)
             {
-               const U8* alloccontroller = SharkSslCon_getHandshakeData(s);
+               const U8* alloccontroller;
+#if USE_KTLS
+               /* The kernel owns the write sequence number */
+               if(((BaSharkSslCon*)s)->ktls)
+                  return E_TLS_HANDSHAKE;
+#endif
+               alloccontroller = SharkSslCon_getHandshakeData(s);
                HttpSocket_send(&con->httpSocket, m, &queueevent, alloccontroller, nb, &sockLen);
+               if(sockLen > 0)
+                  HttpStats_count(HttpStats_BytesOut, sockLen);
                if (nb != sockLen)
                {
                   if ((sockLen < 0) || queueevent || (!SoDispCon_isNonBlocking(con)))
@@ -46396,12 +48796,21 @@ belowstart(SoDispCon* con, ThreadMutex* m, void* buf, int masterclock)
                   {
                      return E_SOCKET_WRITE_FAILED;
                   }
+                  HttpStats_count(HttpStats_BytesOut, sockLen);
                   SoDispCon_setNonblocking(con);
                }
             }
             nb = SharkSslCon_isHandshakeComplete(s);
             if (nb)
             {
+#ifdef HTTP_STATS
+               if(((BaSharkSslCon*)s)->hsTimed)
+               {
+                  ((BaSharkSslCon*)s)->hsTimed=FALSE;
+                  HttpStats_time(HttpStats_TlsHandshake,
+                                 ((BaSharkSslCon*)s)->hsStart);
+               }
+#endif
                if (!buf)
                {
                   sockLen = 0;
@@ -46451,6 +48860,9 @@ handlerfixup(SoDispCon* con,ThreadMutex* m,void* buf,int masterclock)
             {
                return E_SOCKET_WRITE_FAILED;
             }
+            HttpStats_count(HttpStats_BytesOut, nb);
+            if(((BaSharkSslCon*)s)->recBytes < BA_TLS_SMALL_REC_BYTES)
+               ((BaSharkSslCon*)s)->recBytes += (U32)nb;
 
             
             if (SharkSslCon_encryptMore(s))
@@ -46467,11 +48879,211 @@ handlerfixup(SoDispCon* con,ThreadMutex* m,void* buf,int masterclock)
 }
 
 
+#if USE_KTLS
+/* Push the write keys into the kernel TLS module. The connection
+   silently stays in user space if the kernel lacks the tls module or
+   the cipher suite. Only TLS 1.2 is offloaded: a TLS 1.3 server sends
+   post-handshake messages (NewSessionTicket, KeyUpdate) that SharkSSL
+   encrypts with its own write state, which the kernel would own.
+   A TLS 1.2 renegotiation request closes an offloaded connection.
+*/
+static void
+BaSharkSslCon_enableKTLS(SoDispCon* con)
+{
+   BaSharkSslCon* bs = (BaSharkSslCon*)con->sslData;
+   SharkSslCon* s = (SharkSslCon*)bs;
+   SharkSslCipherSuite* cs = s->wCipherSuite;
+   union {
+      struct tls12_crypto_info_aes_gcm_128 gcm128;
+      struct tls12_crypto_info_aes_gcm_256 gcm256;
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+      struct tls12_crypto_info_chacha20_poly1305 chacha;
+#endif
+   } ci;
+   const U8* seq;
+   int size=0;
+   U16 version;
+   bs->ktlsTried=TRUE;
+   if(!cs || s->outBuf.dataLen || bs->corkLen)
+      return;
+#if SHARKSSL_TLS_1_3
+   if(s->minor == SHARKSSL_PROTOCOL_MINOR(SHARKSSL_PROTOCOL_TLS_1_3))
+      return;
+#endif
+   memset(&ci, 0, sizeof(ci));
+   version = TLS_1_2_VERSION;
+#if (SHARKSSL_USE_CHACHA20 && SHARKSSL_USE_POLY1305)
+   /* AES-GCM in TLS 1.2 uses the explicit nonce as sequence number */
+   seq = (cs->flags & suspendenter) ? s->wSeqNum : &s->wIV[4];
+#else
+   seq = &s->wIV[4];
+#endif
+#if SHARKSSL_ENABLE_AES_GCM
+   if(cs->flags & framekernel)
+   {
+      if(cs->keyLen == TLS_CIPHER_AES_GCM_128_KEY_SIZE)
+      {
+         ci.gcm128.info.version = version;
+         ci.gcm128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+         memcpy(ci.gcm128.key, s->wKey, TLS_CIPHER_AES_GCM_128_KEY_SIZE);
+         memcpy(ci.gcm128.salt, s->wIV, TLS_CIPHER_AES_GCM_128_SALT_SIZE);
+         memcpy(ci.gcm128.iv, &s->wIV[4], TLS_CIPHER_AES_GCM_128_IV_SIZE);
+         memcpy(ci.gcm128.rec_seq, seq, TLS_CIPHER_AES_GCM_128_REC_SEQ_SIZE);
+         size = sizeof(ci.gcm128);
+      }
+      else if(cs->keyLen == TLS_CIPHER_AES_GCM_256_KEY_SIZE)
+      {
+         ci.gcm256.info.version = version;
+         ci.gcm256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+         memcpy(ci.gcm256.key, s->wKey, TLS_CIPHER_AES_GCM_256_KEY_SIZE);
+         memcpy(ci.gcm256.salt, s->wIV, TLS_CIPHER_AES_GCM_256_SALT_SIZE);
+         memcpy(ci.gcm256.iv, &s->wIV[4], TLS_CIPHER_AES_GCM_256_IV_SIZE);
+         memcpy(ci.gcm256.rec_seq, seq, TLS_CIPHER_AES_GCM_256_REC_SEQ_SIZE);
+         size = sizeof(ci.gcm256);
+      }
+   }
+#endif
+#if (SHARKSSL_USE_CHACHA20 && SHARKSSL_USE_POLY1305) && defined(TLS_CIPHER_CHACHA20_POLY1305)
+   if(cs->flags & suspendenter)
+   {
+      ci.chacha.info.version = version;
+      ci.chacha.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+      memcpy(ci.chacha.key, s->wKey, TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE);
+      memcpy(ci.chacha.iv, s->wIV, TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE);
+      memcpy(ci.chacha.rec_seq, seq, TLS_CIPHER_CHACHA20_POLY1305_REC_SEQ_SIZE);
+      size = sizeof(ci.chacha);
+   }
+#endif
+   if(size &&
+      !setsockopt(con->httpSocket.hndl, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) &&
+      !setsockopt(con->httpSocket.hndl, SOL_TLS, TLS_TX, &ci, size))
+   {
+      bs->ktls=TRUE;
+   }
+   memset(&ci, 0, sizeof(ci));
+}
+#endif
+
+
+/* Send one record. The data is in the plaintext section of the
+   SharkSSL output buffer when 'data' is NULL.
+*/
+static int
+BaSharkSslCon_send(SoDispCon* con, ThreadMutex* m, U8* data, int len)
+{
+#if USE_KTLS
+   BaSharkSslCon* bs = (BaSharkSslCon*)con->sslData;
+   if(bs->ktls)
+   {
+      int bytes;
+      BaBool queueevent=FALSE;
+      if(con->sendTermPtr) 
+         return E_SOCKET_WRITE_FAILED;
+      con->sendTermPtr=&queueevent;
+      HttpSocket_send(&con->httpSocket,m,&queueevent,
+                      data ? data : SharkSslCon_getEncBufPtr((SharkSslCon*)bs),
+                      len,&bytes);
+      if(queueevent)
+         return E_SOCKET_WRITE_FAILED;
+      con->sendTermPtr=0;
+      if(bytes != len)
+         return E_SOCKET_WRITE_FAILED;
+      HttpStats_count(HttpStats_BytesOut, len);
+      if(bs->recBytes < BA_TLS_SMALL_REC_BYTES)
+         bs->recBytes += (U32)len;
+      return len;
+   }
+#endif
+   return handlerfixup(con, m, data, len);
+}
+
+
+/* Returns the max payload for the next TLS record. */
+static int
+BaSharkSslCon_recSize(BaSharkSslCon* bs)
+{
+   int size = SharkSslCon_getEncBufSize((SharkSslCon*)bs);
+#if BA_TLS_SMALL_REC_BYTES > 0
+   U32 now = (U32)baGetMsClock();
+   if((U32)(now - bs->lastSendTime) > BA_TLS_SMALL_REC_IDLE)
+      bs->recBytes=0;
+   bs->lastSendTime=now;
+   if(bs->recBytes < BA_TLS_SMALL_REC_BYTES && size > BA_TLS_SMALL_REC_SIZE)
+      size = BA_TLS_SMALL_REC_SIZE;
+#endif
+   return size > MAX_SHARK_BUF_SIZE ? MAX_SHARK_BUF_SIZE : size;
+}
+
+
+/* Encrypt and send data coalesced by a corked connection. The data is
+   in the plaintext section of the SharkSSL output buffer.
+*/
+static int
+BaSharkSslCon_flushCork(SoDispCon* con, ThreadMutex* m)
+{
+   BaSharkSslCon* bs = (BaSharkSslCon*)con->sslData;
+   if(bs->corkLen)
+   {
+      int len = bs->corkLen;
+      bs->corkLen=0;
+      len = BaSharkSslCon_send(con, m, 0, len);
+      return len < 0 ? len : 0;
+   }
+   return 0;
+}
+
+
+static int
+BaSharkSslCon_write(SoDispCon* con, ThreadMutex* m, U8* data, int len)
+{
+   BaSharkSslCon* bs = (BaSharkSslCon*)con->sslData;
+   int ix=len;
+#if USE_KTLS
+   if(!bs->ktlsTried && !bs->corkLen &&
+      SharkSslCon_isHandshakeComplete((SharkSslCon*)bs))
+   {
+      BaSharkSslCon_enableKTLS(con);
+   }
+#endif
+   while(ix)
+   {
+      int rsp;
+      int size = BaSharkSslCon_recSize(bs);
+      if(bs->corked)
+      {
+         int chunk = size - bs->corkLen;
+         if(chunk > 0)
+         {
+            if(chunk > ix)
+               chunk = ix;
+            memcpy(SharkSslCon_getEncBufPtr((SharkSslCon*)bs)+bs->corkLen,
+                   data, chunk);
+            bs->corkLen += (U16)chunk;
+            data += chunk;
+            ix -= chunk;
+         }
+         rsp = bs->corkLen >= size ? BaSharkSslCon_flushCork(con, m) : 0;
+      }
+      else
+      {
+         int chunk = ix > size ? size : ix;
+         rsp=BaSharkSslCon_send(con, m, data, chunk);
+         data += chunk;
+         ix -= chunk;
+      }
+      if(rsp < 0)
+         return rsp;
+   }
+   return len;
+}
+
+
 static int
 timerretrigger(SoDispCon* con, int len)
 {
    int rebootnotifier, handlersetup;
    U16* enablelevel;
+   U8* alloccontroller;
    BaBool queueevent=FALSE;
    ThreadMutex* m=0;
 
@@ -46480,22 +49092,42 @@ timerretrigger(SoDispCon* con, int len)
 
    baAssert(len <= SharkSslCon_getEncBufSize(con->sslData));
    rebootnotifier = SharkSslCon_getEncDataLen(con->sslData);
-   if ( ! rebootnotifier )
+#if USE_KTLS
+   if(((BaSharkSslCon*)con->sslData)->ktls)
    {
-      if (len == 0) 
-         return 1;  
-      handlersetup = SharkSslCon_encrypt(con->sslData, 0, (U16)len);
-      if (handlersetup != SharkSslCon_Encrypted)
-         return tsx09parse(con, handlersetup);
-      rebootnotifier = SharkSslCon_getEncDataLen(con->sslData);
+      /* Plaintext in the asynch buffer; the kernel encrypts. */
+      if ( ! rebootnotifier )
+      {
+         if (len == 0) 
+            return 1;  
+         ((SharkSslCon*)con->sslData)->outBuf.temp = 0;
+         ((SharkSslCon*)con->sslData)->outBuf.dataLen = (U16)len;
+         rebootnotifier = len;
+      }
+      alloccontroller = SharkSslCon_getEncBufPtr(con->sslData);
+   }
+   else
+#endif
+   {
+      if ( ! rebootnotifier )
+      {
+         if (len == 0) 
+            return 1;  
+         handlersetup = SharkSslCon_encrypt(con->sslData, 0, (U16)len);
+         if (handlersetup != SharkSslCon_Encrypted)
+            return tsx09parse(con, handlersetup);
+         rebootnotifier = SharkSslCon_getEncDataLen(con->sslData);
+      }
+      alloccontroller = SharkSslCon_getEncData(con->sslData);
    }
    enablelevel = &((SharkSslCon*)con->sslData)->outBuf.temp;
    len = rebootnotifier - *enablelevel;
    HttpSocket_send(&con->httpSocket, m, &queueevent,
-                   SharkSslCon_getEncData(con->sslData)+*enablelevel, len, &len);
+                   alloccontroller+*enablelevel, len, &len);
    (void)queueevent;
    if (len < 0 || !SoDispCon_isValid(con))
       return E_SOCKET_WRITE_FAILED; 
+   HttpStats_count(HttpStats_BytesOut, len);
    *enablelevel += (U16)len;
    baAssert(*enablelevel <= rebootnotifier);
    if (*enablelevel == rebootnotifier)
@@ -46531,29 +49163,32 @@ registersubpacket(
    switch(s)
    {
       case SoDispCon_ExTypeRead:
+         if(((BaSharkSslCon*)con->sslData)->corkLen)
+         {
+            /* The decrypt may use the output buffer (alerts etc.) */
+            int rsp = BaSharkSslCon_flushCork(con, m);
+            if(rsp < 0)
+               return rsp;
+         }
          return belowstart(con, m, alloccontroller, len);
 
       case SoDispCon_ExTypeWrite:
-         if(len > MAX_SHARK_BUF_SIZE)
+         return BaSharkSslCon_write(con, m, (U8*)alloccontroller, len);
+
+      case SoDispCon_ExTypeCork:
+         if(len)
          {
-            U8* ptr=(U8*)alloccontroller;
-            int ix=len;
-            while(ix)
-            {
-               int devicelcdspi = ix > MAX_SHARK_BUF_SIZE ? MAX_SHARK_BUF_SIZE : ix;
-               int rsp=handlerfixup(con, m, ptr, devicelcdspi);
-               if(rsp < 0)
-                  return rsp;
-               ptr += devicelcdspi;
-               ix -= devicelcdspi;
-            }
-            return len;
+            ((BaSharkSslCon*)con->sslData)->corked=TRUE;
+            return 0;
          }
-         return handlerfixup(con, m, alloccontroller, len);
+         ((BaSharkSslCon*)con->sslData)->corked=FALSE;
+         return BaSharkSslCon_flushCork(con, m);
 
       case SoDispCon_ExTypeIdle: 
          
          ((SharkSslCon*)con->sslData)->outBuf.dataLen = 0;
+         ((BaSharkSslCon*)con->sslData)->corked=FALSE;
+         ((BaSharkSslCon*)con->sslData)->corkLen=0;
          return FALSE; 
 
       case SoDispCon_GetSharkSslCon:
@@ -46600,6 +49235,8 @@ registersubpacket(
       }
 
       case SoDispCon_ExTypeMoveCon:
+         ((BaSharkSslCon*)con->sslData)->corked=FALSE;
+         BaSharkSslCon_flushCork(con, 0);
       L_ExTypeMoveCon:
          ((SoDispCon*)alloccontroller)->exec = registersubpacket;
          ((SoDispCon*)alloccontroller)->sslData = con->sslData;
@@ -46609,6 +49246,8 @@ registersubpacket(
          return 0;
 
       case SoDispCon_ExTypeAllocAsynchBuf:
+         ((BaSharkSslCon*)con->sslData)->corked=FALSE;
+         BaSharkSslCon_flushCork(con, 0);
          ((AllocAsynchBufArgs*)alloccontroller)->retVal =
             SharkSslCon_getEncBufPtr(con->sslData);
          ((AllocAsynchBufArgs*)alloccontroller)->size =
@@ -46634,7 +49273,10 @@ erratumworkaround(HttpSharkSslServCon* o)
    int sffsdrnandflash;
    SoDispCon* fdc37m81xconfig = (SoDispCon*)o;
    HttpServer* uarchbuild = HttpConnection_getServer((HttpConnection*)fdc37m81xconfig);
-   SoDispCon* boardmanufacturer = (SoDispCon*)HttpServer_getFreeCon(uarchbuild);
+   SoDispCon* boardmanufacturer;
+   if(servConStopped(fdc37m81xconfig))
+      return;
+   boardmanufacturer = (SoDispCon*)HttpServer_getFreeCon(uarchbuild);
    if(boardmanufacturer)
    {
      L_tryAgain:
@@ -46642,9 +49284,14 @@ erratumworkaround(HttpSharkSslServCon* o)
       if( ! sffsdrnandflash )
       {
          BaSharkSslCon* bs = (BaSharkSslCon*)baMalloc(sizeof(BaSharkSslCon));
+         HttpStats_count(HttpStats_Accepted, 1);
          if (bs)
          {
             memset(bs, 0, sizeof(BaSharkSslCon));
+#ifdef HTTP_STATS
+            bs->hsStart=HttpStats_clock();
+            bs->hsTimed=TRUE;
+#endif
             SharkSsl_createCon2(o->sharkSsl,(SharkSslCon*)bs);
             if(o->favorRSA) SharkSslCon_favorRSA((SharkSslCon*)bs, TRUE);
             DoubleLink_constructor(&bs->link);
@@ -46669,6 +49316,7 @@ erratumworkaround(HttpSharkSslServCon* o)
       if( ! HttpServer_termOldestIdleCon(uarchbuild) )
          goto L_tryAgain;
       HttpServer_returnFreeCon(uarchbuild, (HttpConnection*)boardmanufacturer);
+      HttpStats_count(HttpStats_AcceptFailed, 1);
    }
    else
    {  
@@ -46677,6 +49325,7 @@ erratumworkaround(HttpSharkSslServCon* o)
       SoDispCon_constructor(&con,0,0);
       HttpSocket_accept(&fdc37m81xconfig->httpSocket, &con.httpSocket, &sffsdrnandflash);
       SoDispCon_destructor(&con);
+      HttpStats_count(HttpStats_AcceptFailed, 1);
       TRPR(("\123\145\162\166\145\162\040\143\157\156\156\145\143\164\151\157\156\163\040\145\170\150\141\165\163\164\145\144\012"));
    }
    TRPR(("\110\164\164\160\123\145\162\166\103\157\156\072\072\167\145\142\123\145\162\166\145\162\101\143\143\145\160\164\105\166\040\146\141\151\154\145\144\072\045\163\040\045\144\012",
@@ -46693,6 +49342,8 @@ rangeparser(HttpSharkSslServCon* o)
    int sffsdrnandflash;
    HttpConnection* hCon = (HttpConnection*)o; 
    SoDispCon* soCon = (SoDispCon*)o; 
+   if(servConStopped(soCon))
+      return;
 #ifndef NO_BA_SERVER
 L_tryAgain:
 #endif
@@ -46701,9 +49352,14 @@ L_tryAgain:
    if( ! sffsdrnandflash )
    {
       BaSharkSslCon* bs = (BaSharkSslCon*)baMalloc(sizeof(BaSharkSslCon));
+      HttpStats_count(HttpStats_Accepted, 1);
       if (bs)
       {
          memset(bs, 0, sizeof(BaSharkSslCon));
+#ifdef HTTP_STATS
+         bs->hsStart=HttpStats_clock();
+         bs->hsTimed=TRUE;
+#endif
          SharkSsl_createCon2(o->sharkSsl,(SharkSslCon*)bs);
          if(o->favorRSA) SharkSslCon_favorRSA((SharkSslCon*)bs, TRUE);
          DoubleLink_constructor(&bs->link);
@@ -52567,20 +55223,719 @@ SHARKSSL_API int SharkSslECCKey_createEx(SharkSslECCKey *mcbspplatform, U16 defa
 #endif
 
 #include "WebSocketServer.h"
+#ifndef NO_ZLIB
+#include <zlib.h>
+#endif
+
+/* WSS::pmd flags */
+#define WSS_PMD_ON 1
+#define WSS_PMD_SERVER_NO_CTX 2
+#define WSS_PMD_CLIENT_NO_CTX 4
+
+/* The permessage-deflate "compressed" bit in the first frame byte */
+#define WSS_RSV1 0x40
+
+BA_API WSSFrame*
+WSSFrame_rawCreate(const void* alloccontroller, int len, int buddyavail)
+{
+   WSSFrame* o;
+   int hlen = len < 126 ? 2 : (len <= 0xFFFF ? 4 : 10);
+   if(len < 0)
+      return 0;
+   o = (WSSFrame*)baMalloc(sizeof(WSSFrame)+hlen+len);
+   if(o)
+   {
+      U8* ptr = o->data;
+      o->refCnt=1;
+      o->len=hlen+len;
+      o->deflated=0;
+      o->deflatedBy=0;
+      *ptr++ = 0x80 | (U8)buddyavail;
+      if(len < 126)
+      {
+         *ptr++ = (U8)len;
+      }
+      else if(len <= 0xFFFF)
+      {
+         *ptr++ = 126;
+         *ptr++ = (U8)((unsigned)len >> 8);
+         *ptr++ = (U8)len;
+      }
+      else
+      {
+         *ptr++ = 127;
+         *ptr++ = 0;
+         *ptr++ = 0;
+         *ptr++ = 0;
+         *ptr++ = 0;
+         *ptr++ = (U8)((unsigned)len >> 24);
+         *ptr++ = (U8)((unsigned)len >> 16);
+         *ptr++ = (U8)((unsigned)len >> 8);
+         *ptr++ = (U8)len;
+      }
+      if(len)
+         memcpy(ptr, alloccontroller, len);
+   }
+   return o;
+}
+
+
+BA_API void
+WSSFrame_release(WSSFrame* o)
+{
+   baAssert(o->refCnt);
+   if(--o->refCnt == 0)
+   {
+      if(o->deflated)
+         WSSFrame_release(o->deflated);
+      baFree(o);
+   }
+}
+
+
+#ifndef NO_ZLIB
+
+BA_API void
+WSSDeflate_constructor(
+   WSSDeflate* o, int level, BaBool serverNoContextTakeover)
+{
+   memset(o, 0, sizeof(WSSDeflate));
+   o->level = (U8)(level < 1 ? 1 : (level > 9 ? 9 : level));
+   o->memLevel=8;
+   o->serverWindowBits=15;
+   o->clientWindowBits=15;
+   o->serverNoContextTakeover = serverNoContextTakeover ? TRUE : FALSE;
+   o->maxMessageSize=0xFFFF;
+   o->minSize=64;
+}
+
+
+BA_API void
+WSSDeflate_destructor(WSSDeflate* o)
+{
+   if(o->strm)
+   {
+      deflateEnd((z_streamp)o->strm);
+      baFree(o->strm);
+      o->strm=0;
+   }
+   if(o->outBuf)
+   {
+      baFree(o->outBuf);
+      o->outBuf=0;
+   }
+   if(o->inBuf)
+   {
+      baFree(o->inBuf);
+      o->inBuf=0;
+   }
+   o->outBufSize=o->inBufSize=0;
+}
+
+
+BA_API void
+WSSDeflate_setWindowBits(WSSDeflate* o, int serverBits, int clientBits)
+{
+   /* zlib's deflate does not support an 8 bit window */
+   o->serverWindowBits=(U8)(serverBits<9 ? 9 : (serverBits>15 ? 15 : serverBits));
+   o->clientWindowBits=(U8)(clientBits<8 ? 8 : (clientBits>15 ? 15 : clientBits));
+}
+
+
+static z_streamp
+wssDeflateInit(WSSDeflate* d, int windowBits)
+{
+   z_streamp strm = (z_streamp)baMalloc(sizeof(z_stream));
+   if(strm)
+   {
+      memset(strm, 0, sizeof(z_stream));
+      /* Negative window bits: raw deflate data without a zlib header */
+      if(deflateInit2(strm, d->level, Z_DEFLATED, -windowBits,
+                      d->memLevel, Z_DEFAULT_STRATEGY) != Z_OK)
+      {
+         baFree(strm);
+         strm=0;
+      }
+   }
+   return strm;
+}
+
+
+/* Compress one message payload into a new frame. Sets *cf to NULL
+ * when 'optional' is set and compression does not make the message
+ * smaller.
+ */
+static int
+wssDeflateMsg(WSSDeflate* d, z_streamp strm, U8* data, int len,
+              int opCode, BaBool optional, WSSFrame** cf)
+{
+   U32 bound = (U32)len + ((U32)len >> 12) + ((U32)len >> 14) + 32;
+   U32 n;
+   *cf=0;
+   if(d->outBufSize < bound)
+   {
+      U8* buf = (U8*)baRealloc(d->outBuf, bound);
+      if( ! buf )
+         return E_MALLOC;
+      d->outBuf=buf;
+      d->outBufSize=bound;
+   }
+   strm->next_in=data;
+   strm->avail_in=(uInt)len;
+   strm->next_out=d->outBuf;
+   strm->avail_out=(uInt)bound;
+   if(deflate(strm, Z_SYNC_FLUSH) != Z_OK || strm->avail_in ||
+      ! strm->avail_out)
+   {
+      return -1;
+   }
+   n = bound - strm->avail_out;
+   if(n < 4)
+      return -1;
+   n -= 4; /* Remove the 00 00 FF FF tail added by Z_SYNC_FLUSH */
+   if(optional && n >= (U32)len)
+      return 0;
+   if( (*cf = WSSFrame_rawCreate(d->outBuf, (int)n, opCode)) == 0 )
+      return E_MALLOC;
+   (*cf)->data[0] |= WSS_RSV1;
+   return 0;
+}
+
+
+/* Returns a referenced frame, either 'f' or the compressed version
+ * of 'f', or NULL on error.
+ */
+static WSSFrame*
+wssCompress(WSS* o, WSSFrame* f)
+{
+   WSSDeflate* d = o->deflate;
+   WSSFrame* cf;
+   z_streamp strm;
+   int hlen, len, sffsdrnandflash;
+   int opCode = f->data[0] & 0x0F;
+   if((opCode != 1 && opCode != 2) || (f->data[0] & WSS_RSV1))
+      goto L_plain;
+   len = f->data[1] & 0x7F;
+   hlen = len == 126 ? 4 : (len == 127 ? 10 : 2);
+   len = f->len - hlen;
+   if( ! len || (U32)len < d->minSize )
+      goto L_plain;
+   if( ! (o->pmd & WSS_PMD_SERVER_NO_CTX) )
+   {
+      /* The client's decompressor depends on all previous messages,
+       * thus a compressed message is always sent.
+       */
+      if( ! o->defStrm &&
+          (o->defStrm=wssDeflateInit(d, o->serverWindowBits)) == 0 )
+      {
+         return 0;
+      }
+      if(wssDeflateMsg(d, (z_streamp)o->defStrm, f->data+hlen, len,
+                       opCode, FALSE, &cf))
+      {
+         return 0;
+      }
+      return cf;
+   }
+   if(o->serverWindowBits == d->serverWindowBits)
+   {
+      /* Compress once; the result is shared by all connections
+       * using this configuration.
+       */
+      if(f->deflatedBy != d)
+      {
+         if( ! d->strm )
+         {
+            if( (d->strm=wssDeflateInit(d, d->serverWindowBits)) == 0 )
+               return 0;
+         }
+         else
+            deflateReset((z_streamp)d->strm);
+         if(wssDeflateMsg(d, (z_streamp)d->strm, f->data+hlen, len,
+                          opCode, TRUE, &cf))
+         {
+            return 0;
+         }
+         if(f->deflated)
+            WSSFrame_release(f->deflated);
+         f->deflated=cf;
+         f->deflatedBy=d;
+      }
+      if(f->deflated)
+      {
+         WSSFrame_retain(f->deflated);
+         return f->deflated;
+      }
+      goto L_plain;
+   }
+   /* The client requested a smaller window */
+   if( (strm=wssDeflateInit(d, o->serverWindowBits)) == 0 )
+      return 0;
+   sffsdrnandflash=wssDeflateMsg(d,strm,f->data+hlen,len,opCode,TRUE,&cf);
+   deflateEnd(strm);
+   baFree(strm);
+   if(sffsdrnandflash)
+      return 0;
+   if(cf)
+      return cf;
+  L_plain:
+   WSSFrame_retain(f);
+   return f;
+}
+
+
+/* Decompress a received message into the shared buffer d->inBuf.
+ */
+static int
+wssInflate(WSS* o, U8* data, U32 len, U8** out, U32* outLen)
+{
+   static const U8 tail[4] = {0, 0, 0xFF, 0xFF};
+   WSSDeflate* d = o->deflate;
+   z_streamp strm = (z_streamp)o->infStrm;
+   U32 size=0;
+   int i, sffsdrnandflash=0;
+   if( ! strm )
+   {
+      if( (strm = (z_streamp)baMalloc(sizeof(z_stream))) == 0 )
+         return E_MALLOC;
+      memset(strm, 0, sizeof(z_stream));
+      if(inflateInit2(strm, -(int)o->clientWindowBits) != Z_OK)
+      {
+         baFree(strm);
+         return E_MALLOC;
+      }
+      o->infStrm=strm;
+   }
+   for(i=0 ; i < 2 && ! sffsdrnandflash ; i++)
+   {
+      strm->next_in = i ? (Bytef*)tail : data;
+      strm->avail_in = i ? 4 : (uInt)len;
+      do
+      {
+         int rc;
+         if(size+1 >= d->inBufSize)
+         {
+            /* Grow, but not beyond maxMessageSize + terminator + 1 */
+            U32 max = d->maxMessageSize + 2;
+            U32 newSize = d->inBufSize ? d->inBufSize * 2 : 1024;
+            U8* buf;
+            if(d->inBufSize >= max)
+            {
+               sffsdrnandflash=E_TOO_MUCH_DATA;
+               break;
+            }
+            if(newSize > max)
+               newSize = max;
+            if( (buf = (U8*)baRealloc(d->inBuf, newSize)) == 0 )
+            {
+               sffsdrnandflash=E_MALLOC;
+               break;
+            }
+            d->inBuf=buf;
+            d->inBufSize=newSize;
+         }
+         strm->next_out = d->inBuf + size;
+         strm->avail_out = (uInt)(d->inBufSize - size - 1);
+         rc = inflate(strm, Z_SYNC_FLUSH);
+         size = d->inBufSize - 1 - strm->avail_out;
+         if(rc == Z_STREAM_END)
+            inflateReset(strm);
+         else if(rc == Z_BUF_ERROR)
+         {
+            if(strm->avail_out)
+               break; /* All input consumed */
+         }
+         else if(rc != Z_OK)
+         {
+            sffsdrnandflash=-1;
+            break;
+         }
+      } while(strm->avail_in || ! strm->avail_out);
+   }
+   if( ! sffsdrnandflash && size > d->maxMessageSize )
+      sffsdrnandflash=E_TOO_MUCH_DATA;
+   if(sffsdrnandflash || (o->pmd & WSS_PMD_CLIENT_NO_CTX))
+   {
+      inflateEnd(strm);
+      baFree(strm);
+      o->infStrm=0;
+   }
+   if(sffsdrnandflash)
+      return sffsdrnandflash;
+   d->inBuf[size]=0;
+   *out=d->inBuf;
+   *outLen=size;
+   return 0;
+}
+
+
+static int
+wssExtCmp(const char* tok, int len, const char* name)
+{
+   return (int)strlen(name) == len ? baStrnCaseCmp(tok, name, len) : -1;
+}
+
+
+/* Returns the next token in a Sec-WebSocket-Extensions value and a
+ * pointer to the first separator, if any, following the token.
+ */
+static const char*
+wssExtToken(const char* p, const char** tok, int* len)
+{
+   while(*p == ' ' || *p == '\t') p++;
+   if(*p == '"')
+   {
+      *tok = ++p;
+      while(*p && *p != '"') p++;
+      *len = (int)(p - *tok);
+      if(*p) p++;
+   }
+   else
+   {
+      *tok = p;
+      while(*p && *p != ',' && *p != ';' && *p != '=' &&
+            *p != ' ' && *p != '\t') p++;
+      *len = (int)(p - *tok);
+   }
+   while(*p == ' ' || *p == '\t') p++;
+   return p;
+}
+
+
+/* Select the first acceptable permessage-deflate offer, set the
+ * negotiated parameters, and create the response header value.
+ */
+static BaBool
+wssNegotiate(WSS* o, const char* p, char* resp, int respSize)
+{
+   WSSDeflate* d = o->deflate;
+   while(*p)
+   {
+      const char* tok;
+      int len, serverBits=0, clientBits=0;
+      U8 seen=0;
+      BaBool ok;
+      p = wssExtToken(p, &tok, &len);
+      ok = wssExtCmp(tok, len, "\160\145\162\155\145\163\163\141\147\145\055\144\145\146\154\141\164\145") ? FALSE : TRUE;
+      while(*p == ';')
+      {
+         const char* val=0;
+         int vlen=0, bits=0;
+         U8 bit;
+         p = wssExtToken(p+1, &tok, &len);
+         if(*p == '=')
+         {
+            p = wssExtToken(p+1, &val, &vlen);
+            if(vlen == 1 && *val >= '8' && *val <= '9')
+               bits = *val - '0';
+            else if(vlen == 2 && val[0] == '1' && val[1] >= '0' && val[1] <= '5')
+               bits = 10 + val[1] - '0';
+            else
+               ok=FALSE;
+         }
+         if( ! wssExtCmp(tok, len, "\163\145\162\166\145\162\137\156\157\137\143\157\156\164\145\170\164\137\164\141\153\145\157\166\145\162") )
+         {
+            bit=1;
+            if(val) ok=FALSE;
+         }
+         else if( ! wssExtCmp(tok, len, "\143\154\151\145\156\164\137\156\157\137\143\157\156\164\145\170\164\137\164\141\153\145\157\166\145\162") )
+         {
+            bit=2;
+            if(val) ok=FALSE;
+         }
+         else if( ! wssExtCmp(tok, len, "\163\145\162\166\145\162\137\155\141\170\137\167\151\156\144\157\167\137\142\151\164\163") )
+         {
+            bit=4;
+            if( ! val ) ok=FALSE;
+            serverBits=bits;
+         }
+         else if( ! wssExtCmp(tok, len, "\143\154\151\145\156\164\137\155\141\170\137\167\151\156\144\157\167\137\142\151\164\163") )
+         {
+            bit=8;
+            clientBits = val ? bits : 15;
+         }
+         else
+         {
+            bit=0;
+            ok=FALSE;
+         }
+         if(seen & bit)
+            ok=FALSE;
+         seen |= bit;
+      }
+      if(*p && *p != ',')
+         ok=FALSE;
+      if(ok && (seen & 4) && serverBits < 9)
+         ok=FALSE; /* 8 is not supported by zlib's deflate */
+      if(ok && ! (seen & 8) && d->clientWindowBits < 15)
+         ok=FALSE; /* Client cannot limit its window */
+      if(ok)
+      {
+         int n;
+         o->pmd = WSS_PMD_ON;
+         if(d->serverNoContextTakeover || (seen & 1))
+            o->pmd |= WSS_PMD_SERVER_NO_CTX;
+         if(d->clientNoContextTakeover || (seen & 2))
+            o->pmd |= WSS_PMD_CLIENT_NO_CTX;
+         o->serverWindowBits = (seen & 4) && serverBits < d->serverWindowBits ?
+            (U8)serverBits : d->serverWindowBits;
+         o->clientWindowBits = (seen & 8) && clientBits < d->clientWindowBits ?
+            (U8)clientBits : d->clientWindowBits;
+         n = basnprintf(resp, respSize, "\160\145\162\155\145\163\163\141\147\145\055\144\145\146\154\141\164\145\045\163\045\163",
+                        (o->pmd & WSS_PMD_SERVER_NO_CTX) ?
+                        "\073\040\163\145\162\166\145\162\137\156\157\137\143\157\156\164\145\170\164\137\164\141\153\145\157\166\145\162" : "",
+                        (o->pmd & WSS_PMD_CLIENT_NO_CTX) ?
+                        "\073\040\143\154\151\145\156\164\137\156\157\137\143\157\156\164\145\170\164\137\164\141\153\145\157\166\145\162" : "");
+         if((seen & 4) || o->serverWindowBits < 15)
+         {
+            n += basnprintf(resp+n, respSize-n,
+                            "\073\040\163\145\162\166\145\162\137\155\141\170\137\167\151\156\144\157\167\137\142\151\164\163\075\045\144",
+                            o->serverWindowBits);
+         }
+         if(seen & 8)
+         {
+            basnprintf(resp+n, respSize-n,
+                       "\073\040\143\154\151\145\156\164\137\155\141\170\137\167\151\156\144\157\167\137\142\151\164\163\075\045\144",
+                       o->clientWindowBits);
+         }
+         return TRUE;
+      }
+      while(*p && *p != ',') p++;
+      if(*p) p++;
+   }
+   return FALSE;
+}
+
+#endif /* NO_ZLIB */
+
+
+static void
+wssPmdRelease(WSS* o)
+{
+#ifndef NO_ZLIB
+   if(o->defStrm)
+   {
+      deflateEnd((z_streamp)o->defStrm);
+      baFree(o->defStrm);
+      o->defStrm=0;
+   }
+   if(o->infStrm)
+   {
+      inflateEnd((z_streamp)o->infStrm);
+      baFree(o->infStrm);
+      o->infStrm=0;
+   }
+#endif
+   o->pmd=0;
+}
+
+
+static void
+wssQueueClear(WSS* o)
+{
+   while(o->queueLen)
+   {
+      WSSFrame_release(o->queue[o->queueHead]);
+      o->queueHead = (o->queueHead+1) % o->queueSize;
+      o->queueLen--;
+   }
+   o->queueHead=0;
+   o->queuedBytes=0;
+   o->sent=0;
+   o->asyncPending=FALSE;
+}
+
 
 static int
 simulateldrstr(WSS* o, int flushoffset)
 {
    SoDispCon_closeCon((SoDispCon*)o);
+   wssQueueClear(o);
+   wssPmdRelease(o);
    o->cb->closeFp(o->cb, o, flushoffset);
    return 1;
 }
 
 
+/* Send queued frames until the queue is empty or the socket cannot
+ * accept more data. The send event is active while data is pending.
+ */
+static int
+wssFlush(WSS* o)
+{
+   SoDispCon* con = (SoDispCon*)o;
+   int sffsdrnandflash;
+   for(;;)
+   {
+      WSSFrame* f;
+      BaBool blocked;
+      if(o->asyncPending)
+      {
+         if( (sffsdrnandflash=SoDispCon_asyncReady(con)) <= 0 )
+         {
+            if(sffsdrnandflash < 0)
+               return sffsdrnandflash;
+            break;
+         }
+         o->asyncPending=FALSE;
+      }
+      if( ! o->queueLen )
+      {
+         if(SoDispCon_sendEvActive(con))
+            SoDisp_deactivateSend(con->dispatcher, con);
+         return 0;
+      }
+      f = o->queue[o->queueHead];
+#ifndef NO_ZLIB
+      if(o->pmd && ! o->sent && ! (f->data[0] & WSS_RSV1))
+      {
+         /* Compressing when the frame is sent and not when queued
+          * avoids compressing frames removed by the queue policy.
+          */
+         WSSFrame* cf = wssCompress(o, f);
+         if( ! cf )
+            return E_MALLOC;
+         o->queue[o->queueHead] = cf;
+         o->queuedBytes = o->queuedBytes - (U32)f->len + (U32)cf->len;
+         WSSFrame_release(f);
+         f = cf;
+      }
+#endif
+      if(SoDispCon_isSecure(con))
+      {
+         /* The frame is encrypted in the TLS connection's asynch buffer */
+         int size = f->len - o->sent;
+         U8* buf = (U8*)SoDispCon_allocAsynchBuf(con, &size);
+         if( ! buf )
+            return E_MALLOC;
+         if(size > f->len - o->sent)
+            size = f->len - o->sent;
+         memcpy(buf, f->data + o->sent, size);
+         o->sent += size;
+         if( (sffsdrnandflash=SoDispCon_asyncSend(con, size)) < 0 )
+            return sffsdrnandflash;
+         blocked = o->asyncPending = sffsdrnandflash ? FALSE : TRUE;
+      }
+      else
+      {
+         /* Non blocking: returns the number of bytes the socket accepted */
+         sffsdrnandflash = con->exec(con, 0, SoDispCon_ExTypeWrite,
+                               f->data + o->sent, f->len - o->sent);
+         if(sffsdrnandflash < 0)
+            return sffsdrnandflash;
+         o->sent += sffsdrnandflash;
+         blocked = o->sent < f->len;
+      }
+      if(o->sent == f->len)
+      {
+         o->queuedBytes -= (U32)f->len;
+         o->queueHead = (o->queueHead+1) % o->queueSize;
+         o->queueLen--;
+         o->sent=0;
+         WSSFrame_release(f);
+      }
+      if(blocked)
+         break;
+   }
+   if( ! SoDispCon_sendEvActive(con) )
+      SoDisp_activateSend(con->dispatcher, con);
+   return 0;
+}
+
+
+static void
+wssSendEv(SoDispCon* con)
+{
+   int sffsdrnandflash = wssFlush((WSS*)con);
+   if(sffsdrnandflash < 0)
+      simulateldrstr((WSS*)con, sffsdrnandflash);
+}
+
+
+/* Control frames bypass the byte limit and the queue policy. A
+ * control frame is dropped if the queue has no free entry.
+ */
+static int
+wssEnqueue(WSS* o, WSSFrame* f, BaBool isCtrl)
+{
+   if(o->queueLen && (o->queueLen == o->queueSize ||
+                      o->queuedBytes + (U32)f->len > o->maxQueuedBytes))
+   {
+      if(isCtrl)
+      {
+         if(o->queueLen == o->queueSize)
+            return 0;
+      }
+      else if(o->policy == WSS_QueueDisconnect)
+      {
+         if(o->inRecEv)
+         {
+            /* Called from this connection's own callback: the
+             * receive event handler calls closeFp when it returns.
+             */
+            SoDispCon_closeCon((SoDispCon*)o);
+            wssQueueClear(o);
+            wssPmdRelease(o);
+            o->pendingClose=E_TOO_MUCH_DATA;
+         }
+         else
+            simulateldrstr(o, E_TOO_MUCH_DATA);
+         return E_TOO_MUCH_DATA;
+      }
+      else if(o->policy == WSS_QueueCoalesce)
+      {
+         /* Remove all frames except a partially sent frame */
+         while(o->queueLen > (o->sent ? 1 : 0))
+         {
+            WSSFrame** fp =
+               o->queue + (o->queueHead+o->queueLen-1) % o->queueSize;
+            o->queuedBytes -= (U32)(*fp)->len;
+            o->queueLen--;
+            WSSFrame_release(*fp);
+         }
+         if(o->queueLen == o->queueSize)
+            return E_TOO_MUCH_DATA;
+      }
+      else
+         return E_TOO_MUCH_DATA;
+   }
+   o->queue[(o->queueHead+o->queueLen) % o->queueSize] = f;
+   WSSFrame_retain(f);
+   o->queueLen++;
+   o->queuedBytes += (U32)f->len;
+   if( ! SoDispCon_sendEvActive((SoDispCon*)o) )
+      return wssFlush(o);
+   return 0;
+}
+
+
+static int
+wssSendCtrl(WSS* o, const void* alloccontroller, int len, int buddyavail)
+{
+   int sffsdrnandflash;
+   WSSFrame* f = WSSFrame_rawCreate(alloccontroller, len, buddyavail);
+   if( ! f )
+      return E_MALLOC;
+   sffsdrnandflash = wssEnqueue(o, f, TRUE);
+   WSSFrame_release(f);
+   return sffsdrnandflash;
+}
+
+
 static int
 ictlrmatch(WSS* o, int flushoffset, int sectionsearly)
 {
    U8* buf;
+   if(o->queue)
+   {
+      U8 payload[2];
+      payload[0] = (U8)((unsigned)flushoffset >> 8);
+      payload[1] = (U8)flushoffset;
+      wssSendCtrl(o, payload, flushoffset ? 2 : 0, 0x8);
+      if(sectionsearly)
+         return simulateldrstr(o, flushoffset);
+      return -1;
+   }
    DynBuffer_expand(&o->db, o->db.expandSize);
    buf = (U8*)DynBuffer_getBuf(&o->db);
    if(!buf)
@@ -52672,6 +56027,12 @@ ahashqueued(WSS* o)
           
          *sdramstandby ^= prussresources[i&3];
       }
+      if(bp->buf[0] & 0x70)
+      {
+         /* RSV1 is the permessage-deflate bit, valid for data frames */
+         if((bp->buf[0] & 0x70) != WSS_RSV1 || ! o->pmd || (bp->buf[0] & 0x08))
+            return ictlrmatch(o, 1002, TRUE);
+      }
       i=FALSE;
       switch(bp->buf[0] & 0x0F) 
       {
@@ -52679,10 +56040,31 @@ ahashqueued(WSS* o)
             i=TRUE;
             
          case 0x2: 
+#ifndef NO_ZLIB
+            if(bp->buf[0] & WSS_RSV1)
+            {
+               U8* data;
+               U32 dlen;
+               sffsdrnandflash=wssInflate(
+                  o, (U8*)bp->buf+idmapstart, pl, &data, &dlen);
+               if(sffsdrnandflash)
+               {
+                  return ictlrmatch(o, sffsdrnandflash == E_TOO_MUCH_DATA ?
+                                    1009 : (sffsdrnandflash == E_MALLOC ?
+                                            1011 : 1007), TRUE);
+               }
+               o->cb->frameFp(o->cb, o, data, (int)dlen, i);
+               if( ! SoDispCon_isValid((SoDispCon*)o) )
+                  return 2; 
+               break;
+            }
+#endif
             ntosd2devices=*sdramstandby;
             *sdramstandby=0;  
             o->cb->frameFp(o->cb, o, bp->buf+idmapstart, pl, i);
             *sdramstandby=ntosd2devices;
+            if( ! SoDispCon_isValid((SoDispCon*)o) )
+               return 2; 
             break;
 
          case 0x8: 
@@ -52699,12 +56081,26 @@ ahashqueued(WSS* o)
          case 0x9: 
             if(pl > 125)
                return ictlrmatch(o, 1009, TRUE);
-            bp->buf[0] = (U8)0x8A; 
-            bp->buf[1]= 0x7F & (U8)pl; 
-            if( (sffsdrnandflash=SoDispCon_sendDataNT((SoDispCon*)o,bp->buf,pl+2)) < 0)
+            if(o->queue)
+            {
+               sffsdrnandflash = wssSendCtrl(o, bp->buf+idmapstart, (int)pl, 0xA);
+            }
+            else
+            {
+               /* Pong header in front of the unmasked payload */
+               bp->buf[idmapstart-2] = (U8)0x8A; 
+               bp->buf[idmapstart-1]= 0x7F & (U8)pl; 
+               sffsdrnandflash=SoDispCon_sendDataNT(
+                  (SoDispCon*)o,bp->buf+idmapstart-2,pl+2);
+            }
+            if(sffsdrnandflash < 0)
                return simulateldrstr(o, sffsdrnandflash);
             if(o->cb->pingFp)
+            {
                o->cb->pingFp(o->cb, o, pl ? bp->buf+idmapstart : 0, pl);
+               if( ! SoDispCon_isValid((SoDispCon*)o) )
+                  return 2; 
+            }
             break;
 
          case 0xA: 
@@ -52753,7 +56149,18 @@ multientry(SoDispCon* fdc37m81xconfig)
             return;
          }
          bp->cursor += len;
+         o->inRecEv=TRUE;
          len = ahashqueued(o); 
+         if(len == 1)
+            return; 
+         o->inRecEv=FALSE;
+         if(o->pendingClose)
+         {
+            len=o->pendingClose;
+            o->pendingClose=0;
+            o->cb->closeFp(o->cb, o, len);
+            return;
+         }
       }
    } while(len == 0 && SoDispCon_hasMoreData((SoDispCon*)o));
    if(len && len != 1) 
@@ -52761,14 +56168,19 @@ multientry(SoDispCon* fdc37m81xconfig)
 }
 
 
-BA_API int
-WSS_connect(WSS* o, HttpConnection* con)
+static int
+wssConnect(WSS* o, HttpConnection* con)
 {
    if( ! SoDispCon_isValid((SoDispCon*)con) )
       return -1;
    if(SoDispCon_isValid((SoDispCon*)o))
       SoDispCon_closeCon((SoDispCon*)o);
+   wssQueueClear(o);
+   o->inRecEv=FALSE;
+   o->pendingClose=0;
    SoDispCon_moveCon((SoDispCon*)con, (SoDispCon*)o);
+   if(o->queue && ! SoDispCon_isNonBlocking((SoDispCon*)o))
+      SoDispCon_setNonblocking((SoDispCon*)o);
    SoDisp_addConnection(((SoDispCon*)o)->dispatcher, (SoDispCon*)o);
    SoDisp_activateRec(((SoDispCon*)o)->dispatcher, (SoDispCon*)o);
    BufPrint_erase((BufPrint*)&o->db);
@@ -52777,16 +56189,37 @@ WSS_connect(WSS* o, HttpConnection* con)
 }
 
 
+BA_API int
+WSS_connect(WSS* o, HttpConnection* con)
+{
+   wssPmdRelease(o);
+   return wssConnect(o, con);
+}
+
+
 BA_API int
 WSS_upgrade(WSS* o, HttpRequest* req)
 {
-   if(HttpRequest_wsUpgrade(req))
+   const char* ext=0;
+#ifndef NO_ZLIB
+   char resp[160];
+#endif
+   wssPmdRelease(o);
+#ifndef NO_ZLIB
+   if(o->deflate && (ext=HttpRequest_getHeaderValue(
+                        req, "\123\145\143\055\127\145\142\123\157\143\153\145\164\055\105\170\164\145\156\163\151\157\156\163")) != 0)
    {
+      ext = wssNegotiate(o, ext, resp, sizeof(resp)) ? resp : 0;
+   }
+#endif
+   if(HttpRequest_wsUpgrade2(req, ext))
+   {
+      o->pmd=0;
       HttpResponse_sendError2(
          HttpRequest_getResponse(req), 400, "\116\157\164\040\141\040\127\145\142\123\157\143\153\145\164\040\122\145\161\165\145\163\164");
       return -1;
    }
-   return WSS_connect(o, HttpRequest_getConnection(req));
+   return wssConnect(o, HttpRequest_getConnection(req));
 }
 
 
@@ -52795,6 +56228,17 @@ WSS_rawWrite(WSS* o, const void* alloccontroller, int len, int buddyavail)
 {
    U8 buf[4];
    int sffsdrnandflash;
+   if(o->queue || o->pmd)
+   {
+      WSSFrame* f;
+      if( ! SoDispCon_isValid((SoDispCon*)o) )
+         return -1;
+      if( (f=WSSFrame_rawCreate(alloccontroller, len, buddyavail)) == 0 )
+         return E_MALLOC;
+      sffsdrnandflash = WSS_send(o, f);
+      WSSFrame_release(f);
+      return sffsdrnandflash;
+   }
    buf[0] = 0x80 | (U8)buddyavail;
    if(len >= 126)
    {
@@ -52819,10 +56263,82 @@ WSS_close(WSS* o, int suspendstate)
       return -1;
    ictlrmatch(o, suspendstate <= 0 ? 1000 : suspendstate, FALSE);
    SoDispCon_closeCon((SoDispCon*)o);
+   wssQueueClear(o);
+   wssPmdRelease(o);
    return 0;
 }
 
 
+BA_API int
+WSS_send(WSS* o, WSSFrame* f)
+{
+   if( ! SoDispCon_isValid((SoDispCon*)o) )
+      return -1;
+   if(o->queue)
+      return wssEnqueue(o, f, FALSE);
+#ifndef NO_ZLIB
+   if(o->pmd)
+   {
+      int sffsdrnandflash;
+      WSSFrame* cf = wssCompress(o, f);
+      if( ! cf )
+         return E_MALLOC;
+      sffsdrnandflash=SoDispCon_sendDataNT((SoDispCon*)o, cf->data, cf->len);
+      WSSFrame_release(cf);
+      return sffsdrnandflash;
+   }
+#endif
+   return SoDispCon_sendDataNT((SoDispCon*)o, f->data, f->len);
+}
+
+
+BA_API int
+WSS_setQueue(WSS* o, int maxFrames, U32 maxBytes, WSS_QueuePolicy policy)
+{
+#ifdef NO_ASYNCH_RESP
+   (void)o;
+   (void)maxFrames;
+   (void)maxBytes;
+   (void)policy;
+   return E_INCORRECT_USE; /* No send events */
+#else
+   SoDispCon* con = (SoDispCon*)o;
+   if(o->queueLen || o->asyncPending || maxFrames < 0)
+      return E_INCORRECT_USE;
+   if(maxFrames != o->queueSize)
+   {
+      if(o->queue)
+      {
+         baFree(o->queue);
+         o->queue=0;
+         o->queueSize=0;
+      }
+      if(maxFrames)
+      {
+         o->queue = (WSSFrame**)baMalloc(sizeof(WSSFrame*) * maxFrames);
+         if( ! o->queue )
+            return E_MALLOC;
+         o->queueSize=maxFrames;
+      }
+   }
+   o->queueHead=0;
+   o->maxQueuedBytes=maxBytes;
+   o->policy=(U8)policy;
+   if(SoDispCon_isValid(con))
+   {
+      if(o->queue)
+      {
+         if( ! SoDispCon_isNonBlocking(con) )
+            return SoDispCon_setNonblocking(con);
+      }
+      else if(SoDispCon_isNonBlocking(con))
+         return SoDispCon_setBlocking(con);
+   }
+   return 0;
+#endif
+}
+
+
 BA_API void
 WSS_constructor(
    WSS* o, WSSCB* cb, SoDisp* sha256start, int allocpages, int heartclocksource)
@@ -52831,6 +56347,7 @@ WSS_constructor(
    if(heartclocksource < allocpages)
       heartclocksource = allocpages;
    SoDispCon_constructor((SoDispCon*)o, sha256start, multientry);
+   SoDispCon_setDispSendEvent((SoDispCon*)o, wssSendEv);
    DynBuffer_constructor(&o->db, allocpages, heartclocksource, 0, 0);
    o->cb=cb;
 }
@@ -52841,5 +56358,12 @@ WSS_destructor(WSS* o)
 {
    SoDispCon_destructor((SoDispCon*)o);
    DynBuffer_destructor(&o->db);
+   wssPmdRelease(o);
+   if(o->queue)
+   {
+      wssQueueClear(o);
+      baFree(o->queue);
+      o->queue=0;
+   }
 }
 
@@ -0,0 +1,579 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ *
+ ****************************************************************************
+ *			      PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic LLC, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Sampling heap profiler. See inc/HeapProfiler.h for the API.
+
+Each thread counts down the bytes left until its next sample; the
+distance between samples is drawn from an exponential distribution
+with mean 'sampleRate'. A sampled block is stored in a hash table
+keyed by its address together with a pointer to the bucket for its
+call stack and tag. A counting filter, indexed by a hash of the block
+address, holds the number of sampled blocks per slot; baFree only
+looks in the hash table when the slot is not zero.
+
+The buckets hold the sampled counts. pprof scales the counts by the
+sampling rate given in the heap_v2 header, and baHeapProf_printTags
+applies the same correction.
+*/
+
+/* Use the real allocator in this file */
+#define HEAPPROF_IMPL
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#include <HeapProfiler.h>
+#include <ThreadLib.h>
+#include <string.h>
+#include <math.h>
+
+#if defined(__GLIBC__) && !defined(HEAPPROF_NO_BACKTRACE)
+#include <execinfo.h>
+#define HEAPPROF_BACKTRACE
+#endif
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifndef HEAPPROF_TLS
+#if defined(__GNUC__) || defined(__clang__)
+#define HEAPPROF_TLS __thread
+#elif defined(_MSC_VER)
+#define HEAPPROF_TLS __declspec(thread)
+#else
+#define HEAPPROF_TLS
+#endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HEAPPROF_NOINLINE __attribute__((noinline))
+#else
+#define HEAPPROF_NOINLINE
+#endif
+
+#ifndef HEAPPROF_MAXDEPTH
+#define HEAPPROF_MAXDEPTH 32
+#endif
+
+#define HEAPPROF_DEFAULT_RATE (512*1024)
+#define HEAPPROF_BUCKETS 1024 /* Stack table size, power of 2 */
+#define HEAPPROF_SAMPLES 4096 /* Live sample table size, power of 2 */
+#define HEAPPROF_FILTER_BITS 14
+
+typedef struct HeapProfBucket
+{
+      struct HeapProfBucket* next;
+      const char* tag;
+      U64 allocObjs;
+      U64 allocBytes;
+      U64 liveObjs;
+      U64 liveBytes;
+      U32 hash;
+      U32 depth;
+      void* stack[HEAPPROF_MAXDEPTH];
+} HeapProfBucket;
+
+typedef struct HeapProfSample
+{
+      struct HeapProfSample* next;
+      void* ptr;
+      size_t size;
+      HeapProfBucket* bucket;
+} HeapProfSample;
+
+static HeapProfBucket* heapProfBuckets[HEAPPROF_BUCKETS];
+static HeapProfSample* heapProfSamples[HEAPPROF_SAMPLES];
+static U8 heapProfFilter[1 << HEAPPROF_FILTER_BITS];
+static U32 heapProfNoOfBuckets;
+static ThreadMutex heapProfLock;
+static BaBool heapProfInitialized;
+static size_t heapProfRate; /* Zero when not sampling */
+
+static HEAPPROF_TLS S64 heapProfBytesLeft;
+static HEAPPROF_TLS U32 heapProfRnd;
+static HEAPPROF_TLS const char* heapProfTag;
+
+
+static U32
+HeapProf_ptrHash(const void* p)
+{
+   U64 x = (U64)(size_t)p;
+   x ^= x >> 33;
+   x *= 0xff51afd7ed558ccdULL;
+   x ^= x >> 33;
+   return (U32)x;
+}
+
+#define HeapProf_filterIx(h) ((h) >> (32 - HEAPPROF_FILTER_BITS))
+#define HeapProf_inFilter(h) heapProfFilter[HeapProf_filterIx(h)]
+
+
+/* Distance in bytes to the next sample */
+static S64
+HeapProf_nextSample(void)
+{
+   double u;
+   if( ! heapProfRnd )
+      heapProfRnd = HeapProf_ptrHash(&heapProfRnd) ^ baGetMsClock() ^ 1;
+   heapProfRnd ^= heapProfRnd << 13;
+   heapProfRnd ^= heapProfRnd >> 17;
+   heapProfRnd ^= heapProfRnd << 5;
+   u = ((heapProfRnd >> 8) + 1) / 16777217.0;
+   return (S64)(-log(u) * (double)heapProfRate) + 1;
+}
+
+
+static HeapProfBucket*
+HeapProf_getBucket(void** stack, U32 depth, const char* tag)
+{
+   HeapProfBucket* b;
+   U32 i, h = 2166136261u ^ HeapProf_ptrHash(tag);
+   for(i=0 ; i < depth ; i++)
+      h = (h ^ HeapProf_ptrHash(stack[i])) * 16777619u;
+   for(b=heapProfBuckets[h & (HEAPPROF_BUCKETS-1)] ; b ; b=b->next)
+   {
+      if(b->hash == h && b->depth == depth && b->tag == tag &&
+         ! memcmp(b->stack, stack, depth * sizeof(void*)))
+      {
+         return b;
+      }
+   }
+   b = (HeapProfBucket*)baMalloc(sizeof(HeapProfBucket));
+   if(b)
+   {
+      memset(b, 0, sizeof(HeapProfBucket));
+      b->hash=h;
+      b->depth=depth;
+      b->tag=tag;
+      memcpy(b->stack, stack, depth * sizeof(void*));
+      b->next = heapProfBuckets[h & (HEAPPROF_BUCKETS-1)];
+      heapProfBuckets[h & (HEAPPROF_BUCKETS-1)] = b;
+      heapProfNoOfBuckets++;
+   }
+   return b;
+}
+
+
+static void
+HeapProf_track(void* ptr, size_t size, HeapProfBucket* b, HeapProfSample* s)
+{
+   U32 h = HeapProf_ptrHash(ptr);
+   s->ptr=ptr;
+   s->size=size;
+   s->bucket=b;
+   s->next=heapProfSamples[h & (HEAPPROF_SAMPLES-1)];
+   heapProfSamples[h & (HEAPPROF_SAMPLES-1)]=s;
+   if(heapProfFilter[HeapProf_filterIx(h)] != 0xFF) /* Sticky when full */
+      heapProfFilter[HeapProf_filterIx(h)]++;
+   b->liveObjs++;
+   b->liveBytes += size;
+}
+
+
+/* Returns the removed sample or NULL if 'ptr' was not sampled. The
+   caller must hold the lock.
+ */
+static HeapProfSample*
+HeapProf_untrack(void* ptr)
+{
+   U32 h = HeapProf_ptrHash(ptr);
+   HeapProfSample** sp = heapProfSamples + (h & (HEAPPROF_SAMPLES-1));
+   for( ; *sp ; sp = &(*sp)->next)
+   {
+      if((*sp)->ptr == ptr)
+      {
+         HeapProfSample* s = *sp;
+         *sp = s->next;
+         if(heapProfFilter[HeapProf_filterIx(h)] != 0xFF)
+            heapProfFilter[HeapProf_filterIx(h)]--;
+         s->bucket->liveObjs--;
+         s->bucket->liveBytes -= s->size;
+         return s;
+      }
+   }
+   return 0;
+}
+
+
+static HEAPPROF_NOINLINE void
+HeapProf_sample(void* ptr, size_t size)
+{
+   void* stack[HEAPPROF_MAXDEPTH+2];
+   HeapProfBucket* b;
+   HeapProfSample* s;
+   int depth, skip;
+   if( ! heapProfRnd )
+   {
+      /* First request in this thread: only seed the distance */
+      heapProfBytesLeft = HeapProf_nextSample();
+      return;
+   }
+   heapProfBytesLeft = HeapProf_nextSample();
+#ifdef HEAPPROF_BACKTRACE
+   /* Skip this function and the baHeapProfXX wrapper */
+   skip=2;
+   depth = backtrace(stack, HEAPPROF_MAXDEPTH+2);
+   if(depth <= skip)
+      return;
+#elif defined(__GNUC__) || defined(__clang__)
+   skip=0;
+   depth=1;
+   stack[0] = __builtin_return_address(1);
+#else
+   skip=0;
+   depth=0;
+#endif
+   s = (HeapProfSample*)baMalloc(sizeof(HeapProfSample));
+   if( ! s )
+      return;
+   ThreadMutex_set(&heapProfLock);
+   b = HeapProf_getBucket(stack+skip, (U32)(depth-skip), heapProfTag);
+   if(b)
+   {
+      b->allocObjs++;
+      b->allocBytes += size;
+      HeapProf_track(ptr, size, b, s);
+      s=0;
+   }
+   ThreadMutex_release(&heapProfLock);
+   if(s)
+      baFree(s);
+}
+
+
+static HeapProfSample*
+HeapProf_release(void* ptr)
+{
+   HeapProfSample* s = 0;
+   if(heapProfInitialized && HeapProf_inFilter(HeapProf_ptrHash(ptr)))
+   {
+      ThreadMutex_set(&heapProfLock);
+      s = HeapProf_untrack(ptr);
+      ThreadMutex_release(&heapProfLock);
+   }
+   return s;
+}
+
+
+void*
+baHeapProfMalloc(size_t n)
+{
+   void* p = baMalloc(n);
+   if(heapProfRate && p && (heapProfBytesLeft -= (S64)n) < 0)
+      HeapProf_sample(p, n);
+   return p;
+}
+
+
+void*
+baHeapProfRealloc(void* p, size_t n)
+{
+   HeapProfSample* s = p ? HeapProf_release(p) : 0;
+   void* np = baRealloc(p, n);
+   if( ! np && n )
+   {
+      if(s) /* The old block is still valid */
+      {
+         ThreadMutex_set(&heapProfLock);
+         HeapProf_track(p, s->size, s->bucket, s);
+         ThreadMutex_release(&heapProfLock);
+      }
+      return 0;
+   }
+   if(s)
+      baFree(s);
+   if(heapProfRate && np && (heapProfBytesLeft -= (S64)n) < 0)
+      HeapProf_sample(np, n);
+   return np;
+}
+
+
+void
+baHeapProfFree(void* p)
+{
+   if(p)
+   {
+      HeapProfSample* s = HeapProf_release(p);
+      if(s)
+         baFree(s);
+      baFree(p);
+   }
+}
+
+
+BA_API int
+baHeapProf_start(size_t sampleRate)
+{
+   if( ! heapProfInitialized )
+   {
+      ThreadMutex_constructor(&heapProfLock);
+      heapProfInitialized=TRUE;
+   }
+   heapProfRate = sampleRate ? sampleRate : HEAPPROF_DEFAULT_RATE;
+   return 0;
+}
+
+
+BA_API void
+baHeapProf_stop(void)
+{
+   heapProfRate=0;
+}
+
+
+BA_API const char*
+baHeapProf_setTag(const char* tag)
+{
+   const char* prev = heapProfTag;
+   heapProfTag=tag;
+   return prev;
+}
+
+
+/* Copy the buckets so that printing, which may allocate memory, can
+   run without holding the lock.
+ */
+static HeapProfBucket*
+HeapProf_snapshot(U32* len)
+{
+   HeapProfBucket* copy;
+   U32 i, n=0;
+   if( ! heapProfInitialized )
+   {
+      *len=0;
+      return 0;
+   }
+   ThreadMutex_set(&heapProfLock);
+   copy = (HeapProfBucket*)baMalloc(
+      (heapProfNoOfBuckets ? heapProfNoOfBuckets : 1) * sizeof(HeapProfBucket));
+   if(copy)
+   {
+      for(i=0 ; i < HEAPPROF_BUCKETS ; i++)
+      {
+         HeapProfBucket* b;
+         for(b=heapProfBuckets[i] ; b ; b=b->next)
+            copy[n++] = *b;
+      }
+   }
+   ThreadMutex_release(&heapProfLock);
+   *len=n;
+   return copy;
+}
+
+
+static void
+HeapProf_printHex(BufPrint* out, const void* p)
+{
+   static const char hex[]="0123456789abcdef";
+   char buf[2+2*sizeof(void*)+1];
+   U64 v = (U64)(size_t)p;
+   int i = sizeof(buf)-1;
+   buf[i]=0;
+   do {
+      buf[--i] = hex[v & 15];
+      v >>= 4;
+   } while(v && i > 2);
+   buf[--i]='x';
+   buf[--i]='0';
+   BufPrint_write(out, buf+i, -1);
+}
+
+
+BA_API int
+baHeapProf_print(BufPrint* out, const char* tag)
+{
+   U64 liveObjs=0, liveBytes=0, allocObjs=0, allocBytes=0;
+   U32 i, j, len;
+   HeapProfBucket* b = HeapProf_snapshot(&len);
+   if( ! b && heapProfInitialized )
+      return -1;
+   for(i=0 ; i < len ; i++)
+   {
+      if( ! tag || (b[i].tag && ! strcmp(tag, b[i].tag)) )
+      {
+         liveObjs += b[i].liveObjs;
+         liveBytes += b[i].liveBytes;
+         allocObjs += b[i].allocObjs;
+         allocBytes += b[i].allocBytes;
+      }
+   }
+   BufPrint_printf(out,
+                   "heap profile: %llu: %llu [%llu: %llu] @ heap_v2/%u\n",
+                   liveObjs, liveBytes, allocObjs, allocBytes,
+                   (unsigned)(heapProfRate ? heapProfRate :
+                              HEAPPROF_DEFAULT_RATE));
+   for(i=0 ; i < len ; i++)
+   {
+      if(tag && ( ! b[i].tag || strcmp(tag, b[i].tag)))
+         continue;
+      BufPrint_printf(out, "%llu: %llu [%llu: %llu] @",
+                      b[i].liveObjs, b[i].liveBytes,
+                      b[i].allocObjs, b[i].allocBytes);
+      for(j=0 ; j < b[i].depth ; j++)
+      {
+         BufPrint_putc(out, ' ');
+         HeapProf_printHex(out, b[i].stack[j]);
+      }
+      BufPrint_putc(out, '\n');
+   }
+   if(b)
+      baFree(b);
+#ifdef __linux__
+   {
+      /* pprof uses the mappings to symbolize the addresses */
+      char buf[512];
+      int fd = open("/proc/self/maps", O_RDONLY);
+      if(fd >= 0)
+      {
+         int n;
+         BufPrint_printf(out, "\nMAPPED_LIBRARIES:\n");
+         while((n = (int)read(fd, buf, sizeof(buf))) > 0)
+            BufPrint_write(out, buf, n);
+         close(fd);
+      }
+   }
+#endif
+   return 0;
+}
+
+
+/* Estimated number of real allocations represented by 'n' samples
+   with an average size of 'avg' bytes.
+ */
+static double
+HeapProf_scale(U64 n, U64 bytes, size_t rate)
+{
+   double avg;
+   if( ! n )
+      return 0;
+   avg = (double)bytes / (double)n;
+   return (double)n / (1.0 - exp(-avg / (double)rate));
+}
+
+
+BA_API int
+baHeapProf_printTags(BufPrint* out)
+{
+   U32 i, j, len;
+   size_t rate = heapProfRate ? heapProfRate : HEAPPROF_DEFAULT_RATE;
+   HeapProfBucket* b = HeapProf_snapshot(&len);
+   if( ! b && heapProfInitialized )
+      return -1;
+   BufPrint_printf(out, "%-16s %12s %14s %12s %14s\n", "tag",
+                   "live_objs", "live_bytes", "alloc_objs", "alloc_bytes");
+   /* Sum the entries per tag; the first bucket of each tag holds the
+      totals after the merge loop.
+   */
+   for(i=0 ; i < len ; i++)
+   {
+      double liveObjs, liveBytes, allocObjs, allocBytes;
+      if(b[i].depth == (U32)~0)
+         continue;
+      liveObjs = HeapProf_scale(b[i].liveObjs, b[i].liveBytes, rate);
+      liveBytes = b[i].liveObjs ?
+         liveObjs * (double)b[i].liveBytes / (double)b[i].liveObjs : 0;
+      allocObjs = HeapProf_scale(b[i].allocObjs, b[i].allocBytes, rate);
+      allocBytes = b[i].allocObjs ?
+         allocObjs * (double)b[i].allocBytes / (double)b[i].allocObjs : 0;
+      for(j=i+1 ; j < len ; j++)
+      {
+         if(b[j].depth != (U32)~0 && b[j].tag == b[i].tag)
+         {
+            double n = HeapProf_scale(b[j].liveObjs, b[j].liveBytes, rate);
+            liveObjs += n;
+            if(b[j].liveObjs)
+               liveBytes += n * (double)b[j].liveBytes / (double)b[j].liveObjs;
+            n = HeapProf_scale(b[j].allocObjs, b[j].allocBytes, rate);
+            allocObjs += n;
+            if(b[j].allocObjs)
+               allocBytes += n*(double)b[j].allocBytes/(double)b[j].allocObjs;
+            b[j].depth = (U32)~0;
+         }
+      }
+      BufPrint_printf(out, "%-16s %12llu %14llu %12llu %14llu\n",
+                      b[i].tag ? b[i].tag : "-",
+                      (U64)liveObjs, (U64)liveBytes,
+                      (U64)allocObjs, (U64)allocBytes);
+   }
+   if(b)
+      baFree(b);
+   return 0;
+}
+
+
+static void*
+HeapProfAllocator_malloc(AllocatorIntf* super, size_t* size)
+{
+   HeapProfAllocator* o = (HeapProfAllocator*)super;
+   const char* prev = baHeapProf_setTag(o->tag);
+   void* p = AllocatorIntf_malloc(o->backend, size);
+   baHeapProf_setTag(prev);
+   return p;
+}
+
+
+static void*
+HeapProfAllocator_realloc(AllocatorIntf* super, void* p, size_t* size)
+{
+   HeapProfAllocator* o = (HeapProfAllocator*)super;
+   const char* prev = baHeapProf_setTag(o->tag);
+   p = AllocatorIntf_realloc(o->backend, p, size);
+   baHeapProf_setTag(prev);
+   return p;
+}
+
+
+static void
+HeapProfAllocator_free(AllocatorIntf* super, void* p)
+{
+   HeapProfAllocator* o = (HeapProfAllocator*)super;
+   AllocatorIntf_free(o->backend, p);
+}
+
+
+BA_API void
+HeapProfAllocator_constructor(
+   HeapProfAllocator* o, const char* tag, AllocatorIntf* backend)
+{
+   o->backend = backend ? backend : AllocatorIntf_getDefault();
+   o->tag=tag;
+   AllocatorIntf_constructor((AllocatorIntf*)o,
+                             HeapProfAllocator_malloc,
+                             o->backend->reallocCB ?
+                             HeapProfAllocator_realloc : 0,
+                             HeapProfAllocator_free);
+}
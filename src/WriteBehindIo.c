@@ -0,0 +1,433 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Write-behind I/O, see inc/WriteBehindIo.h.
+
+A file opened for writing (WbRes) owns up to 'buffers' buffers. The
+user's thread fills the current buffer and appends it to the
+WriteBehindIo queue when full. The WriteBehindIo thread writes the
+queued buffers in order and returns them to the file's free list.
+The buffers are allocated and released by the user's thread only;
+the mutex protects the queue, the free lists, and the 'queued',
+'error', and 'waiting' members.
+*/
+
+#include <stddef.h>
+#include <string.h>
+#include <WriteBehindIo.h>
+#include <BaErrorCodes.h>
+
+#ifndef WRITEBEHINDIO_STACKSIZE
+#define WRITEBEHINDIO_STACKSIZE 16000
+#endif
+
+struct WbRes;
+
+typedef struct
+{
+   DoubleLink link; /* In WriteBehindIo queue or WbRes free list */
+   struct WbRes* res;
+   size_t len;
+   U8 data[1];
+} WbBuf;
+
+typedef struct WbRes
+{
+   ResIntf super;
+   ThreadSemaphore sem; /* Signaled when a buffer is returned */
+   DoubleList freeList;
+   WriteBehindIo* wb;
+   ResIntfPtr res; /* The file in the wrapped I/O */
+   WbBuf* cur; /* Buffer being filled */
+   int allocated;
+   int queued;
+   int error; /* First error returned by the wrapped I/O */
+   BaBool waiting;
+} WbRes;
+
+#define WriteBehindIo_io(o) ((WriteBehindIo*)(o))->io
+
+
+/* Wait for the WriteBehindIo thread to return a buffer. The mutex
+ * must be locked.
+ */
+static void
+WbRes_wait(WbRes* o)
+{
+   o->waiting=TRUE;
+   ThreadMutex_release(&o->wb->mutex);
+   ThreadSemaphore_wait(&o->sem);
+   ThreadMutex_set(&o->wb->mutex);
+}
+
+
+static int
+WbRes_getError(WbRes* o)
+{
+   int status;
+   ThreadMutex_set(&o->wb->mutex);
+   status=o->error;
+   ThreadMutex_release(&o->wb->mutex);
+   return status;
+}
+
+
+static WbBuf*
+WbRes_getBuf(WbRes* o)
+{
+   WriteBehindIo* wb = o->wb;
+   WbBuf* b;
+   ThreadMutex_set(&wb->mutex);
+   while(DoubleList_isEmpty(&o->freeList) && o->allocated == wb->buffers)
+      WbRes_wait(o);
+   b=(WbBuf*)DoubleList_removeFirst(&o->freeList);
+   ThreadMutex_release(&wb->mutex);
+   if( ! b )
+   {
+      size_t size = offsetof(WbBuf, data) + wb->bufSize;
+      if( (b=(WbBuf*)AllocatorIntf_malloc(wb->alloc, &size)) == 0 )
+         return 0;
+      DoubleLink_constructor(&b->link);
+      b->res=o;
+      o->allocated++;
+   }
+   b->len=0;
+   return b;
+}
+
+
+/* Queue the current buffer if it holds data */
+static void
+WbRes_queue(WbRes* o)
+{
+   WriteBehindIo* wb = o->wb;
+   if(o->cur && o->cur->len)
+   {
+      ThreadMutex_set(&wb->mutex);
+      DoubleList_insertLast(&wb->queue, &o->cur->link);
+      o->queued++;
+      ThreadMutex_release(&wb->mutex);
+      ThreadSemaphore_signal(&wb->workSem);
+      o->cur=0;
+   }
+}
+
+
+/* Queue the current buffer and wait until all data is written */
+static int
+WbRes_drain(WbRes* o)
+{
+   int status;
+   WbRes_queue(o);
+   ThreadMutex_set(&o->wb->mutex);
+   while(o->queued)
+      WbRes_wait(o);
+   status=o->error;
+   ThreadMutex_release(&o->wb->mutex);
+   return status;
+}
+
+
+static int
+WbRes_read(ResIntfPtr super, void* buf, size_t maxSize, size_t* size)
+{
+   (void)super;
+   (void)buf;
+   (void)maxSize;
+   *size=0;
+   return IOINTF_NOIMPLEMENTATION;
+}
+
+
+static int
+WbRes_write(ResIntfPtr super, const void* buf, size_t size)
+{
+   WbRes* o = (WbRes*)super;
+   const U8* ptr = (const U8*)buf;
+   size_t bufSize = o->wb->bufSize;
+   int status = WbRes_getError(o);
+   while( ! status && size )
+   {
+      size_t n;
+      if( ! o->cur && (o->cur=WbRes_getBuf(o)) == 0 )
+         return IOINTF_MEM;
+      n = bufSize - o->cur->len;
+      if(n > size)
+         n=size;
+      memcpy(o->cur->data + o->cur->len, ptr, n);
+      o->cur->len+=n;
+      ptr+=n;
+      size-=n;
+      if(o->cur->len == bufSize)
+      {
+         WbRes_queue(o);
+         status=WbRes_getError(o);
+      }
+   }
+   return status;
+}
+
+
+static int
+WbRes_seek(ResIntfPtr super, BaFileSize offset)
+{
+   WbRes* o = (WbRes*)super;
+   int status = WbRes_drain(o);
+   return status ? status : o->res->seekFp(o->res, offset);
+}
+
+
+static int
+WbRes_flush(ResIntfPtr super)
+{
+   WbRes* o = (WbRes*)super;
+   int status = WbRes_drain(o);
+   if( ! status && o->res->flushFp )
+      status=o->res->flushFp(o->res);
+   return status;
+}
+
+
+static int
+WbRes_close(ResIntfPtr super)
+{
+   WbRes* o = (WbRes*)super;
+   WriteBehindIo* wb = o->wb;
+   WbBuf* b;
+   int status = WbRes_drain(o);
+   if( ! status && wb->sync != WriteBehindIo_SyncNone && o->res->flushFp )
+      status=o->res->flushFp(o->res);
+   if(o->res->closeFp(o->res) && ! status)
+      status=IOINTF_IOERROR;
+   if(o->cur)
+      AllocatorIntf_free(wb->alloc, o->cur);
+   while( (b=(WbBuf*)DoubleList_removeFirst(&o->freeList)) != 0 )
+      AllocatorIntf_free(wb->alloc, b);
+   ThreadSemaphore_destructor(&o->sem);
+   AllocatorIntf_free(wb->alloc, o);
+   return status;
+}
+
+
+static void
+WriteBehindIo_run(Thread* th)
+{
+   WriteBehindIo* o = (WriteBehindIo*)((U8*)th-offsetof(WriteBehindIo,thread));
+   ThreadMutex_set(&o->mutex);
+   for(;;)
+   {
+      WbRes* res;
+      WbBuf* b = (WbBuf*)DoubleList_removeFirst(&o->queue);
+      if( ! b )
+      {
+         if(o->stop)
+            break;
+         ThreadMutex_release(&o->mutex);
+         ThreadSemaphore_wait(&o->workSem);
+         ThreadMutex_set(&o->mutex);
+         continue;
+      }
+      res=b->res;
+      if( ! res->error ) /* Discard the data after an error */
+      {
+         ResIntfPtr r = res->res;
+         int status;
+         ThreadMutex_release(&o->mutex);
+         status=r->writeFp(r, b->data, b->len);
+         if( ! status && o->sync == WriteBehindIo_SyncEachBuffer && r->flushFp )
+            status=r->flushFp(r);
+         ThreadMutex_set(&o->mutex);
+         res->error=status;
+      }
+      DoubleList_insertLast(&res->freeList, &b->link);
+      res->queued--;
+      if(res->waiting)
+      {
+         res->waiting=FALSE;
+         ThreadSemaphore_signal(&res->sem);
+      }
+   }
+   ThreadMutex_release(&o->mutex);
+   ThreadSemaphore_signal(&o->stoppedSem);
+}
+
+
+static ResIntfPtr
+WriteBehindIo_openRes(IoIntfPtr super, const char* name, U32 mode,
+                      int* status, const char** ecode)
+{
+   WriteBehindIo* o = (WriteBehindIo*)super;
+   WbRes* res;
+   ResIntfPtr r;
+   size_t size = sizeof(WbRes);
+   if((mode & OpenRes_READ) || ! (mode & OpenRes_WRITE))
+      return o->io->openResFp(o->io, name, mode, status, ecode);
+   if( (r=o->io->openResFp(o->io, name, mode, status, ecode)) == 0 )
+      return 0;
+   if( (res=(WbRes*)AllocatorIntf_malloc(o->alloc, &size)) == 0 )
+   {
+      r->closeFp(r);
+      *status=IOINTF_MEM;
+      return 0;
+   }
+   memset(res, 0, sizeof(WbRes));
+   ResIntf_constructor((ResIntf*)res, WbRes_read, WbRes_write,
+                       WbRes_seek, WbRes_flush, WbRes_close);
+   ThreadSemaphore_constructor(&res->sem);
+   DoubleList_constructor(&res->freeList);
+   res->wb=o;
+   res->res=r;
+   return (ResIntfPtr)res;
+}
+
+
+static int
+WriteBehindIo_property(IoIntfPtr o, const char* name, void* a, void* b)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->propertyFp(io, name, a, b);
+}
+
+
+static int
+WriteBehindIo_closeDir(IoIntfPtr o, DirIntfPtr* dirIntf)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->closeDirFp(io, dirIntf);
+}
+
+
+static int
+WriteBehindIo_mkDir(IoIntfPtr o, const char* name, const char** ecode)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->mkDirFp(io, name, ecode);
+}
+
+
+static int
+WriteBehindIo_rename(IoIntfPtr o, const char* from, const char* to,
+                     const char** ecode)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->renameFp(io, from, to, ecode);
+}
+
+
+static DirIntfPtr
+WriteBehindIo_openDir(IoIntfPtr o, const char* dirname, int* status,
+                      const char** ecode)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->openDirFp(io, dirname, status, ecode);
+}
+
+
+static ResIntfPtr
+WriteBehindIo_openResGzip(IoIntfPtr o, const char* name, ThreadMutex* m,
+                          BaFileSize* size, int* status, const char** ecode)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->openResGzipFp(io, name, m, size, status, ecode);
+}
+
+
+static int
+WriteBehindIo_remove(IoIntfPtr o, const char* name, const char** ecode)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->removeFp(io, name, ecode);
+}
+
+
+static int
+WriteBehindIo_rmDir(IoIntfPtr o, const char* name, const char** ecode)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->rmDirFp(io, name, ecode);
+}
+
+
+static int
+WriteBehindIo_stat(IoIntfPtr o, const char* name, IoStat* st)
+{
+   IoIntfPtr io = WriteBehindIo_io(o);
+   return io->statFp(io, name, st);
+}
+
+
+BA_API void
+WriteBehindIo_constructor(WriteBehindIo* o, IoIntfPtr io, size_t bufSize,
+                          int buffers, WriteBehindIo_Sync sync,
+                          AllocatorIntf* alloc)
+{
+   memset(o, 0, sizeof(WriteBehindIo));
+   IoIntf_constructorRW((IoIntf*)o,
+                        WriteBehindIo_property,
+                        WriteBehindIo_closeDir,
+                        io->mkDirFp ? WriteBehindIo_mkDir : 0,
+                        io->renameFp ? WriteBehindIo_rename : 0,
+                        WriteBehindIo_openDir,
+                        WriteBehindIo_openRes,
+                        io->openResGzipFp ? WriteBehindIo_openResGzip : 0,
+                        io->removeFp ? WriteBehindIo_remove : 0,
+                        io->rmDirFp ? WriteBehindIo_rmDir : 0,
+                        WriteBehindIo_stat);
+   o->io=io;
+   o->alloc = alloc ? alloc : AllocatorIntf_getDefault();
+   o->bufSize = bufSize ? bufSize : 16*1024;
+   o->buffers = buffers < 2 ? 2 : buffers;
+   o->sync=sync;
+   ThreadMutex_constructor(&o->mutex);
+   ThreadSemaphore_constructor(&o->workSem);
+   ThreadSemaphore_constructor(&o->stoppedSem);
+   DoubleList_constructor(&o->queue);
+   Thread_constructor(&o->thread, WriteBehindIo_run, ThreadPrioNormal,
+                      WRITEBEHINDIO_STACKSIZE);
+   Thread_start(&o->thread);
+}
+
+
+BA_API void
+WriteBehindIo_destructor(WriteBehindIo* o)
+{
+   ThreadMutex_set(&o->mutex);
+   o->stop=TRUE;
+   ThreadMutex_release(&o->mutex);
+   ThreadSemaphore_signal(&o->workSem);
+   ThreadSemaphore_wait(&o->stoppedSem);
+   Thread_destructor(&o->thread);
+   ThreadSemaphore_destructor(&o->stoppedSem);
+   ThreadSemaphore_destructor(&o->workSem);
+   ThreadMutex_destructor(&o->mutex);
+}
@@ -0,0 +1,462 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *                                                                        
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *                                                                         
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+
+Socket Dispatcher kqueue implementation for BSD and macOS.
+https://man.freebsd.org/cgi/man.cgi?kqueue
+
+A connection registers an EVFILT_READ filter when the receive event
+is active and an EVFILT_WRITE filter when the send event is active.
+The kevent udata is the connection; events, returned by the current
+kevent() call, for a filter removed by a callback are discarded.
+*/
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#define sodisp_c 1
+
+#ifdef __cplusplus
+#error Cannot compile any Barracuda code in C++ mode
+#endif
+
+#include <HttpServer.h>
+#include <HttpTrace.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+
+extern UserDefinedErrHandler barracudaUserDefinedErrHandler;
+
+#define link2Con(l) \
+ (SoDispCon*)((U8*)l-offsetof(SoDispCon,dispatcherLink))
+
+
+BA_API void
+baFatalEf(BaFatalErrorCodes ecode1, unsigned int ecode2,
+            const char* file, int line)
+{
+#ifdef HTTP_TRACE
+   static int recursiveCall=0;
+   if( ! recursiveCall )
+   {
+      recursiveCall=1;
+      HttpTrace_printf(0,"Fatal error detected in Barracuda.\n"
+                       "E1 = %d, E2=%d\n"
+                       "%s, line %d\n",
+                       ecode1, ecode2,
+                       file, line);
+      HttpTrace_flush();
+   }
+   recursiveCall=0;
+#endif
+   if(barracudaUserDefinedErrHandler)
+      (*barracudaUserDefinedErrHandler)(ecode1, ecode2, file, line);
+   else
+   {
+      for(;;) Thread_sleep(100000);
+   }
+}
+
+
+/* Wait 'tmo' milliseconds for one event on socket 's'.
+   Returns 1 if the event is signaled, 0 on timeout, and -1 on error.
+*/
+static int
+HttpSocket_poll(HttpSocket* s, short events, int tmo)
+{
+   struct pollfd pfd;
+   int status;
+   pfd.fd = s->hndl;
+   pfd.events = events;
+   pfd.revents = 0;
+   do {
+      status = poll(&pfd, 1, tmo);
+   } while(status < 0 && errno == EINTR);
+   if(status > 0)
+      return (pfd.revents & (POLLERR | POLLNVAL)) ? -1 : 1;
+   return status;
+}
+
+
+int
+BaAddrinfo_platConnect(BaAddrinfo* addr, HttpSocket* s, U32 timeout)
+{
+   int status;
+   HttpSocket_setNonblocking(s, &status);
+   status = socketConnect(s->hndl, addr->ai_addr, addr->ai_addrlen);
+   if(status)
+   {
+      HttpSocket_wouldBlock(s, &status);
+      if( ! status )
+      {
+         HttpSocket_close(s);
+         status = E_CANNOT_CONNECT;
+      }
+      else if(timeout)
+      {
+         struct sockaddr_storage peer;
+         socklen_t len=sizeof(struct sockaddr_storage);
+         if(HttpSocket_poll(s, POLLOUT, (int)timeout) > 0 &&
+            ! socketGetPeerName(s->hndl, (struct sockaddr*)&peer, &len))
+         {
+            status = 1; /* We are done */
+         }
+         else
+         {
+            HttpSocket_close(s);
+            status = E_CANNOT_CONNECT;
+         }
+      }
+      else
+         status = 0; /* pending */
+   }
+   else
+      status = 1; /* We are done */
+   return status;
+}
+
+
+/* Returns 0 if no data, >0 if data and <0 on error.
+   This function is called unprotected i.e. the SoDisp mutex is not set.
+   isTerminated is a variable handled by the caller.
+   Can be set to TRUE by a another thread.
+   If TRUE, the object "o" is no longer valid.
+*/
+int
+SoDispCon_platReadData(SoDispCon* o, ThreadMutex* m, BaBool* isTerminated,
+                       void* data, int len)
+{
+   int status;
+   if(m && ThreadMutex_isOwner(m))
+   {
+      if(o->rtmo)
+      {
+         SoDisp* disp;
+         int tmo = o->rtmo*50;
+         o->rtmo=0;
+         if(SoDispCon_recEvActive(o))
+         {
+            disp=SoDispCon_getDispatcher(o);
+            SoDisp_deactivateRec(disp, o);
+         }
+         else
+            disp=0;
+         ThreadMutex_release(m);
+         status = HttpSocket_poll(&o->httpSocket, POLLIN, tmo) > 0 ? 0 : -1;
+         ThreadMutex_set(m);
+         if(*isTerminated)
+            return E_SOCKET_READ_FAILED;
+         if(disp)
+            SoDisp_activateRec(disp, o);
+         if(status)
+            return E_TIMEOUT;
+      }
+      ThreadMutex_release(m);
+      HttpSocket_recv(&o->httpSocket,data,len,&status);
+      ThreadMutex_set(m);
+      if(*isTerminated)
+         return E_SOCKET_READ_FAILED;
+   }
+   else
+   {
+      if(o->rtmo)
+      {
+         int tmo = o->rtmo*50;
+         o->rtmo=0;
+         if(HttpSocket_poll(&o->httpSocket, POLLIN, tmo) <= 0)
+            return E_TIMEOUT;
+      }
+      HttpSocket_recv(&o->httpSocket,data,len,&status);
+   }
+   if( ! SoDispCon_isNonBlocking(o) )
+      SoDispCon_clearSocketHasNonBlockData(o);
+   if(status < 0)
+   {
+      SoDispCon_closeCon(o);
+      return E_SOCKET_READ_FAILED;
+   }
+   /* status=len, which can be zero if a non blocking socket.
+    */
+   return status;
+}
+
+
+/* Register or remove one filter. Pending events for a removed filter
+   are discarded.
+*/
+static void
+SoDisp_changeFilter(SoDisp* o, SoDispCon* con, short filter, BaBool add)
+{
+   struct kevent ch;
+   if(add || SoDispCon_isValid(con))
+   {
+      EV_SET(&ch, SoDispCon_getId(con), filter, add ? EV_ADD : EV_DELETE,
+             0, 0, (void*)con);
+      if(kevent(o->kq, &ch, 1, 0, 0, 0) < 0 && add)
+      {
+         TRPR(("kevent failed on %d:  %s\n",
+               SoDispCon_getId(con),strerror(errno)));
+         SoDispCon_closeCon(con);
+         if( ! DoubleList_isInList(&o->termList, &con->dispatcherLink) )
+            DoubleList_insertLast(&o->termList, &con->dispatcherLink);
+         return;
+      }
+   }
+   if( ! add )
+   {
+      struct kevent* ev;
+      for(ev=o->curEv ; ev < o->endEv ; ev++)
+      {
+         if((SoDispCon*)ev->udata == con && ev->filter == filter)
+            ev->filter = 0;
+      }
+   }
+}
+
+
+BA_API void
+SoDisp_constructor(SoDisp* o, ThreadMutex* mutex)
+{
+   memset(o, 0, sizeof(SoDisp));
+   DoubleList_constructor(&o->termList);
+   o->maxevents = 1024;
+   o->kq = kqueue();
+   if(o->kq < 0)
+      baFatalE(FE_SOCKET,0);
+   o->mutex = mutex;
+   o->defaultPollDelay = o->pollDelay = 1000;
+   o->doExit = FALSE;
+   o->events = (struct kevent*)baMalloc(
+      sizeof(struct kevent) * o->maxevents);
+   if(!o->events)
+      baFatalE(FE_MALLOC,0);
+   HttpTrace_printf(0, "KQUEUE dispatcher\n");
+}
+
+
+void
+_SoDisp_destructor(struct SoDisp* o)
+{
+   if(o->events)
+   {
+      baFree(o->events);
+      o->events=0;
+      close(o->kq);
+      o->kq=-1;
+   }
+}
+
+
+BA_API void
+SoDisp_newCon(SoDisp* o, struct SoDispCon* con)
+{
+   (void)o; /* not used */
+   DoubleLink_constructor(&con->dispatcherLink);
+}
+
+
+BA_API void
+SoDisp_addConnection(SoDisp* o, SoDispCon* con)
+{
+   (void)o; /* not used */
+   baAssert(!SoDispCon_dispatcherHasCon(con));
+   SoDispCon_setDispatcherHasCon(con);
+}
+
+
+BA_API void
+SoDisp_activateRec(SoDisp* o, SoDispCon* con)
+{
+   baAssert(!SoDispCon_recEvActive(con));
+   if(SoDispCon_isValid(con))
+   {
+      SoDispCon_setRecEvActive(con);
+      SoDisp_changeFilter(o,con,EVFILT_READ,TRUE);
+   }
+   else if( ! DoubleList_isInList(&o->termList, &con->dispatcherLink) )
+      DoubleList_insertLast(&o->termList, &con->dispatcherLink);
+}
+
+
+void
+SoDisp_deactivateRec(SoDisp* o, SoDispCon* con)
+{
+   baAssert(SoDispCon_recEvActive(con));
+   SoDispCon_setRecEvInactive(con);
+   SoDisp_changeFilter(o,con,EVFILT_READ,FALSE);
+   if( ! SoDispCon_sendEvActive(con) &&
+       DoubleLink_isLinked(&con->dispatcherLink) )
+   {
+      DoubleLink_unlink(&con->dispatcherLink);
+   }
+}
+
+
+#ifndef NO_ASYNCH_RESP
+void
+SoDisp_activateSend(SoDisp* o, SoDispCon* con)
+{
+   baAssert(!SoDispCon_sendEvActive(con));
+   if(SoDispCon_isValid(con))
+   {
+      SoDispCon_setSendEvActive(con);
+      SoDisp_changeFilter(o,con,EVFILT_WRITE,TRUE);
+   }
+   else if( ! DoubleList_isInList(&o->termList, &con->dispatcherLink) )
+      DoubleList_insertLast(&o->termList, &con->dispatcherLink);
+}
+
+
+void
+SoDisp_deactivateSend(SoDisp* o, SoDispCon* con)
+{
+   baAssert(SoDispCon_sendEvActive(con));
+   SoDispCon_setSendEvInactive(con);
+   SoDisp_changeFilter(o,con,EVFILT_WRITE,FALSE);
+   if( ! SoDispCon_recEvActive(con) &&
+       DoubleLink_isLinked(&con->dispatcherLink) )
+   {
+      DoubleLink_unlink(&con->dispatcherLink);
+   }
+}
+#endif
+
+
+void
+SoDisp_removeConnection(SoDisp* o, SoDispCon* con)
+{
+   (void)o; /* not used */
+   baAssert(SoDispCon_dispatcherHasCon(con));
+   baAssert(!SoDispCon_recEvActive(con));
+   baAssert(!SoDispCon_sendEvActive(con));
+   SoDispCon_clearDispatcherHasCon(con);
+   if(DoubleLink_isLinked(&con->dispatcherLink))
+      DoubleLink_unlink(&con->dispatcherLink);
+}
+
+
+/* Dispatch an event for a connection that is no longer valid or that
+   has a socket error. The event lets the owner close the connection.
+ */
+static void
+SoDisp_dispTermEvent(SoDispCon* con)
+{
+   if(SoDispCon_sendEvActive(con))
+      SoDispCon_dispSendEvent(con);
+   else
+   {
+      SoDispCon_setDispHasRecData(con);
+      SoDispCon_dispRecEvent(con);
+   }
+}
+
+
+void
+SoDisp_run(SoDisp* o, S32 timeout)
+{
+   int n;
+   int modTimeout;
+   struct timespec ts;
+   SoDisp_mutexSet(o);
+   o->doExit = FALSE;
+   if(timeout < 0) timeout=-1;
+   do
+   {
+      while( ! DoubleList_isEmpty(&o->termList) )
+      {
+         DoubleLink* l = DoubleList_removeFirst(&o->termList);
+         SoDisp_dispTermEvent(link2Con(l));
+      }
+      if(timeout >= 0)
+         modTimeout=timeout;
+      else
+         modTimeout=o->pollDelay;
+      ts.tv_sec = modTimeout / 1000;
+      ts.tv_nsec = (modTimeout % 1000) * 1000000;
+      SoDisp_mutexRelease(o);
+      n = kevent(o->kq, 0, 0, o->events, o->maxevents, &ts);
+      SoDisp_mutexSet(o);
+      if(n > 0)
+      {
+         o->endEv = o->events + n;
+         for(o->curEv=o->events ; o->curEv < o->endEv ; o->curEv++)
+         {
+            SoDispCon* con = (SoDispCon*)o->curEv->udata;
+            if(o->curEv->filter == EVFILT_WRITE)
+            {
+               if((o->curEv->flags & EV_ERROR) || !SoDispCon_isValid(con))
+                  SoDisp_dispTermEvent(con);
+               else
+                  SoDispCon_dispSendEvent(con);
+            }
+            else if(o->curEv->filter == EVFILT_READ)
+            {
+               if((o->curEv->flags & EV_ERROR) || !SoDispCon_isValid(con))
+                  SoDisp_dispTermEvent(con);
+               else
+               {
+                  /* EV_EOF: the read returns zero and closes the con. */
+                  SoDispCon_setDispHasRecData(con);
+                  SoDispCon_dispRecEvent(con);
+               }
+            }
+         }
+         o->curEv = o->endEv = 0;
+      }
+      else if(n == 0)
+      {
+         if(o->pollDelay != o->defaultPollDelay)
+         {
+            if(o->pollDelay == 0)
+               o->pollDelay=o->defaultPollDelay;
+            else
+            {
+               o->pollDelay = o->pollDelay + o->pollDelay/15;
+               if(o->pollDelay > o->defaultPollDelay)
+                  o->pollDelay = o->defaultPollDelay;
+            }
+         }
+      }
+      else if(EINTR != errno)
+      {
+         TRPR(("kevent failed: %s\n",strerror(errno)));
+         SoDisp_mutexRelease(o);
+         Thread_sleep(10);
+         SoDisp_mutexSet(o);
+      }
+   } while( (timeout < 0 || n > 0) && ! o->doExit );
+   SoDisp_mutexRelease(o);
+}
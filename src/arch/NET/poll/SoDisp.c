@@ -0,0 +1,494 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *                                                                        
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *                                                                         
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+
+Socket Dispatcher poll() implementation.
+
+An alternative to the select() based generic dispatcher for POSIX
+systems without epoll, such as QNX. The number of connections is not
+limited by FD_SETSIZE, and the pollfd array is kept between calls to
+poll(): an entry is added, changed, or removed when a connection's
+receive or send event is activated or deactivated. A removed entry
+is replaced by the last entry in the array.
+*/
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#define sodisp_c 1
+
+#ifdef __cplusplus
+#error Cannot compile any Barracuda code in C++ mode
+#endif
+
+#include <HttpServer.h>
+#include <HttpTrace.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+
+extern UserDefinedErrHandler barracudaUserDefinedErrHandler;
+
+#define link2Con(l) \
+ (SoDispCon*)((U8*)l-offsetof(SoDispCon,dispatcherLink))
+
+
+BA_API void
+baFatalEf(BaFatalErrorCodes ecode1, unsigned int ecode2,
+            const char* file, int line)
+{
+#ifdef HTTP_TRACE
+   static int recursiveCall=0;
+   if( ! recursiveCall )
+   {
+      recursiveCall=1;
+      HttpTrace_printf(0,"Fatal error detected in Barracuda.\n"
+                       "E1 = %d, E2=%d\n"
+                       "%s, line %d\n",
+                       ecode1, ecode2,
+                       file, line);
+      HttpTrace_flush();
+   }
+   recursiveCall=0;
+#endif
+   if(barracudaUserDefinedErrHandler)
+      (*barracudaUserDefinedErrHandler)(ecode1, ecode2, file, line);
+   else
+   {
+      for(;;) Thread_sleep(100000);
+   }
+}
+
+
+/* Wait 'tmo' milliseconds for one event on socket 's'.
+   Returns 1 if the event is signaled, 0 on timeout, and -1 on error.
+*/
+static int
+HttpSocket_poll(HttpSocket* s, short events, int tmo)
+{
+   struct pollfd pfd;
+   int status;
+   pfd.fd = s->hndl;
+   pfd.events = events;
+   pfd.revents = 0;
+   do {
+      status = poll(&pfd, 1, tmo);
+   } while(status < 0 && errno == EINTR);
+   if(status > 0)
+      return (pfd.revents & (POLLERR | POLLNVAL)) ? -1 : 1;
+   return status;
+}
+
+
+int
+BaAddrinfo_platConnect(BaAddrinfo* addr, HttpSocket* s, U32 timeout)
+{
+   int status;
+   HttpSocket_setNonblocking(s, &status);
+   status = socketConnect(s->hndl, addr->ai_addr, addr->ai_addrlen);
+   if(status)
+   {
+      HttpSocket_wouldBlock(s, &status);
+      if( ! status )
+      {
+         HttpSocket_close(s);
+         status = E_CANNOT_CONNECT;
+      }
+      else if(timeout)
+      {
+         struct sockaddr_storage peer;
+         socklen_t len=sizeof(struct sockaddr_storage);
+         if(HttpSocket_poll(s, POLLOUT, (int)timeout) > 0 &&
+            ! socketGetPeerName(s->hndl, (struct sockaddr*)&peer, &len))
+         {
+            status = 1; /* We are done */
+         }
+         else
+         {
+            HttpSocket_close(s);
+            status = E_CANNOT_CONNECT;
+         }
+      }
+      else
+         status = 0; /* pending */
+   }
+   else
+      status = 1; /* We are done */
+   return status;
+}
+
+
+/* Returns 0 if no data, >0 if data and <0 on error.
+   This function is called unprotected i.e. the SoDisp mutex is not set.
+   isTerminated is a variable handled by the caller.
+   Can be set to TRUE by a another thread.
+   If TRUE, the object "o" is no longer valid.
+*/
+int
+SoDispCon_platReadData(SoDispCon* o, ThreadMutex* m, BaBool* isTerminated,
+                       void* data, int len)
+{
+   int status;
+   if(m && ThreadMutex_isOwner(m))
+   {
+      if(o->rtmo)
+      {
+         SoDisp* disp;
+         int tmo = o->rtmo*50;
+         o->rtmo=0;
+         if(SoDispCon_recEvActive(o))
+         {
+            disp=SoDispCon_getDispatcher(o);
+            SoDisp_deactivateRec(disp, o);
+         }
+         else
+            disp=0;
+         ThreadMutex_release(m);
+         status = HttpSocket_poll(&o->httpSocket, POLLIN, tmo) > 0 ? 0 : -1;
+         ThreadMutex_set(m);
+         if(*isTerminated)
+            return E_SOCKET_READ_FAILED;
+         if(disp)
+            SoDisp_activateRec(disp, o);
+         if(status)
+            return E_TIMEOUT;
+      }
+      ThreadMutex_release(m);
+      HttpSocket_recv(&o->httpSocket,data,len,&status);
+      ThreadMutex_set(m);
+      if(*isTerminated)
+         return E_SOCKET_READ_FAILED;
+   }
+   else
+   {
+      if(o->rtmo)
+      {
+         int tmo = o->rtmo*50;
+         o->rtmo=0;
+         if(HttpSocket_poll(&o->httpSocket, POLLIN, tmo) <= 0)
+            return E_TIMEOUT;
+      }
+      HttpSocket_recv(&o->httpSocket,data,len,&status);
+   }
+   if( ! SoDispCon_isNonBlocking(o) )
+      SoDispCon_clearSocketHasNonBlockData(o);
+   if(status < 0)
+   {
+      SoDispCon_closeCon(o);
+      return E_SOCKET_READ_FAILED;
+   }
+   /* status=len, which can be zero if a non blocking socket.
+    */
+   return status;
+}
+
+
+/* Add, update, or remove the connection's pollfd entry.
+ */
+static void
+SoDisp_changeConState(SoDisp* o, SoDispCon* con)
+{
+   short events=0;
+   int ix;
+   if(SoDispCon_recEvActive(con))
+      events |= POLLIN;
+   if(SoDispCon_sendEvActive(con))
+      events |= POLLOUT;
+   if(con->pollIx)
+   {
+      ix = con->pollIx-1;
+      baAssert(o->cons[ix] == con);
+      if(events)
+      {
+         o->fds[ix].events = events;
+      }
+      else
+      {
+         /* Move the last entry to the free slot */
+         int last = --o->nfds;
+         if(ix != last)
+         {
+            o->fds[ix] = o->fds[last];
+            o->cons[ix] = o->cons[last];
+            o->cons[ix]->pollIx = ix+1;
+         }
+         con->pollIx=0;
+      }
+   }
+   else if(events)
+   {
+      if(o->nfds == o->maxfds)
+      {
+         int max = o->maxfds ? o->maxfds*2 : 64;
+         struct pollfd* fds = (struct pollfd*)baRealloc(
+            o->fds, sizeof(struct pollfd) * max);
+         SoDispCon** cons;
+         if(fds)
+            o->fds=fds;
+         cons = fds ? (SoDispCon**)baRealloc(
+            o->cons, sizeof(SoDispCon*) * max) : 0;
+         if(!cons)
+            baFatalE(FE_MALLOC,0);
+         o->cons=cons;
+         o->maxfds=max;
+      }
+      ix = o->nfds++;
+      o->fds[ix].fd = SoDispCon_getId(con);
+      o->fds[ix].events = events;
+      o->fds[ix].revents = 0;
+      o->cons[ix] = con;
+      con->pollIx = ix+1;
+   }
+}
+
+
+BA_API void
+SoDisp_constructor(SoDisp* o, ThreadMutex* mutex)
+{
+   memset(o, 0, sizeof(SoDisp));
+   DoubleList_constructor(&o->termList);
+   o->mutex = mutex;
+   o->defaultPollDelay = o->pollDelay = 1000;
+   o->doExit = FALSE;
+}
+
+
+void
+_SoDisp_destructor(struct SoDisp* o)
+{
+   if(o->fds)
+   {
+      baFree(o->fds);
+      baFree(o->cons);
+      o->fds=0;
+      o->cons=0;
+      o->nfds=o->maxfds=0;
+   }
+}
+
+
+BA_API void
+SoDisp_newCon(SoDisp* o, struct SoDispCon* con)
+{
+   (void)o; /* not used */
+   DoubleLink_constructor(&con->dispatcherLink);
+   con->pollIx=0;
+}
+
+
+BA_API void
+SoDisp_addConnection(SoDisp* o, SoDispCon* con)
+{
+   (void)o; /* not used */
+   baAssert(!SoDispCon_dispatcherHasCon(con));
+   SoDispCon_setDispatcherHasCon(con);
+}
+
+
+BA_API void
+SoDisp_activateRec(SoDisp* o, SoDispCon* con)
+{
+   baAssert(!SoDispCon_recEvActive(con));
+   if(SoDispCon_isValid(con))
+   {
+      SoDispCon_setRecEvActive(con);
+      SoDisp_changeConState(o,con);
+   }
+   else if( ! DoubleList_isInList(&o->termList, &con->dispatcherLink) )
+      DoubleList_insertLast(&o->termList, &con->dispatcherLink);
+}
+
+
+void
+SoDisp_deactivateRec(SoDisp* o, SoDispCon* con)
+{
+   baAssert(SoDispCon_recEvActive(con));
+   SoDispCon_setRecEvInactive(con);
+   SoDisp_changeConState(o,con);
+   if( ! con->pollIx && DoubleLink_isLinked(&con->dispatcherLink) )
+      DoubleLink_unlink(&con->dispatcherLink);
+}
+
+
+#ifndef NO_ASYNCH_RESP
+void
+SoDisp_activateSend(SoDisp* o, SoDispCon* con)
+{
+   baAssert(!SoDispCon_sendEvActive(con));
+   if(SoDispCon_isValid(con))
+   {
+      SoDispCon_setSendEvActive(con);
+      SoDisp_changeConState(o,con);
+   }
+   else if( ! DoubleList_isInList(&o->termList, &con->dispatcherLink) )
+      DoubleList_insertLast(&o->termList, &con->dispatcherLink);
+}
+
+
+void
+SoDisp_deactivateSend(SoDisp* o, SoDispCon* con)
+{
+   baAssert(SoDispCon_sendEvActive(con));
+   SoDispCon_setSendEvInactive(con);
+   SoDisp_changeConState(o,con);
+   if( ! con->pollIx && DoubleLink_isLinked(&con->dispatcherLink) )
+      DoubleLink_unlink(&con->dispatcherLink);
+}
+#endif
+
+
+void
+SoDisp_removeConnection(SoDisp* o, SoDispCon* con)
+{
+   (void)o; /* not used */
+   baAssert(SoDispCon_dispatcherHasCon(con));
+   baAssert(!SoDispCon_recEvActive(con));
+   baAssert(!SoDispCon_sendEvActive(con));
+   baAssert(!con->pollIx);
+   SoDispCon_clearDispatcherHasCon(con);
+   if(DoubleLink_isLinked(&con->dispatcherLink))
+      DoubleLink_unlink(&con->dispatcherLink);
+}
+
+
+/* Dispatch an event for a connection that is no longer valid or that
+   has a socket error. The event lets the owner close the connection.
+ */
+static void
+SoDisp_dispTermEvent(SoDispCon* con)
+{
+   if(SoDispCon_sendEvActive(con))
+      SoDispCon_dispSendEvent(con);
+   else
+   {
+      SoDispCon_setDispHasRecData(con);
+      SoDispCon_dispRecEvent(con);
+   }
+}
+
+
+void
+SoDisp_run(SoDisp* o, S32 timeout)
+{
+   int n;
+   int modTimeout;
+   SoDisp_mutexSet(o);
+   o->doExit = FALSE;
+   if(timeout < 0) timeout=-1;
+   do
+   {
+      while( ! DoubleList_isEmpty(&o->termList) )
+      {
+         DoubleLink* l = DoubleList_removeFirst(&o->termList);
+         SoDisp_dispTermEvent(link2Con(l));
+      }
+      if(timeout >= 0)
+         modTimeout=timeout;
+      else
+         modTimeout=o->pollDelay;
+      SoDisp_mutexRelease(o);
+      n = poll(o->fds, (nfds_t)o->nfds, modTimeout);
+      SoDisp_mutexSet(o);
+      if(n > 0)
+      {
+         int ix, events=n;
+         /* Iterate backwards: an entry removed by a callback is
+          * replaced by the last entry, which is already processed or
+          * is the entry being processed.
+          */
+         for(ix = o->nfds ; --ix >= 0 && events > 0 ; )
+         {
+            SoDispCon* con;
+            short revents;
+            if(ix >= o->nfds)
+               continue;
+            revents = o->fds[ix].revents;
+            if( ! revents )
+               continue;
+            o->fds[ix].revents = 0;
+            events--;
+            con = o->cons[ix];
+            if((revents & (POLLERR|POLLNVAL)) || !SoDispCon_isValid(con))
+            {
+               SoDisp_dispTermEvent(con);
+               if(ix < o->nfds && o->cons[ix] == con &&
+                  SoDispCon_isValid(con))
+               {
+                  SoDispCon_closeCon(con);
+                  goto L_rec;
+               }
+            }
+            else
+            {
+               if((revents & POLLOUT) ||
+                  ((revents & POLLHUP) && ! SoDispCon_recEvActive(con)))
+               {
+                  SoDispCon_dispSendEvent(con);
+                  if( ! (ix < o->nfds && o->cons[ix] == con) )
+                     continue;
+               }
+               if((revents & (POLLIN|POLLHUP)) && SoDispCon_recEvActive(con))
+               {
+                 L_rec:
+                  SoDispCon_setDispHasRecData(con);
+                  SoDispCon_dispRecEvent(con);
+               }
+            }
+         }
+      }
+      else if(n == 0)
+      {
+         if(o->pollDelay != o->defaultPollDelay)
+         {
+            if(o->pollDelay == 0)
+               o->pollDelay=o->defaultPollDelay;
+            else
+            {
+               o->pollDelay = o->pollDelay + o->pollDelay/15;
+               if(o->pollDelay > o->defaultPollDelay)
+                  o->pollDelay = o->defaultPollDelay;
+            }
+         }
+      }
+      else if(EINTR != errno)
+      {
+         TRPR(("poll failed: %s\n",strerror(errno)));
+         SoDisp_mutexRelease(o);
+         Thread_sleep(10);
+         SoDisp_mutexSet(o);
+      }
+   } while( (timeout < 0 || n > 0) && ! o->doExit );
+   SoDisp_mutexRelease(o);
+}
@@ -0,0 +1,142 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ *
+ ****************************************************************************
+ *			      HEADER
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *
+ *   this software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+ *
+ * POSIX mmap based ZipReader. See inc/MMapZipReader.h
+ */
+
+#ifndef BA_LIB
+#define BA_LIB 1
+#endif
+
+#include <MMapZipReader.h>
+#include <HttpTrace.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+
+/* The ZipIo bypasses this callback for most reads when 'map' is set.
+   It is still used by the ZipContainer, the central directory iterator,
+   and the AES decrypter.
+*/
+static int
+MMapZipReader_read(MMapZipReader* o, void* data, U32 offset, U32 size,
+                   int blockStart)
+{
+   ZipReader* zr = (ZipReader*)o;
+   (void)blockStart;
+   if(!zr->map || (BaFileSize)offset + size > o->mapSize)
+      return IOINTF_IOERROR;
+   memcpy(data, zr->map + offset, size);
+   return 0;
+}
+
+
+static int
+MMapZipReader_closed(MMapZipReader* o, void* data, U32 offset, U32 size,
+                     int blockStart)
+{
+   (void)o;
+   (void)data;
+   (void)offset;
+   (void)size;
+   (void)blockStart;
+   return IOINTF_IOERROR;
+}
+
+
+BA_API void
+MMapZipReader_constructor(MMapZipReader* o, const char* pathName)
+{
+   struct stat st;
+   int fd;
+   memset(o, 0, sizeof(MMapZipReader));
+   ZipReader_constructor((ZipReader*)o, (CspReader_Read)MMapZipReader_read, 0);
+   fd = open(pathName, O_RDONLY);
+   if(fd < 0 || fstat(fd, &st))
+   {
+      o->lastECode = errno == ENOENT ? IOINTF_ENOENT : IOINTF_NOACCESS;
+      goto L_err;
+   }
+   /* ZipReader::size is U32 and a ZIP file needs at least an end of
+      central directory record (22 bytes).
+   */
+   if(st.st_size < 22 || (BaFileSize)st.st_size > 0xFFFFFFFFu)
+   {
+      o->lastECode = IOINTF_IOERROR;
+      goto L_err;
+   }
+   o->addr = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   if(o->addr == MAP_FAILED)
+   {
+      o->addr = 0;
+      o->lastECode = errno == ENOMEM ? IOINTF_MEM : IOINTF_IOERROR;
+      goto L_err;
+   }
+   close(fd);
+#ifdef MADV_RANDOM
+   /* Requests touch scattered entries; avoid useless readahead. */
+   madvise(o->addr, (size_t)st.st_size, MADV_RANDOM);
+#endif
+   o->mapSize = (BaFileSize)st.st_size;
+   ((ZipReader*)o)->size = (U32)st.st_size;
+   ((ZipReader*)o)->map = (const U8*)o->addr;
+   CspReader_setIsValid(o);
+   return;
+
+  L_err:
+   if(fd >= 0)
+      close(fd);
+   TRPR(("Error: MMapZipReader, cannot map %s.", pathName));
+}
+
+
+BA_API int
+MMapZipReader_close(MMapZipReader* o)
+{
+   if(o->addr)
+   {
+      int status = munmap(o->addr, (size_t)o->mapSize) ? IOINTF_IOERROR : 0;
+      o->addr = 0;
+      ((ZipReader*)o)->map = 0;
+      ((CspReader*)o)->readCB = (CspReader_Read)MMapZipReader_closed;
+      return status;
+   }
+   return -1;
+}
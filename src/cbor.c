@@ -0,0 +1,925 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+CBOR (RFC 8949) parser and encoder, including RFC 8746 typed arrays.
+See inc/cbor.h for the API.
+*/
+
+#include <string.h>
+#include "cbor.h"
+
+#if defined(B_LITTLE_ENDIAN)
+#define CBOR_HOST_LE 1
+#elif defined(B_BIG_ENDIAN)
+#define CBOR_HOST_LE 0
+#endif
+
+#define CBOR_S64MAX ((U64)0x7FFFFFFFFFFFFFFFULL)
+
+typedef enum {
+   CBORPSt_Head,
+   CBORPSt_String,
+   CBORPSt_TArray
+} CBORPSt;
+
+
+/****************************************************************************
+                          Typed array element conversion
+ ****************************************************************************/
+
+/* Load a typed array element as raw bits, independent of host byte order */
+static U64
+CBOR_load(const U8* p, int size, int le)
+{
+   U64 v=0;
+   int i;
+   if(le)
+   {
+      for(i=size-1 ; i >= 0 ; i--)
+         v = (v << 8) | p[i];
+   }
+   else
+   {
+      for(i=0 ; i < size ; i++)
+         v = (v << 8) | p[i];
+   }
+   return v;
+}
+
+
+#ifndef NO_DOUBLE
+static float
+CBOR_half2float(U16 h)
+{
+   union { U32 u; float f; } v;
+   U32 e = (h >> 10) & 0x1F;
+   U32 m = h & 0x3FF;
+   if(e == 0)
+   {
+      v.f = (float)m * 5.9604644775390625e-8f; /* m * 2^-24 */
+      if(h & 0x8000)
+         v.f = -v.f;
+      return v.f;
+   }
+   if(e == 31)
+      v.u = 0x7F800000 | (m << 13);
+   else
+      v.u = ((e + 112) << 23) | (m << 13);
+   v.u |= (U32)(h & 0x8000) << 16;
+   return v.f;
+}
+#endif
+
+
+/* Convert 'n' elements of type 't' at 'src' to host format in 'dest'.
+   Float16 is expanded to float.
+*/
+static void
+CBOR_convert(void* dest, const U8* src, CBORAT t, S32 n, int le)
+{
+   int size = CBORAT_size(t);
+   S32 i;
+   switch(size)
+   {
+      case 1:
+         memcpy(dest, src, n);
+         break;
+      case 2:
+         if(t == CBORAT_Float16)
+         {
+#ifndef NO_DOUBLE
+            for(i=0 ; i < n ; i++, src+=2)
+               ((float*)dest)[i] = CBOR_half2float((U16)CBOR_load(src,2,le));
+#endif
+         }
+         else
+         {
+            for(i=0 ; i < n ; i++, src+=2)
+               ((U16*)dest)[i] = (U16)CBOR_load(src,2,le);
+         }
+         break;
+      case 4:
+         for(i=0 ; i < n ; i++, src+=4)
+            ((U32*)dest)[i] = (U32)CBOR_load(src,4,le);
+         break;
+      default:
+         for(i=0 ; i < n ; i++, src+=8)
+            ((U64*)dest)[i] = CBOR_load(src,8,le);
+   }
+}
+
+
+/****************************************************************************
+                                 CBORParser
+ ****************************************************************************/
+
+static void
+CBORParser_setInt(UBJVal* v, S64 i)
+{
+   if(i >= -128 && i <= 127)
+   {
+      v->t = UBJT_Int8;
+      v->u.int8 = (S8)i;
+   }
+   else if(i >= 0 && i <= 255)
+   {
+      v->t = UBJT_Uint8;
+      v->u.uint8 = (U8)i;
+   }
+   else if(i >= -32768 && i <= 32767)
+   {
+      v->t = UBJT_Int16;
+      v->u.int16 = (S16)i;
+   }
+   else if(i >= -2147483647-1 && i <= 2147483647)
+   {
+      v->t = UBJT_Int32;
+      v->u.int32 = (S32)i;
+   }
+   else
+   {
+      v->t = UBJT_Int64;
+      v->u.int64 = i;
+   }
+}
+
+
+static int
+CBORParser_err(CBORParser* o, UBJPStatus status)
+{
+   o->status = (U8)status;
+   return -1;
+}
+
+
+#define CBORParser_top(o) (o->stack + o->stackIx - 1)
+
+/* Set the member name for the next callback */
+#define CBORParser_setName(o) \
+   o->val.name = o->stackIx && CBORParser_top(o)->isObj ? o->name : 0
+
+
+static int
+CBORParser_service(CBORParser* o, int recLevel)
+{
+   if(UBJPIntf_service(o->intf, &o->val, recLevel))
+      return CBORParser_err(o, UBJPStatus_IntfErr);
+   return 0;
+}
+
+
+/* Called when a value or a member name is complete. Pops and
+   terminates the definite length containers ending with this item.
+   Returns -1 on error, 1 if the root value is complete, otherwise 0.
+*/
+static int
+CBORParser_itemDone(CBORParser* o)
+{
+   while(o->stackIx)
+   {
+      CBORPStackNode* n = CBORParser_top(o);
+      if(n->isObj)
+         n->isKey = !n->isKey;
+      if(n->count < 0 || --n->count)
+         return 0;
+      o->stackIx--;
+      o->val.t = (U8)(n->isObj ? UBJT_EndObject : UBJT_EndArray);
+      o->val.name = 0;
+      if(CBORParser_service(o, o->stackIx))
+         return -1;
+   }
+   o->status = (U8)(o->bufPtr < o->bufEnd ?
+                    UBJPStatus_Done : UBJPStatus_DoneEOS);
+   return 1;
+}
+
+
+/* Returns 1 when the head is available in 'head' (copied if split
+   between chunks) and 0 if more data is needed.
+*/
+static int
+CBORParser_readHead(CBORParser* o, const U8** head)
+{
+   static const U8 argLen[32]={
+      0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,1,2,4,8,0,0,0,0
+   };
+   U32 need;
+   U32 avail = (U32)(o->bufEnd - o->bufPtr);
+   if(o->headLen == 0)
+   {
+      if(avail == 0)
+         return 0;
+      need = 1 + argLen[*o->bufPtr & 31];
+      if(avail >= need)
+      {
+         *head = o->bufPtr;
+         o->bufPtr += need;
+         return 1;
+      }
+      memcpy(o->head, o->bufPtr, avail);
+      o->headLen = (U8)avail;
+      o->bufPtr += avail;
+      return 0;
+   }
+   need = 1 + argLen[o->head[0] & 31] - o->headLen;
+   if(avail < need)
+   {
+      memcpy(o->head + o->headLen, o->bufPtr, avail);
+      o->headLen += (U8)avail;
+      o->bufPtr += avail;
+      return 0;
+   }
+   memcpy(o->head + o->headLen, o->bufPtr, need);
+   o->bufPtr += need;
+   o->headLen = 0;
+   *head = o->head;
+   return 1;
+}
+
+
+static int
+CBORParser_push(CBORParser* o, int isObj, U64 arg, int ai)
+{
+   CBORPStackNode* n;
+   if(o->stackIx == o->stackLen)
+      return CBORParser_err(o, UBJPStatus_Overflow);
+   CBORParser_setName(o);
+   o->val.t = (U8)(isObj ? UBJT_BeginObject : UBJT_BeginArray);
+   if(CBORParser_service(o, o->stackIx))
+      return -1;
+   n = o->stack + o->stackIx++;
+   n->isObj = (U8)isObj;
+   n->isKey = (U8)isObj;
+   if(ai == 31)
+   {
+      n->count = -1;
+      return 0;
+   }
+   if(arg > 0x3FFFFFFF)
+      return CBORParser_err(o, UBJPStatus_Overflow);
+   o->val.t = UBJT_Count;
+   o->val.len = (S32)arg;
+   o->val.x = UBJT_InvalidType;
+   o->val.name = 0;
+   if(CBORParser_service(o, o->stackIx-1))
+      return -1;
+   n->count = isObj ? (S64)arg * 2 : (S64)arg;
+   if(arg)
+      return 0;
+   /* Empty container: end it and complete the item in the parent */
+   o->stackIx--;
+   o->val.t = (U8)(isObj ? UBJT_EndObject : UBJT_EndArray);
+   if(CBORParser_service(o, o->stackIx))
+      return -1;
+   return CBORParser_itemDone(o);
+}
+
+
+/* Decimal member name for integer map keys */
+static int
+CBORParser_intKey(CBORParser* o, U64 arg, int neg)
+{
+   char tmp[24];
+   char* ptr = tmp + sizeof(tmp);
+   int len;
+   if(neg)
+   {
+      /* -1 - arg, computed without overflow */
+      arg++;
+      if(arg == 0)
+         return CBORParser_err(o, UBJPStatus_Overflow);
+   }
+   do {
+      *--ptr = (char)('0' + arg % 10);
+      arg /= 10;
+   } while(arg);
+   if(neg)
+      *--ptr = '-';
+   len = (int)(tmp + sizeof(tmp) - ptr);
+   if(len >= o->memberNameLen)
+      return CBORParser_err(o, UBJPStatus_Overflow);
+   memcpy(o->name, ptr, len);
+   o->name[len] = 0;
+   return CBORParser_itemDone(o);
+}
+
+
+/* Start of a typed array: the tag is followed by the byte string head */
+static int
+CBORParser_beginTArray(CBORParser* o, U64 arg)
+{
+   static const U8 ubjType[] = {
+      UBJT_Uint8, UBJT_Int8, UBJT_Int32, UBJT_Int16, UBJT_Int64, UBJT_Int32,
+      UBJT_Int64, UBJT_Int64, UBJT_Float32, UBJT_Float32, UBJT_Float64
+   };
+   int size = CBORAT_size(o->taType);
+   if(arg % size || arg / size > 0x7FFFFFFF)
+      return CBORParser_err(o, UBJPStatus_Overflow);
+   o->remaining = arg;
+   o->taLeft = (S32)(arg / size);
+   o->elemLen = 0;
+   o->state = CBORPSt_TArray;
+   if( ! o->arrayCB )
+   {
+      CBORParser_setName(o);
+      o->val.t = UBJT_BeginArray;
+      if(CBORParser_service(o, o->stackIx))
+         return -1;
+      o->val.t = UBJT_Count;
+      o->val.len = o->taLeft;
+      o->val.x = ubjType[o->taType];
+      o->val.name = 0;
+      if(CBORParser_service(o, o->stackIx))
+         return -1;
+   }
+   else if( ! o->taLeft )
+   {
+      CBORAT t = o->taType == CBORAT_Float16 ?
+         CBORAT_Float32 : (CBORAT)o->taType;
+      if(o->arrayCB(o, o->stackIx && CBORParser_top(o)->isObj ? o->name : 0,
+                    t, o->scratch.buf, 0, 0, o->stackIx))
+      {
+         return CBORParser_err(o, UBJPStatus_IntfErr);
+      }
+   }
+   return 0;
+}
+
+
+/* Deliver 'n' complete typed array elements */
+static int
+CBORParser_taDeliver(CBORParser* o, const U8* p, S32 n)
+{
+   CBORAT t = (CBORAT)o->taType;
+   int size = CBORAT_size(t);
+   if(o->arrayCB)
+   {
+      CBORAT outT = t == CBORAT_Float16 ? CBORAT_Float32 : t;
+      const char* name = o->stackIx && CBORParser_top(o)->isObj ? o->name : 0;
+#ifdef CBOR_HOST_LE
+      if(o->taLE == CBOR_HOST_LE && t != CBORAT_Float16 &&
+          ! ((uintptr_t)p & (size - 1)) )
+      {
+         o->taLeft -= n;
+         if(o->arrayCB(o, name, outT, p, n, o->taLeft, o->stackIx))
+            return CBORParser_err(o, UBJPStatus_IntfErr);
+         return 0;
+      }
+#endif
+      while(n)
+      {
+         int outSize = CBORAT_size(outT);
+         S32 chunk = CBORPARS_SCRATCH_LEN / outSize;
+         if(chunk > n)
+            chunk = n;
+         CBOR_convert(o->scratch.buf, p, t, chunk, o->taLE);
+         p += chunk * size;
+         n -= chunk;
+         o->taLeft -= chunk;
+         if(o->arrayCB(o,name,outT,o->scratch.buf,chunk,o->taLeft,o->stackIx))
+            return CBORParser_err(o, UBJPStatus_IntfErr);
+      }
+      return 0;
+   }
+   o->val.name = 0;
+   for( ; n ; n--, p += size)
+   {
+      U64 v = CBOR_load(p, size, o->taLE);
+      switch(t)
+      {
+         case CBORAT_Uint8:
+            o->val.t = UBJT_Uint8; o->val.u.uint8 = (U8)v; break;
+         case CBORAT_Int8:
+            o->val.t = UBJT_Int8; o->val.u.int8 = (S8)v; break;
+         case CBORAT_Uint16:
+            o->val.t = UBJT_Int32; o->val.u.int32 = (S32)v; break;
+         case CBORAT_Int16:
+            o->val.t = UBJT_Int16; o->val.u.int16 = (S16)v; break;
+         case CBORAT_Uint32:
+            o->val.t = UBJT_Int64; o->val.u.int64 = (S64)v; break;
+         case CBORAT_Int32:
+            o->val.t = UBJT_Int32; o->val.u.int32 = (S32)v; break;
+         case CBORAT_Uint64:
+            if(v > CBOR_S64MAX)
+               return CBORParser_err(o, UBJPStatus_Overflow);
+            /* fall through */
+         case CBORAT_Int64:
+            o->val.t = UBJT_Int64; o->val.u.int64 = (S64)v; break;
+#ifndef NO_DOUBLE
+         case CBORAT_Float16:
+            o->val.t = UBJT_Float32;
+            o->val.u.float32 = CBOR_half2float((U16)v);
+            break;
+         case CBORAT_Float32:
+         {
+            union { U32 u; float f; } f;
+            f.u = (U32)v;
+            o->val.t = UBJT_Float32; o->val.u.float32 = f.f;
+            break;
+         }
+         case CBORAT_Float64:
+         {
+            union { U64 u; double d; } d;
+            d.u = v;
+            o->val.t = UBJT_Float64; o->val.u.float64 = d.d;
+            break;
+         }
+#endif
+         default:
+            return CBORParser_err(o, UBJPStatus_ParseErr);
+      }
+      o->taLeft--;
+      if(CBORParser_service(o, o->stackIx+1))
+         return -1;
+   }
+   return 0;
+}
+
+
+/* Process a data item head. Returns -1 on error, 1 if the root value
+   is complete, otherwise 0.
+*/
+static int
+CBORParser_head(CBORParser* o, const U8* head)
+{
+   static const U8 taTypes[24] = {
+      CBORAT_Uint8, CBORAT_Uint16, CBORAT_Uint32, CBORAT_Uint64,
+      CBORAT_Uint8, CBORAT_Uint16, CBORAT_Uint32, CBORAT_Uint64,
+      CBORAT_Int8, CBORAT_Int16, CBORAT_Int32, CBORAT_Int64,
+      CBORAT_InvalidType, CBORAT_Int16, CBORAT_Int32, CBORAT_Int64,
+      CBORAT_Float16, CBORAT_Float32, CBORAT_Float64, CBORAT_InvalidType,
+      CBORAT_Float16, CBORAT_Float32, CBORAT_Float64, CBORAT_InvalidType
+   };
+   U64 arg;
+   int major = head[0] >> 5;
+   int ai = head[0] & 31;
+   int isKey;
+   switch(ai)
+   {
+      case 24: arg = head[1]; break;
+      case 25: arg = CBOR_load(head+1, 2, FALSE); break;
+      case 26: arg = CBOR_load(head+1, 4, FALSE); break;
+      case 27: arg = CBOR_load(head+1, 8, FALSE); break;
+      case 28: case 29: case 30:
+         return CBORParser_err(o, UBJPStatus_ParseErr);
+      default: arg = (U64)ai;
+   }
+   if(o->indefStr)
+   {
+      if(head[0] == 0xFF)
+      {
+         o->indefStr = FALSE;
+         if(o->isKey)
+         {
+            o->name[o->nameLen] = 0;
+            return CBORParser_itemDone(o);
+         }
+         CBORParser_setName(o);
+         o->val.t = UBJT_String;
+         o->val.u.string = "";
+         o->val.len = 0;
+         o->val.x = 0;
+         if(CBORParser_service(o, o->stackIx))
+            return -1;
+         return CBORParser_itemDone(o);
+      }
+      /* Segments must be definite length strings of the same type */
+      if(major != o->strMajor || ai == 31 || arg > 0x7FFFFFFF)
+         return CBORParser_err(o, UBJPStatus_ParseErr);
+      o->remaining = arg;
+      o->state = CBORPSt_String;
+      return 0;
+   }
+   isKey = o->stackIx && CBORParser_top(o)->isKey;
+   if(o->taType != CBORAT_InvalidType)
+   {
+      if(major == 2 && ai != 31 && !isKey)
+         return CBORParser_beginTArray(o, arg);
+      /* Not a typed array: ignore the tag */
+      o->taType = CBORAT_InvalidType;
+   }
+   switch(major)
+   {
+      case 0:
+      case 1:
+         if(isKey)
+            return CBORParser_intKey(o, arg, major);
+         if(arg > CBOR_S64MAX)
+            return CBORParser_err(o, UBJPStatus_Overflow);
+         CBORParser_setInt(&o->val, major ? -1 - (S64)arg : (S64)arg);
+         break;
+
+      case 2:
+      case 3:
+         o->strMajor = (U8)major;
+         o->isKey = (U8)isKey;
+         o->nameLen = 0;
+         if(ai == 31)
+         {
+            o->indefStr = TRUE;
+            return 0;
+         }
+         if(arg > 0x7FFFFFFF)
+            return CBORParser_err(o, UBJPStatus_Overflow);
+         o->remaining = arg;
+         o->state = CBORPSt_String;
+         return 0;
+
+      case 4:
+      case 5:
+         if(isKey)
+            return CBORParser_err(o, UBJPStatus_ParseErr);
+         return CBORParser_push(o, major == 5, arg, ai);
+
+      case 6:
+         if(arg >= 64 && arg <= 87)
+         {
+            o->taType = taTypes[arg - 64];
+            o->taLE = (arg & 4) ? TRUE : FALSE;
+         }
+         return 0;
+
+      default:
+         if(ai == 31)
+         {
+            CBORPStackNode* n = CBORParser_top(o);
+            if( ! o->stackIx || n->count >= 0 || (n->isObj && ! n->isKey) )
+               return CBORParser_err(o, UBJPStatus_ParseErr);
+            o->stackIx--;
+            o->val.t = (U8)(n->isObj ? UBJT_EndObject : UBJT_EndArray);
+            o->val.name = 0;
+            if(CBORParser_service(o, o->stackIx))
+               return -1;
+            return CBORParser_itemDone(o);
+         }
+         if(isKey)
+            return CBORParser_err(o, UBJPStatus_ParseErr);
+         if(ai == 20 || ai == 21)
+         {
+            o->val.t = UBJT_Boolean;
+            o->val.u.uint8 = (U8)(ai == 21);
+         }
+#ifndef NO_DOUBLE
+         else if(ai == 25)
+         {
+            o->val.t = UBJT_Float32;
+            o->val.u.float32 = CBOR_half2float((U16)arg);
+         }
+         else if(ai == 26)
+         {
+            union { U32 u; float f; } f;
+            f.u = (U32)arg;
+            o->val.t = UBJT_Float32;
+            o->val.u.float32 = f.f;
+         }
+         else if(ai == 27)
+         {
+            union { U64 u; double d; } d;
+            d.u = arg;
+            o->val.t = UBJT_Float64;
+            o->val.u.float64 = d.d;
+         }
+#endif
+         else /* null, undefined, and unassigned simple values */
+            o->val.t = UBJT_Null;
+   }
+   CBORParser_setName(o);
+   if(CBORParser_service(o, o->stackIx))
+      return -1;
+   return CBORParser_itemDone(o);
+}
+
+
+void
+CBORParser_constructor(CBORParser* o, UBJPIntf* intf, char* name,
+                       int memberNameLen, int extraStackLen)
+{
+   memset(o, 0, sizeof(CBORParser));
+   o->intf = intf;
+   o->name = name;
+   o->memberNameLen = memberNameLen;
+   o->stackLen = CBORPARS_STACK_LEN + extraStackLen;
+   o->status = UBJPStatus_NeedMoreData;
+   o->taType = CBORAT_InvalidType;
+}
+
+
+int
+CBORParser_parse(CBORParser* o, const U8* buf, U32 size)
+{
+   const U8* head;
+   const U8* p;
+   U32 n;
+   int rc;
+   if(o->status == UBJPStatus_DoneEOS || o->status == UBJPStatus_NeedMoreData)
+   {
+      o->bufPtr = buf;
+      o->bufEnd = buf + size;
+   }
+   else if(o->status != UBJPStatus_Done)
+      return -1;
+
+   for(;;)
+   {
+      switch(o->state)
+      {
+         case CBORPSt_Head:
+            if( ! CBORParser_readHead(o, &head) )
+               goto L_needMore;
+            rc = CBORParser_head(o, head);
+            break;
+
+         case CBORPSt_String:
+            n = (U32)(o->bufEnd - o->bufPtr);
+            if(n > o->remaining)
+               n = (U32)o->remaining;
+            if(o->isKey)
+            {
+               if(o->nameLen + (int)n >= o->memberNameLen)
+                  return CBORParser_err(o, UBJPStatus_Overflow);
+               memcpy(o->name + o->nameLen, o->bufPtr, n);
+               o->nameLen += (int)n;
+            }
+            else
+            {
+               if( ! n && o->remaining )
+                  goto L_needMore;
+               CBORParser_setName(o);
+               o->val.t = UBJT_String;
+               o->val.u.string = (const char*)o->bufPtr;
+               o->val.len = (S32)n;
+               o->val.x = o->indefStr ? -1 : (S32)(o->remaining - n);
+               if(CBORParser_service(o, o->stackIx))
+                  return -1;
+            }
+            o->bufPtr += n;
+            o->remaining -= n;
+            if(o->remaining)
+               goto L_needMore;
+            o->state = CBORPSt_Head;
+            rc = 0;
+            if( ! o->indefStr )
+            {
+               if(o->isKey)
+                  o->name[o->nameLen] = 0;
+               rc = CBORParser_itemDone(o);
+            }
+            break;
+
+         case CBORPSt_TArray:
+         {
+            U32 esize = CBORAT_size(o->taType);
+            n = (U32)(o->bufEnd - o->bufPtr);
+            if(n > o->remaining)
+               n = (U32)o->remaining;
+            p = o->bufPtr;
+            o->bufPtr += n;
+            o->remaining -= n;
+            if(o->elemLen)
+            {
+               U32 k = esize - o->elemLen;
+               if(k > n)
+                  k = n;
+               memcpy(o->elem + o->elemLen, p, k);
+               o->elemLen += (U8)k;
+               p += k;
+               n -= k;
+               if(o->elemLen == esize)
+               {
+                  o->elemLen = 0;
+                  if(CBORParser_taDeliver(o, o->elem, 1))
+                     return -1;
+               }
+            }
+            if(n >= esize && CBORParser_taDeliver(o, p, (S32)(n / esize)))
+               return -1;
+            if(n % esize)
+            {
+               memcpy(o->elem, p + n - n % esize, n % esize);
+               o->elemLen = (U8)(n % esize);
+            }
+            if(o->remaining)
+               goto L_needMore;
+            o->state = CBORPSt_Head;
+            o->taType = CBORAT_InvalidType;
+            if( ! o->arrayCB )
+            {
+               o->val.t = UBJT_EndArray;
+               o->val.name = 0;
+               if(CBORParser_service(o, o->stackIx))
+                  return -1;
+            }
+            rc = CBORParser_itemDone(o);
+            break;
+         }
+
+         default:
+            baAssert(0);
+            return CBORParser_err(o, UBJPStatus_ParseErr);
+      }
+      if(rc)
+         return rc;
+   }
+
+  L_needMore:
+   o->status = UBJPStatus_NeedMoreData;
+   return 0;
+}
+
+
+/****************************************************************************
+                                 CBOREncoder
+ ****************************************************************************/
+
+/* Make sure 'size' bytes can be written to the buffer */
+static int
+CBOREncoder_reserve(CBOREncoder* o, S32 size)
+{
+   UBJEBuf* b = o->buf;
+   if(o->status)
+      return o->status;
+   if(b->cursor + size > b->dlen &&
+      (b->flushCB(b, size) || b->cursor + size > b->dlen))
+   {
+      o->status = UBJEStatus_FlushErr;
+   }
+   return o->status;
+}
+
+
+/* Copy data to the buffer, flushing or expanding the buffer as needed */
+static int
+CBOREncoder_raw(CBOREncoder* o, const U8* data, S32 len)
+{
+   UBJEBuf* b = o->buf;
+   for(;;)
+   {
+      S32 n = b->dlen - b->cursor;
+      if(n > len)
+         n = len;
+      memcpy(b->data + b->cursor, data, n);
+      b->cursor += n;
+      data += n;
+      len -= n;
+      if( ! len )
+         return 0;
+      if(b->flushCB(b, len) || b->cursor >= b->dlen)
+         return o->status = UBJEStatus_FlushErr;
+   }
+}
+
+
+/* Write 'v' big endian using 'size' bytes */
+static int
+CBOREncoder_be(CBOREncoder* o, U64 v, int size)
+{
+   U8* p;
+   if(CBOREncoder_reserve(o, size))
+      return o->status;
+   o->buf->cursor += size;
+   p = o->buf->data + o->buf->cursor;
+   while(size--)
+   {
+      *--p = (U8)v;
+      v >>= 8;
+   }
+   return 0;
+}
+
+
+/* Write the initial byte 'ib' followed by the argument 'v' */
+static int
+CBOREncoder_bits(CBOREncoder* o, U8 ib, U64 v, int size)
+{
+   if(CBOREncoder_reserve(o, size + 1))
+      return o->status;
+   o->buf->data[o->buf->cursor++] = ib;
+   return size ? CBOREncoder_be(o, v, size) : 0;
+}
+
+
+int
+CBOREncoder_head(CBOREncoder* o, U8 major, U64 arg)
+{
+   U8 ib = (U8)(major << 5);
+   if(arg < 24)
+      return CBOREncoder_bits(o, (U8)(ib | arg), 0, 0);
+   if(arg <= 0xFF)
+      return CBOREncoder_bits(o, (U8)(ib | 24), arg, 1);
+   if(arg <= 0xFFFF)
+      return CBOREncoder_bits(o, (U8)(ib | 25), arg, 2);
+   if(arg <= 0xFFFFFFFF)
+      return CBOREncoder_bits(o, (U8)(ib | 26), arg, 4);
+   return CBOREncoder_bits(o, (U8)(ib | 27), arg, 8);
+}
+
+
+int
+CBOREncoder_indef(CBOREncoder* o, U8 major)
+{
+   return CBOREncoder_bits(o, (U8)((major << 5) | 31), 0, 0);
+}
+
+
+int
+CBOREncoder_integer(CBOREncoder* o, S64 v)
+{
+   return v < 0 ?
+      CBOREncoder_head(o, 1, ~(U64)v) : CBOREncoder_head(o, 0, (U64)v);
+}
+
+
+#ifndef NO_DOUBLE
+int
+CBOREncoder_float32(CBOREncoder* o, float v)
+{
+   union { U32 u; float f; } f;
+   f.f = v;
+   return CBOREncoder_bits(o, 0xFA, f.u, 4);
+}
+
+
+int
+CBOREncoder_float64(CBOREncoder* o, double v)
+{
+   union { U64 u; double d; } d;
+   d.d = v;
+   return CBOREncoder_bits(o, 0xFB, d.u, 8);
+}
+#endif
+
+
+int
+CBOREncoder_write(CBOREncoder* o, U8 major, const void* data, S32 len)
+{
+   if(CBOREncoder_head(o, major, (U64)len))
+      return o->status;
+   return len ? CBOREncoder_raw(o, (const U8*)data, len) : 0;
+}
+
+
+int
+CBOREncoder_typedArray(CBOREncoder* o, CBORAT t, const void* data, S32 count)
+{
+   /* Big endian typed array tags; add 4 for little endian */
+   static const U8 tags[] = {64, 72, 65, 73, 66, 74, 67, 75, 0, 81, 82};
+   int size;
+   if((unsigned)t > CBORAT_Float64 || t == CBORAT_Float16)
+      return o->status = UBJEStatus_Unknown;
+   size = CBORAT_size(t);
+#ifdef CBOR_HOST_LE
+   if(CBOREncoder_tag(o, tags[t] + (CBOR_HOST_LE && size > 1 ? 4 : 0)) ||
+      CBOREncoder_write(o, 2, data, count * size))
+   {
+      return o->status;
+   }
+#else
+   /* Unknown host byte order: write the elements big endian */
+   if(CBOREncoder_tag(o, tags[t]) || CBOREncoder_head(o, 2, count * size))
+      return o->status;
+   for( ; count ; count--, data = (const U8*)data + size)
+   {
+      U64 v;
+      switch(size)
+      {
+         case 1: v = *(const U8*)data; break;
+         case 2: v = *(const U16*)data; break;
+         case 4: v = *(const U32*)data; break;
+         default: v = *(const U64*)data;
+      }
+      if(CBOREncoder_be(o, v, size))
+         return o->status;
+   }
+#endif
+   return 0;
+}
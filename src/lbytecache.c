@@ -0,0 +1,494 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Persistent Lua bytecode cache.
+
+Lua API, installed by balua_bytecache():
+  ba.bytecache.setdir(io [,dir]) -> true | nil, err
+  ba.bytecache.loadfile(name [,io [,env]]) -> func | nil, err
+  ba.bytecache.loadlsp(name [,io [,env]]) -> func | nil, err
+  ba.bytecache.build(io [,dir]) -> compiled, failed
+  ba.bytecache.stats() -> hits, misses
+
+setdir() enables the cache and sets the directory 'dir' in the
+writable I/O 'io' where the compiled chunks are saved; call setdir()
+without arguments to disable the cache. The cache directory must only
+be writable by the server since loading bytecode is not safe for
+untrusted data.
+
+loadfile() and loadlsp() load the Lua script or LSP page 'name' from
+'io', by default the VM's I/O, and return the compiled function. The
+optional 'env' table is set as the function's _ENV. A cache entry is
+keyed by the name and the SHA-256 hash of the source, thus a changed
+source is compiled again, and a ZIP file with a new version of an
+application does not use the chunks compiled for the previous
+version. loadlsp() compiles the Lua code returned by ba.parselsp().
+A chunk that cannot be loaded, e.g. a chunk created by an
+incompatible Lua build, is compiled and saved again. Obsolete entries
+are not removed; delete the cache directory to reclaim the space.
+
+build() compiles all .lua and .lsp files in 'io', starting at 'dir',
+and saves the chunks in the cache. Run build() on the target, or on a
+build with the same Lua configuration and byte order, to precompile
+an application ZIP file before it is deployed:
+  ba.bytecache.setdir(ba.openio"disk", "/var/cache/mako")
+  print(ba.bytecache.build(ba.mkio(ba.openio"disk", "myapp.zip")))
+*/
+
+#ifndef BA_LIB
+#define BA_LIB
+#endif
+#ifndef LUA_LIB
+#define LUA_LIB
+#endif
+
+#include <string.h>
+#include <SharkSslCrypto.h>
+#include "balua.h"
+
+/* Magic and format version, followed by the SHA-256 of the source */
+#define LBYTECACHE_MAGIC "BLC\001"
+#define LBYTECACHE_HDRLEN (4+SHARKSSL_SHA256_HASH_LEN)
+
+#ifndef LBYTECACHE_MAXDEPTH
+#define LBYTECACHE_MAXDEPTH 16
+#endif
+
+typedef struct
+{
+   IoIntf* io; /* Cache I/O or NULL when not enabled */
+   const char* dir;
+} LBytecache;
+
+static U32 lbytecacheHits;
+static U32 lbytecacheMisses;
+
+
+/* Get the cache configuration from the upvalue table */
+static void
+LBytecache_get(lua_State* L, LBytecache* o)
+{
+   o->io=0;
+   o->dir="";
+   if(lua_getfield(L, lua_upvalueindex(1), "io") != LUA_TNIL)
+   {
+      o->io=baluaENV_checkIoIntf(L, lua_absindex(L, -1));
+      lua_getfield(L, lua_upvalueindex(1), "dir");
+      o->dir=lua_tostring(L, -1); /* Anchored by the upvalue table */
+      lua_pop(L, 1);
+   }
+   lua_pop(L, 1);
+}
+
+
+/* Read resource 'name'. The returned buffer must be released with
+   baFree.
+*/
+static char*
+LBytecache_read(IoIntf* io, const char* name, size_t* len, int* status)
+{
+   IoStat st;
+   ResIntfPtr r;
+   char* buf;
+   size_t size, n=0;
+   if( (*status=io->statFp(io, name, &st)) != 0 )
+      return 0;
+   if(st.isDir)
+   {
+      *status=IOINTF_NOTFOUND;
+      return 0;
+   }
+   r=io->openResFp(io, name, OpenRes_READ, status, 0);
+   if( ! r )
+      return 0;
+   size=(size_t)st.size;
+   buf=(char*)baMalloc(size+1);
+   if(buf)
+   {
+      while(n < size)
+      {
+         size_t rsize;
+         if( (*status=r->readFp(r, buf+n, size-n, &rsize)) != 0 || ! rsize )
+            break;
+         n+=rsize;
+      }
+      if(n != size)
+      {
+         if( ! *status )
+            *status=IOINTF_IOERROR;
+         baFree(buf);
+         buf=0;
+      }
+   }
+   else
+      *status=IOINTF_MEM;
+   r->closeFp(r);
+   *len=size;
+   return buf;
+}
+
+
+/* Push the cache file name for source 'name' of type 'kind' */
+static const char*
+LBytecache_pushName(lua_State* L, LBytecache* o, const char* name,
+                    char kind, const U8* srcHash)
+{
+   static const char hex[]="0123456789abcdef";
+   SharkSslSha256Ctx ctx;
+   U8 digest[SHARKSSL_SHA256_HASH_LEN];
+   char key[33];
+   size_t dlen=strlen(o->dir);
+   int i;
+   SharkSslSha256Ctx_constructor(&ctx);
+   SharkSslSha256Ctx_append(&ctx, (const U8*)&kind, 1);
+   SharkSslSha256Ctx_append(&ctx, (const U8*)name, (U32)strlen(name));
+   SharkSslSha256Ctx_append(&ctx, srcHash, SHARKSSL_SHA256_HASH_LEN);
+   SharkSslSha256Ctx_finish(&ctx, digest);
+   for(i=0 ; i < 16 ; i++)
+   {
+      key[2*i]=hex[digest[i] >> 4];
+      key[2*i+1]=hex[digest[i] & 15];
+   }
+   key[32]=0;
+   return lua_pushfstring(L, "%s%s%s.luac", o->dir,
+                          dlen && o->dir[dlen-1] != '/' ? "/" : "", key);
+}
+
+
+/* Push the cached function. Returns 0 on success or -1 if not found
+   or if the chunk cannot be loaded; nothing is pushed on failure.
+*/
+static int
+LBytecache_loadCached(lua_State* L, LBytecache* o, const char* cname,
+                      const U8* srcHash, const char* chunkname)
+{
+   size_t len;
+   int status;
+   char* buf=LBytecache_read(o->io, cname, &len, &status);
+   if( ! buf )
+      return -1;
+   status=-1;
+   if(len > LBYTECACHE_HDRLEN &&
+      ! memcmp(buf, LBYTECACHE_MAGIC, 4) &&
+      ! memcmp(buf+4, srcHash, SHARKSSL_SHA256_HASH_LEN))
+   {
+      status=luaL_loadbufferx(
+         L, buf+LBYTECACHE_HDRLEN, len-LBYTECACHE_HDRLEN, chunkname, "b");
+      if(status)
+      {
+         lua_pop(L, 1); /* error message */
+         status=-1;
+      }
+   }
+   baFree(buf);
+   return status;
+}
+
+
+static int
+LBytecache_writer(lua_State* L, const void* p, size_t sz, void* ud)
+{
+   ResIntfPtr r = (ResIntfPtr)ud;
+   (void)L;
+   return r->writeFp(r, p, sz) ? 1 : 0;
+}
+
+
+/* Save the function at the top of the stack as 'cname'. The chunk is
+   written to a temporary file and renamed, thus a concurrent reader
+   or a power failure never sees a partial chunk.
+*/
+static void
+LBytecache_save(lua_State* L, LBytecache* o, const char* cname,
+                const U8* srcHash)
+{
+   ResIntfPtr r;
+   int status;
+   const char* tmp = lua_pushfstring(L, "%s.tmp", cname);
+   r=o->io->openResFp(o->io, tmp, OpenRes_WRITE, &status, 0);
+   if(r)
+   {
+      lua_pushvalue(L, -2);
+      status = r->writeFp(r, LBYTECACHE_MAGIC, 4) ||
+         r->writeFp(r, srcHash, SHARKSSL_SHA256_HASH_LEN) ||
+         lua_dump(L, LBytecache_writer, r, 0);
+      lua_pop(L, 1);
+      if(r->closeFp(r))
+         status=-1;
+      if( ! status && o->io->renameFp(o->io, tmp, cname, 0) )
+      {
+         o->io->removeFp(o->io, cname, 0);
+         status=o->io->renameFp(o->io, tmp, cname, 0);
+      }
+      if(status)
+         o->io->removeFp(o->io, tmp, 0);
+   }
+   lua_pop(L, 1); /* tmp */
+}
+
+
+/* Push the compiled function for the Lua script or LSP page 'name'.
+   Returns 1 on success; pushes nil and an error message and returns 2
+   on failure.
+*/
+static int
+LBytecache_load(lua_State* L, LBytecache* o, IoIntf* io, const char* name,
+                BaBool lsp, int envIx)
+{
+   U8 srcHash[SHARKSSL_SHA256_HASH_LEN];
+   const char* cname=0;
+   const char* chunkname;
+   char* src;
+   size_t len;
+   int status;
+   src=LBytecache_read(io, name, &len, &status);
+   if( ! src )
+   {
+      lua_pushnil(L);
+      lua_pushfstring(L, "%s: %s", name, baErr2Str(status));
+      return 2;
+   }
+   sharkssl_sha256((const U8*)src, (U32)len, srcHash);
+   chunkname=lua_pushfstring(L, "@%s", name);
+   if(o->io)
+   {
+      cname=LBytecache_pushName(L, o, name, lsp ? 'p' : 'l', srcHash);
+      if( ! LBytecache_loadCached(L, o, cname, srcHash, chunkname) )
+      {
+         baFree(src);
+         lbytecacheHits++;
+         goto L_ready;
+      }
+   }
+   lbytecacheMisses++;
+   if(lsp)
+   {
+      balua_pushbatab(L);
+      if(lua_getfield(L, -1, "parselsp") != LUA_TFUNCTION)
+      {
+         baFree(src);
+         lua_pushnil(L);
+         lua_pushliteral(L, "ba.parselsp not installed");
+         return 2;
+      }
+      lua_pushlstring(L, src, len);
+      baFree(src);
+      if(lua_pcall(L, 1, 2, 0) || ! lua_isstring(L, -2))
+      {
+         lua_pushnil(L);
+         lua_pushfstring(L, "%s: %s", name, lua_isstring(L, -2) ?
+                         lua_tostring(L, -2) : "cannot parse LSP");
+         return 2;
+      }
+      lua_pop(L, 1);
+      lua_replace(L, -2); /* Replace ba table with Lua code */
+      src=(char*)lua_tolstring(L, -1, &len);
+      status=luaL_loadbufferx(L, src, len, chunkname, "t");
+      lua_replace(L, -2); /* Lua code */
+   }
+   else
+   {
+      status=luaL_loadbufferx(L, src, len, chunkname, "t");
+      baFree(src);
+   }
+   if(status)
+   {
+      lua_pushnil(L);
+      lua_insert(L, -2);
+      return 2;
+   }
+   if(cname)
+      LBytecache_save(L, o, cname, srcHash);
+  L_ready:
+   if(envIx)
+   {
+      lua_pushvalue(L, envIx);
+      if( ! lua_setupvalue(L, -2, 1) )
+         lua_pop(L, 1);
+   }
+   return 1;
+}
+
+
+static int
+LBytecache_loadx(lua_State* L, BaBool lsp)
+{
+   LBytecache o;
+   const char* name = luaL_checkstring(L, 1);
+   IoIntf* io = lua_isnoneornil(L, 2) ?
+      balua_getparam(L)->vmio : baluaENV_checkIoIntf(L, 2);
+   int envIx=0;
+   if( ! lua_isnoneornil(L, 3) )
+   {
+      luaL_checktype(L, 3, LUA_TTABLE);
+      envIx=3;
+   }
+   LBytecache_get(L, &o);
+   return LBytecache_load(L, &o, io, name, lsp, envIx);
+}
+
+
+static int
+LBytecache_loadfile(lua_State* L)
+{
+   return LBytecache_loadx(L, FALSE);
+}
+
+
+static int
+LBytecache_loadlsp(lua_State* L)
+{
+   return LBytecache_loadx(L, TRUE);
+}
+
+
+static int
+LBytecache_setdir(lua_State* L)
+{
+   if(lua_isnoneornil(L, 1))
+   {
+      lua_pushnil(L);
+      lua_setfield(L, lua_upvalueindex(1), "io");
+   }
+   else
+   {
+      IoIntf* io = baluaENV_checkIoIntf(L, 1);
+      const char* dir = luaL_optstring(L, 2, "");
+      IoStat st;
+      if( ! io->renameFp || ! io->removeFp )
+      {
+         lua_pushnil(L);
+         lua_pushliteral(L, "read only I/O");
+         return 2;
+      }
+      if(*dir && io->statFp(io, dir, &st) &&
+         (! io->mkDirFp || io->mkDirFp(io, dir, 0)))
+      {
+         lua_pushnil(L);
+         lua_pushfstring(L, "cannot create %s", dir);
+         return 2;
+      }
+      lua_settop(L, 1);
+      lua_setfield(L, lua_upvalueindex(1), "io");
+      lua_pushstring(L, dir);
+      lua_setfield(L, lua_upvalueindex(1), "dir");
+   }
+   lua_pushboolean(L, TRUE);
+   return 1;
+}
+
+
+static void
+LBytecache_buildDir(lua_State* L, LBytecache* o, IoIntf* io,
+                    const char* dir, int depth, lua_Integer* compiled,
+                    lua_Integer* failed)
+{
+   int status;
+   DirIntfPtr d = io->openDirFp(io, dir, &status, 0);
+   if( ! d )
+      return;
+   while( ! d->readFp(d) )
+   {
+      IoStat st;
+      const char* name = d->getNameFp(d);
+      size_t len = strlen(name);
+      const char* path;
+      if( ! strcmp(name, ".") || ! strcmp(name, "..") || d->statFp(d, &st) )
+         continue;
+      path = *dir ? lua_pushfstring(L, "%s/%s", dir, name) :
+         lua_pushstring(L, name);
+      if(st.isDir)
+      {
+         if(depth < LBYTECACHE_MAXDEPTH)
+            LBytecache_buildDir(L, o, io, path, depth+1, compiled, failed);
+      }
+      else if(len > 4 && (! strcmp(name+len-4, ".lua") ||
+                          ! strcmp(name+len-4, ".lsp")))
+      {
+         int n = LBytecache_load(L, o, io, path, name[len-2] == 's', 0);
+         if(n == 1)
+            (*compiled)++;
+         else
+            (*failed)++;
+         lua_pop(L, n);
+      }
+      lua_pop(L, 1); /* path */
+   }
+   io->closeDirFp(io, &d);
+}
+
+
+static int
+LBytecache_build(lua_State* L)
+{
+   LBytecache o;
+   IoIntf* io = baluaENV_checkIoIntf(L, 1);
+   const char* dir = luaL_optstring(L, 2, "");
+   lua_Integer compiled=0, failed=0;
+   LBytecache_get(L, &o);
+   if( ! o.io )
+      luaL_error(L, "no cache directory");
+   LBytecache_buildDir(L, &o, io, dir, 0, &compiled, &failed);
+   lua_pushinteger(L, compiled);
+   lua_pushinteger(L, failed);
+   return 2;
+}
+
+
+static int
+LBytecache_stats(lua_State* L)
+{
+   lua_pushinteger(L, (lua_Integer)lbytecacheHits);
+   lua_pushinteger(L, (lua_Integer)lbytecacheMisses);
+   return 2;
+}
+
+
+void
+balua_bytecache(lua_State* L)
+{
+   static const luaL_Reg bytecacheLib[] = {
+      {"setdir", LBytecache_setdir},
+      {"loadfile", LBytecache_loadfile},
+      {"loadlsp", LBytecache_loadlsp},
+      {"build", LBytecache_build},
+      {"stats", LBytecache_stats},
+      {NULL, NULL}
+   };
+   balua_pushbatab(L);
+   luaL_newlibtable(L, bytecacheLib);
+   lua_newtable(L); /* Upvalue: cache configuration */
+   luaL_setfuncs(L, bytecacheLib, 1);
+   lua_setfield(L, -2, "bytecache");
+   lua_pop(L, 1);
+}
@@ -0,0 +1,620 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *                                                                        
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *                                                                         
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Lua CBOR (RFC 8949) encoder and decoder, using the CBOR codec in
+src/cbor.c.
+
+Lua API, installed by balua_cbor():
+  ba.cbor.encode(value [,atype]) -> string | nil, err
+  ba.cbor.decode(str [,null]) -> value | nil, err
+
+Lua arrays are encoded as CBOR arrays and other tables as maps. Lua
+strings are encoded as text strings if valid UTF-8, otherwise as byte
+strings. When 'atype' is set to one of "u8", "i8", "u16", "i16",
+"u32", "i32", "u64", "i64", "f32", or "f64", arrays where all elements
+are numbers are encoded as RFC 8746 typed arrays of that type.
+
+The decoder converts typed arrays to Lua tables in bulk and uint8
+typed arrays and byte strings to Lua strings. The optional 'null'
+argument sets the Lua value used for CBOR null and undefined; null
+members are omitted and null array elements leave a hole when 'null'
+is not set.
+*/
+
+#ifndef BA_LIB
+#define BA_LIB
+#endif
+#ifndef LUA_LIB
+#define LUA_LIB
+#endif
+
+#include <string.h>
+#include "balua.h"
+#include "cbor.h"
+
+#ifndef LCBOR_MAXDEPTH
+#define LCBOR_MAXDEPTH 64
+#endif
+
+#ifndef LCBOR_NAMESIZE
+#define LCBOR_NAMESIZE 256
+#endif
+
+/* Number of string chunks kept on the stack before concatenating */
+#define LCBOR_MAXPIECES 32
+
+
+/****************************************************************************
+                                  Decoder
+ ****************************************************************************/
+
+typedef struct
+{
+   UBJPIntf super;
+   lua_State* L;
+   U32 cnt[LCBOR_MAXDEPTH]; /* Number of elements in array */
+   U8 isObj[LCBOR_MAXDEPTH];
+   int nullIx; /* Stack index: null value or 0 */
+   int pieces; /* String chunks on the stack */
+   int taIx; /* Current typed array index */
+   U8 pending; /* UBJT_BeginArray/Object: table not yet created */
+   U8 taOpen; /* Typed array table or string on the stack */
+   char name[LCBOR_NAMESIZE];
+   CBORParser parser; /* Followed by the extra parser stack */
+   CBORPStackNode stack[LCBOR_MAXDEPTH-CBORPARS_STACK_LEN];
+} LCborDec;
+
+
+/* Create the table for a container started by UBJT_Begin[Array|Object],
+   presized if the container length is known.
+*/
+static void
+LCborDec_open(LCborDec* o, int count)
+{
+   if(o->pending == UBJT_BeginObject)
+      lua_createtable(o->L, 0, count);
+   else
+      lua_createtable(o->L, count, 0);
+   o->pending = 0;
+}
+
+
+/* Store the value on top of the stack in the parent container. The
+   member name of a container is pushed below the container when it
+   starts, since the name buffer is reused by the container's members.
+*/
+static void
+LCborDec_set(LCborDec* o, int level, int isNil, int isCont)
+{
+   lua_State* L = o->L;
+   if(level == 0)
+   {
+      if(isNil)
+         lua_pushnil(L);
+      return;
+   }
+   if(o->isObj[level-1])
+   {
+      if(isCont)
+         lua_rawset(L, -3);
+      else if( ! isNil )
+         lua_setfield(L, -2, o->name);
+   }
+   else
+   {
+      o->cnt[level-1]++;
+      if( ! isNil )
+         lua_rawseti(L, -2, (lua_Integer)o->cnt[level-1]);
+   }
+}
+
+
+static int
+LCborDec_service(UBJPIntf* super, UBJVal* v, int level)
+{
+   LCborDec* o = (LCborDec*)super;
+   lua_State* L = o->L;
+   int isNil=FALSE;
+   if(o->pending)
+   {
+      if(v->t == UBJT_Count)
+      {
+         LCborDec_open(o, v->len < 4096 ? v->len : 4096);
+         return 0;
+      }
+      LCborDec_open(o, 0);
+   }
+   if( ! lua_checkstack(L, 3) )
+      return -1;
+   switch(v->t)
+   {
+      case UBJT_BeginObject:
+      case UBJT_BeginArray:
+         if(level >= LCBOR_MAXDEPTH)
+            return -1;
+         if(level && o->isObj[level-1])
+            lua_pushstring(L, v->name);
+         o->pending = v->t;
+         o->isObj[level] = v->t == UBJT_BeginObject;
+         o->cnt[level] = 0;
+         return 0;
+      case UBJT_EndObject:
+      case UBJT_EndArray:
+         LCborDec_set(o, level, FALSE, TRUE);
+         return 0;
+      case UBJT_Count:
+         return 0;
+      case UBJT_String:
+         if(v->x == 0 && o->pieces == 0)
+            lua_pushlstring(L, v->u.string, v->len);
+         else
+         {
+            lua_pushlstring(L, v->u.string, v->len);
+            if(++o->pieces == LCBOR_MAXPIECES || v->x == 0)
+            {
+               lua_concat(L, o->pieces);
+               o->pieces = 1;
+            }
+            if(v->x)
+               return 0;
+            o->pieces = 0;
+         }
+         break;
+      case UBJT_Boolean:
+         lua_pushboolean(L, v->u.uint8);
+         break;
+      case UBJT_Int8:
+         lua_pushinteger(L, v->u.int8);
+         break;
+      case UBJT_Uint8:
+         lua_pushinteger(L, v->u.uint8);
+         break;
+      case UBJT_Int16:
+         lua_pushinteger(L, v->u.int16);
+         break;
+      case UBJT_Int32:
+         lua_pushinteger(L, v->u.int32);
+         break;
+      case UBJT_Int64:
+         lua_pushinteger(L, (lua_Integer)v->u.int64);
+         break;
+#ifndef NO_DOUBLE
+      case UBJT_Float32:
+         lua_pushnumber(L, (lua_Number)v->u.float32);
+         break;
+      case UBJT_Float64:
+         lua_pushnumber(L, (lua_Number)v->u.float64);
+         break;
+#endif
+      case UBJT_Null:
+         if(o->nullIx)
+            lua_pushvalue(L, o->nullIx);
+         else
+            isNil=TRUE;
+         break;
+      default:
+         baAssert(0);
+         return -1;
+   }
+   LCborDec_set(o, level, isNil, FALSE);
+   return 0;
+}
+
+
+/* Typed array callback: copies the elements directly to a Lua table,
+   or to a Lua string for uint8 arrays.
+*/
+static int
+LCborDec_array(CBORParser* p, const char* name, CBORAT t, const void* data,
+               S32 n, S32 remaining, int level)
+{
+   LCborDec* o = (LCborDec*)p->intf;
+   lua_State* L = o->L;
+   S32 i;
+   int ix;
+   (void)name;
+   if(o->pending)
+      LCborDec_open(o, 0);
+   if( ! lua_checkstack(L, 3) )
+      return -1;
+   if(t == CBORAT_Uint8)
+   {
+      lua_pushlstring(L, (const char*)data, (size_t)n);
+      if(o->taOpen)
+         lua_concat(L, 2);
+      o->taOpen = remaining ? TRUE : FALSE;
+      if( ! remaining )
+         LCborDec_set(o, level, FALSE, FALSE);
+      return 0;
+   }
+   if( ! o->taOpen )
+   {
+      lua_createtable(L, n + remaining, 0);
+      o->taIx = 0;
+      o->taOpen = TRUE;
+   }
+   ix = o->taIx;
+   switch(t)
+   {
+#define LCBOR_COPY(ctype, push) \
+      for(i=0 ; i < n ; i++) \
+      { \
+         push(L, ((const ctype*)data)[i]); \
+         lua_rawseti(L, -2, ++ix); \
+      } \
+      break
+      case CBORAT_Int8: LCBOR_COPY(S8, lua_pushinteger);
+      case CBORAT_Uint16: LCBOR_COPY(U16, lua_pushinteger);
+      case CBORAT_Int16: LCBOR_COPY(S16, lua_pushinteger);
+      case CBORAT_Uint32: LCBOR_COPY(U32, lua_pushinteger);
+      case CBORAT_Int32: LCBOR_COPY(S32, lua_pushinteger);
+      case CBORAT_Uint64: /* Values above 2^63-1 wrap */
+      case CBORAT_Int64: LCBOR_COPY(S64, lua_pushinteger);
+#ifndef NO_DOUBLE
+      case CBORAT_Float32: LCBOR_COPY(float, lua_pushnumber);
+      case CBORAT_Float64: LCBOR_COPY(double, lua_pushnumber);
+#endif
+#undef LCBOR_COPY
+      default:
+         return -1;
+   }
+   o->taIx = ix;
+   if( ! remaining )
+   {
+      o->taOpen = FALSE;
+      LCborDec_set(o, level, FALSE, FALSE);
+   }
+   return 0;
+}
+
+
+static const char*
+LCborDec_status2str(int status)
+{
+   switch(status)
+   {
+      case UBJPStatus_NeedMoreData: return "incomplete";
+      case UBJPStatus_Overflow: return "overflow";
+      case UBJPStatus_IntfErr: return "nesting too deep";
+      default: break;
+   }
+   return "parse error";
+}
+
+
+static int
+LCbor_decode(lua_State* L)
+{
+   LCborDec o;
+   size_t len;
+   const char* buf = luaL_checklstring(L, 1, &len);
+   int status;
+   lua_settop(L, 2);
+   memset(&o, 0, sizeof(LCborDec) - sizeof(o.parser) - sizeof(o.stack));
+   UBJPIntf_constructor((UBJPIntf*)&o, LCborDec_service);
+   CBORParser_constructor(&o.parser, (UBJPIntf*)&o, o.name, sizeof(o.name),
+                          LCBOR_MAXDEPTH-CBORPARS_STACK_LEN);
+   CBORParser_setArrayCB(&o.parser, LCborDec_array);
+   o.L = L;
+   o.nullIx = lua_isnil(L, 2) ? 0 : 2;
+   status = CBORParser_parse(&o.parser, (const U8*)buf, (U32)len);
+   if(status > 0)
+   {
+      if(CBORParser_getStatus(&o.parser) == UBJPStatus_DoneEOS)
+         return 1;
+      lua_pushnil(L);
+      lua_pushliteral(L, "trailing data");
+      return 2;
+   }
+   lua_settop(L, 2);
+   lua_pushnil(L);
+   lua_pushstring(L, LCborDec_status2str(CBORParser_getStatus(&o.parser)));
+   return 2;
+}
+
+
+/****************************************************************************
+                                  Encoder
+ ****************************************************************************/
+
+typedef struct
+{
+   CBOREncoder super;
+   UBJEBuf buf;
+   lua_State* L;
+   CBORAT atype;
+   const char* err;
+} LCborEnc;
+
+
+/* UBJEBuf callback: expand the buffer */
+static int
+LCborEnc_expand(UBJEBuf* b, int sizeRequired)
+{
+   S32 size = b->dlen * 2;
+   U8* data;
+   if(size < b->cursor + sizeRequired)
+      size = b->cursor + sizeRequired + 256;
+   data = (U8*)baRealloc(b->data, size);
+   if( ! data )
+      return -1;
+   b->data = data;
+   b->dlen = size;
+   return 0;
+}
+
+
+/* CBOR text strings must be UTF-8; other Lua strings are encoded as
+   byte strings.
+*/
+static int
+LCborEnc_isUtf8(const U8* s, size_t len)
+{
+   const U8* end = s + len;
+   while(s < end)
+   {
+      int n;
+      U8 c = *s++;
+      if(c < 0x80)
+         continue;
+      if(c >= 0xC2 && c <= 0xDF)
+         n = 1;
+      else if(c >= 0xE0 && c <= 0xEF)
+         n = 2;
+      else if(c >= 0xF0 && c <= 0xF4)
+         n = 3;
+      else
+         return FALSE;
+      if(end - s < n)
+         return FALSE;
+      /* Reject overlong forms, surrogates, and code points > 10FFFF */
+      if((c == 0xE0 && *s < 0xA0) || (c == 0xED && *s > 0x9F) ||
+         (c == 0xF0 && *s < 0x90) || (c == 0xF4 && *s > 0x8F))
+      {
+         return FALSE;
+      }
+      while(n--)
+      {
+         if((*s++ & 0xC0) != 0x80)
+            return FALSE;
+      }
+   }
+   return TRUE;
+}
+
+
+static void
+LCborEnc_string(CBOREncoder* e, const char* s, size_t len)
+{
+   if(LCborEnc_isUtf8((const U8*)s, len))
+      CBOREncoder_string(e, s, (S32)len);
+   else
+      CBOREncoder_bytes(e, s, (S32)len);
+}
+
+
+/* Encode the array at 'ix' with 'n' elements as a typed array. Returns
+   0 if an element is not a number that fits the type.
+*/
+static int
+LCborEnc_typedArray(LCborEnc* o, int ix, int n)
+{
+   lua_State* L = o->L;
+   int i, ok=TRUE;
+   int size = CBORAT_size(o->atype);
+   U8* data = (U8*)baMalloc(n * size);
+   if( ! data )
+   {
+      o->err = "memory";
+      return -1;
+   }
+   for(i=0 ; ok && i < n ; i++)
+   {
+      lua_Integer v;
+      int isnum;
+      lua_rawgeti(L, ix, i+1);
+      if(o->atype >= CBORAT_Float32)
+      {
+         lua_Number d = lua_tonumberx(L, -1, &isnum);
+         ok = isnum && lua_type(L, -1) == LUA_TNUMBER;
+         if(o->atype == CBORAT_Float32)
+            ((float*)data)[i] = (float)d;
+#ifndef NO_DOUBLE
+         else
+            ((double*)data)[i] = (double)d;
+#endif
+      }
+      else
+      {
+         v = lua_tointegerx(L, -1, &isnum);
+         ok = isnum && lua_type(L, -1) == LUA_TNUMBER;
+         switch(o->atype)
+         {
+            case CBORAT_Uint8: ((U8*)data)[i] = (U8)v; break;
+            case CBORAT_Int8: ((S8*)data)[i] = (S8)v; break;
+            case CBORAT_Uint16: ((U16*)data)[i] = (U16)v; break;
+            case CBORAT_Int16: ((S16*)data)[i] = (S16)v; break;
+            case CBORAT_Uint32: ((U32*)data)[i] = (U32)v; break;
+            case CBORAT_Int32: ((S32*)data)[i] = (S32)v; break;
+            default: ((S64*)data)[i] = (S64)v;
+         }
+      }
+      lua_pop(L, 1);
+   }
+   if(ok && CBOREncoder_typedArray((CBOREncoder*)o, o->atype, data, n))
+      o->err = "memory";
+   baFree(data);
+   return o->err ? -1 : ok;
+}
+
+
+static int
+LCborEnc_value(LCborEnc* o, int ix, int level)
+{
+   lua_State* L = o->L;
+   CBOREncoder* e = (CBOREncoder*)o;
+   size_t len;
+   const char* s;
+   if(level > LCBOR_MAXDEPTH || ! lua_checkstack(L, 4))
+   {
+      o->err = "nesting too deep";
+      return -1;
+   }
+   switch(lua_type(L, ix))
+   {
+      case LUA_TNIL:
+         CBOREncoder_null(e);
+         break;
+      case LUA_TBOOLEAN:
+         CBOREncoder_boolean(e, lua_toboolean(L, ix));
+         break;
+      case LUA_TNUMBER:
+         if(lua_isinteger(L, ix))
+            CBOREncoder_integer(e, (S64)lua_tointeger(L, ix));
+#ifndef NO_DOUBLE
+         else
+            CBOREncoder_float64(e, (double)lua_tonumber(L, ix));
+#endif
+         break;
+      case LUA_TSTRING:
+         s = lua_tolstring(L, ix, &len);
+         LCborEnc_string(e, s, len);
+         break;
+      case LUA_TTABLE:
+      {
+         int i, pairs=0;
+         int n = (int)lua_rawlen(L, ix);
+         lua_pushnil(L);
+         while(lua_next(L, ix))
+         {
+            pairs++;
+            lua_pop(L, 1);
+         }
+         if(n && n == pairs)
+         {
+            if(o->atype != CBORAT_InvalidType)
+            {
+               int rc = LCborEnc_typedArray(o, ix, n);
+               if(rc)
+                  return rc < 0 ? -1 : 0;
+            }
+            CBOREncoder_beginArray(e, n);
+            for(i=1 ; i <= n ; i++)
+            {
+               lua_rawgeti(L, ix, i);
+               if(LCborEnc_value(o, lua_gettop(L), level+1))
+                  return -1;
+               lua_pop(L, 1);
+            }
+            break;
+         }
+         CBOREncoder_beginObject(e, pairs);
+         lua_pushnil(L);
+         while(lua_next(L, ix))
+         {
+            if(lua_type(L, -2) == LUA_TSTRING)
+            {
+               s = lua_tolstring(L, -2, &len);
+               LCborEnc_string(e, s, len);
+            }
+            else if(lua_isinteger(L, -2))
+               CBOREncoder_integer(e, (S64)lua_tointeger(L, -2));
+            else
+            {
+               o->err = "invalid key type";
+               return -1;
+            }
+            if(LCborEnc_value(o, lua_gettop(L), level+1))
+               return -1;
+            lua_pop(L, 1);
+         }
+         break;
+      }
+      default:
+         o->err = "unsupported type";
+         return -1;
+   }
+   if(e->status)
+   {
+      o->err = "memory";
+      return -1;
+   }
+   return 0;
+}
+
+
+static int
+LCbor_encode(lua_State* L)
+{
+   static const char* const atypes[] = {
+      "u8", "i8", "u16", "i16", "u32", "i32", "u64", "i64", "", "f32", "f64",
+      NULL
+   };
+   LCborEnc o;
+   lua_settop(L, 2);
+   o.atype = lua_isnil(L, 2) ? CBORAT_InvalidType :
+      (CBORAT)luaL_checkoption(L, 2, NULL, atypes);
+   if(o.atype == CBORAT_Float16)
+      luaL_argerror(L, 2, "invalid type");
+   o.L = L;
+   o.err = 0;
+   UBJEBuf_constructor(&o.buf, LCborEnc_expand, (U8*)baMalloc(256), 256);
+   if( ! o.buf.data )
+      luaL_error(L, "memory");
+   CBOREncoder_constructor((CBOREncoder*)&o, &o.buf);
+   if(LCborEnc_value(&o, 1, 0))
+   {
+      baFree(o.buf.data);
+      lua_pushnil(L);
+      lua_pushstring(L, o.err);
+      return 2;
+   }
+   lua_pushlstring(L, (const char*)o.buf.data, (size_t)o.buf.cursor);
+   baFree(o.buf.data);
+   return 1;
+}
+
+
+void
+balua_cbor(lua_State* L)
+{
+   static const luaL_Reg cborLib[] = {
+      {"encode", LCbor_encode},
+      {"decode", LCbor_decode},
+      {NULL, NULL}
+   };
+   balua_pushbatab(L);
+   luaL_newlib(L, cborLib);
+   lua_setfield(L, -2, "cbor");
+   lua_pop(L, 1);
+}
@@ -0,0 +1,125 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Lua bindings for the sampling heap profiler (inc/HeapProfiler.h).
+The library must be compiled with BA_HEAP_PROFILE.
+
+Lua API, installed by balua_heapprof():
+  ba.heapprof.start([rate])
+  ba.heapprof.stop()
+  ba.heapprof.profile([tag]) -> string
+  ba.heapprof.tags() -> string
+
+profile() returns the live heap in the pprof heap_v2 format; save the
+string to a file and run: pprof --text mako heap.prof
+tags() returns a text table with the estimated live heap and
+allocation totals per tag.
+*/
+
+#ifndef BA_LIB
+#define BA_LIB
+#endif
+#ifndef LUA_LIB
+#define LUA_LIB
+#endif
+
+#include <HeapProfiler.h>
+#include <DynBuffer.h>
+#include "balua.h"
+
+
+static int
+LHeapProf_start(lua_State* L)
+{
+   baHeapProf_start((size_t)luaL_optinteger(L, 1, 0));
+   return 0;
+}
+
+
+static int
+LHeapProf_stop(lua_State* L)
+{
+   (void)L;
+   baHeapProf_stop();
+   return 0;
+}
+
+
+static int
+LHeapProf_push(lua_State* L, DynBuffer* db, int status)
+{
+   if(status || DynBuffer_getECode(db))
+   {
+      DynBuffer_destructor(db);
+      luaL_error(L, "memory");
+   }
+   lua_pushlstring(L, DynBuffer_getBuf(db), DynBuffer_getBufSize(db));
+   DynBuffer_destructor(db);
+   return 1;
+}
+
+
+static int
+LHeapProf_profile(lua_State* L)
+{
+   DynBuffer db;
+   const char* tag = luaL_optstring(L, 1, 0);
+   DynBuffer_constructor(&db, 8192, 8192, 0, 0);
+   return LHeapProf_push(L, &db, baHeapProf_print((BufPrint*)&db, tag));
+}
+
+
+static int
+LHeapProf_tags(lua_State* L)
+{
+   DynBuffer db;
+   DynBuffer_constructor(&db, 1024, 1024, 0, 0);
+   return LHeapProf_push(L, &db, baHeapProf_printTags((BufPrint*)&db));
+}
+
+
+void
+balua_heapprof(lua_State* L)
+{
+   static const luaL_Reg heapProfLib[] = {
+      {"start", LHeapProf_start},
+      {"stop", LHeapProf_stop},
+      {"profile", LHeapProf_profile},
+      {"tags", LHeapProf_tags},
+      {NULL, NULL}
+   };
+   balua_pushbatab(L);
+   luaL_newlib(L, heapProfLib);
+   lua_setfield(L, -2, "heapprof");
+   lua_pop(L, 1);
+}
@@ -0,0 +1,152 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Lua bindings for HttpStats (inc/HttpStats.h). The library must be
+compiled with USE_HTTP_STATS=1.
+
+Lua API, installed by balua_httpstats():
+  ba.httpstats.collect() -> table
+  ba.httpstats.prometheus([prefix]) -> string
+  ba.httpstats.enable([bool]) -> bool
+
+collect() returns the counters keyed by their Prometheus names, e.g.
+t.connections_accepted_total, and one table per histogram, e.g.
+t.request_service_seconds, with the fields count, sum, max, p50, p90,
+p99, and p999. Times are in seconds.
+
+prometheus() returns the data in the Prometheus text exposition
+format; an LSP page can publish it as follows:
+  response:setcontenttype"text/plain; version=0.0.4"
+  response:write(ba.httpstats.prometheus())
+
+enable() returns the current state and optionally enables or disables
+recording.
+*/
+
+#ifndef BA_LIB
+#define BA_LIB
+#endif
+#ifndef LUA_LIB
+#define LUA_LIB
+#endif
+
+#include <HttpStats.h>
+#include <DynBuffer.h>
+#include "balua.h"
+
+
+static int
+LHttpStats_collect(lua_State* L)
+{
+   static const struct {
+      const char* name;
+      U32 perMille;
+   } percentiles[] = {
+      {"p50", 500}, {"p90", 900}, {"p99", 990}, {"p999", 999}
+   };
+   HttpStatsData* data = (HttpStatsData*)lua_newuserdatauv(
+      L, sizeof(HttpStatsData), 0);
+   int i, j;
+   HttpStats_collect(data);
+   lua_createtable(L, 0, HttpStats_NoOfCounters + HttpStats_NoOfHistograms);
+   for(i=0 ; i < HttpStats_NoOfCounters ; i++)
+   {
+      lua_pushinteger(L, (lua_Integer)data->counters[i]);
+      lua_setfield(L, -2, HttpStats_counterName((HttpStats_Counter)i));
+   }
+   for(i=0 ; i < HttpStats_NoOfHistograms ; i++)
+   {
+      const HttpStatsHist* h = data->hist+i;
+      lua_createtable(L, 0, 7);
+      lua_pushinteger(L, (lua_Integer)h->count);
+      lua_setfield(L, -2, "count");
+      lua_pushnumber(L, (lua_Number)h->sum / 1e6);
+      lua_setfield(L, -2, "sum");
+      lua_pushnumber(L, (lua_Number)h->max / 1e6);
+      lua_setfield(L, -2, "max");
+      for(j=0 ; j < (int)(sizeof(percentiles)/sizeof(percentiles[0])) ; j++)
+      {
+         lua_pushnumber(L, (lua_Number)HttpStatsHist_percentile(
+                           h, percentiles[j].perMille) / 1e6);
+         lua_setfield(L, -2, percentiles[j].name);
+      }
+      lua_setfield(L, -2, HttpStats_histName((HttpStats_Histogram)i));
+   }
+   return 1;
+}
+
+
+static int
+LHttpStats_prometheus(lua_State* L)
+{
+   const char* prefix = luaL_optstring(L, 1, 0);
+   DynBuffer db;
+   int status;
+   DynBuffer_constructor(&db, 4096, 4096, 0, 0);
+   status = HttpStats_printPrometheus((BufPrint*)&db, prefix);
+   if(status || DynBuffer_getECode(&db))
+   {
+      DynBuffer_destructor(&db);
+      luaL_error(L, "memory");
+   }
+   lua_pushlstring(L, DynBuffer_getBuf(&db), DynBuffer_getBufSize(&db));
+   DynBuffer_destructor(&db);
+   return 1;
+}
+
+
+static int
+LHttpStats_enable(lua_State* L)
+{
+   BaBool enabled = HttpStats_isEnabled();
+   if( ! lua_isnoneornil(L, 1) )
+      HttpStats_setEnabled(balua_checkboolean(L, 1));
+   lua_pushboolean(L, enabled);
+   return 1;
+}
+
+
+void
+balua_httpstats(lua_State* L)
+{
+   static const luaL_Reg httpStatsLib[] = {
+      {"collect", LHttpStats_collect},
+      {"prometheus", LHttpStats_prometheus},
+      {"enable", LHttpStats_enable},
+      {NULL, NULL}
+   };
+   balua_pushbatab(L);
+   luaL_newlib(L, httpStatsLib);
+   lua_setfield(L, -2, "httpstats");
+   lua_pop(L, 1);
+}
@@ -0,0 +1,440 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *                                                                        
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *                                                                         
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Lua JSON decoder building Lua tables directly from the JParser
+callbacks, without going through a JVal tree.
+
+Lua API, installed by balua_jsondec():
+  ba.json.fastdecode(str [,null]) -> value | nil, err
+  ba.json.fastparser([null]) -> parser
+  parser:parse(chunk) -> true, v1, v2, ... | nil, err
+
+The optional 'null' argument sets the Lua value used for JSON null.
+JSON null members are omitted and null array elements leave a hole
+when 'null' is not set.
+
+The parse method can be called with chunks as they are read from a
+socket. It returns true followed by all values completed by the chunk,
+which may be none. A Lua error raised by parse, such as a memory
+error, discards the value being parsed, and the next call starts with
+a new value.
+*/
+
+#ifndef BA_LIB
+#define BA_LIB
+#endif
+#ifndef LUA_LIB
+#define LUA_LIB
+#endif
+
+#include <string.h>
+#include "balua.h"
+#include "JParser.h"
+
+#ifndef LJSONDEC_MAXDEPTH
+#define LJSONDEC_MAXDEPTH 64
+#endif
+
+#ifndef LJSONDEC_NAMESIZE
+#define LJSONDEC_NAMESIZE 256
+#endif
+
+/* Upper limit for presizing a table from the size of its previous
+   sibling. */
+#ifndef LJSONDEC_MAXHINT
+#define LJSONDEC_MAXHINT 1024
+#endif
+
+/* Number of slots in the member name cache; must be a power of 2 */
+#define LJSONDEC_KEYCACHE 64
+
+#define LJSONDEC_MT "JSONDECODER"
+
+/* User values in the LJsonDec userdata */
+#define LJSONDEC_UV_STACK 1 /* Open containers, indexed by level+1 */
+#define LJSONDEC_UV_KEYS 2 /* Anchors the cached member names */
+#define LJSONDEC_UV_NULL 3 /* Value used for JSON null, if any */
+
+
+typedef struct
+{
+   JParserIntf super;
+   lua_State* L;
+   const char* keys[LJSONDEC_KEYCACHE];
+   U32 cnt[LJSONDEC_MAXDEPTH]; /* Number of elements in container */
+   U32 hintA[LJSONDEC_MAXDEPTH]; /* Size of last array at level */
+   U32 hintH[LJSONDEC_MAXDEPTH]; /* Size of last object at level */
+   U8 isObj[LJSONDEC_MAXDEPTH]; /* Container type at level */
+   int sIx; /* Stack index: UV_STACK table */
+   int kIx; /* Stack index: UV_KEYS table */
+   int curIx; /* Stack index: parent container of the current level */
+   int nullIx; /* Stack index: null value or 0 */
+   int curLevel; /* Level of the container at curIx */
+   int maxLevel;
+   BaBool busy; /* Set while JParser_parse runs, see LJsonDec_run */
+   char name[LJSONDEC_NAMESIZE];
+   JParser parser; /* Must be last: extra parser stack follows */
+} LJsonDec;
+
+#define LJSONDEC_SIZE \
+   (sizeof(LJsonDec)+(LJSONDEC_MAXDEPTH-JPARSER_STACK_LEN)*sizeof(JParserStackNode))
+
+
+/* Push an object member name. Records typically repeat the same
+   member names, and the cache lets us push the anchored Lua string
+   instead of creating the string again.
+*/
+static void
+LJsonDec_pushKey(LJsonDec* o, const char* name)
+{
+   lua_State* L = o->L;
+   size_t len = strlen(name);
+   unsigned int slot = len ? (unsigned int)
+      (len*31 + (U8)name[0] + (U8)name[len-1]*7) & (LJSONDEC_KEYCACHE-1) : 0;
+   const char* k = o->keys[slot];
+   if(k && !strcmp(k, name))
+   {
+      lua_rawgeti(L, o->kIx, slot+1);
+      return;
+   }
+   lua_pushlstring(L, name, len);
+   lua_pushvalue(L, -1);
+   lua_rawseti(L, o->kIx, slot+1);
+   o->keys[slot] = lua_tostring(L, -1);
+}
+
+
+static int
+LJsonDec_service(JParserIntf* super, JParserVal* v, int level)
+{
+   LJsonDec* o = (LJsonDec*)super;
+   lua_State* L = o->L;
+   int isNil=FALSE;
+   if(v->t == JParserT_EndObject || v->t == JParserT_EndArray)
+   {
+      /* Sibling containers are typically equally sized, as in
+         arrays of records; presize the next sibling. */
+      U32 n = o->cnt[level] < LJSONDEC_MAXHINT ?
+         o->cnt[level] : LJSONDEC_MAXHINT;
+      if(v->t == JParserT_EndArray)
+         o->hintA[level]=n;
+      else
+         o->hintH[level]=n;
+      return 0;
+   }
+   if(level >= LJSONDEC_MAXDEPTH-1)
+      return -1;
+   if(level && o->curLevel != level-1)
+   {
+      lua_rawgeti(L, o->sIx, level);
+      lua_replace(L, o->curIx);
+      o->curLevel = level-1;
+   }
+   switch(v->t)
+   {
+      case JParserT_String:
+         lua_pushstring(L, v->v.s);
+         break;
+      case JParserT_Double:
+#ifdef NO_DOUBLE
+         baAssert(0);
+         lua_pushnil(L);
+#else
+         lua_pushnumber(L, (lua_Number)v->v.f);
+#endif
+         break;
+      case JParserT_Int:
+         lua_pushinteger(L, (lua_Integer)v->v.d);
+         break;
+      case JParserT_Long:
+         lua_pushinteger(L, (lua_Integer)(S64)v->v.l);
+         break;
+      case JParserT_Boolean:
+         lua_pushboolean(L, v->v.b);
+         break;
+      case JParserT_Null:
+         if(o->nullIx)
+            lua_pushvalue(L, o->nullIx);
+         else
+            isNil=TRUE;
+         break;
+      case JParserT_BeginObject:
+      case JParserT_BeginArray:
+         if(v->t == JParserT_BeginObject)
+            lua_createtable(L, 0, (int)o->hintH[level]);
+         else
+            lua_createtable(L, (int)o->hintA[level], 0);
+         o->cnt[level]=0;
+         o->isObj[level] = v->t == JParserT_BeginObject;
+         lua_pushvalue(L, -1);
+         lua_rawseti(L, o->sIx, level+1);
+         if(level > o->maxLevel)
+            o->maxLevel=level;
+         if(level == 0)
+         {
+            lua_pop(L, 1);
+            return 0;
+         }
+         break;
+      default:
+         baAssert(0);
+         return -1;
+   }
+   if(level == 0)
+      return -1; /* JParser only accepts object or array as root */
+   o->cnt[level-1]++;
+   if(isNil)
+      return 0;
+   if(o->isObj[level-1])
+   {
+      LJsonDec_pushKey(o, v->memberName);
+      lua_insert(L, -2);
+      lua_rawset(L, o->curIx);
+   }
+   else
+      lua_rawseti(L, o->curIx, (lua_Integer)o->cnt[level-1]);
+   return 0;
+}
+
+
+static const char*
+LJsonDec_status2str(JParsStat status)
+{
+   switch(status)
+   {
+      case JParsStat_NeedMoreData: return "incomplete";
+      case JParsStat_MemErr: return "memory";
+      case JParsStat_StackOverflow: return "nesting too deep";
+      default: break;
+   }
+   return "parse error";
+}
+
+
+static void
+LJsonDec_initParser(LJsonDec* o)
+{
+   JParser_constructor(&o->parser, (JParserIntf*)o, o->name,
+                       sizeof(o->name), AllocatorIntf_getDefault(),
+                       LJSONDEC_MAXDEPTH-JPARSER_STACK_LEN);
+}
+
+
+static LJsonDec*
+LJsonDec_create(lua_State* L, int nullIx)
+{
+   LJsonDec* o = (LJsonDec*)lua_newuserdatauv(L, LJSONDEC_SIZE, 3);
+   memset(o, 0, sizeof(LJsonDec));
+   luaL_getmetatable(L, LJSONDEC_MT);
+   lua_setmetatable(L, -2);
+   JParserIntf_constructor((JParserIntf*)o, LJsonDec_service);
+   LJsonDec_initParser(o);
+   lua_newtable(L);
+   lua_setiuservalue(L, -2, LJSONDEC_UV_STACK);
+   lua_newtable(L);
+   lua_setiuservalue(L, -2, LJSONDEC_UV_KEYS);
+   if(nullIx && !lua_isnoneornil(L, nullIx))
+   {
+      lua_pushvalue(L, nullIx);
+      lua_setiuservalue(L, -2, LJSONDEC_UV_NULL);
+   }
+   return o;
+}
+
+
+/* Parse 'len' bytes and push all completed values. Expects the
+   LJsonDec userdata at 'udIx'. Returns the number of values pushed or
+   -1 on error, with the error message pushed.
+*/
+static int
+LJsonDec_run(lua_State* L, LJsonDec* o, int udIx, const U8* buf, U32 len)
+{
+   int top, n=0;
+   if(o->busy)
+   {
+      /* A Lua error in LJsonDec_service unwound JParser_parse: drop
+         the partial value and restart the parser.
+      */
+      JParser_destructor(&o->parser);
+      LJsonDec_initParser(o);
+      lua_newtable(L);
+      lua_setiuservalue(L, udIx, LJSONDEC_UV_STACK);
+      o->maxLevel=0;
+      o->busy=FALSE;
+   }
+   top=lua_gettop(L);
+   lua_getiuservalue(L, udIx, LJSONDEC_UV_STACK);
+   o->sIx = top+1;
+   lua_getiuservalue(L, udIx, LJSONDEC_UV_KEYS);
+   o->kIx = top+2;
+   lua_pushnil(L);
+   o->curIx = top+3;
+   o->nullIx = lua_getiuservalue(L, udIx, LJSONDEC_UV_NULL) == LUA_TNIL ?
+      0 : top+4;
+   o->curLevel = -1;
+   o->L = L;
+   for(;;)
+   {
+      int status;
+      o->busy=TRUE; /* Remains set if the callback raises a Lua error */
+      status = JParser_parse(&o->parser, buf, len);
+      o->busy=FALSE;
+      if(status < 0)
+      {
+         lua_settop(L, top);
+         lua_pushstring(L,
+            LJsonDec_status2str(JParser_getStatus(&o->parser)));
+         return -1;
+      }
+      if(status == 0)
+         break;
+      /* Completed value: move it from the container stack */
+      luaL_checkstack(L, 2, 0);
+      lua_rawgeti(L, o->sIx, 1);
+      lua_insert(L, top+1+n);
+      n++;
+      o->sIx++; o->kIx++; o->curIx++;
+      if(o->nullIx) o->nullIx++;
+      for( ; o->maxLevel >= 0 ; o->maxLevel--)
+      {
+         lua_pushnil(L);
+         lua_rawseti(L, o->sIx, o->maxLevel+1);
+      }
+      o->maxLevel=0;
+      o->curLevel = -1;
+      if(JParser_getStatus(&o->parser) != JParsStat_Done)
+         break;
+   }
+   lua_settop(L, top+n);
+   return n;
+}
+
+
+static LJsonDec*
+LJsonDec_check(lua_State* L)
+{
+   return (LJsonDec*)luaL_checkudata(L, 1, LJSONDEC_MT);
+}
+
+
+static int
+LJsonDec_parse(lua_State* L)
+{
+   size_t len;
+   LJsonDec* o = LJsonDec_check(L);
+   const char* buf = luaL_optlstring(L, 2, "", &len);
+   int n;
+   lua_settop(L, 2);
+   lua_pushboolean(L, TRUE);
+   n = LJsonDec_run(L, o, 1, (const U8*)buf, (U32)len);
+   if(n < 0)
+   {
+      lua_pushnil(L);
+      lua_insert(L, -2);
+      return 2;
+   }
+   return n+1;
+}
+
+
+static int
+LJsonDec_gc(lua_State* L)
+{
+   LJsonDec* o = LJsonDec_check(L);
+   JParser_destructor(&o->parser);
+   return 0;
+}
+
+
+static int
+LJsonDec_fastparser(lua_State* L)
+{
+   LJsonDec_create(L, 1);
+   return 1;
+}
+
+
+static int
+LJsonDec_fastdecode(lua_State* L)
+{
+   size_t len;
+   const char* buf = luaL_checklstring(L, 1, &len);
+   LJsonDec* o;
+   int n;
+   lua_settop(L, 2);
+   o = LJsonDec_create(L, 2);
+   n = LJsonDec_run(L, o, 3, (const U8*)buf, (U32)len);
+   if(n == 1)
+      return 1;
+   if(n >= 0)
+   {
+      lua_settop(L, 3);
+      lua_pushstring(L, n ? "trailing data" :
+                     LJsonDec_status2str(JParser_getStatus(&o->parser)));
+   }
+   lua_pushnil(L);
+   lua_insert(L, -2);
+   return 2;
+}
+
+
+void
+balua_jsondec(lua_State* L)
+{
+   static const luaL_Reg parserLib[] = {
+      {"parse", LJsonDec_parse},
+      {"__gc", LJsonDec_gc},
+      {NULL, NULL}
+   };
+   static const luaL_Reg jsonLib[] = {
+      {"fastdecode", LJsonDec_fastdecode},
+      {"fastparser", LJsonDec_fastparser},
+      {NULL, NULL}
+   };
+   luaL_newmetatable(L, LJSONDEC_MT);
+   lua_pushvalue(L, -1);
+   lua_setfield(L, -2, "__index");
+   luaL_setfuncs(L, parserLib, 0);
+   lua_pop(L, 1);
+   balua_pushbatab(L);
+   lua_getfield(L, -1, "json");
+   if( ! lua_istable(L, -1) )
+   {
+      lua_pop(L, 1);
+      lua_newtable(L);
+      lua_pushvalue(L, -1);
+      lua_setfield(L, -3, "json");
+   }
+   luaL_setfuncs(L, jsonLib, 0);
+   lua_pop(L, 2);
+}
@@ -0,0 +1,656 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+Thread caching size class allocator. See inc/tcalloc.h.
+
+Layout of the region given to init_tcalloc:
+  [span table][page map][pages ...]
+The span table holds one TcSpan per page, since a span starts on a
+page and no two spans start on the same page. The page map maps each
+page to the span owning it. Both tables are sized at init time, so the
+allocator never needs memory outside the region.
+*/
+
+#include <tcalloc.h>
+#include <ThreadLib.h>
+#include <string.h>
+
+#ifdef BA_POSIX
+#include <pthread.h>
+#endif
+
+/* TCALLOC_NO_CACHE disables the thread caches. It is set below when
+   the compiler's thread local storage keyword is unknown, since
+   tcCache must not be shared by the threads.
+*/
+#if !defined(TCALLOC_TLS) && !defined(TCALLOC_NO_CACHE)
+#if defined(__GNUC__) || defined(__clang__)
+#define TCALLOC_TLS __thread
+#elif defined(_MSC_VER)
+#define TCALLOC_TLS __declspec(thread)
+#else
+#define TCALLOC_NO_CACHE
+#endif
+#endif
+
+/* Upper limit for the objects held by one thread cache. */
+#ifndef TCALLOC_MAX_THREAD_CACHE
+#define TCALLOC_MAX_THREAD_CACHE (256*1024)
+#endif
+
+#define TC_PAGE_SHIFT 12
+#define TC_PAGE_SIZE (1 << TC_PAGE_SHIFT)
+#define TC_ALIGN 16
+#define TC_MAX_SMALL 8192
+#define TC_NCLASSES 33 /* Class 0 is not used */
+#define TC_FREE_LISTS 128 /* Free span lists by page count */
+
+typedef struct TcSpan
+{
+      struct TcSpan* next;
+      struct TcSpan* prev;
+      void* freeList; /* Free objects in a small object span */
+      U32 page; /* First page index */
+      U32 npages;
+      U32 inUse; /* Objects handed out, including those in caches */
+      U8 sizeClass; /* 0 for large objects and free spans */
+      U8 isFree;
+} TcSpan;
+
+typedef struct
+{
+      void* list;
+      U32 len;
+} TcFreeList;
+
+typedef struct TcCache
+{
+      TcFreeList lists[TC_NCLASSES];
+      size_t size;
+} TcCache;
+
+typedef struct
+{
+      ThreadMutex lock;
+      TcSpan nonEmpty; /* Circular list of spans with free objects */
+} TcCentral;
+
+static char* tcBase; /* First page */
+static U32 tcPages;
+static TcSpan* tcSpans;
+static TcSpan** tcPageMap;
+static TcSpan tcFreeSpans[TC_FREE_LISTS+1]; /* [TC_FREE_LISTS]: larger */
+static size_t tcFreeBytes;
+static ThreadMutex tcPageLock;
+static TcCentral tcCentral[TC_NCLASSES];
+static U16 tcClassSize[TC_NCLASSES];
+static U8 tcClassPages[TC_NCLASSES];
+static U8 tcClassBatch[TC_NCLASSES];
+static U8 tcClassIx[TC_MAX_SMALL/TC_ALIGN+1];
+static void (*tcExhaustedCB)(void);
+
+#ifndef TCALLOC_NO_CACHE
+static TCALLOC_TLS TcCache* tcCache;
+#ifdef BA_POSIX
+static pthread_key_t tcCacheKey;
+#endif
+#endif
+
+
+/****************************************************************************
+                                 Span lists
+ ****************************************************************************/
+
+static void
+TcSpan_listInit(TcSpan* head)
+{
+   head->next = head->prev = head;
+}
+
+
+static void
+TcSpan_unlink(TcSpan* o)
+{
+   o->prev->next = o->next;
+   o->next->prev = o->prev;
+   o->next = o->prev = 0;
+}
+
+
+static void
+TcSpan_push(TcSpan* head, TcSpan* o)
+{
+   o->next = head->next;
+   o->prev = head;
+   head->next->prev = o;
+   head->next = o;
+}
+
+
+#define TcSpan_addr(o) (tcBase + ((size_t)(o)->page << TC_PAGE_SHIFT))
+#define TcSpan_fromPtr(p) \
+   tcPageMap[(size_t)((char*)(p) - tcBase) >> TC_PAGE_SHIFT]
+
+
+/****************************************************************************
+                                 Page heap
+ All functions require tcPageLock.
+ ****************************************************************************/
+
+static void
+TcPageHeap_insert(TcSpan* o)
+{
+   o->isFree = TRUE;
+   o->sizeClass = 0;
+   tcPageMap[o->page] = o;
+   tcPageMap[o->page + o->npages - 1] = o;
+   TcSpan_push(&tcFreeSpans[o->npages < TC_FREE_LISTS ?
+                            o->npages : TC_FREE_LISTS], o);
+}
+
+
+static TcSpan*
+TcPageHeap_alloc(U32 npages)
+{
+   TcSpan* o = 0;
+   U32 i;
+   for(i = npages ; i < TC_FREE_LISTS ; i++)
+   {
+      if(tcFreeSpans[i].next != &tcFreeSpans[i])
+      {
+         o = tcFreeSpans[i].next;
+         break;
+      }
+   }
+   if( ! o )
+   {  /* Best fit in the list of large spans */
+      TcSpan* s;
+      TcSpan* head = &tcFreeSpans[TC_FREE_LISTS];
+      for(s = head->next ; s != head ; s = s->next)
+      {
+         if(s->npages >= npages && (!o || s->npages < o->npages))
+            o = s;
+      }
+      if( ! o )
+         return 0;
+   }
+   TcSpan_unlink(o);
+   if(o->npages > npages)
+   {
+      TcSpan* rest = tcSpans + o->page + npages;
+      rest->page = o->page + npages;
+      rest->npages = o->npages - npages;
+      TcPageHeap_insert(rest);
+      o->npages = npages;
+   }
+   o->isFree = FALSE;
+   o->freeList = 0;
+   o->inUse = 0;
+   for(i = 0 ; i < npages ; i++)
+      tcPageMap[o->page + i] = o;
+   tcFreeBytes -= (size_t)npages << TC_PAGE_SHIFT;
+   return o;
+}
+
+
+static void
+TcPageHeap_free(TcSpan* o)
+{
+   TcSpan* n;
+   tcFreeBytes += (size_t)o->npages << TC_PAGE_SHIFT;
+   if(o->page > 0 && (n = tcPageMap[o->page - 1]) != 0 && n->isFree)
+   {
+      TcSpan_unlink(n);
+      n->npages += o->npages;
+      o = n;
+   }
+   if(o->page + o->npages < tcPages &&
+      (n = tcPageMap[o->page + o->npages]) != 0 && n->isFree)
+   {
+      TcSpan_unlink(n);
+      o->npages += n->npages;
+   }
+   TcPageHeap_insert(o);
+}
+
+
+static TcSpan*
+TcPageHeap_lockedAlloc(U32 npages)
+{
+   TcSpan* o;
+   ThreadMutex_set(&tcPageLock);
+   o = TcPageHeap_alloc(npages);
+   ThreadMutex_release(&tcPageLock);
+   if( ! o && tcExhaustedCB )
+      tcExhaustedCB();
+   return o;
+}
+
+
+/****************************************************************************
+                            Central free lists
+ ****************************************************************************/
+
+/* Move up to 'n' objects of class 'c' to 'list'. Returns number moved. */
+static U32
+TcCentral_fetch(U32 c, void** list, U32 n)
+{
+   TcCentral* o = tcCentral + c;
+   U32 cnt = 0;
+   void* head = 0;
+   ThreadMutex_set(&o->lock);
+   while(cnt < n)
+   {
+      TcSpan* s = o->nonEmpty.next;
+      if(s == &o->nonEmpty)
+      {
+         U32 i, size = tcClassSize[c];
+         U32 objs;
+         char* ptr;
+         ThreadMutex_release(&o->lock);
+         s = TcPageHeap_lockedAlloc(tcClassPages[c]);
+         ThreadMutex_set(&o->lock);
+         if( ! s )
+            break;
+         s->sizeClass = (U8)c;
+         objs = ((U32)tcClassPages[c] << TC_PAGE_SHIFT) / size;
+         ptr = TcSpan_addr(s) + (objs-1) * size;
+         for(i = 0 ; i < objs ; i++, ptr -= size)
+         {
+            *(void**)ptr = s->freeList;
+            s->freeList = ptr;
+         }
+         TcSpan_push(&o->nonEmpty, s);
+      }
+      while(cnt < n && s->freeList)
+      {
+         void* obj = s->freeList;
+         s->freeList = *(void**)obj;
+         *(void**)obj = head;
+         head = obj;
+         s->inUse++;
+         cnt++;
+      }
+      if( ! s->freeList )
+         TcSpan_unlink(s);
+   }
+   ThreadMutex_release(&o->lock);
+   *list = head;
+   return cnt;
+}
+
+
+/* Return a linked list of objects of class 'c'. */
+static void
+TcCentral_release(U32 c, void* list)
+{
+   TcCentral* o = tcCentral + c;
+   TcSpan* emptySpans = 0;
+   ThreadMutex_set(&o->lock);
+   while(list)
+   {
+      void* next = *(void**)list;
+      TcSpan* s = TcSpan_fromPtr(list);
+      if( ! s->freeList )
+         TcSpan_push(&o->nonEmpty, s);
+      *(void**)list = s->freeList;
+      s->freeList = list;
+      if(--s->inUse == 0)
+      {
+         /* Collect and give back to the page heap after unlocking */
+         TcSpan_unlink(s);
+         s->next = emptySpans;
+         emptySpans = s;
+      }
+      list = next;
+   }
+   ThreadMutex_release(&o->lock);
+   if(emptySpans)
+   {
+      ThreadMutex_set(&tcPageLock);
+      while(emptySpans)
+      {
+         TcSpan* s = emptySpans;
+         emptySpans = s->next;
+         TcPageHeap_free(s);
+      }
+      ThreadMutex_release(&tcPageLock);
+   }
+}
+
+
+/****************************************************************************
+                               Thread cache
+ ****************************************************************************/
+
+#ifndef TCALLOC_NO_CACHE
+
+/* Give 'n' objects in list 'c' back to the central list. */
+static void
+TcCache_releaseList(TcCache* o, U32 c, U32 n)
+{
+   TcFreeList* fl = o->lists + c;
+   void* head = fl->list;
+   void* tail = head;
+   U32 i;
+   if(n > fl->len)
+      n = fl->len;
+   if( ! n )
+      return;
+   for(i = 1 ; i < n ; i++)
+      tail = *(void**)tail;
+   fl->list = *(void**)tail;
+   *(void**)tail = 0;
+   fl->len -= n;
+   o->size -= (size_t)n * tcClassSize[c];
+   TcCentral_release(c, head);
+}
+
+
+static void
+TcCache_scavenge(TcCache* o)
+{
+   U32 c;
+   for(c = 1 ; c < TC_NCLASSES ; c++)
+      TcCache_releaseList(o, c, (o->lists[c].len + 1) / 2);
+}
+
+
+static void
+TcCache_flush(TcCache* o)
+{
+   U32 c;
+   for(c = 1 ; c < TC_NCLASSES ; c++)
+      TcCache_releaseList(o, c, o->lists[c].len);
+}
+
+
+#ifdef BA_POSIX
+static void
+TcCache_onThreadExit(void* cache)
+{
+   tcCache = (TcCache*)cache;
+   tcalloc_flushThreadCache();
+}
+#endif
+
+
+static TcCache*
+TcCache_create(void)
+{
+   void* obj;
+   U32 c = tcClassIx[(sizeof(TcCache) + TC_ALIGN - 1) / TC_ALIGN];
+   if( ! TcCentral_fetch(c, &obj, 1) )
+      return 0;
+   memset(obj, 0, sizeof(TcCache));
+   tcCache = (TcCache*)obj;
+#ifdef BA_POSIX
+   pthread_setspecific(tcCacheKey, obj);
+#endif
+   return tcCache;
+}
+
+#endif /* TCALLOC_NO_CACHE */
+
+
+/****************************************************************************
+                                 Public API
+ ****************************************************************************/
+
+void
+tcalloc_setExhaustedCB(void (*cb)(void))
+{
+   tcExhaustedCB = cb;
+}
+
+
+void
+init_tcalloc(char* heapstart, char* heapend)
+{
+   size_t total, size, meta;
+   U32 c, i;
+
+   /* Size classes: 16 byte steps up to 128, then four classes per
+      power of two up to TC_MAX_SMALL.
+   */
+   for(c = 1 ; c <= 8 ; c++)
+      tcClassSize[c] = (U16)(c * 16);
+   for(size = 128 ; c < TC_NCLASSES ; size *= 2)
+   {
+      for(i = 1 ; i <= 4 ; i++)
+         tcClassSize[c++] = (U16)(size + i * size / 4);
+   }
+   for(c = 1, i = 0 ; i <= TC_MAX_SMALL/TC_ALIGN ; i++)
+   {
+      while(tcClassSize[c] < i * TC_ALIGN)
+         c++;
+      tcClassIx[i] = (U8)c;
+   }
+   tcClassIx[0] = 1;
+   for(c = 1 ; c < TC_NCLASSES ; c++)
+   {
+      size = tcClassSize[c];
+      /* At least 8 objects per span, and waste at most 1/8 */
+      for(i = 1 ; ; i++)
+      {
+         size_t bytes = (size_t)i << TC_PAGE_SHIFT;
+         if(bytes >= size * 8 && bytes % size <= bytes / 8)
+            break;
+      }
+      tcClassPages[c] = (U8)i;
+      i = (U32)(32*1024 / size);
+      tcClassBatch[c] = (U8)(i < 2 ? 2 : i > 32 ? 32 : i);
+      ThreadMutex_constructor(&tcCentral[c].lock);
+      TcSpan_listInit(&tcCentral[c].nonEmpty);
+   }
+   for(i = 0 ; i <= TC_FREE_LISTS ; i++)
+      TcSpan_listInit(&tcFreeSpans[i]);
+   ThreadMutex_constructor(&tcPageLock);
+
+   /* Each page needs a TcSpan and a page map entry */
+   heapstart = (char*)(((size_t)heapstart + TC_ALIGN - 1) & ~(size_t)(TC_ALIGN-1));
+   total = (size_t)(heapend - heapstart);
+   meta = sizeof(TcSpan) + sizeof(TcSpan*);
+   tcPages = (U32)(total / (TC_PAGE_SIZE + meta));
+   tcSpans = (TcSpan*)heapstart;
+   tcPageMap = (TcSpan**)(tcSpans + tcPages);
+   tcBase = (char*)(tcPageMap + tcPages);
+   tcBase = (char*)(((size_t)tcBase + TC_PAGE_SIZE-1) & ~(size_t)(TC_PAGE_SIZE-1));
+   while(tcPages && tcBase + ((size_t)tcPages << TC_PAGE_SHIFT) > heapend)
+      tcPages--;
+   if( ! tcPages )
+      baFatalE(FE_MALLOC, 0);
+   memset(tcSpans, 0, tcPages * meta);
+   tcSpans->page = 0;
+   tcSpans->npages = tcPages;
+   TcPageHeap_insert(tcSpans);
+   tcFreeBytes = (size_t)tcPages << TC_PAGE_SHIFT;
+#if !defined(TCALLOC_NO_CACHE) && defined(BA_POSIX)
+   pthread_key_create(&tcCacheKey, TcCache_onThreadExit);
+#endif
+}
+
+
+void*
+tcalloc(size_t bytes)
+{
+   U32 c;
+   if(bytes > TC_MAX_SMALL)
+   {
+      TcSpan* s;
+      size_t npages = (bytes + TC_PAGE_SIZE - 1) >> TC_PAGE_SHIFT;
+      if(npages > tcPages)
+         return 0;
+      s = TcPageHeap_lockedAlloc((U32)npages);
+      return s ? TcSpan_addr(s) : 0;
+   }
+   c = tcClassIx[(bytes + TC_ALIGN - 1) / TC_ALIGN];
+#ifndef TCALLOC_NO_CACHE
+   {
+      TcCache* o = tcCache;
+      TcFreeList* fl;
+      void* obj;
+      if( ! o && (o = TcCache_create()) == 0 )
+         return 0;
+      fl = o->lists + c;
+      if( ! fl->list )
+      {
+         fl->len = TcCentral_fetch(c, &fl->list, tcClassBatch[c]);
+         if( ! fl->len )
+            return 0;
+         o->size += (size_t)fl->len * tcClassSize[c];
+      }
+      obj = fl->list;
+      fl->list = *(void**)obj;
+      fl->len--;
+      o->size -= tcClassSize[c];
+      return obj;
+   }
+#else
+   {
+      void* obj;
+      return TcCentral_fetch(c, &obj, 1) ? obj : 0;
+   }
+#endif
+}
+
+
+void
+tcfree(void* mem)
+{
+   TcSpan* s;
+   U32 c;
+   if( ! mem )
+      return;
+   s = TcSpan_fromPtr(mem);
+   baAssert(s && !s->isFree);
+   c = s->sizeClass;
+   if( ! c )
+   {
+      ThreadMutex_set(&tcPageLock);
+      TcPageHeap_free(s);
+      ThreadMutex_release(&tcPageLock);
+      return;
+   }
+#ifndef TCALLOC_NO_CACHE
+   {
+      TcCache* o = tcCache;
+      if(o)
+      {
+         TcFreeList* fl = o->lists + c;
+         *(void**)mem = fl->list;
+         fl->list = mem;
+         fl->len++;
+         o->size += tcClassSize[c];
+         if(fl->len > 2U * tcClassBatch[c])
+            TcCache_releaseList(o, c, tcClassBatch[c]);
+         if(o->size > TCALLOC_MAX_THREAD_CACHE)
+            TcCache_scavenge(o);
+         return;
+      }
+   }
+#endif
+   *(void**)mem = 0;
+   TcCentral_release(c, mem);
+}
+
+
+void*
+tcrealloc(void* oldmem, size_t bytes)
+{
+   TcSpan* s;
+   size_t oldSize;
+   void* mem;
+   if( ! oldmem )
+      return tcalloc(bytes);
+   if( ! bytes )
+   {
+      tcfree(oldmem);
+      return 0;
+   }
+   s = TcSpan_fromPtr(oldmem);
+   if(s->sizeClass)
+   {
+      oldSize = tcClassSize[s->sizeClass];
+      if(bytes <= TC_MAX_SMALL &&
+         tcClassIx[(bytes + TC_ALIGN - 1) / TC_ALIGN] == s->sizeClass)
+      {
+         return oldmem;
+      }
+   }
+   else
+   {
+      oldSize = (size_t)s->npages << TC_PAGE_SHIFT;
+      if(bytes > TC_MAX_SMALL && bytes <= oldSize && bytes > oldSize/2)
+         return oldmem;
+   }
+   mem = tcalloc(bytes);
+   if(mem)
+   {
+      memcpy(mem, oldmem, bytes < oldSize ? bytes : oldSize);
+      tcfree(oldmem);
+   }
+   return mem;
+}
+
+
+void
+tcalloc_flushThreadCache(void)
+{
+#ifndef TCALLOC_NO_CACHE
+   TcCache* o = tcCache;
+   if(o)
+   {
+      TcCache_flush(o);
+      tcCache = 0;
+#ifdef BA_POSIX
+      /* Prevent the thread exit destructor from releasing it again */
+      pthread_setspecific(tcCacheKey, 0);
+#endif
+      /* The cache object itself goes back to the central list */
+      *(void**)o = 0;
+      TcCentral_release(TcSpan_fromPtr(o)->sizeClass, o);
+   }
+#endif
+}
+
+
+size_t
+tcalloc_freePages(void)
+{
+   size_t n;
+   ThreadMutex_set(&tcPageLock);
+   n = tcFreeBytes;
+   ThreadMutex_release(&tcPageLock);
+   return n;
+}
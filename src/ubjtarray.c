@@ -0,0 +1,202 @@
+/*
+ *     ____             _________                __                _
+ *    / __ \___  ____ _/ /_  __(_)___ ___  ___  / /   ____  ____ _(_)____
+ *   / /_/ / _ \/ __ `/ / / / / / __ `__ \/ _ \/ /   / __ \/ __ `/ / ___/
+ *  / _, _/  __/ /_/ / / / / / / / / / / /  __/ /___/ /_/ / /_/ / / /__
+ * /_/ |_|\___/\__,_/_/ /_/ /_/_/ /_/ /_/\___/_____/\____/\__, /_/\___/
+ *                                                       /____/
+ *
+ *                  Barracuda Embedded Web-Server
+ ****************************************************************************
+ *            PROGRAM MODULE
+ *
+ *   $Id$
+ *
+ *   COPYRIGHT:  Real Time Logic, 2026
+ *   This software is copyrighted by and is the sole property of Real
+ *   Time Logic LLC.  All rights, title, ownership, or other interests in
+ *   the software remain the property of Real Time Logic LLC.  This
+ *   software may only be used in accordance with the terms and
+ *   conditions stipulated in the corresponding license agreement under
+ *   which the software has been supplied.  Any unauthorized use,
+ *   duplication, transmission, distribution, or disclosure of this
+ *   software is expressly forbidden.
+ *
+ *   This Copyright notice may not be removed or modified without prior
+ *   written consent of Real Time Logic LLC.
+ *
+ *   Real Time Logic LLC. reserves the right to modify this software
+ *   without notice.
+ *
+ *               http://www.realtimelogic.com
+ ****************************************************************************
+
+UBJSON optimized strongly typed arrays: bulk encoding and decoding of
+C number arrays. See UBJEncoder_typedArray and UBJ_typedArrayHeader in
+inc/ubjson.h.
+*/
+
+#include <string.h>
+#include "ubjson.h"
+
+
+/* Copy 'n' elements of 'size' bytes, reversing the byte order when
+   the host is not big endian. The loads and stores are byte order
+   independent; the compiler reduces them to byte swap instructions.
+*/
+static void
+UBJ_copyBE(U8* dest, const U8* src, int size, S32 n)
+{
+#ifdef B_BIG_ENDIAN
+   memcpy(dest, src, (size_t)size * n);
+#else
+   S32 i;
+   switch(size)
+   {
+      case 1:
+         memcpy(dest, src, n);
+         break;
+      case 2:
+         for(i=0 ; i < n ; i++, src+=2, dest+=2)
+         {
+            U16 v = (U16)((src[0] << 8) | src[1]);
+            memcpy(dest, &v, 2);
+         }
+         break;
+      case 4:
+         for(i=0 ; i < n ; i++, src+=4, dest+=4)
+         {
+            U32 v = ((U32)src[0] << 24) | ((U32)src[1] << 16) |
+               ((U32)src[2] << 8) | src[3];
+            memcpy(dest, &v, 4);
+         }
+         break;
+      default:
+         for(i=0 ; i < n ; i++, src+=8, dest+=8)
+         {
+            U64 v = ((U64)src[0] << 56) | ((U64)src[1] << 48) |
+               ((U64)src[2] << 40) | ((U64)src[3] << 32) |
+               ((U64)src[4] << 24) | ((U64)src[5] << 16) |
+               ((U64)src[6] << 8) | src[7];
+            memcpy(dest, &v, 8);
+         }
+   }
+#endif
+}
+
+
+/* Same as UBJ_copyBE, but from host byte order to big endian */
+static void
+UBJ_copyToBE(U8* dest, const U8* src, int size, S32 n)
+{
+#ifdef B_BIG_ENDIAN
+   memcpy(dest, src, (size_t)size * n);
+#else
+   S32 i;
+   int j;
+   switch(size)
+   {
+      case 1:
+         memcpy(dest, src, n);
+         break;
+      case 2:
+         for(i=0 ; i < n ; i++, src+=2, dest+=2)
+         {
+            U16 v;
+            memcpy(&v, src, 2);
+            dest[0] = (U8)(v >> 8);
+            dest[1] = (U8)v;
+         }
+         break;
+      case 4:
+         for(i=0 ; i < n ; i++, src+=4, dest+=4)
+         {
+            U32 v;
+            memcpy(&v, src, 4);
+            for(j=3 ; j >= 0 ; j--, v >>= 8)
+               dest[j] = (U8)v;
+         }
+         break;
+      default:
+         for(i=0 ; i < n ; i++, src+=8, dest+=8)
+         {
+            U64 v;
+            memcpy(&v, src, 8);
+            for(j=7 ; j >= 0 ; j--, v >>= 8)
+               dest[j] = (U8)v;
+         }
+   }
+#endif
+}
+
+
+int
+UBJEncoder_typedArray(UBJEncoder* o, UBJT type, const void* data, S32 count)
+{
+   UBJEBuf* b = o->buf;
+   const U8* src = (const U8*)data;
+   int size = UBJT_size(type);
+   if( ! size || count < 0 )
+      return UBJEncoder_setStatus(o, UBJEStatus_TypeMismatch);
+   if(UBJEncoder_beginArray(o, count, type))
+      return o->status;
+   while(count)
+   {
+      S32 n = (b->dlen - b->cursor) / size;
+      if( ! n )
+      {
+         if(b->flushCB(b, count * size) || b->dlen - b->cursor < size)
+            return UBJEncoder_setStatus(o, UBJEStatus_FlushErr);
+         continue;
+      }
+      if(n > count)
+         n = count;
+      UBJ_copyToBE(b->data + b->cursor, src, size, n);
+      b->cursor += n * size;
+      src += n * size;
+      count -= n;
+   }
+   return UBJEncoder_endArray(o);
+}
+
+
+int
+UBJ_typedArrayHeader(const U8* buf, U32 size, UBJT* type, S32* count)
+{
+   U64 v=0;
+   U32 i, len;
+   if(size < 5)
+      return 0;
+   if(buf[0] != UBJT_BeginArray || buf[1] != '$' || ! UBJT_size(buf[2]) ||
+      buf[3] != UBJT_Count)
+   {
+      return -1;
+   }
+   switch(buf[4])
+   {
+      case UBJT_Int8:
+      case UBJT_Uint8: len = 1; break;
+      case UBJT_Int16: len = 2; break;
+      case UBJT_Int32: len = 4; break;
+      case UBJT_Int64: len = 8; break;
+      default: return -1;
+   }
+   if(size < 5 + len)
+      return 0;
+   for(i=0 ; i < len ; i++)
+      v = (v << 8) | buf[5+i];
+   if(buf[4] != UBJT_Uint8 && (v >> (len * 8 - 1)) & 1)
+      return -1; /* negative */
+   if(v > 0x7FFFFFFF)
+      return -1;
+   *type = (UBJT)buf[2];
+   *count = (S32)v;
+   return (int)(5 + len);
+}
+
+
+void
+UBJ_typedArrayCopy(void* dest, const U8* src, UBJT type, S32 count)
+{
+   UBJ_copyBE((U8*)dest, src, UBJT_size(type), count);
+}